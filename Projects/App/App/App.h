@@ -3,6 +3,7 @@
 #include "GlfwWindow.h"
 #include "AppTypes.h"
 #include "AssImpModelLoaderService.h"
+#include "CachedModelLoaderService.h"
 #include "FpsCounter.h"
 #include "UI/UiPresenter.h"
 #include "ImGuiVulkanGlfw.h"
@@ -66,12 +67,15 @@ public: // METHODS
 	{
 		// Services
 		auto window = std::make_unique<GlfwWindow>();
-		auto modelLoaderService = std::make_unique<AssimpModelLoaderService>();
+		auto modelLoaderService = std::make_unique<CachedModelLoaderService>(
+			std::make_unique<AssimpModelLoaderService>(), options.CacheDir,
+			AssimpModelLoaderService::ImportFlags, AssimpModelLoaderService::PostProcessVersion);
 
 		const auto builder = std::make_unique<GlfwVkSurfaceBuilder>(window->GetGlfwWindow());
 		const auto size = window->GetFramebufferSize();
 		const auto framebufferSize = VkExtent2D{size.Width, size.Height};
-		auto vulkanService = std::make_unique<VulkanService>(options.EnabledVulkanValidationLayers, options.VSync, options.UseMsaa, this, builder.get(), framebufferSize);
+		auto vulkanService = std::make_unique<VulkanService>(options.EnabledVulkanValidationLayers, options.VSync, options.UseMsaa, this, builder.get(), framebufferSize,
+			options.CacheDir + "PipelineCache.bin");
 
 		auto imgui = std::make_unique<ImGuiVulkanGlfw>(window->GetGlfwWindow(), vulkanService.get());
 		
@@ -80,7 +84,7 @@ public: // METHODS
 		auto library = std::make_unique<LibraryManager>(*this, *scene, *modelLoaderService, options.AssetsDir);
 
 		// UI
-		auto ui = std::make_unique<UiPresenter>(*this, *library, *scene, *vulkanService, window.get(), options.ShaderDir, options.AssetsDir, *modelLoaderService);
+		auto ui = std::make_unique<UiPresenter>(*this, *library, *scene, *vulkanService, window.get(), options.ShaderDir, options.AssetsDir, options.CacheDir, *modelLoaderService);
 
 		
 		// Set all teh things
@@ -140,8 +144,18 @@ private: // METHODS
 			_fpsCounter.AddFrameTime(dt);
 			if ((currentTime - _lastFpsUpdate) > _reportFpsRate)
 			{
-				char title[32];
-				snprintf(title, 32, "Flux - %.1f fps", _fpsCounter.GetFps());
+				const auto& stats = _ui->HACK_GetForwardRendererRef().GetFrameStats();
+				char title[448];
+				snprintf(title, 448, "Flux - %.1f fps - %u/%u visible, %u/%u casters, %u/%u cascades drawn - %u draws, %u instances - %u descriptor writes - %u binds, %u skipped - %u lights, %u cluster refs%s - %u decoding, last %u in %.0f ms - %u pipelines in %.0f ms",
+					_fpsCounter.GetFps(),
+					stats.ObjectsVisible, stats.ObjectsVisible + stats.ObjectsCulled,
+					stats.ShadowCastersVisible, stats.ShadowCastersVisible + stats.ShadowCastersCulled,
+					stats.ShadowCascadesDrawn, stats.ShadowCascades,
+					stats.DrawCalls, stats.Instances, stats.MaterialDescriptorWrites + stats.FrameDescriptorWrites,
+					stats.StateBinds, stats.StateBindsSkipped, stats.PointLightsVisible, stats.LightClusterRefs,
+					stats.LightClustersTruncated ? " (truncated)" : "",
+					stats.TexturesDecoding, stats.LastDecodeBatchCount, stats.LastDecodeBatchMs,
+					stats.PipelinesCreated, stats.PipelineCreateMs);
 				_window->SetWindowTitle(title);
 				_lastFpsUpdate = currentTime;
 			}
@@ -274,9 +288,9 @@ private: // METHODS
 		return _ui->HACK_GetForwardRendererRef().Hack_CreateTextureResource(path);
 	}
 
-	IblTextureResourceIds CreateIblTextureResources(const std::string& path) override
+	IblTextureResourceIds CreateIblTextureResources(const std::string& path, IblQuality quality) override
 	{
-		return _ui->HACK_GetForwardRendererRef().CreateIblTextureResources(path);
+		return _ui->HACK_GetForwardRendererRef().CreateIblTextureResources(path, quality);
 	}
 	SkyboxResourceId CreateSkybox(const SkyboxCreateInfo& createInfo) override
 	{
@@ -10,6 +10,7 @@ struct AppOptions
 	std::string AssetsDir{};
 	std::string ModelsDir{};
 	std::string IblDir{};
+	std::string CacheDir{};
 	bool EnabledVulkanValidationLayers = false;
 	bool VSync = false;
 	bool LoadDemoScene = false;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "MeshOptimizer.h"
+
 #include <Framework/IModelLoaderService.h>
 #include <Framework/Material.h>
 #include <Framework/Vertex.h>
@@ -10,6 +12,7 @@
 
 #include <vector>
 #include <string>
+#include <iomanip>
 #include <iostream>
 
 
@@ -18,16 +21,27 @@
 class AssimpModelLoaderService final : public IModelLoaderService
 {
 public:
+	// Anything that changes the output of LoadModel must change this too, it's part of the model cache key
+	static constexpr u32 ImportFlags =
+		aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes;
+
+	// Welding and reordering are done by MeshOptimizer rather than aiProcess_JoinIdenticalVertices and friends
+	static constexpr u32 PostProcessVersion = MeshOptimizer::Version;
+
+private:
+	bool _dumpMaterials = false;
+	bool _dumpMeshStats = false; // Vertex counts and ACMR before and after MeshOptimizer
 
+public:
+	explicit AssimpModelLoaderService(bool dumpMaterials = false, bool dumpMeshStats = false)
+		: _dumpMaterials(dumpMaterials), _dumpMeshStats(dumpMeshStats) {}
+	
 	std::optional<ModelDefinition> LoadModel(const std::string& path) override
 	{
 		ModelDefinition modelDefinition{};
 
 		Assimp::Importer importer{};
-		const aiScene *scene = importer.ReadFile(path, 
-			aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes 
-			// | aiProcess_OptimizeMeshes | aiProcess_JoinIdenticalVertices  // TODO Experiment with more flags to optimise things
-		);
+		const aiScene *scene = importer.ReadFile(path, ImportFlags);
 
 		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 		{
@@ -35,13 +49,16 @@ public:
 			return std::nullopt;
 		}
 
-		std::cout << "\nDumping: " << path << std::endl;
-		DumpMaterialsToConsole(*scene);
+		if (_dumpMaterials)
+		{
+			std::cout << "\nDumping: " << path << std::endl;
+			DumpMaterialsToConsole(*scene);
+		}
 
 		const auto directory = path.substr(0, path.find_last_of("/\\") + 1); // TODO Use FileService to split path
 		
 		ProcessMaterials(modelDefinition, scene, directory);
-		ProcessNode(modelDefinition, scene->mRootNode, scene);
+		ProcessNode(modelDefinition, scene->mRootNode, scene, _dumpMeshStats);
 		
 		return modelDefinition;
 	}
@@ -70,14 +87,14 @@ private:
 
 	
 	static void ProcessNode(ModelDefinition& outModel, aiNode *node,
-		const aiScene *aiScene)
+		const aiScene *aiScene, bool dumpMeshStats)
 	{
 		// Process all the meshes in this node
 		for (unsigned int i = 0; i < node->mNumMeshes; ++i)
 		{
 			const u32 mId = node->mMeshes[i];
 			aiMesh* aiMesh = aiScene->mMeshes[mId];
-			MeshDefinition meshDef = ProcessMesh(aiMesh, aiScene);
+			MeshDefinition meshDef = ProcessMesh(aiMesh, aiScene, dumpMeshStats);
 			outModel.Meshes.emplace_back(std::move(meshDef));
 		}
 
@@ -85,11 +102,11 @@ private:
 		for (unsigned int i = 0; i < node->mNumChildren; ++i)
 		{
 			aiNode* child = node->mChildren[i];
-			ProcessNode(outModel, child, aiScene);
+			ProcessNode(outModel, child, aiScene, dumpMeshStats);
 		}
 	}
 	
-	static MeshDefinition ProcessMesh(aiMesh* mesh, const aiScene* aiScene)
+	static MeshDefinition ProcessMesh(aiMesh* mesh, const aiScene* aiScene, bool dumpMeshStats)
 	{
 		MeshDefinition meshDefinition{};
 
@@ -165,6 +182,18 @@ private:
 
 		// Compute AABB
 		meshDefinition.Bounds = AABB{ positions };
+
+
+		const auto stats = MeshOptimizer::Optimize(meshDefinition);
+		if (dumpMeshStats)
+		{
+			std::cout << std::fixed << std::setprecision(3)
+				<< "Optimized mesh '" << meshDefinition.Name << "': "
+				<< stats.VerticesBefore << " -> " << stats.VerticesAfter << " verts, ACMR "
+				<< stats.AcmrBefore << " -> " << stats.AcmrAfter
+				<< (stats.VerticesAfter <= 0x10000 ? ", 16-bit indices\n" : "\n")
+				<< std::defaultfloat;
+		}
 		
 		return meshDefinition;
 	}
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <Framework/IModelLoaderService.h>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Wraps another model loader with an on disk cache of the ModelDefinitions it produces. Entries are keyed by source
+// path, source modified time and the wrapped loader's import flags and version, so touching a model or changing how
+// it's imported falls back to a fresh import that rewrites the entry.
+//
+// The file is a fixed header followed by 16 byte aligned blocks in the same layout as the in memory arrays. A warm load
+// is a single read followed by one memcpy per vertex and index array, no parsing.
+class CachedModelLoaderService final : public IModelLoaderService
+{
+private: // Types
+	static constexpr u32 Magic = 0x434D5846; // "FXMC"
+	static constexpr u32 FormatVersion = 2;
+	static constexpr size_t BlockAlignment = 16;
+
+	struct FileHeader
+	{
+		u32 Magic;
+		u32 FormatVersion;
+		u32 VertexSize;
+		u32 ImportFlags;
+		u32 ImportVersion;
+		u32 Padding;
+		i64 SourceWriteTime;
+		u64 FileSize;
+		u32 MeshCount;
+		u32 MaterialCount;
+	};
+
+	static_assert(std::is_trivially_copyable_v<Vertex>);
+	static_assert(std::is_trivially_copyable_v<AABB>);
+	static_assert(std::is_trivially_copyable_v<FileHeader>);
+
+	class Writer
+	{
+	public:
+		std::vector<char> Bytes{};
+
+		void Raw(const void* data, size_t size)
+		{
+			const auto* bytes = (const char*)data;
+			Bytes.insert(Bytes.end(), bytes, bytes + size);
+		}
+		template <typename T> void Value(const T& value) { Raw(&value, sizeof(T)); }
+		void String(const std::string& str)
+		{
+			Value((u32)str.size());
+			Raw(str.data(), str.size());
+		}
+		template <typename T> void Block(const std::vector<T>& items)
+		{
+			Value((u64)items.size());
+			Bytes.resize((Bytes.size() + BlockAlignment - 1) / BlockAlignment * BlockAlignment, 0);
+			Raw(items.data(), items.size() * sizeof(T));
+		}
+	};
+
+	// Bounds checked cursor. Any overrun marks the reader failed rather than throwing, a bad entry is just a cache miss.
+	class Reader
+	{
+	private:
+		const char* _data;
+		size_t _size;
+		size_t _offset = 0;
+		bool _failed = false;
+
+	public:
+		Reader(const char* data, size_t size) : _data(data), _size(size) {}
+
+		bool Failed() const { return _failed; }
+
+		bool Raw(void* dst, size_t size)
+		{
+			if (_failed || size > _size - _offset)
+			{
+				_failed = true;
+				return false;
+			}
+			memcpy(dst, _data + _offset, size);
+			_offset += size;
+			return true;
+		}
+		template <typename T> T Value()
+		{
+			T value{};
+			Raw(&value, sizeof(T));
+			return value;
+		}
+		std::string String()
+		{
+			const auto size = Value<u32>();
+			if (_failed || size > _size - _offset)
+			{
+				_failed = true;
+				return {};
+			}
+			std::string str(_data + _offset, size);
+			_offset += size;
+			return str;
+		}
+		template <typename T> void Block(std::vector<T>& outItems)
+		{
+			const auto count = Value<u64>();
+			_offset = std::min(_size, (_offset + BlockAlignment - 1) / BlockAlignment * BlockAlignment);
+			if (_failed || count > (_size - _offset) / sizeof(T))
+			{
+				_failed = true;
+				return;
+			}
+			outItems.resize(count);
+			Raw(outItems.data(), count * sizeof(T));
+		}
+	};
+
+private: // Data
+	std::unique_ptr<IModelLoaderService> _inner;
+	std::filesystem::path _cacheDir;
+	u32 _importFlags;
+	u32 _importVersion;
+
+public: // Methods
+	// importFlags or importVersion must change whenever the wrapped loader would produce different output for the same file
+	CachedModelLoaderService(std::unique_ptr<IModelLoaderService> inner, const std::string& cacheDir, u32 importFlags,
+		u32 importVersion)
+		: _inner(std::move(inner)), _cacheDir(cacheDir), _importFlags(importFlags), _importVersion(importVersion)
+	{
+	}
+
+	std::optional<ModelDefinition> LoadModel(const std::string& path) override
+	{
+		using Clock = std::chrono::steady_clock;
+		const auto ElapsedMs = [](Clock::time_point since)
+		{
+			return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+		};
+
+		std::error_code ec;
+		const auto writeTime = std::filesystem::last_write_time(path, ec);
+		if (ec)
+		{
+			return _inner->LoadModel(path); // Let the wrapped loader report it
+		}
+		const i64 sourceWriteTime = writeTime.time_since_epoch().count();
+		const auto cachePath = CachePathFor(path);
+
+
+		const auto warmStart = Clock::now();
+		if (auto cached = TryReadCache(cachePath, path, sourceWriteTime))
+		{
+			std::cout << "Loaded " << path << " from model cache in " << ElapsedMs(warmStart) << " ms\n";
+			return cached;
+		}
+
+
+		const auto coldStart = Clock::now();
+		auto model = _inner->LoadModel(path);
+		if (!model)
+		{
+			return std::nullopt;
+		}
+		const auto importMs = ElapsedMs(coldStart);
+
+		WriteCache(cachePath, path, sourceWriteTime, *model);
+		std::cout << "Imported " << path << " in " << importMs << " ms, cached in " << ElapsedMs(coldStart) - importMs << " ms\n";
+
+		return model;
+	}
+
+private:
+	std::filesystem::path CachePathFor(const std::string& path) const
+	{
+		std::stringstream name;
+		name << std::hex << std::hash<std::string>{}(path) << ".fxmodel";
+		return _cacheDir / name.str();
+	}
+
+	std::optional<ModelDefinition> TryReadCache(const std::filesystem::path& cachePath, const std::string& sourcePath,
+		i64 sourceWriteTime) const
+	{
+		std::ifstream file(cachePath, std::ios::binary | std::ios::ate);
+		if (!file)
+		{
+			return std::nullopt;
+		}
+
+		const auto fileSize = (size_t)file.tellg();
+		if (fileSize < sizeof(FileHeader))
+		{
+			return std::nullopt;
+		}
+
+		std::vector<char> bytes(fileSize);
+		file.seekg(0);
+		if (!file.read(bytes.data(), fileSize))
+		{
+			return std::nullopt;
+		}
+
+		Reader reader{ bytes.data(), bytes.size() };
+
+		const auto header = reader.Value<FileHeader>();
+		if (header.Magic != Magic ||
+			header.FormatVersion != FormatVersion ||
+			header.VertexSize != sizeof(Vertex) ||
+			header.ImportFlags != _importFlags ||
+			header.ImportVersion != _importVersion ||
+			header.SourceWriteTime != sourceWriteTime ||
+			header.FileSize != fileSize ||
+			reader.String() != sourcePath) // Guards against hash collisions in the file name
+		{
+			return std::nullopt;
+		}
+
+		ModelDefinition model{};
+
+		model.Materials.resize(header.MaterialCount);
+		for (auto& material : model.Materials)
+		{
+			material.Name = reader.String();
+			material.Textures.resize(reader.Value<u32>());
+			for (auto& texture : material.Textures)
+			{
+				texture.Type = (TextureType)reader.Value<u32>();
+				texture.Path = reader.String();
+			}
+			if (reader.Failed())
+				return std::nullopt;
+		}
+
+		model.Meshes.resize(header.MeshCount);
+		for (auto& mesh : model.Meshes)
+		{
+			mesh.Name = reader.String();
+			mesh.Bounds = reader.Value<AABB>();
+			mesh.MaterialIndex = reader.Value<u32>();
+			reader.Block(mesh.Vertices);
+			reader.Block(mesh.Indices);
+			if (reader.Failed())
+				return std::nullopt;
+		}
+
+		return model;
+	}
+
+	void WriteCache(const std::filesystem::path& cachePath, const std::string& sourcePath, i64 sourceWriteTime,
+		const ModelDefinition& model) const
+	{
+		Writer writer{};
+
+		writer.Value(FileHeader{}); // Patched below once the size is known
+		writer.String(sourcePath);
+
+		for (const auto& material : model.Materials)
+		{
+			writer.String(material.Name);
+			writer.Value((u32)material.Textures.size());
+			for (const auto& texture : material.Textures)
+			{
+				writer.Value((u32)texture.Type);
+				writer.String(texture.Path);
+			}
+		}
+
+		for (const auto& mesh : model.Meshes)
+		{
+			writer.String(mesh.Name);
+			writer.Value(mesh.Bounds);
+			writer.Value(mesh.MaterialIndex);
+			writer.Block(mesh.Vertices);
+			writer.Block(mesh.Indices);
+		}
+
+		FileHeader header{};
+		header.Magic = Magic;
+		header.FormatVersion = FormatVersion;
+		header.VertexSize = sizeof(Vertex);
+		header.ImportFlags = _importFlags;
+		header.ImportVersion = _importVersion;
+		header.SourceWriteTime = sourceWriteTime;
+		header.FileSize = writer.Bytes.size();
+		header.MeshCount = (u32)model.Meshes.size();
+		header.MaterialCount = (u32)model.Materials.size();
+		memcpy(writer.Bytes.data(), &header, sizeof(FileHeader));
+
+
+		// Write to a temp file and swap it in, so an interrupted write never leaves a truncated entry behind
+		std::error_code ec;
+		std::filesystem::create_directories(_cacheDir, ec);
+
+		auto tempPath = cachePath;
+		tempPath += ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			if (!file || !file.write(writer.Bytes.data(), writer.Bytes.size()))
+			{
+				std::cerr << "Failed to write model cache: " << tempPath.string() << "\n";
+				return;
+			}
+		}
+
+		std::filesystem::rename(tempPath, cachePath, ec);
+		if (ec)
+		{
+			std::cerr << "Failed to write model cache: " << cachePath.string() << " - " << ec.message() << "\n";
+			std::filesystem::remove(tempPath, ec);
+		}
+	}
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+#include <Framework/IModelLoaderService.h>
+#include <Framework/Vertex.h>
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Import time mesh optimisation, run in this order:
+//   1. Weld bitwise identical vertices.
+//   2. Reorder triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation").
+//   3. Reorder clusters of those triangles so outward facing ones draw first, cutting overdraw (Sander et al.
+//      "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"). Skipped if it costs too much cache.
+//   4. Renumber vertices in first use order so vertex fetch walks memory linearly.
+class MeshOptimizer
+{
+public: // Types
+	struct Stats
+	{
+		u32 VerticesBefore = 0;
+		u32 VerticesAfter = 0;
+		f32 AcmrBefore = 0;
+		f32 AcmrAfter = 0;
+	};
+
+private: // Types
+	static constexpr u32 OptimizeCacheSize = 32;   // LRU size the Forsyth scoring targets
+	static constexpr u32 MeasureCacheSize = 16;    // FIFO size used to report ACMR, typical of real hardware
+	static constexpr f32 OverdrawAcmrThreshold = 1.05f; // Max ACMR growth accepted from the overdraw pass
+
+public: // Methods
+	// Bump when the output of Optimize changes, cached models are keyed on it
+	static constexpr u32 Version = 1;
+
+	static Stats Optimize(MeshDefinition& mesh)
+	{
+		Stats stats{};
+		stats.VerticesBefore = (u32)mesh.Vertices.size();
+		stats.AcmrBefore = Acmr(mesh.Indices, stats.VerticesBefore);
+
+		if (mesh.Indices.size() >= 3)
+		{
+			WeldVertices(mesh.Vertices, mesh.Indices);
+
+			const u32 vertexCount = (u32)mesh.Vertices.size();
+			auto cacheOrdered = OptimizeVertexCache(mesh.Indices, vertexCount);
+			const f32 cacheAcmr = Acmr(cacheOrdered, vertexCount);
+
+			auto overdrawOrdered = OptimizeOverdraw(cacheOrdered, mesh.Vertices);
+			mesh.Indices = Acmr(overdrawOrdered, vertexCount) <= cacheAcmr * OverdrawAcmrThreshold
+				? std::move(overdrawOrdered)
+				: std::move(cacheOrdered);
+
+			OptimizeVertexFetch(mesh.Vertices, mesh.Indices);
+		}
+
+		stats.VerticesAfter = (u32)mesh.Vertices.size();
+		stats.AcmrAfter = Acmr(mesh.Indices, stats.VerticesAfter);
+		return stats;
+	}
+
+	// Average cache miss ratio - vertex shader invocations per triangle. 3 is no reuse, ~0.5 is the best possible.
+	static f32 Acmr(const std::vector<u32>& indices, u32 vertexCount)
+	{
+		if (indices.size() < 3)
+			return 0;
+
+		// Ring of the last N vertices transformed. cacheTime[v] is when v entered it, so v hits if it entered within N.
+		std::vector<u32> cacheTime(vertexCount, 0);
+		u32 time = MeasureCacheSize + 1;
+		u32 misses = 0;
+
+		for (const u32 index : indices)
+		{
+			if (time - cacheTime[index] > MeasureCacheSize)
+			{
+				cacheTime[index] = time++;
+				misses++;
+			}
+		}
+
+		return (f32)misses / (f32)(indices.size() / 3);
+	}
+
+private:
+	static void WeldVertices(std::vector<Vertex>& vertices, std::vector<u32>& indices)
+	{
+		std::unordered_map<Vertex, u32> unique{};
+		unique.reserve(vertices.size());
+
+		std::vector<u32> remap(vertices.size());
+		std::vector<Vertex> welded{};
+		welded.reserve(vertices.size());
+
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const auto [it, inserted] = unique.try_emplace(vertices[i], (u32)welded.size());
+			if (inserted)
+			{
+				welded.push_back(vertices[i]);
+			}
+			remap[i] = it->second;
+		}
+
+		for (auto& index : indices)
+		{
+			index = remap[index];
+		}
+		vertices = std::move(welded);
+	}
+
+	static f32 VertexScore(i32 cachePosition, u32 remainingTriangles)
+	{
+		if (remainingTriangles == 0)
+			return -1.f;
+
+		f32 score = 0;
+		if (cachePosition >= 0)
+		{
+			// The last triangle's vertices get a fixed score so the next triangle doesn't simply reuse its edge forever
+			score = cachePosition < 3
+				? 0.75f
+				: std::pow(1.f - (f32)(cachePosition - 3) / (f32)(OptimizeCacheSize - 3), 1.5f);
+		}
+
+		// Favour vertices with few triangles left, so isolated ones get finished off instead of stranded
+		return score + 2.f / std::sqrt((f32)remainingTriangles);
+	}
+
+	static std::vector<u32> OptimizeVertexCache(const std::vector<u32>& indices, u32 vertexCount)
+	{
+		const u32 triangleCount = (u32)indices.size() / 3;
+
+		// Vertex -> triangle adjacency, packed
+		std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+		for (const u32 index : indices)
+		{
+			adjacencyOffsets[index + 1]++;
+		}
+		std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+		std::vector<u32> adjacency(indices.size());
+		std::vector<u32> remaining(vertexCount, 0); // Triangles not yet emitted, which are kept at the front of the list
+		for (u32 t = 0; t < triangleCount; t++)
+		{
+			for (u32 k = 0; k < 3; k++)
+			{
+				const u32 v = indices[t * 3 + k];
+				adjacency[adjacencyOffsets[v] + remaining[v]++] = t;
+			}
+		}
+
+		std::vector<i32> cachePosition(vertexCount, -1);
+		std::vector<f32> vertexScore(vertexCount);
+		for (u32 v = 0; v < vertexCount; v++)
+		{
+			vertexScore[v] = VertexScore(-1, remaining[v]);
+		}
+
+		std::vector<f32> triangleScore(triangleCount);
+		std::vector<bool> emitted(triangleCount, false);
+		for (u32 t = 0; t < triangleCount; t++)
+		{
+			triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		}
+
+		std::vector<u32> cache{};
+		std::vector<u32> nextCache{};
+		cache.reserve(OptimizeCacheSize + 3);
+		nextCache.reserve(OptimizeCacheSize + 3);
+
+		std::vector<u32> result{};
+		result.reserve(indices.size());
+
+		i64 bestTriangle = -1;
+		u32 scanCursor = 0;
+
+		for (u32 emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+		{
+			// Nothing in the cache has triangles left, fall back to the best unemitted triangle in input order
+			if (bestTriangle < 0)
+			{
+				while (emitted[scanCursor])
+					scanCursor++;
+
+				f32 bestScore = -1;
+				for (u32 t = scanCursor; t < triangleCount; t++)
+				{
+					if (!emitted[t] && triangleScore[t] > bestScore)
+					{
+						bestScore = triangleScore[t];
+						bestTriangle = t;
+
+						if (bestScore >= 3 * VertexScore(-1, 1))
+							break; // Can't do better than a fully isolated triangle
+					}
+				}
+			}
+
+			const u32 tri = (u32)bestTriangle;
+			emitted[tri] = true;
+
+			// Emit and detach from each vertex's live triangle list
+			nextCache.clear();
+			for (u32 k = 0; k < 3; k++)
+			{
+				const u32 v = indices[tri * 3 + k];
+				result.push_back(v);
+				nextCache.push_back(v);
+
+				u32* begin = adjacency.data() + adjacencyOffsets[v];
+				u32* end = begin + remaining[v];
+				*std::find(begin, end, tri) = *(end - 1);
+				remaining[v]--;
+			}
+
+			// Move the triangle's vertices to the front of the LRU
+			for (const u32 v : cache)
+			{
+				if (v != nextCache[0] && v != nextCache[1] && v != nextCache[2])
+					nextCache.push_back(v);
+			}
+			std::swap(cache, nextCache);
+
+			// Rescore everything whose cache position changed, including those just evicted
+			for (u32 i = 0; i < (u32)cache.size(); i++)
+			{
+				const u32 v = cache[i];
+				cachePosition[v] = i < OptimizeCacheSize ? (i32)i : -1;
+				vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+			}
+
+			// Pick the next triangle from those touching the cache
+			bestTriangle = -1;
+			f32 bestScore = -1;
+			for (const u32 v : cache)
+			{
+				for (u32 a = adjacencyOffsets[v]; a < adjacencyOffsets[v] + remaining[v]; a++)
+				{
+					const u32 t = adjacency[a];
+					const f32 score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+					triangleScore[t] = score;
+
+					if (score > bestScore)
+					{
+						bestScore = score;
+						bestTriangle = t;
+					}
+				}
+			}
+
+			if (cache.size() > OptimizeCacheSize)
+			{
+				cache.resize(OptimizeCacheSize);
+			}
+		}
+
+		return result;
+	}
+
+	static std::vector<u32> OptimizeOverdraw(const std::vector<u32>& indices, const std::vector<Vertex>& vertices)
+	{
+		const u32 triangleCount = (u32)indices.size() / 3;
+
+		// Split into clusters where the cache order restarts, i.e. a triangle misses on all three vertices. Reordering
+		// whole clusters leaves the locality inside each one intact.
+		std::vector<u32> clusterStarts{};
+		{
+			std::vector<u32> cacheTime(vertices.size(), 0);
+			u32 time = MeasureCacheSize + 1;
+
+			for (u32 t = 0; t < triangleCount; t++)
+			{
+				u32 misses = 0;
+				for (u32 k = 0; k < 3; k++)
+				{
+					const u32 v = indices[t * 3 + k];
+					if (time - cacheTime[v] > MeasureCacheSize)
+					{
+						cacheTime[v] = time++;
+						misses++;
+					}
+				}
+
+				if (t == 0 || misses == 3)
+					clusterStarts.push_back(t);
+			}
+		}
+		const u32 clusterCount = (u32)clusterStarts.size();
+		clusterStarts.push_back(triangleCount);
+
+		if (clusterCount < 2)
+			return indices;
+
+
+		// Mesh centroid, weighting triangles by area
+		glm::vec3 meshCentroid{ 0 };
+		f32 meshArea = 0;
+
+		std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3{ 0 });
+		std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3{ 0 });
+
+		for (u32 c = 0; c < clusterCount; c++)
+		{
+			f32 clusterArea = 0;
+			for (u32 t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+			{
+				const glm::vec3& p0 = vertices[indices[t * 3]].Pos;
+				const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Pos;
+				const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Pos;
+
+				const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // Length is twice the area
+				const f32 area = glm::length(normal);
+				const glm::vec3 centroid = (p0 + p1 + p2) / 3.f;
+
+				clusterCentroid[c] += centroid * area;
+				clusterNormal[c] += normal;
+				clusterArea += area;
+			}
+
+			meshCentroid += clusterCentroid[c];
+			meshArea += clusterArea;
+			clusterCentroid[c] = clusterArea > 0 ? clusterCentroid[c] / clusterArea : clusterCentroid[c];
+		}
+		meshCentroid = meshArea > 0 ? meshCentroid / meshArea : meshCentroid;
+
+
+		// Clusters facing away from the centre are more likely to be in front, so draw them first
+		std::vector<f32> clusterSortKey(clusterCount);
+		for (u32 c = 0; c < clusterCount; c++)
+		{
+			const f32 normalLength = glm::length(clusterNormal[c]);
+			clusterSortKey[c] = normalLength > 0
+				? glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c] / normalLength)
+				: 0.f;
+		}
+
+		std::vector<u32> clusterOrder(clusterCount);
+		std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+		std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+			[&](u32 a, u32 b) { return clusterSortKey[a] > clusterSortKey[b]; });
+
+		std::vector<u32> result{};
+		result.reserve(indices.size());
+		for (const u32 c : clusterOrder)
+		{
+			result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+		}
+		return result;
+	}
+
+	static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<u32>& indices)
+	{
+		constexpr u32 Unassigned = 0xFFFFFFFF;
+		std::vector<u32> remap(vertices.size(), Unassigned);
+		std::vector<Vertex> ordered{};
+		ordered.reserve(vertices.size());
+
+		for (auto& index : indices)
+		{
+			if (remap[index] == Unassigned)
+			{
+				remap[index] = (u32)ordered.size();
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		vertices = std::move(ordered); // Unreferenced vertices are dropped
+	}
+};
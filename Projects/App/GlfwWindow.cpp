@@ -25,6 +25,7 @@ GlfwWindow::GlfwWindow()
 	glfwSetKeyCallback(_window, KeyCallback);
 	glfwSetCursorPosCallback(_window, CursorPosCallback);
 	glfwSetScrollCallback(_window, ScrollCallback);
+	glfwSetMouseButtonCallback(_window, MouseButtonCallback);
 }
 
 GlfwWindow::~GlfwWindow()
@@ -156,6 +157,24 @@ void GlfwWindow::OnScrollChanged(f64 xOffset, f64 yOffset)
 	PointerWheelChanged.Invoke(this, args);
 }
 
+void GlfwWindow::OnMouseButton(int button, int action, int mods)
+{
+	const auto buttonAction = ToMouseButtonState(action);
+	
+	auto props = PointerPointProperties{};
+	props.UpdateKind = ToPointerUpdateKind(ToMouseButton(button), buttonAction);
+	const auto args = PointerEventArgs{PointerPoint{_mousePos, props}};
+
+	if (buttonAction == MouseButtonAction::Pressed)
+	{
+		PointerPressed.Invoke(this, args);
+	}
+	else
+	{
+		PointerReleased.Invoke(this, args);
+	}
+}
+
 void GlfwWindow::ScrollCallback(GLFWwindow* window, f64 xOffset, f64 yOffset)
 {
 	g_window_map[window]->OnScrollChanged(xOffset, yOffset);
@@ -171,6 +190,11 @@ void GlfwWindow::CursorPosCallback(GLFWwindow* window, double xPos, double yPos)
 	g_window_map[window]->OnCursorPosChanged(xPos, yPos);
 }
 
+void GlfwWindow::MouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+	g_window_map[window]->OnMouseButton(button, action, mods);
+}
+
 void GlfwWindow::WindowSizeCallback(GLFWwindow* window, int width, int height)
 {
 	g_window_map[window]->OnWindowSizeChanged(width, height);
@@ -237,6 +261,20 @@ i32 GlfwWindow::ToGlfwButton(MouseButton button)
 	return (i32)button;
 }
 
+PointerUpdateKind GlfwWindow::ToPointerUpdateKind(MouseButton button, MouseButtonAction action)
+{
+	const bool pressed = action == MouseButtonAction::Pressed;
+	switch (button)
+	{
+	case MouseButton::Left:    return pressed ? PointerUpdateKind::LeftButtonPressed   : PointerUpdateKind::LeftButtonReleased;
+	case MouseButton::Right:   return pressed ? PointerUpdateKind::RightButtonPressed  : PointerUpdateKind::RightButtonReleased;
+	case MouseButton::Middle:  return pressed ? PointerUpdateKind::MiddleButtonPressed : PointerUpdateKind::MiddleButtonReleased;
+	case MouseButton::Button4: return pressed ? PointerUpdateKind::XButton1Pressed     : PointerUpdateKind::XButton1Released;
+	case MouseButton::Button5: return pressed ? PointerUpdateKind::XButton2Pressed     : PointerUpdateKind::XButton2Released;
+	default:                   return PointerUpdateKind::Other;
+	}
+}
+
 VirtualKey GlfwWindow::ToKey(i32 glfwKey)
 {
 	return (VirtualKey)glfwKey;
@@ -76,11 +76,13 @@ private: // Methods
 	void OnKeyCallback(int key, int scancode, int action, int mods);
 	void OnCursorPosChanged(f64 xPos, f64 yPos);
 	void OnScrollChanged(f64 xOffset, f64 yOffset);
+	void OnMouseButton(int button, int action, int mods);
 
 	// Callbacks
 	static void ScrollCallback(GLFWwindow* window, f64 xOffset, f64 yOffset);
 	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 	static void CursorPosCallback(GLFWwindow* window, double xPos, double yPos);
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 	static void WindowSizeCallback(GLFWwindow* window, int width, int height);
 	static void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
 	
@@ -93,6 +95,7 @@ private: // Methods
 
 	static MouseButton ToMouseButton(i32 glfwButton);
 	static i32 ToGlfwButton(MouseButton button);
+	static PointerUpdateKind ToPointerUpdateKind(MouseButton button, MouseButtonAction action);
 
 	static VirtualKey ToKey(i32 glfwKey);
 	static i32 ToGlfwKey(VirtualKey virtualKey);
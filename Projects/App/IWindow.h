@@ -225,6 +225,9 @@ struct PointerPointProperties
 
 	bool IsHorizonalMouseWheel = false;
 	f64 MouseWheelDelta = 0; // https://docs.microsoft.com/en-us/uwp/api/windows.ui.input.pointerpointproperties.mousewheeldelta?view=winrt-19041#Windows_UI_Input_PointerPointProperties_MouseWheelDelta
+
+	// Which button changed for PointerPressed/PointerReleased events
+	PointerUpdateKind UpdateKind = PointerUpdateKind::Other;
 };
 
 struct PointerPoint
@@ -287,8 +290,8 @@ public:
 	//Event<IWindow*, PointerEventArgs> PointerEntered;
 	//Event<IWindow*, PointerEventArgs> PointerExited;
 	Event<IWindow*, PointerEventArgs> PointerMoved;
-	//Event<IWindow*, PointerEventArgs> PointerPressed;
-	//Event<IWindow*, PointerEventArgs> PointerReleased;
+	Event<IWindow*, PointerEventArgs> PointerPressed;
+	Event<IWindow*, PointerEventArgs> PointerReleased;
 	
 	// Specifies the event that occurs when the mouse wheel is rotated.
 	Event<IWindow*, PointerEventArgs> PointerWheelChanged;
@@ -304,5 +307,7 @@ public:
 typedef std::function<void(IWindow* sender, WindowSizeChangedEventArgs args)> WindowSizeChangedDelegate;
 typedef std::function<void(IWindow* sender, PointerEventArgs args)> PointerMovedDelegate;
 typedef std::function<void(IWindow* sender, PointerEventArgs args)> PointerWheelChangedDelegate;
+typedef std::function<void(IWindow* sender, PointerEventArgs args)> PointerPressedDelegate;
+typedef std::function<void(IWindow* sender, PointerEventArgs args)> PointerReleasedDelegate;
 typedef std::function<void(IWindow* sender, KeyEventArgs args)> KeyDownDelegate;
 typedef std::function<void(IWindow* sender, KeyEventArgs args)> KeyUpDelegate;
@@ -104,7 +104,7 @@ ImGuiVulkanGlfw::ImGuiVulkanGlfw(GLFWwindow* window, VulkanService* vk)
 		initInfo.QueueFamily = vkh::FindQueueFamilies(vk->PhysicalDevice(), vk->Surface()).GraphicsAndComputeFamily.value();
 		// vomit
 		initInfo.Queue = vk->GraphicsQueue();
-		initInfo.PipelineCache = nullptr;
+		initInfo.PipelineCache = vk->GetPipelineCache().Handle();
 		initInfo.DescriptorPool = _imguiDescriptorPool;
 		initInfo.MinImageCount = minImageCount;
 		initInfo.ImageCount = imageCount;
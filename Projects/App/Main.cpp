@@ -12,6 +12,7 @@ int main()
 		options.AssetsDir = R"(../Data/Assets/)";
 		options.ModelsDir = R"(../Data/Assets/Models/)";
 		options.IblDir = R"(../Data/Assets/IBL/)";
+		options.CacheDir = R"(../Cache/)";
 		options.VSync = true;
 		options.UseMsaa = true;
 
@@ -36,6 +36,10 @@ void SceneView::BuildUI(const std::vector<Entity*>& ents, std::unordered_set<Ent
 		CameraPanel(headerFlags);
 		ImGui::Spacing();
 		ImGui::Spacing();
+
+		ShadowPanel(headerFlags);
+		ImGui::Spacing();
+		ImGui::Spacing();
 		
 		IblPanel(headerFlags);
 		ImGui::Spacing();
@@ -66,6 +70,8 @@ void SceneView::SceneLoadPanel(ImGuiTreeNodeFlags headerFlags) const
 			if (ImGui::Button("Demo Scene")) { _del->LoadDemoScene(); }
 			ImGui::SameLine();
 			if (ImGui::Button("Heavy Demo Scene")) { _del->LoadHeavyDemoScene(); }
+			ImGui::SameLine();
+			if (ImGui::Button("Light Stress Scene")) { _del->LoadLightStressScene(); }
 		}
 		ImGui::EndChild();
 	}
@@ -255,7 +261,7 @@ void SceneView::BackdropPanel(ImGuiTreeNodeFlags headerFlags) const
 	{
 		auto roCopy = _del->GetRenderOptions();
 
-		if (ImGui::BeginChild("Backdrop Panel", ImVec2{ 0,51 }, true))
+		if (ImGui::BeginChild("Backdrop Panel", ImVec2{ 0,74 }, true))
 		{
 			ImGui::PushItemWidth(50);
 			if (ImGui::DragFloat("Brightness", &roCopy.BackdropBrightness, .01f, 0, 10, "%0.2f")) {
@@ -264,6 +270,16 @@ void SceneView::BackdropPanel(ImGuiTreeNodeFlags headerFlags) const
 			ImGui::PopItemWidth();
 			
 			if (ImGui::Checkbox("Ambient Sky", &roCopy.ShowIrradiance)) _del->SetRenderOptions(roCopy);
+
+			// Applies to skyboxes loaded afterwards
+			int quality = (int)roCopy.SkyboxQuality;
+			ImGui::PushItemWidth(100);
+			if (ImGui::Combo("Skybox Quality", &quality, "Interactive\0Final\0"))
+			{
+				roCopy.SkyboxQuality = (IblQuality)quality;
+				_del->SetRenderOptions(roCopy);
+			}
+			ImGui::PopItemWidth();
 		}
 		ImGui::EndChild();
 	}
@@ -273,7 +289,7 @@ void SceneView::CameraPanel(ImGuiTreeNodeFlags headerFlags) const
 {
 	if (ImGui::CollapsingHeader("Camera", headerFlags))
 	{
-		if (ImGui::BeginChild("Camera Options", ImVec2{ 0,51 }, true))
+		if (ImGui::BeginChild("Camera Options", ImVec2{ 0,74 }, true))
 		{
 			auto roCopy = _del->GetRenderOptions();
 
@@ -282,12 +298,39 @@ void SceneView::CameraPanel(ImGuiTreeNodeFlags headerFlags) const
 			ImGui::PopItemWidth();
 
 			if (ImGui::Checkbox("Show Clipping", &roCopy.ShowClipping)) { _del->SetRenderOptions(roCopy); }
+			if (ImGui::Checkbox("Depth Prepass", &roCopy.DepthPrepass)) { _del->SetRenderOptions(roCopy); }
 		}
 		ImGui::EndChild();
 	}
 
 }
 
+void SceneView::ShadowPanel(ImGuiTreeNodeFlags headerFlags) const
+{
+	if (ImGui::CollapsingHeader("Shadows", headerFlags))
+	{
+		if (ImGui::BeginChild("Shadow Options", ImVec2{ 0,74 }, true))
+		{
+			auto roCopy = _del->GetRenderOptions();
+
+			ImGui::PushItemWidth(50);
+			if (ImGui::SliderInt("Cascades", &roCopy.ShadowCascadeCount, 1, 4)) { _del->SetRenderOptions(roCopy); }
+
+			const char* resolutions[] = { "1024", "2048", "4096" };
+			int current = roCopy.ShadowMapResolution <= 1024 ? 0 : roCopy.ShadowMapResolution <= 2048 ? 1 : 2;
+			if (ImGui::Combo("Resolution", &current, resolutions, 3))
+			{
+				roCopy.ShadowMapResolution = 1024 << current;
+				_del->SetRenderOptions(roCopy);
+			}
+
+			if (ImGui::DragFloat("Distance", &roCopy.ShadowDistance, 1.f, 10, 1000, "%0.0f")) { _del->SetRenderOptions(roCopy); }
+			ImGui::PopItemWidth();
+		}
+		ImGui::EndChild();
+	}
+}
+
 void SceneView::PostPanel(ImGuiTreeNodeFlags headerFlags) const
 {
 	if (ImGui::CollapsingHeader("Post-Processing", headerFlags))
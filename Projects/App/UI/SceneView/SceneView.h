@@ -19,6 +19,7 @@ public:
 	virtual ~ISceneViewDelegate() = default;
 	virtual void LoadDemoScene() = 0;
 	virtual void LoadHeavyDemoScene() = 0;
+	virtual void LoadLightStressScene() = 0;
 	virtual void LoadModel(const std::string& path) = 0;
 	virtual void CreateDirectionalLight() = 0;
 	virtual void CreatePointLight() = 0;
@@ -65,6 +66,7 @@ private:
 	void IblPanel(ImGuiTreeNodeFlags headerFlags) const;
 	void BackdropPanel(ImGuiTreeNodeFlags headerFlags) const;
 	void CameraPanel(ImGuiTreeNodeFlags headerFlags) const;
+	void ShadowPanel(ImGuiTreeNodeFlags headerFlags) const;
 	
 	void PostPanel(ImGuiTreeNodeFlags headerFlags) const;
 	void PostVignette() const;
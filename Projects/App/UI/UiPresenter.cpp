@@ -13,7 +13,7 @@
 #include <imgui/imgui_impl_glfw.h>
 #include <imgui/imgui_impl_vulkan.h>
 
-UiPresenter::UiPresenter(IUiPresenterDelegate& dgate, LibraryManager& library, SceneManager& scene, VulkanService& vulkan, IWindow* window, const std::string& shaderDir, const std::string& assetDir, IModelLoaderService& modelLoaderService) :
+UiPresenter::UiPresenter(IUiPresenterDelegate& dgate, LibraryManager& library, SceneManager& scene, VulkanService& vulkan, IWindow* window, const std::string& shaderDir, const std::string& assetDir, const std::string& cacheDir, IModelLoaderService& modelLoaderService) :
 	_delegate(dgate),
 	_scene{scene},
 	_library{library},
@@ -26,10 +26,12 @@ UiPresenter::UiPresenter(IUiPresenterDelegate& dgate, LibraryManager& library, S
 	_window->WindowSizeChanged.Attach(_windowSizeChangedHandler);
 	_window->PointerMoved.Attach(_pointerMovedHandler);
 	_window->PointerWheelChanged.Attach(_pointerWheelChangedHandler);
+	_window->PointerPressed.Attach(_pointerPressedHandler);
+	_window->PointerReleased.Attach(_pointerReleasedHandler);
 	_window->KeyDown.Attach(_keyDownHandler);
 	_window->KeyUp.Attach(_keyUpHandler);
 
-	_forwardRenderer = std::make_unique<ForwardRenderer>(_vk, _shaderDir, assetDir, modelLoaderService, 
+	_forwardRenderer = std::make_unique<ForwardRenderer>(_vk, _shaderDir, assetDir, cacheDir, modelLoaderService, 
 		Extent2D{ ViewportRect().Extent.Width, ViewportRect().Extent.Height });
 
 	_viewportView = ViewportView{this, _forwardRenderer.get()};
@@ -40,6 +42,8 @@ UiPresenter::~UiPresenter()
 	_window->WindowSizeChanged.Detach(_windowSizeChangedHandler);
 	_window->PointerMoved.Detach(_pointerMovedHandler);
 	_window->PointerWheelChanged.Detach(_pointerWheelChangedHandler);
+	_window->PointerPressed.Detach(_pointerPressedHandler);
+	_window->PointerReleased.Detach(_pointerReleasedHandler);
 	_window->KeyDown.Detach(_keyDownHandler);
 	_window->KeyUp.Detach(_keyUpHandler);
 }
@@ -272,36 +276,52 @@ void UiPresenter::Draw(u32 imageIndex, VkCommandBuffer commandBuffer)
 {
 	// Draw Scene
 	{
+		const auto& camera = _scene.GetCamera();
+		const auto view = camera.GetViewMatrix();
+
 		// Convert scene to render primitives
 		SceneRendererPrimitives scene = {};
-		for (const auto& entity : _scene.EntitiesView())
+		for (const auto& entity : _scene.LightEntitiesView())
 		{
-			if (entity->Renderable.has_value())
-			{
-				for (auto&& submesh : entity->Renderable->GetSubmeshes())
-				{
-					Material* mat = _scene.GetMaterial(submesh.MatId);
-					scene.Materials.emplace(mat);
-					
-					SceneRendererPrimitives::RenderableObject object = {
-						submesh.Id,
-						entity->Transform.GetMatrix(),
-						*mat
-					};
-					scene.Objects.emplace_back(object);
-				}
-			}
+			scene.Lights.emplace_back(Converters::ToLight(*entity));
+		}
+
+		// Only gather renderables the BVH says could land in the camera frustum or a shadow cascade
+		_scene.UpdateSpatialIndex();
+		scene.SceneBounds = _scene.GetSceneBounds();
+		_scene.TakeChangedBounds(scene.ChangedBounds);
+		_forwardRenderer->GetCullingFrusta(scene.Lights, view, scene.SceneBounds, GetRenderOptions(), _cullingFrusta);
+		_drawCandidates.clear();
+		for (const auto& frustum : _cullingFrusta)
+		{
+			_scene.QueryFrustum(frustum, _drawCandidates);
+		}
+		std::sort(_drawCandidates.begin(), _drawCandidates.end(), [](const Entity* a, const Entity* b) { return a->Id < b->Id; });
+		_drawCandidates.erase(std::unique(_drawCandidates.begin(), _drawCandidates.end()), _drawCandidates.end());
 
-			if (entity->Light.has_value())
+		for (Entity* entity : _drawCandidates)
+		{
+			const auto transform = entity->Transform.GetMatrix();
+			const auto worldBounds = entity->Renderable->GetBounds().Transform(transform); // Submeshes share the entity bounds
+			
+			for (auto&& submesh : entity->Renderable->GetSubmeshes())
 			{
-				scene.Lights.emplace_back(Converters::ToLight(*entity));
+				Material* mat = _scene.GetMaterial(submesh.MatId);
+				scene.Materials.emplace(mat);
+				
+				SceneRendererPrimitives::RenderableObject object = {
+					submesh.Id,
+					transform,
+					*mat,
+					worldBounds
+				};
+				scene.Objects.emplace_back(object);
 			}
 		}
 
 		// Get camera deets
-		const auto& camera = _scene.GetCamera();
 		scene.ViewPosition = camera.Position;
-		scene.ViewMatrix = camera.GetViewMatrix();
+		scene.ViewMatrix = view;
 		
 		_forwardRenderer->Draw(imageIndex, commandBuffer, scene, GetRenderOptions());
 	}
@@ -409,6 +429,14 @@ void UiPresenter::LoadHeavyDemoScene()
 	FrameSelectionOrAll();
 }
 
+void UiPresenter::LoadLightStressScene()
+{
+	printf("LoadLightStressScene()\n");
+	_library.LoadLightStressScene();
+	ClearSelection();
+	FrameSelectionOrAll();
+}
+
 void UiPresenter::LoadModel(const std::string& path)
 {
 	printf("LoadModel(%s)\n", path.c_str());
@@ -720,6 +748,65 @@ void UiPresenter::OnPointerMoved(IWindow* sender, PointerEventArgs args)
 		}
 	}
 }
+void UiPresenter::OnPointerPressed(IWindow* sender, PointerEventArgs args)
+{
+	if (args.CurrentPoint.Properties.UpdateKind != PointerUpdateKind::LeftButtonPressed)
+		return;
+
+	// TODO Refactor - this is ugly as it's accessing the gui's state in a global way.
+	ImGuiIO& io = ImGui::GetIO();
+	if (io.WantCaptureMouse)
+		return;
+
+	_pickPressPosition = args.CurrentPoint.Position;
+	_pickPending = true;
+}
+
+void UiPresenter::OnPointerReleased(IWindow* sender, PointerEventArgs args)
+{
+	if (args.CurrentPoint.Properties.UpdateKind != PointerUpdateKind::LeftButtonReleased || !_pickPending)
+		return;
+
+	_pickPending = false;
+
+	// LMB drags orbit the camera, so only treat it as a click if the pointer barely moved
+	const auto pos = args.CurrentPoint.Position;
+	const auto dx = pos.X - _pickPressPosition.X;
+	const auto dy = pos.Y - _pickPressPosition.Y;
+	if (dx*dx + dy*dy > 3.0*3.0)
+		return;
+
+	PickEntityAt(pos);
+}
+
+void UiPresenter::PickEntityAt(const Point2D& windowPos)
+{
+	const auto viewport = ViewportRect();
+	const f64 localX = windowPos.X - viewport.Offset.X;
+	const f64 localY = windowPos.Y - viewport.Offset.Y;
+	if (localX < 0 || localY < 0 || localX >= viewport.Extent.Width || localY >= viewport.Extent.Height)
+		return;
+
+	// Unproject the pixel through the renderer's projection. Its y flip means clip space y already points down.
+	const auto& camera = _scene.GetCamera();
+	const glm::mat4 invViewProj = glm::inverse(_forwardRenderer->GetProjectionMatrix() * camera.GetViewMatrix());
+	const glm::vec2 ndc{ 2.f * (f32)localX / viewport.Extent.Width - 1.f, 2.f * (f32)localY / viewport.Extent.Height - 1.f };
+
+	const glm::vec4 farPoint = invViewProj * glm::vec4{ ndc, 1.f, 1.f };
+	const glm::vec3 direction = glm::normalize(glm::vec3{ farPoint } / farPoint.w - camera.Position);
+
+	f32 distance;
+	Entity* hit = _scene.Raycast(camera.Position, direction, distance);
+	if (hit)
+	{
+		ReplaceSelection(hit);
+	}
+	else
+	{
+		ClearSelection();
+	}
+}
+
 void UiPresenter::OnWindowSizeChanged(IWindow* sender, const WindowSizeChangedEventArgs args)
 {
 	_vk.InvalidateSwapchain();
@@ -9,6 +9,7 @@
 #include "ViewportView/IViewportViewDelegate.h"
 #include "ViewportView/ViewportView.h"
 
+#include <Framework/Frustum.h>
 #include <Renderer/LowLevel/VulkanService.h>
 
 #include <chrono>
@@ -50,6 +51,8 @@ private: // DATA
 
 	bool _firstCursorInput = true;
 	f64 _lastCursorX{}, _lastCursorY{};
+	Point2D _pickPressPosition{};
+	bool _pickPending = false;
 
 	// PropsView helpers
 	int _selectedMaterialIndex = -1;
@@ -63,6 +66,10 @@ private: // DATA
 	u32 _activeSkybox = 0;
 	std::unordered_set<Entity*> _selection{};
 
+	// Draw scratch, kept to avoid per frame allocations
+	std::vector<Frustum> _cullingFrusta{};
+	std::vector<Entity*> _drawCandidates{};
+
 	// Layout
 	u32 _sceneViewWidth = 250;
 	u32 _propsViewWidth = 300;
@@ -75,6 +82,8 @@ private: // DATA
 	WindowSizeChangedDelegate _windowSizeChangedHandler = [this](auto* s, auto a) { OnWindowSizeChanged(s, a); };
 	PointerMovedDelegate _pointerMovedHandler = [this](auto* s, auto a) { OnPointerMoved(s, a); };
 	PointerWheelChangedDelegate _pointerWheelChangedHandler = [this](auto* s, auto a) { OnPointerWheelChanged(s, a); };
+	PointerPressedDelegate _pointerPressedHandler = [this](auto* s, auto a) { OnPointerPressed(s, a); };
+	PointerReleasedDelegate _pointerReleasedHandler = [this](auto* s, auto a) { OnPointerReleased(s, a); };
 	KeyDownDelegate _keyDownHandler = [this](auto* s, auto a) { OnKeyDown(s, a); };
 	KeyUpDelegate _keyUpHandler = [this](auto* s, auto a) { OnKeyUp(s, a); };
 	std::string _shaderDir;
@@ -82,7 +91,7 @@ private: // DATA
 
 public: // METHODS
 	
-	UiPresenter(IUiPresenterDelegate& dgate, LibraryManager& library, SceneManager& scene, VulkanService& vulkan, IWindow* window, const std::string& shaderDir, const std::string& assetDir, IModelLoaderService& modelLoaderService);
+	UiPresenter(IUiPresenterDelegate& dgate, LibraryManager& library, SceneManager& scene, VulkanService& vulkan, IWindow* window, const std::string& shaderDir, const std::string& assetDir, const std::string& cacheDir, IModelLoaderService& modelLoaderService);
 	~UiPresenter() override;
 	// Disable copy
 	UiPresenter(const UiPresenter&) = delete;
@@ -142,6 +151,7 @@ private: // METHODS
 
 	
 	void BuildImGui();
+	void PickEntityAt(const Point2D& windowPos);
 
 
 	// Event handlers
@@ -149,6 +159,8 @@ private: // METHODS
 	void OnKeyUp(IWindow* sender, KeyEventArgs args);
 	void OnPointerWheelChanged(IWindow* sender, PointerEventArgs args);
 	void OnPointerMoved(IWindow* sender, PointerEventArgs args);
+	void OnPointerPressed(IWindow* sender, PointerEventArgs args);
+	void OnPointerReleased(IWindow* sender, PointerEventArgs args);
 	void OnWindowSizeChanged(IWindow* sender, WindowSizeChangedEventArgs args);
 
 
@@ -156,6 +168,7 @@ private: // METHODS
 
 	void LoadDemoScene() override;
 	void LoadHeavyDemoScene() override;
+	void LoadLightStressScene() override;
 	void LoadModel(const std::string& path) override;
 
 	void CreateDirectionalLight() override;
@@ -3,7 +3,10 @@
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/common.hpp>
 
+#include <array>
+#include <cmath>
 #include <vector>
 
 struct AABB
@@ -34,9 +37,9 @@ struct AABB
 	
 	glm::vec3 Min() const { return _min; }
 	glm::vec3 Max() const { return _max; }
-	std::vector<glm::vec3> Corners() const
+	std::array<glm::vec3, 8> Corners() const
 	{
-		return std::vector<glm::vec3>
+		return std::array<glm::vec3, 8>
 		{
 			glm::vec3{ _min.x, _min.y, _min.z },
 			glm::vec3{ _max.x, _min.y, _min.z },
@@ -53,6 +56,47 @@ struct AABB
 	{
 		return (_max.x - _min.x) * (_max.y - _min.y) * (_max.z - _min.z);
 	}
+
+	float SurfaceArea() const
+	{
+		const glm::vec3 d = _max - _min;
+		return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	AABB Expand(float margin) const
+	{
+		return AABB{ _min - glm::vec3{ margin }, _max + glm::vec3{ margin } };
+	}
+
+	bool Overlaps(const AABB& other) const
+	{
+		return _min.x <= other._max.x && _max.x >= other._min.x &&
+			_min.y <= other._max.y && _max.y >= other._min.y &&
+			_min.z <= other._max.z && _max.z >= other._min.z;
+	}
+
+	bool Contains(const AABB& other) const
+	{
+		return _min.x <= other._min.x && _max.x >= other._max.x &&
+			_min.y <= other._min.y && _max.y >= other._max.y &&
+			_min.z <= other._min.z && _max.z >= other._max.z;
+	}
+
+	// Slab test. invDirection is 1/direction per component. On a hit outDistance is the entry distance, or 0 if the
+	// origin is inside the box.
+	bool IntersectsRay(const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& outDistance) const
+	{
+		const glm::vec3 t0 = (_min - origin) * invDirection;
+		const glm::vec3 t1 = (_max - origin) * invDirection;
+		const glm::vec3 tNear = glm::min(t0, t1);
+		const glm::vec3 tFar = glm::max(t0, t1);
+
+		const float entry = fmax(fmax(tNear.x, tNear.y), fmax(tNear.z, 0.f));
+		const float exit = fmin(fmin(tFar.x, tFar.y), fmin(tFar.z, maxDistance));
+		
+		outDistance = entry;
+		return entry <= exit;
+	}
 	
 	/*AABB Transform(const glm::mat3& transform) const
 	{
@@ -65,19 +109,24 @@ struct AABB
 	// TODO change this to create an oriented bounding box. The user can then create a bounding box from the OBB.
 	AABB Transform(const glm::mat4& transform) const
 	{
-		// Transform all corners of the AABB then create a new AABB from the transformed corners.
-		
-		auto corners = Corners();
-		std::vector<glm::vec3> cornersNew{};
-		for (auto& c : corners)
+		// Equivalent to bounding the 8 transformed corners: move the center, then project the half extents onto each
+		// world axis via the absolute rotation/scale. Affine transforms only.
+		const glm::vec3 center = glm::vec3{ transform * glm::vec4{ Center(), 1.f } };
+		const glm::vec3 extents = Extents();
+
+		glm::vec3 newExtents{};
+		for (int i = 0; i < 3; i++)
 		{
-			auto cn = glm::vec3{ transform * glm::vec4{ c, 1.f } };
-			cornersNew.emplace_back(cn);
+			newExtents[i] =
+				std::abs(transform[0][i]) * extents.x +
+				std::abs(transform[1][i]) * extents.y +
+				std::abs(transform[2][i]) * extents.z;
 		}
 		
-		return AABB{ cornersNew };
+		return AABB{ center - newExtents, center + newExtents };
 	}
 	glm::vec3 Center() const { return (_min + _max) / 2.f; }
+	glm::vec3 Extents() const { return (_max - _min) / 2.f; }
 
 	AABB Merge(const AABB& other) const
 	{
@@ -94,11 +143,11 @@ struct AABB
 		const glm::vec3 small{
 			fmin(a.Min().x, b.Min().x),
 			fmin(a.Min().y, b.Min().y),
-			fmin(a.Min().x, b.Min().z) };
+			fmin(a.Min().z, b.Min().z) };
 		const glm::vec3  big{
 			fmax(a.Max().x, b.Max().x),
 			fmax(a.Max().y, b.Max().y),
-			fmax(a.Max().x, b.Max().z) };
+			fmax(a.Max().z, b.Max().z) };
 		return AABB{ small, big };
 	}
 	
@@ -3,6 +3,8 @@
 #include "CommonTypes.h"
 #include <glm/vec3.hpp>
 
+#include <array>
+
 
 // TODO Move these back to the Renderer layer
 
@@ -24,6 +26,13 @@ struct VignetteOptions
 	float OuterRadius = 1.75f;
 };
 
+// Cost of the prefilter convolution run when a skybox is loaded
+enum class IblQuality
+{
+	Interactive, // Quarter resolution and few samples, for flicking between skyboxes
+	Final,
+};
+
 struct RenderOptions
 {
 	float ExposureBias = 1;
@@ -31,7 +40,12 @@ struct RenderOptions
 	float BackdropBrightness = 1.0f;;
 	float SkyboxRotation = 0; // degrees
 	bool ShowIrradiance = true;
+	IblQuality SkyboxQuality = IblQuality::Final; // Applies to skyboxes loaded afterwards
 	bool ShowClipping = false;
+	bool DepthPrepass = true; // Lay down opaque depth first so lighting runs once per pixel
+	int ShadowCascadeCount = 4; // 1 to 4
+	int ShadowMapResolution = 2048; // Per cascade
+	float ShadowDistance = 150; // View depth past which nothing is shadowed
 	VignetteOptions Vignette = {};
 	GrainOptions Grain = {};
 	//bool DrawDepth = false;
@@ -56,9 +70,9 @@ typedef TypedId<TextureIdType> TextureResourceId;
 struct IblTextureResourceIds
 {
 	TextureResourceId EnvironmentCubemapId;
-	TextureResourceId IrradianceCubemapId;
 	TextureResourceId PrefilterCubemapId;
 	TextureResourceId BrdfLutId;
+	std::array<glm::vec3, 9> IrradianceSh{}; // L2 spherical harmonics of the diffuse irradiance, see ShIrradiance
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
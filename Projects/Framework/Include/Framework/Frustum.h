@@ -0,0 +1,72 @@
+#pragma once
+
+#include "AABB.h"
+
+#include <glm/geometric.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
+
+struct Frustum
+{
+	Frustum() = default;
+
+	// Extracts the clip planes from a view-projection matrix (Gribb/Hartmann). Planes point inwards.
+	explicit Frustum(const glm::mat4& viewProjection)
+	{
+		const glm::mat4& m = viewProjection;
+		const glm::vec4 row0{ m[0][0], m[1][0], m[2][0], m[3][0] };
+		const glm::vec4 row1{ m[0][1], m[1][1], m[2][1], m[3][1] };
+		const glm::vec4 row2{ m[0][2], m[1][2], m[2][2], m[3][2] };
+		const glm::vec4 row3{ m[0][3], m[1][3], m[2][3], m[3][3] };
+
+		_planes[0] = row3 + row0; // left
+		_planes[1] = row3 - row0; // right
+		_planes[2] = row3 + row1; // bottom
+		_planes[3] = row3 - row1; // top
+		_planes[4] = row3 + row2; // near. Assumes -1..1 depth, which is conservative for 0..1 projections too.
+		_planes[5] = row3 - row2; // far
+
+		for (auto& plane : _planes)
+		{
+			plane /= glm::length(glm::vec3{ plane });
+		}
+	}
+
+	enum class Result { Outside, Intersecting, Inside };
+
+	// Outside only if the box is fully behind at least one plane, so boxes straddling a frustum corner can be kept
+	Result Classify(const AABB& box) const
+	{
+		const glm::vec3 center = box.Center();
+		const glm::vec3 extents = box.Extents();
+		auto result = Result::Inside;
+
+		for (const auto& plane : _planes)
+		{
+			const glm::vec3 normal{ plane };
+			const float radius = glm::dot(extents, glm::abs(normal));
+			const float distance = glm::dot(normal, center) + plane.w;
+			
+			if (distance < -radius)
+			{
+				return Result::Outside;
+			}
+			if (distance < radius)
+			{
+				result = Result::Intersecting;
+			}
+		}
+
+		return result;
+	}
+
+	bool Intersects(const AABB& box) const { return Classify(box) != Result::Outside; }
+
+	// Inward facing, normalized. Order: left, right, bottom, top, near, far.
+	const std::array<glm::vec4, 6>& Planes() const { return _planes; }
+
+private:
+	std::array<glm::vec4, 6> _planes{};
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The split sum environment BRDF: scale and bias to F0 for the specular IBL term, indexed by (NdotV, 1 - roughness) as
+// Pbr.frag samples it. It only depends on the BRDF, so one table serves every environment.
+//
+// Integrated on the CPU across a JobSystem, one row per job, and kept in the cache dir between runs. The sample loop
+// runs over structure of arrays halfway vectors without branches so the compiler can vectorise it. Pure CPU, no Vulkan
+// use.
+class BrdfLut final
+{
+public: // Types
+	static constexpr u32 Dim = 512;
+	static constexpr u32 SampleCount = 1024; // Hammersley points per texel
+
+private: // Types
+	static constexpr u32 Magic = 0x4C425846; // "FXBL"
+	static constexpr u32 FormatVersion = 1; // Bump when the integration changes
+
+	struct FileHeader
+	{
+		u32 Magic;
+		u32 FormatVersion;
+		u32 Dim;
+		u32 SampleCount;
+	};
+
+public: // Methods
+	// Dim * Dim texels in VK_FORMAT_R16G16_SFLOAT, row 0 being roughness 1. Read from cacheDir, or integrated and saved
+	// there when it's missing or stale.
+	static std::vector<u32> LoadOrGenerate(const std::string& cacheDir, JobSystem& jobs);
+
+	static std::vector<u32> Generate(JobSystem& jobs);
+
+private:
+	static void IntegrateRow(u32 row, u32* texels);
+	static bool TryLoad(const std::filesystem::path& path, std::vector<u32>& outTexels);
+	static void Save(const std::filesystem::path& path, const std::vector<u32>& texels);
+};
@@ -3,6 +3,7 @@
 
 #include "Renderer/LowLevel/GpuTypes.h"
 #include "Framework/CommonTypes.h"
+#include "Framework/AABB.h"
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct Light
@@ -27,6 +28,8 @@ struct SceneRendererPrimitives
 
 		// TODO maybe use an index into the materials to show intent that this isn't the mat owner for now this is easier to get it working
 		const Material& Material;  // i32 MaterialIndex = -1
+
+		AABB WorldBounds{}; // Used for culling. Empty bounds are treated as unknown and never culled.
 	};
 
 	std::set<const Material*> Materials{};
@@ -35,5 +38,43 @@ struct SceneRendererPrimitives
 	glm::vec3 ViewPosition;
 	glm::mat4 ViewMatrix;
 	glm::mat4 ProjectionMatrix;
-	glm::mat4 LightSpaceMatrix;
+	AABB SceneBounds{}; // Every renderable, shadow cascades are fitted to it. Empty if unknown.
+	std::vector<AABB> ChangedBounds{}; // Renderables added, removed or moved since the last frame. Empty boxes are unknown.
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A run of objects sharing a mesh and material, drawn with one instanced call. Transforms live in an InstanceBuffer at
+// [FirstInstance, FirstInstance + InstanceCount).
+struct InstanceBatch
+{
+	MeshResourceId MeshId;
+	const Material* Material = nullptr;
+	u32 FirstInstance = 0;
+	u32 InstanceCount = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Counters for the most recently recorded frame. Visible counts come from the GPU cull and lag by the frames in flight.
+struct RendererFrameStats
+{
+	u32 MaterialDescriptorWrites = 0;
+	u32 FrameDescriptorWrites = 0;
+	u32 DrawCalls = 0; // Shadow and PBR passes
+	u32 Instances = 0;
+	u32 ObjectsVisible = 0;
+	u32 ObjectsCulled = 0;
+	u32 ShadowCastersVisible = 0;
+	u32 ShadowCastersCulled = 0;
+	u32 ShadowCascadesDrawn = 0; // The rest kept last frame's shadow map
+	u32 ShadowCascades = 0;
+	u32 StateBinds = 0;        // Pipeline, descriptor set and geometry binds in the scene pass
+	u32 StateBindsSkipped = 0; // Binds the scene pass skipped because the state was already bound
+	u32 PointLightsVisible = 0; // Point lights reaching at least one cluster
+	u32 LightClusterRefs = 0;   // Point light references across all clusters
+	bool LightClustersTruncated = false; // Some lights were dropped from some clusters, see LightClusters::Truncated()
+	u32 TexturesDecoding = 0;      // Queued or decoded but not yet installed
+	u32 LastDecodeBatchCount = 0;
+	f32 LastDecodeBatchMs = 0;     // Wall time from the batch's first queued texture to its last installed one
+	u32 PipelinesCreated = 0;      // By the last startup or swapchain resize
+	f32 PipelineCreateMs = 0;
 };
@@ -110,7 +110,7 @@ private:
 		{
 			const auto usageFlags = needsFormatConversion
 				? VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT // copy to, then from
-				: VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // copy to, then use in descSet
+				: VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // copy to, then use in descSet and read back for irradiance
 			
 			std::tie(cubemapTextureImage, cubemapTextureImageMemory) = vkh::CreateImage2D(
 				faceTexelWidth, faceTexelHeight,
@@ -180,7 +180,7 @@ private:
 				VK_SAMPLE_COUNT_1_BIT,
 				desiredFormat, // format
 				VK_IMAGE_TILING_OPTIMAL, // tiling
-				VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, //usage flags
+				VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // irradiance reads it back
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, //memory flags
 				physicalDevice, device,
 				cubeSides,// array layers for cubemap
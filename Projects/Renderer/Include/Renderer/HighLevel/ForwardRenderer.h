@@ -2,6 +2,7 @@
 
 #include "Renderer/HighLevel/CommonRendererHighLevel.h"
 #include "Renderer/HighLevel/ResourceRegistry.h"
+#include "Renderer/HighLevel/ShadowCascades.h"
 #include "Renderer/HighLevel/RenderStages/BloomRenderStage.h"
 #include "Renderer/HighLevel/RenderStages/PbrRenderStage.h"
 #include "Renderer/HighLevel/RenderStages/PostEffectsRenderStage.h"
@@ -11,11 +12,19 @@
 #include "Renderer/LowLevel/UniformBufferObjects.h"
 
 #include "Renderer/LowLevel/Framebuffer.h"
+#include "Renderer/LowLevel/JobSystem.h"
+#include "Renderer/LowLevel/ParallelCommandRecorder.h"
 #include "Renderer/LowLevel/VulkanService.h"
 
 #include <Framework/CommonTypes.h>
+#include <Framework/Frustum.h>
 #include <Framework/IModelLoaderService.h> // Used for mesh/model/texture definitions TODO remove dependency?
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <optional>
 #include <vector>
 
 
@@ -74,7 +83,7 @@ private:// Data
 	std::unique_ptr<ResourceRegistry> _resourceRegistry = nullptr;
 	
 	// Framebuffers
-	std::unique_ptr<FramebufferResources> _shadowmapFramebuffer = nullptr;
+	std::unique_ptr<FramebufferResources> _shadowmapFramebuffer = nullptr; // Atlas of every shadow cascade
 	std::unique_ptr<FramebufferResources> _sceneFramebuffer = nullptr;
 	std::unique_ptr<FramebufferResources> _postFramebuffer = nullptr;
 
@@ -88,23 +97,55 @@ private:// Data
 	std::unique_ptr<BloomRenderStage>       _bloomRenderStage = nullptr;
 #endif
 
+	// Camera clip planes, light clustering slices the depth between them
+	static constexpr f32 NearClip = 0.05f;
+	static constexpr f32 FarClip = 1000.f;
+
+	ShadowCascades _shadowCascades{}; // This frame's
+	std::vector<std::optional<Frustum>> _shadowFrusta{}; // Scratch, one per cascade, none if its tile is kept
+
+	// What each atlas tile holds. A tile is only redrawn when its cascade is refitted or a caster inside it changes.
+	struct ShadowTile
+	{
+		glm::mat4 ViewProjection{};
+		bool Valid = false;
+	};
+	std::array<ShadowTile, ShadowCascades::MaxCascades> _shadowTiles{};
+
+	// Shadow and scene draws are recorded into secondary command buffers across threads
+	static constexpr u32 MinDrawsPerChunk = 16;
+	std::unique_ptr<JobSystem> _jobSystem = nullptr;
+	std::unique_ptr<ParallelCommandRecorder> _commandRecorder = nullptr;
+
+	mutable RendererFrameStats _frameStats{};
+
 public: // Lifetime
 	
-	ForwardRenderer(VulkanService& vulkanService, std::string shaderDir, std::string assetsDir, IModelLoaderService& modelLoaderService, Extent2D resolution) :
+	ForwardRenderer(VulkanService& vulkanService, std::string shaderDir, std::string assetsDir, const std::string& cacheDir,
+		IModelLoaderService& modelLoaderService, Extent2D resolution) :
 		_vk(vulkanService),
 		_shaderDir(std::move(shaderDir)),
 		_assetsDir(std::move(assetsDir)),
 		_modelLoaderService(modelLoaderService)
 	{
-		_resourceRegistry = std::make_unique<ResourceRegistry>(&_vk, &modelLoaderService, _shaderDir, _assetsDir);
+		const auto pipelineStats = _vk.GetPipelineCache().GetStats();
+
+		_jobSystem = std::make_unique<JobSystem>();
+		_resourceRegistry = std::make_unique<ResourceRegistry>(&_vk, &modelLoaderService, _shaderDir, _assetsDir, cacheDir,
+			_jobSystem.get());
+
+		_commandRecorder = std::make_unique<ParallelCommandRecorder>(_vk, *_jobSystem, _vk.GetSwapchain().GetImageCount());
 		
 		// Shadowmap
 		_shadowMapRenderStage = std::make_unique<ShadowMapRenderStage>( _shaderDir, _vk );
-		_shadowmapFramebuffer = CreateShadowmapFramebuffer(4096, 4096, _shadowMapRenderStage->GetRenderPass());
+		const RenderOptions defaults{};
+		const auto atlasExtent = ShadowCascades::AtlasExtent(defaults.ShadowCascadeCount, defaults.ShadowMapResolution);
+		_shadowmapFramebuffer = CreateShadowmapFramebuffer(atlasExtent.Width, atlasExtent.Height, _shadowMapRenderStage->GetRenderPass());
 
 		// Scene
 		_skyboxRenderStage = std::make_unique<SkyboxRenderStage>(_vk, _resourceRegistry.get(), _shaderDir, _assetsDir, _modelLoaderService);
 		_pbrRenderStage = std::make_unique<PbrRenderStage>(_vk, _resourceRegistry.get(), *this, _shaderDir, _assetsDir);
+		BindShadowInstanceBuffers();
 		_sceneFramebuffer = CreateSceneFramebuffer(resolution.Width, resolution.Height, _pbrRenderStage->GetRenderPass());
 #if FEATURE_BLOOM
 		// Bloom
@@ -119,6 +160,8 @@ public: // Lifetime
 		_postEffectsRenderStage->CreateDescriptorResources(TextureData{_sceneFramebuffer->OutputDescriptor});
 #endif
 		_postFramebuffer = CreatePostFramebuffer(resolution.Width, resolution.Height, _postEffectsRenderStage->GetRenderPass());
+
+		RecordPipelineCreation(pipelineStats);
 	}
 	
 	ForwardRenderer(const ForwardRenderer&) = delete;
@@ -129,6 +172,9 @@ public: // Lifetime
 
 	~ForwardRenderer() override
 	{
+		_commandRecorder = nullptr;
+		_jobSystem = nullptr;
+
 		_sceneFramebuffer->Destroy();
 		_sceneFramebuffer = nullptr;
 
@@ -159,6 +205,8 @@ public: // Lifetime
 public: // Methods
 	void HandleSwapchainRecreated(u32 width, u32 height, u32 numSwapchainImages)
 	{
+		const auto pipelineStats = _vk.GetPipelineCache().GetStats();
+
 		_postEffectsRenderStage->DestroyDescriptorResources();
 #if FEATURE_BLOOM
 		_bloomRenderStage->DestroyDescriptorResources();
@@ -166,9 +214,12 @@ public: // Methods
 		_postFramebuffer->Destroy();
 		_sceneFramebuffer->Destroy();
 
+		_commandRecorder->HandleSwapchainRecreated(numSwapchainImages);
+
 		_skyboxRenderStage->HandleSwapchainRecreated(width, height, numSwapchainImages);
 
 		_pbrRenderStage->HandleSwapchainRecreated(width, height, numSwapchainImages);
+		BindShadowInstanceBuffers();
 	
 		_sceneFramebuffer = CreateSceneFramebuffer(width, height, _pbrRenderStage->GetRenderPass());
 
@@ -179,35 +230,159 @@ public: // Methods
 		_postEffectsRenderStage->CreateDescriptorResources(TextureData{_sceneFramebuffer->OutputDescriptor});
 #endif
 		_postFramebuffer = CreatePostFramebuffer(width, height, _postEffectsRenderStage->GetRenderPass());
+
+		RecordPipelineCreation(pipelineStats);
 	}
 	
-	void Draw(u32 imageIndex, VkCommandBuffer commandBuffer, const SceneRendererPrimitives& scene, const RenderOptions& options) const
+	const RendererFrameStats& GetFrameStats() const { return _frameStats; }
+
+	glm::mat4 GetProjectionMatrix() const
 	{
+		const auto vfov = 45.f;
+		const auto aspect = _sceneFramebuffer->Desc.Extent.width / (f32)_sceneFramebuffer->Desc.Extent.height;
+		auto projection = glm::perspective(glm::radians(vfov), aspect, NearClip, FarClip);
+		projection = glm::scale(projection, glm::vec3{ 1.f,-1.f,1.f });// flip Y to convert glm from OpenGL coord system to Vulkan
+		return projection;
+	}
+
+	// Every volume Draw() culls against: the camera, plus each shadow cascade when there's a caster. Lets the caller
+	// skip gathering objects that no pass will draw.
+	void GetCullingFrusta(const std::vector<Light>& lights, const glm::mat4& view, const AABB& sceneBounds,
+		const RenderOptions& options, std::vector<Frustum>& outFrusta) const
+	{
+		outFrusta.clear();
+		outFrusta.emplace_back(GetProjectionMatrix() * view);
+
+		ShadowCascades cascades{};
+		BuildShadowCascades(lights, view, sceneBounds, options, cascades);
+		for (u32 i = 0; i < cascades.Count(); i++)
+		{
+			outFrusta.emplace_back(cascades.Get(i).ViewProjection);
+		}
+	}
+
+	void Draw(u32 imageIndex, VkCommandBuffer commandBuffer, const SceneRendererPrimitives& scene, const RenderOptions& options)
+	{
+		// Resources created since last frame are submitted ahead of this frame on the graphics queue
+		_resourceRegistry->FlushUploads();
+		_frameStats.TexturesDecoding = _resourceRegistry->GetDecodingTextureCount();
+		_frameStats.LastDecodeBatchCount = _resourceRegistry->GetLastDecodeBatchCount();
+		_frameStats.LastDecodeBatchMs = _resourceRegistry->GetLastDecodeBatchMs();
+
+		// Cascades first, the atlas may need resizing before descriptors point at it
+		BuildShadowCascades(scene.Lights, scene.ViewMatrix, scene.SceneBounds, options, _shadowCascades);
+		const bool hasShadowCaster = _shadowCascades.Count() > 0;
+		if (hasShadowCaster)
+		{
+			UpdateShadowAtlas(_shadowCascades);
+		}
+		const u32 staleCascades = InvalidateShadowTiles(_shadowCascades, scene.ChangedBounds);
+		const u32 staleCount = (u32)std::popcount(staleCascades);
+
 		// Update all descriptors
 		const auto skyboxDescUpdated = _skyboxRenderStage->UpdateDescriptors(options);
 		_pbrRenderStage->UpdateDescriptors(imageIndex, options, skyboxDescUpdated, scene); // also update other passes?
+		_frameStats.MaterialDescriptorWrites = _pbrRenderStage->GetMaterialDescriptorWrites();
+		_frameStats.FrameDescriptorWrites = _pbrRenderStage->GetFrameDescriptorWrites();
 
 		// TODO Just update the descriptor for this imageIndex????
 		//_postEffectsRenderStage.CreateDescriptorResources(TextureData{_sceneFramebuffer.OutputDescriptor});
 
-		// Draw Shadow Pass to Shadowmap Framebuffer
-		auto lightSpaceMatrix = glm::identity<glm::mat4>();
-		if (FindShadowCasterMatrix(scene.Lights, lightSpaceMatrix))
+		const auto projection = GetProjectionMatrix();
+
+		// Stream objects to the GPU, which culls them against the camera, and separately against each stale cascade for
+		// the shadow pass
+		_shadowFrusta.clear();
+		for (u32 i = 0; i < _shadowCascades.Count(); i++)
+		{
+			_shadowFrusta.emplace_back(staleCascades & (1u << i)
+				? std::optional<Frustum>{ _shadowCascades.Get(i).ViewProjection }
+				: std::nullopt);
+		}
+		_pbrRenderStage->PrepareDraws(imageIndex, scene.Objects, Frustum{ projection * scene.ViewMatrix }, _shadowFrusta,
+			scene.ViewPosition);
+		if (_pbrRenderStage->InstanceBufferRecreated())
+		{
+			_shadowMapRenderStage->SetInstanceBuffer(imageIndex, _pbrRenderStage->GetInstanceBuffer(imageIndex), _vk.LogicalDevice());
+		}
+		_pbrRenderStage->RecordCulling(commandBuffer);
+		_pbrRenderStage->PrepareRecording(imageIndex, options, scene.Lights, scene.ViewMatrix, projection,
+			NearClip, FarClip, _sceneFramebuffer->Desc.Extent, scene.ViewPosition, _shadowCascades);
+		_commandRecorder->BeginFrame(imageIndex);
+		
+		const auto& scenePass = _pbrRenderStage->GetScenePass();
+		const auto objectCount = (u32)scene.Objects.size();
+		_frameStats.ObjectsVisible = std::min(objectCount,
+			scenePass.GetVisibleCount(SceneRenderPass::View::Camera) + _pbrRenderStage->GetTransparentCount());
+		_frameStats.ObjectsCulled = objectCount - _frameStats.ObjectsVisible;
+		// Summed over the cascades drawn, an object in two cascades is drawn twice
+		_frameStats.ShadowCastersVisible = 0;
+		for (u32 i = 0; i < _shadowCascades.Count(); i++)
+		{
+			_frameStats.ShadowCastersVisible += std::min(objectCount, scenePass.GetVisibleCount(SceneRenderPass::ShadowView(i)));
+		}
+		const u32 shadowCandidates = objectCount * staleCount;
+		_frameStats.ShadowCastersCulled = shadowCandidates - std::min(shadowCandidates, _frameStats.ShadowCastersVisible);
+		_frameStats.ShadowCascadesDrawn = staleCount;
+		_frameStats.ShadowCascades = _shadowCascades.Count();
+		_frameStats.DrawCalls = _pbrRenderStage->GetDrawCallCount();
+		_frameStats.Instances = _frameStats.ObjectsVisible + _frameStats.ShadowCastersVisible;
+		_frameStats.PointLightsVisible = _pbrRenderStage->GetLightClusters().Header().PointCount;
+		_frameStats.LightClusterRefs = (u32)_pbrRenderStage->GetLightClusters().LightIndices().size();
+		_frameStats.LightClustersTruncated = _pbrRenderStage->GetLightClusters().Truncated();
+
+		// Redraw stale cascades into their tiles of the shadow atlas. When only some are stale the rest are kept, and each
+		// stale tile is cleared by the first chunk reaching it.
+		if (staleCount > 0)
 		{
 			const auto shadowRenderArea = vki::Rect2D({}, _shadowmapFramebuffer->Desc.Extent);
+			const bool keepAtlas = staleCount < _shadowCascades.Count();
 
 			auto beginInfo = vki::RenderPassBeginInfo(
-				_shadowMapRenderStage->GetRenderPass(),
+				keepAtlas ? _shadowMapRenderStage->GetLoadRenderPass() : _shadowMapRenderStage->GetRenderPass(),
 				_shadowmapFramebuffer->Framebuffer,
 				shadowRenderArea,
 				_shadowmapFramebuffer->ClearValues);
 
-			vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			// Cascades' items are chunked as one range, so small cascades share a secondary buffer. A stale cascade's
+			// items are its tile clear, when keeping the atlas, then its groups.
+			const u32 clearItems = keepAtlas ? 1 : 0;
+			std::array<u32, ShadowCascades::MaxCascades + 1> cascadeFirstItem{};
+			for (u32 i = 0; i < _shadowCascades.Count(); i++)
 			{
-				_shadowMapRenderStage->Draw(commandBuffer, shadowRenderArea,
-					scene, lightSpaceMatrix,
-					_pbrRenderStage->Hack_GetRenderables(),// TODO extract resources from PbrRenderStage into ForwardRenderer
-					_resourceRegistry->Hack_GetMeshes()); // TODO pass resRegistry into shadow pass so it can get meshes it needs
+				const u32 itemCount = staleCascades & (1u << i)
+					? clearItems + (u32)scenePass.GetDrawGroups(SceneRenderPass::ShadowView(i)).size()
+					: 0;
+				cascadeFirstItem[i + 1] = cascadeFirstItem[i] + itemCount;
+			}
+			const auto shadowItemCount = cascadeFirstItem[_shadowCascades.Count()];
+
+			vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			{
+				_commandRecorder->RecordAndExecute(commandBuffer, beginInfo.renderPass, beginInfo.framebuffer,
+					shadowItemCount, MinDrawsPerChunk,
+					[&](VkCommandBuffer secondary, u32 firstItem, u32 itemCount)
+					{
+						for (u32 i = 0; i < _shadowCascades.Count(); i++)
+						{
+							u32 first = std::max(firstItem, cascadeFirstItem[i]);
+							const u32 end = std::min(firstItem + itemCount, cascadeFirstItem[i + 1]);
+							if (first >= end)
+								continue;
+
+							if (clearItems > 0 && first == cascadeFirstItem[i])
+							{
+								_shadowMapRenderStage->ClearTile(secondary, _shadowCascades, i);
+								first++;
+							}
+							if (first < end)
+							{
+								const u32 firstGroup = first - cascadeFirstItem[i] - clearItems;
+								_shadowMapRenderStage->Draw(secondary, imageIndex, _shadowCascades, i, scenePass, firstGroup, end - first);
+							}
+						}
+					});
+				_frameStats.DrawCalls += shadowItemCount - clearItems * staleCount;
 			}
 			vkCmdEndRenderPass(commandBuffer);
 		}
@@ -226,26 +401,55 @@ public: // Methods
 
 		// Draw Scene (skybox and pbr) to Scene Framebuffer
 		{
-			// Calc Projection
-			const auto vfov = 45.f;
-			const auto aspect = _sceneFramebuffer->Desc.Extent.width / (f32)_sceneFramebuffer->Desc.Extent.height;
-			auto projection = glm::perspective(glm::radians(vfov), aspect, 0.05f, 1000.f);
-			projection = glm::scale(projection, glm::vec3{ 1.f,-1.f,1.f });// flip Y to convert glm from OpenGL coord system to Vulkan
-
 			auto renderPassBeginInfo = vki::RenderPassBeginInfo(
 				_pbrRenderStage->GetRenderPass(),
 				_sceneFramebuffer->Framebuffer,
 				sceneRenderArea,
 				_sceneFramebuffer->ClearValues);
 
-			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 			{
-				vkCmdSetViewport(commandBuffer, 0, 1, &sceneViewport);
-				vkCmdSetScissor(commandBuffer, 0, 1, &sceneRenderArea);
-
-				_skyboxRenderStage->Draw(commandBuffer, imageIndex, options, scene.ViewMatrix, projection);
-
-				_pbrRenderStage->Draw(commandBuffer, imageIndex, options, scene.Objects, scene.Lights, scene.ViewMatrix, projection, scene.ViewPosition, lightSpaceMatrix);
+				// Chunks record concurrently
+				std::atomic<u32> stateBinds = 0;
+				std::atomic<u32> stateBindsSkipped = 0;
+
+				// All opaque depth must be down before any of it is shaded
+				if (const auto prepassCount = _pbrRenderStage->GetDepthPrepassItemCount(); prepassCount > 0)
+				{
+					_commandRecorder->RecordAndExecute(commandBuffer, renderPassBeginInfo.renderPass, renderPassBeginInfo.framebuffer,
+						prepassCount, MinDrawsPerChunk,
+						[&](VkCommandBuffer secondary, u32 firstItem, u32 itemCount)
+						{
+							vkCmdSetViewport(secondary, 0, 1, &sceneViewport);
+							vkCmdSetScissor(secondary, 0, 1, &sceneRenderArea);
+							const auto counts = _pbrRenderStage->RecordDepthPrepass(secondary, imageIndex, firstItem, itemCount);
+							stateBinds += counts.Binds;
+							stateBindsSkipped += counts.Skipped;
+						});
+					_frameStats.DrawCalls += prepassCount;
+				}
+
+				_commandRecorder->RecordAndExecute(commandBuffer, renderPassBeginInfo.renderPass, renderPassBeginInfo.framebuffer,
+					_pbrRenderStage->GetDrawItemCount(), MinDrawsPerChunk,
+					[&](VkCommandBuffer secondary, u32 firstItem, u32 itemCount)
+					{
+						// Dynamic state isn't inherited from the primary
+						vkCmdSetViewport(secondary, 0, 1, &sceneViewport);
+						vkCmdSetScissor(secondary, 0, 1, &sceneRenderArea);
+
+						// Skybox goes behind everything, so it leads the first chunk
+						if (firstItem == 0)
+						{
+							_skyboxRenderStage->Draw(secondary, imageIndex, options, scene.ViewMatrix, projection);
+						}
+
+						const auto counts = _pbrRenderStage->RecordDraws(secondary, imageIndex, firstItem, itemCount);
+						stateBinds += counts.Binds;
+						stateBindsSkipped += counts.Skipped;
+					});
+
+				_frameStats.StateBinds = stateBinds;
+				_frameStats.StateBindsSkipped = stateBindsSkipped;
 			}
 			vkCmdEndRenderPass(commandBuffer);
 		}
@@ -318,12 +522,12 @@ public: // PBR RenderPass routing methods
 
 public: // Skybox RenderPass routing methods
 	VkDescriptorImageInfo GetShadowmapDescriptor() override { return _shadowmapFramebuffer->OutputDescriptor; }
-	const TextureResource& GetIrradianceTextureResource()  override { return _skyboxRenderStage->GetIrradianceTextureResource(); }
+	const ShIrradiance::Coefficients& GetIrradianceSh() override { return _skyboxRenderStage->GetIrradianceSh(); }
 	const TextureResource& GetPrefilterTextureResource() override { return _skyboxRenderStage->GetPrefilterTextureResource(); }
 	const TextureResource& GetBrdfTextureResource() override { return _skyboxRenderStage->GetBrdfTextureResource(); }
-	IblTextureResourceIds CreateIblTextureResources(const std::string& path) const
+	IblTextureResourceIds CreateIblTextureResources(const std::string& path, IblQuality quality) const
 	{
-		return _skyboxRenderStage->CreateIblTextureResources(path);
+		return _skyboxRenderStage->CreateIblTextureResources(path, quality);
 	}
 
 	SkyboxResourceId CreateSkybox(const SkyboxCreateInfo& createInfo) const
@@ -339,6 +543,24 @@ public: // Skybox RenderPass routing methods
 
 
 private:// Methods
+
+	void BindShadowInstanceBuffers()
+	{
+		const u32 frameCount = _pbrRenderStage->GetInstanceBufferCount();
+		_shadowMapRenderStage->CreateDescriptorSets(frameCount, _vk.LogicalDevice());
+		for (u32 i = 0; i < frameCount; i++)
+		{
+			_shadowMapRenderStage->SetInstanceBuffer(i, _pbrRenderStage->GetInstanceBuffer(i), _vk.LogicalDevice());
+		}
+	}
+
+	// Pipelines created since the snapshot, and the time spent creating them, shown with the frame stats
+	void RecordPipelineCreation(const PipelineCache::Stats& snapshot) const
+	{
+		const auto created = _vk.GetPipelineCache().GetStats() - snapshot;
+		_frameStats.PipelinesCreated = created.PipelinesCreated;
+		_frameStats.PipelineCreateMs = (f32)created.CreateMs;
+	}
 	
 	std::unique_ptr<FramebufferResources> CreateSceneFramebuffer(u32 width, u32 height, VkRenderPass renderPass) const
 	{
@@ -395,24 +617,88 @@ private:// Methods
 		return std::make_unique<FramebufferResources>(desc, renderPass, _vk);
 	}
 
-	// Returns light transform matrix if found, otherwise identity
-	static bool FindShadowCasterMatrix(const std::vector<Light>& lights, glm::mat4& outMatrix)
+	// The first directional light casts shadows. Must match the light Pbr.frag shadows, LightClusters skips dim ones.
+	static const Light* FindShadowCaster(const std::vector<Light>& lights)
 	{
-		// Find teh first direction light as use as a shadow caster
 		for (auto&& light : lights)
 		{
-			if (light.Type == Light::LightType::Directional)
+			if (light.Type == Light::LightType::Directional && light.Intensity >= 0.01f)
 			{
-				const auto view = glm::lookAt(light.Pos, { 0,0,0 }, { 0,1,0 });
-				const auto projection = glm::ortho(-50.f, 50.f, -50.f, 50.f, -50.f, 50.f); // TODO Set the bounds dynamically. Near/Far clip planes seems weird. -50 near solves odd clipping issues. Check my understanding of this.
+				return &light;
+			}
+		}
+		return nullptr;
+	}
 
-				outMatrix = projection * view;
-				return true;
+	// Leaves outCascades empty without a shadow caster
+	void BuildShadowCascades(const std::vector<Light>& lights, const glm::mat4& view, const AABB& sceneBounds,
+		const RenderOptions& options, ShadowCascades& outCascades) const
+	{
+		outCascades.Clear();
+
+		const Light* caster = FindShadowCaster(lights);
+		if (!caster)
+			return;
+
+		ShadowCascades::BuildInfo info{};
+		info.View = view;
+		info.Projection = GetProjectionMatrix();
+		info.Near = NearClip;
+		info.LightDirection = caster->Pos;
+		info.SceneBounds = sceneBounds;
+		info.CascadeCount = (u32)std::clamp(options.ShadowCascadeCount, 1, (i32)ShadowCascades::MaxCascades);
+		info.Resolution = (u32)std::clamp(options.ShadowMapResolution, 256, 4096);
+		info.MaxDistance = std::clamp(options.ShadowDistance, 1.f, FarClip);
+		outCascades.Build(info);
+	}
+
+	// Returns a bit per cascade whose tile must be redrawn this frame, and records the tiles as holding them. A tile is
+	// stale if it was never drawn, its cascade was refitted, or a renderable changed inside its frustum.
+	u32 InvalidateShadowTiles(const ShadowCascades& cascades, const std::vector<AABB>& changedBounds)
+	{
+		u32 staleMask = 0;
+		for (u32 i = 0; i < ShadowCascades::MaxCascades; i++)
+		{
+			auto& tile = _shadowTiles[i];
+			if (i >= cascades.Count())
+			{
+				tile.Valid = false; // Casters may change while the cascade is unused
+				continue;
+			}
+
+			const auto& viewProjection = cascades.Get(i).ViewProjection;
+			bool stale = !tile.Valid || tile.ViewProjection != viewProjection;
+			if (!stale)
+			{
+				const Frustum frustum{ viewProjection };
+				stale = std::any_of(changedBounds.begin(), changedBounds.end(),
+					[&](const AABB& bounds) { return bounds.IsEmpty() || frustum.Intersects(bounds); });
+			}
+
+			if (stale)
+			{
+				staleMask |= 1u << i;
+				tile.ViewProjection = viewProjection;
+				tile.Valid = true;
 			}
 		}
+		return staleMask;
+	}
+
+	// Resizes the atlas when the cascade count or resolution changes. Waits for the GPU, which is fine for an option
+	// change.
+	void UpdateShadowAtlas(const ShadowCascades& cascades)
+	{
+		const auto extent = ShadowCascades::AtlasExtent(cascades.Count(), cascades.Resolution());
+		const auto& current = _shadowmapFramebuffer->Desc.Extent;
+		if (current.width == extent.Width && current.height == extent.Height)
+			return;
 
-		outMatrix = glm::identity<glm::mat4>();
-		return false;
+		vkDeviceWaitIdle(_vk.LogicalDevice());
+		_shadowTiles = {};
+		_shadowmapFramebuffer->Destroy();
+		_shadowmapFramebuffer = CreateShadowmapFramebuffer(extent.Width, extent.Height, _shadowMapRenderStage->GetRenderPass());
+		_pbrRenderStage->SetSkyboxDirty(); // Rewrites every frame descriptor set, they sample the atlas
 	}
 
 };
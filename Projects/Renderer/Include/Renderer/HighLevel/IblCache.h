@@ -0,0 +1,335 @@
+#pragma once
+
+#include "Renderer/LowLevel/TextureResource.h"
+#include "Renderer/LowLevel/VulkanHelpers.h"
+#include "Renderer/LowLevel/VulkanInitializers.h"
+
+#include <Framework/CommonTypes.h>
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using vkh = VulkanHelpers;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// On disk cache of the maps IblLoader generates for an environment, so a relaunch uploads them rather than rerunning
+// the convolutions. Entries are named by a hash of the source image's contents and also keyed by a generation key the
+// caller derives from whatever else shapes the output, eg. the generation shaders.
+//
+// The file is a fixed header, a desc per texture, then every mip of every layer tightly packed in the texture's own
+// format. Loading validates the descs against the textures being filled, so changing a map's size, mip count or format
+// is a miss that regenerates and rewrites the entry.
+class IblCache final
+{
+private: // Types
+	static constexpr u32 Magic = 0x42495846; // "FXIB"
+	static constexpr u32 FormatVersion = 1;
+
+	struct FileHeader
+	{
+		u32 Magic;
+		u32 FormatVersion;
+		u64 ContentHash;
+		u64 GenerationKey;
+		u64 FileSize;
+		u32 TextureCount;
+		u32 Padding;
+	};
+
+	struct TextureDesc
+	{
+		u32 Width;
+		u32 Height;
+		u32 MipLevels;
+		u32 LayerCount;
+		u32 Format;
+		u32 TexelSize;
+
+		bool operator==(const TextureDesc&) const = default;
+	};
+
+	static_assert(std::is_trivially_copyable_v<FileHeader>);
+	static_assert(std::is_trivially_copyable_v<TextureDesc>);
+
+	static constexpr u64 FnvOffset = 14695981039346656037ull;
+	static constexpr u64 FnvPrime = 1099511628211ull;
+
+public: // Methods
+	// FNV-1a. Chain calls by passing the previous result as the seed.
+	static u64 Hash(const void* data, size_t size, u64 seed = FnvOffset)
+	{
+		const auto* bytes = (const u8*)data;
+		u64 hash = seed;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * FnvPrime;
+		}
+		return hash;
+	}
+
+	// Zero if the file can't be read
+	static u64 HashFile(const std::string& path, u64 seed = FnvOffset)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return 0;
+
+		u64 hash = seed;
+		std::vector<char> chunk(1 << 20);
+		while (file)
+		{
+			file.read(chunk.data(), chunk.size());
+			hash = Hash(chunk.data(), (size_t)file.gcount(), hash);
+		}
+		return hash;
+	}
+
+	static std::filesystem::path PathFor(const std::string& cacheDir, u64 contentHash)
+	{
+		std::stringstream name;
+		name << std::hex << contentHash << ".fxibl";
+		return std::filesystem::path(cacheDir) / name.str();
+	}
+
+	// Fills the textures, in order, from the entry and leaves them in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. False
+	// if there's no valid entry or it doesn't match the textures' shapes.
+	static bool TryLoad(const std::filesystem::path& path, u64 contentHash, u64 generationKey,
+		const std::vector<const TextureResource*>& textures,
+		VkCommandPool transferPool, VkQueue transferQueue, VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+
+		const auto fileSize = (u64)file.tellg();
+		file.seekg(0);
+
+		FileHeader header{};
+		if (!file.read((char*)&header, sizeof(FileHeader)) ||
+			header.Magic != Magic ||
+			header.FormatVersion != FormatVersion ||
+			header.ContentHash != contentHash ||
+			header.GenerationKey != generationKey ||
+			header.FileSize != fileSize ||
+			header.TextureCount != (u32)textures.size())
+		{
+			return false;
+		}
+
+		u64 expectedSize = sizeof(FileHeader) + sizeof(TextureDesc) * textures.size();
+		for (const auto* texture : textures)
+		{
+			TextureDesc desc{};
+			if (!file.read((char*)&desc, sizeof(TextureDesc)) || desc != DescOf(*texture))
+				return false;
+			expectedSize += DataSize(desc);
+		}
+		if (expectedSize != fileSize)
+			return false;
+
+
+		// Stream each texture's texels straight into staging memory and copy them over
+		for (const auto* texture : textures)
+		{
+			const auto desc = DescOf(*texture);
+			const auto size = DataSize(desc);
+
+			auto [stagingBuffer, stagingMemory] = vkh::CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, device, physicalDevice);
+
+			void* mapped;
+			vkMapMemory(device, stagingMemory, 0, size, 0, &mapped);
+			const bool read = (bool)file.read((char*)mapped, size);
+			vkUnmapMemory(device, stagingMemory);
+
+			if (read)
+			{
+				auto* cmdBuf = vkh::BeginSingleTimeCommands(transferPool, device);
+				const auto range = vki::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 0, desc.MipLevels, 0, desc.LayerCount);
+				vkh::TransitionImageLayout(cmdBuf, texture->Image(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+
+				const auto regions = CopyRegions(desc);
+				vkCmdCopyBufferToImage(cmdBuf, stagingBuffer, texture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					(u32)regions.size(), regions.data());
+
+				vkh::TransitionImageLayout(cmdBuf, texture->Image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+				vkh::EndSingeTimeCommands(cmdBuf, transferPool, transferQueue, device);
+			}
+
+			vkDestroyBuffer(device, stagingBuffer, nullptr);
+			vkFreeMemory(device, stagingMemory, nullptr);
+
+			if (!read)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Reads the textures back and writes them as the entry. Textures must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	// and created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT. Failures are reported and otherwise ignored.
+	static void Save(const std::filesystem::path& path, u64 contentHash, u64 generationKey,
+		const std::vector<const TextureResource*>& textures,
+		VkCommandPool transferPool, VkQueue transferQueue, VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		FileHeader header{};
+		header.Magic = Magic;
+		header.FormatVersion = FormatVersion;
+		header.ContentHash = contentHash;
+		header.GenerationKey = generationKey;
+		header.FileSize = sizeof(FileHeader) + sizeof(TextureDesc) * textures.size();
+		header.TextureCount = (u32)textures.size();
+		for (const auto* texture : textures)
+		{
+			header.FileSize += DataSize(DescOf(*texture));
+		}
+
+
+		// Write to a temp file and swap it in, so an interrupted write never leaves a truncated entry behind
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+		auto tempPath = path;
+		tempPath += ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(FileHeader));
+			for (const auto* texture : textures)
+			{
+				const auto desc = DescOf(*texture);
+				file.write((const char*)&desc, sizeof(TextureDesc));
+			}
+
+			// Cached memory makes reading the texels back much faster, but isn't guaranteed to exist
+			const VkMemoryPropertyFlags coherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			const VkMemoryPropertyFlags readbackFlags = HasMemoryType(physicalDevice, coherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+				? coherent | VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+				: coherent;
+
+			for (const auto* texture : textures)
+			{
+				if (!file)
+					break;
+
+				const auto desc = DescOf(*texture);
+				const auto size = DataSize(desc);
+
+				auto [stagingBuffer, stagingMemory] = vkh::CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					readbackFlags, device, physicalDevice);
+
+				auto* cmdBuf = vkh::BeginSingleTimeCommands(transferPool, device);
+				const auto range = vki::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 0, desc.MipLevels, 0, desc.LayerCount);
+				vkh::TransitionImageLayout(cmdBuf, texture->Image(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, range);
+
+				const auto regions = CopyRegions(desc);
+				vkCmdCopyImageToBuffer(cmdBuf, texture->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer,
+					(u32)regions.size(), regions.data());
+
+				vkh::TransitionImageLayout(cmdBuf, texture->Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+
+				// Make the copy visible to the host once the fence signals
+				VkMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+				vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+				vkh::EndSingeTimeCommands(cmdBuf, transferPool, transferQueue, device);
+
+				void* mapped;
+				vkMapMemory(device, stagingMemory, 0, size, 0, &mapped);
+				file.write((const char*)mapped, size);
+				vkUnmapMemory(device, stagingMemory);
+
+				vkDestroyBuffer(device, stagingBuffer, nullptr);
+				vkFreeMemory(device, stagingMemory, nullptr);
+			}
+
+			if (!file)
+			{
+				std::cerr << "Failed to write ibl cache: " << tempPath.string() << "\n";
+				file.close();
+				std::filesystem::remove(tempPath, ec);
+				return;
+			}
+		}
+
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec)
+		{
+			std::cerr << "Failed to write ibl cache: " << path.string() << " - " << ec.message() << "\n";
+			std::filesystem::remove(tempPath, ec);
+		}
+	}
+
+private:
+	static TextureDesc DescOf(const TextureResource& texture)
+	{
+		return TextureDesc{ texture.Width(), texture.Height(), texture.MipLevels(), texture.LayerCount(),
+			(u32)texture.Format(), TexelSize(texture.Format()) };
+	}
+
+	static u32 TexelSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R16G16_SFLOAT: return 4;
+		case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+		case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+		default: throw std::runtime_error("Unsupported ibl cache format");
+		}
+	}
+
+	static u32 MipDim(u32 dim, u32 mip) { return std::max(1u, dim >> mip); }
+
+	static u64 DataSize(const TextureDesc& desc)
+	{
+		u64 size = 0;
+		for (u32 mip = 0; mip < desc.MipLevels; mip++)
+		{
+			size += (u64)MipDim(desc.Width, mip) * MipDim(desc.Height, mip) * desc.LayerCount * desc.TexelSize;
+		}
+		return size;
+	}
+
+	// One region per mip covering every layer, packed back to back
+	static std::vector<VkBufferImageCopy> CopyRegions(const TextureDesc& desc)
+	{
+		std::vector<VkBufferImageCopy> regions(desc.MipLevels);
+		VkDeviceSize offset = 0;
+		for (u32 mip = 0; mip < desc.MipLevels; mip++)
+		{
+			const auto width = MipDim(desc.Width, mip);
+			const auto height = MipDim(desc.Height, mip);
+			regions[mip] = vki::BufferImageCopy(offset, 0, 0,
+				vki::ImageSubresourceLayers(VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, desc.LayerCount),
+				vki::Offset3D(0, 0, 0),
+				vki::Extent3D(width, height, 1));
+			offset += (VkDeviceSize)width * height * desc.LayerCount * desc.TexelSize;
+		}
+		return regions;
+	}
+
+	static bool HasMemoryType(VkPhysicalDevice physicalDevice, VkMemoryPropertyFlags flags)
+	{
+		VkPhysicalDeviceMemoryProperties props;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &props);
+		for (u32 i = 0; i < props.memoryTypeCount; i++)
+		{
+			if ((props.memoryTypes[i].propertyFlags & flags) == flags)
+				return true;
+		}
+		return false;
+	}
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Renderer/HighLevel/ShIrradiance.h"
+#include "Renderer/LowLevel/TextureResource.h"
+
+#include <Framework/CommonTypes.h>
+
+#include <vulkan/vulkan.h>
+
+#include <bit>
+#include <string>
+
+class PipelineCache;
+class TexelsRgbaF32;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct IblTextureResources
+{
+	TextureResource EnvironmentCubemap;
+	TextureResource PrefilterCubemap;
+	ShIrradiance::Coefficients IrradianceSh{};
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Makes an environment's IBL maps with compute shaders that write each cubemap mip through a storage image, one
+// dispatch per mip covering all six faces. Every stage and the readback the irradiance SH is projected from are
+// recorded into one command buffer and waited on with one fence. The GPU time of each stage is printed when the queue
+// supports timestamps.
+class IblGenerator final
+{
+public: // Types
+	static constexpr u32 EnvironmentDim = 2048;
+	static constexpr u32 EnvironmentMips = (u32)std::bit_width(EnvironmentDim);
+	static constexpr VkFormat StorageFormat = VK_FORMAT_R16G16B16A16_SFLOAT; // Match the shaders' image formats
+	static constexpr u32 IrradianceShFaceDim = 32; // Smallest env mip the irradiance is projected from
+
+	struct PrefilterDesc
+	{
+		u32 Dim;
+		u32 MipLevels;
+		i32 SampleCount; // Per texel of the rough mips. Mip 0 is a mirror and takes one.
+	};
+
+private: // Types
+	enum class Stage : u32
+	{
+		Upload,
+		Environment,
+		EnvironmentMips,
+		Prefilter,
+		Readback,
+		Count,
+	};
+
+	// Match IblPrefilterCubemap.comp
+	struct PrefilterPushConstants
+	{
+		f32 EnvMapResPerFace;
+		f32 Roughness;
+		i32 SampleCount;
+	};
+
+public: // Methods
+	// Converts the equirectangular image to an environment cubemap, box filters its mips and prefilters it
+	static IblTextureResources FromEquirectangular(const std::string& path, const PrefilterDesc& prefilter,
+		const std::string& shaderDir, VkCommandPool pool, VkQueue queue, VkPhysicalDevice physicalDevice, VkDevice device,
+		PipelineCache& pipelineCache);
+
+	// Prefilters an environment that's already loaded. It must be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+	static IblTextureResources FromCubemap(TextureResource environment, const PrefilterDesc& prefilter,
+		const std::string& shaderDir, VkCommandPool pool, VkQueue queue, VkPhysicalDevice physicalDevice, VkDevice device,
+		PipelineCache& pipelineCache);
+
+	// For environments that skipped generation, eg. loaded from IblCache
+	static ShIrradiance::Coefficients ProjectIrradianceSh(const TextureResource& environment, VkCommandPool pool,
+		VkQueue queue, VkPhysicalDevice physicalDevice, VkDevice device);
+
+	// Cubemaps every mip of which the generator, and IblCache, can write
+	static TextureResource CreateEnvironmentCubemap(VkPhysicalDevice physicalDevice, VkDevice device);
+	static TextureResource CreatePrefilterCubemap(const PrefilterDesc& desc, VkPhysicalDevice physicalDevice,
+		VkDevice device);
+
+private:
+	static IblTextureResources Generate(const TexelsRgbaF32* equirectangular, TextureResource environment,
+		const PrefilterDesc& prefilter, const std::string& shaderDir, VkCommandPool pool, VkQueue queue,
+		VkPhysicalDevice physicalDevice, VkDevice device, PipelineCache& pipelineCache);
+
+	static TextureResource CreateCubemap(u32 dim, u32 mipLevels, VkPhysicalDevice physicalDevice, VkDevice device);
+	static VkImageView CreateMipView(VkImage image, VkFormat format, u32 mip, VkDevice device);
+	static VkPipeline CreateComputePipeline(const std::string& shaderPath, VkPipelineLayout layout, VkDevice device,
+		PipelineCache& pipelineCache);
+
+	static void ImageBarrier(VkCommandBuffer cmdBuf, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+		u32 baseMip, u32 mipCount);
+
+	// Copies every face of the env mip the irradiance is projected from into a host visible buffer
+	static u32 IrradianceShMip(const TextureResource& environment);
+	static VkDeviceSize IrradianceShReadbackSize(const TextureResource& environment);
+	static void RecordIrradianceShReadback(VkCommandBuffer cmdBuf, const TextureResource& environment, VkBuffer buffer);
+	static ShIrradiance::Coefficients ProjectIrradianceSh(const TextureResource& environment, const void* readback);
+
+	static void SubmitAndWait(VkCommandBuffer cmdBuf, VkCommandPool pool, VkQueue queue, VkDevice device);
+	static u64 TimestampMask(VkPhysicalDevice physicalDevice);
+	static const char* StageName(Stage stage);
+};
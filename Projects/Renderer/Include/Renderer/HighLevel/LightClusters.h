@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Renderer/HighLevel/CommonRendererHighLevel.h"
+
+#include <Framework/CommonTypes.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Assigns point lights to a froxel grid: screen tiles split into depth slices that grow exponentially with distance.
+// Each cluster stores a run in a shared light index list, so a fragment only evaluates the lights that can reach it.
+// Directional lights reach everything and sit at the front of the light list, outside the clusters.
+//
+// Point lights get a finite range where their radiance drops below Cutoff; Pbr.frag fades them to zero there. Bounds
+// are conservative: each light's view space bounding box is projected per slice it overlaps. Pure CPU, no Vulkan use.
+class LightClusters final
+{
+public: // Types
+	static constexpr u32 TilesX = 16;
+	static constexpr u32 TilesY = 9;
+	static constexpr u32 Slices = 24;
+	static constexpr u32 ClusterCount = TilesX * TilesY * Slices;
+	static constexpr f32 Cutoff = 0.05f; // Radiance at a light's range
+
+	// Match Pbr.frag
+	struct GpuLight
+	{
+		glm::vec4 ColorIntensity; // [R,G,B,Intensity]
+		glm::vec4 PosRadius;      // Point: [X,Y,Z,Range]. Directional: [DirX,DirY,DirZ,0]
+	};
+	static_assert(sizeof(GpuLight) == 32);
+
+	struct GpuHeader
+	{
+		glm::vec4 ViewDepthRow;  // dot with a world position gives its view depth
+		glm::vec2 TileScale;     // Converts gl_FragCoord.xy to tile coordinates
+		f32 SliceScale;          // slice = log(viewDepth) * SliceScale + SliceBias
+		f32 SliceBias;
+		u32 DirectionalCount;
+		u32 PointCount;
+		u32 Padding[2];
+	};
+	static_assert(sizeof(GpuHeader) == 48);
+
+	struct GpuCluster
+	{
+		u32 Offset; // Into the light index list
+		u32 Count;
+	};
+
+	struct BuildInfo
+	{
+		glm::mat4 View{};
+		glm::mat4 Projection{}; // Symmetric perspective, Vulkan clip space. May flip Y.
+		f32 Near = 0;           // Must match Projection
+		f32 Far = 0;
+		u32 Width = 0;          // Render target size in pixels
+		u32 Height = 0;
+		u32 MaxLights = 0;      // Lights past these are dropped
+		u32 MaxLightIndices = 0;
+	};
+
+private: // Types
+	// A light's tile rectangle within one slice
+	struct Span
+	{
+		u32 Light;
+		u16 Slice, MinX, MaxX, MinY, MaxY;
+	};
+
+private: // Data
+	GpuHeader _header{};
+	std::vector<GpuLight> _lights{}; // Directional, then point lights
+	std::vector<GpuCluster> _clusters{};
+	std::vector<u32> _lightIndices{}; // Into _lights
+	std::vector<Span> _spans{};       // Scratch, kept to avoid per-frame allocations
+	bool _truncated = false;
+
+public: // Methods
+	void Build(const std::vector<Light>& lights, const BuildInfo& info);
+
+	// Distance at which a point light's radiance falls to Cutoff, using its brightest channel
+	static f32 LightRange(const Light& light);
+
+	static u32 ClusterIndex(u32 tileX, u32 tileY, u32 slice) { return (slice * TilesY + tileY) * TilesX + tileX; }
+
+	const GpuHeader& Header() const { return _header; }
+	const std::vector<GpuLight>& Lights() const { return _lights; }
+	const std::vector<GpuCluster>& Clusters() const { return _clusters; }
+	const std::vector<u32>& LightIndices() const { return _lightIndices; }
+
+	// True if the last Build() hit MaxLights or MaxLightIndices, so some lights are missing from some clusters
+	bool Truncated() const { return _truncated; }
+};
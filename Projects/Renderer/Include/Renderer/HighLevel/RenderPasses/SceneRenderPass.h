@@ -1,13 +1,242 @@
 #pragma once
 
-// TODO Refactor common code from PbrRenderStage and ShadowMapGraphicsPipelineStage here.
+#include "Renderer/HighLevel/ShadowCascades.h"
+#include "Renderer/LowLevel/GpuMemoryAllocator.h"
+#include "Renderer/LowLevel/GpuTypes.h"
 
-// GOAL: new class that efficiently draws huge amounts of render primitives
+#include <Framework/AABB.h>
+#include <Framework/CommonTypes.h>
+#include <Framework/Frustum.h>
 
-// This only does the drawing! 3d scene object culling, etc is done externally
+#include <glm/mat4x4.hpp>
+#include <vulkan/vulkan.h>
 
-// Descriptor set levels common for all objects
-// 1. Pass
-// 2. Material
-// 3. Mesh Draw
-// 4. Constant buffers?
\ No newline at end of file
+#include <array>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class InstanceBuffer;
+class ResourceRegistry;
+class VulkanService;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Draws huge amounts of scene objects with a near constant CPU cost. Objects are streamed into a persistently mapped
+// buffer with their bounds, then a compute shader frustum culls them for each view, copies the survivors' transforms
+// into the InstanceBuffer and writes the instance counts of the indirect draws. Passes issue one indirect call per
+// DrawGroup rather than one call per mesh.
+//
+// Each (mesh, material) pair the camera sees and each mesh a shadow cascade sees is a bucket, which becomes one
+// VkDrawIndexedIndirectCommand. A mesh's shadow buckets are consecutive, one per cascade. Buckets sharing a pool chunk, index type and material form a DrawGroup. With
+// VK_KHR_draw_indirect_count a second dispatch compacts away draws that culled to nothing, otherwise they're issued
+// with zero instances. Each frame's buffers grow to fit its objects and buckets.
+//
+// Usage per frame: BeginFrame(), Add() every object, Finalize(), then Cull() outside a render pass before any
+// DrawIndirect().
+class SceneRenderPass final
+{
+public: // Types
+	enum class View : u32
+	{
+		Camera = 0,
+		Shadow = 1, // First cascade, the rest follow
+	};
+	static constexpr u32 ViewCount = 1 + ShadowCascades::MaxCascades;
+	static View ShadowView(u32 cascade) { return View((u32)View::Shadow + cascade); }
+
+	// A run of draws sharing vertex and index bindings, and material for the camera view
+	struct DrawGroup
+	{
+		f32 NearestDistSquared = 0; // Camera view only, its groups are ordered front to back by it
+		VkBuffer PositionBuffer = nullptr;
+		VkBuffer AttributeBuffer = nullptr;
+		VkBuffer IndexBuffer = nullptr;
+		VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+		const Material* Material = nullptr; // Null for the shadow view
+		u32 FirstDraw = 0;
+		u32 DrawCount = 0;
+		u32 CounterIndex = 0; // Compacted draw count's slot in the counter buffer
+	};
+
+private: // Types
+	static constexpr u32 NoBucket = UINT32_MAX;
+	static constexpr u32 WorkgroupSize = 64; // Match SceneCull.comp and SceneCompact.comp
+	static constexpr u32 StaleBucketFrames = 256; // Unused this long, a bucket counts as stale
+	static constexpr u32 InitialObjectCapacity = 4096;
+	static constexpr u32 InitialDrawCapacity = 1024;
+
+	// Match SceneCull.comp
+	struct GpuObject
+	{
+		glm::mat4 Transform;
+		glm::vec3 BoundsMin;
+		u32 CameraBucket;
+		glm::vec3 BoundsMax;
+		u32 ShadowBucket; // First cascade's
+	};
+	static_assert(sizeof(GpuObject) == 96);
+
+	// VkDrawIndexedIndirectCommand followed by what the compaction needs, drawn with a stride of sizeof(GpuDrawCommand)
+	struct GpuDrawCommand
+	{
+		VkDrawIndexedIndirectCommand Command;
+		u32 Group;
+		u32 GroupFirstDraw;
+		u32 Padding;
+	};
+	static_assert(sizeof(GpuDrawCommand) == 32);
+
+	struct PushConstants
+	{
+		std::array<glm::vec4, 6> Planes; // Cull only
+		u32 Count;                       // Objects to cull or draws to compact
+		u32 View;
+	};
+
+	struct Bucket
+	{
+		View BucketView = View::Camera;
+		const Material* Material = nullptr;
+		VkBuffer PositionBuffer = nullptr;
+		VkBuffer AttributeBuffer = nullptr;
+		VkBuffer IndexBuffer = nullptr;
+		VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+		u32 IndexCount = 0;
+		u32 FirstIndex = 0;
+		i32 VertexOffset = 0;
+
+		u32 FrameStamp = 0;    // Last frame an object used the bucket
+		u32 LastUsed = 0;      // Same, but also counts objects of a shadow cascade that was skipped
+		u32 InstanceCount = 0; // Objects added this frame, the most that can survive culling
+		f32 NearestDistSquared = 0; // From the camera to this frame's closest object, camera view only
+	};
+
+	// Most objects of a mesh share a material, so a one entry cache skips the map lookup
+	struct MeshBuckets
+	{
+		u32 Shadow = NoBucket; // First cascade's
+		const Material* LastMaterial = nullptr;
+		u32 LastCamera = NoBucket;
+	};
+
+	struct BucketKey
+	{
+		u32 MeshId;
+		const Material* Material;
+		bool operator==(const BucketKey& other) const { return MeshId == other.MeshId && Material == other.Material; }
+	};
+	struct BucketKeyHash
+	{
+		size_t operator()(const BucketKey& key) const
+		{
+			return std::hash<const Material*>()(key.Material) ^ (std::hash<u32>()(key.MeshId) << 1);
+		}
+	};
+
+	// Recreated larger when a frame outgrows it
+	struct GrowableBuffer
+	{
+		VkBuffer Buffer = nullptr;
+		GpuAllocation Allocation{};
+		u32 Capacity = 0; // Elements
+	};
+
+	struct FrameResources
+	{
+		GrowableBuffer Objects{};        // GpuObject per object, host written
+		GrowableBuffer BucketDraws{};    // Draw index per bucket, host written
+		GrowableBuffer Draws{};          // GpuDrawCommand per draw, host written with zero instances
+		GrowableBuffer CompactedDraws{}; // Non-empty draws packed to the front of each group
+		GrowableBuffer Counters{};       // Visible objects per view, then compacted draws per group
+		VkDescriptorSet DescriptorSet = nullptr;
+		bool DescriptorsStale = true; // A buffer, or the instance buffer, was recreated since the set was written
+
+		u32 ObjectCount = 0;
+		u32 DrawCount = 0;
+		bool Culled = false; // Counters hold results once the GPU is done with the frame
+	};
+
+private: // Data
+	VulkanService* _vk = nullptr;
+	const ResourceRegistry* _resourceRegistry = nullptr;
+	InstanceBuffer* _instanceBuffer = nullptr;
+
+	VkDescriptorSetLayout _descriptorSetLayout = nullptr;
+	VkDescriptorPool _descriptorPool = nullptr;
+	VkPipelineLayout _pipelineLayout = nullptr;
+	VkPipeline _cullPipeline = nullptr;
+	VkPipeline _compactPipeline = nullptr;
+
+	std::vector<FrameResources> _frames{}; // 1 per frame in flight
+
+	// Buckets persist between frames so a steady scene is all cache hits. Rebuilt once stale pairs outnumber live ones.
+	std::vector<Bucket> _buckets{};
+	std::vector<MeshBuckets> _meshBuckets{}; // Indexed by MeshResourceId
+	std::unordered_map<BucketKey, u32, BucketKeyHash> _cameraBucketLookup{};
+
+	// This frame
+	u32 _frameIndex = 0;
+	u32 _frameStamp = 0;
+	glm::vec3 _cameraPosition{};
+	u32 _shadowCascadeCount = 0;
+	std::array<std::optional<Frustum>, ViewCount> _frusta{};
+	std::array<std::vector<u32>, ViewCount> _activeBuckets{};
+	std::array<std::vector<DrawGroup>, ViewCount> _drawGroups{};
+	std::array<u32, ViewCount> _visibleCounts{};
+
+public: // Methods
+	SceneRenderPass() = delete;
+	SceneRenderPass(VulkanService& vk, const ResourceRegistry* registry, InstanceBuffer& instanceBuffer,
+		const std::string& shaderDir, u32 numImagesInFlight);
+	~SceneRenderPass();
+	SceneRenderPass(const SceneRenderPass&) = delete;
+	SceneRenderPass& operator=(const SceneRenderPass&) = delete;
+	SceneRenderPass(SceneRenderPass&&) = delete;
+	SceneRenderPass& operator=(SceneRenderPass&&) = delete;
+
+	// Caller guarantees the GPU has finished with frameIndex. One entry per shadow cascade, none draws no shadows. A
+	// cascade without a frustum is skipped this frame, eg. its shadow map is cached.
+	void BeginFrame(u32 frameIndex, const Frustum& cameraFrustum, const glm::vec3& cameraPosition,
+		const std::vector<std::optional<Frustum>>& shadowFrusta);
+
+	// A null material keeps the object out of the camera view, eg. transparent objects that are sorted on the CPU.
+	// Empty bounds are treated as unknown and never culled.
+	void Add(const glm::mat4& transform, const AABB& worldBounds, MeshResourceId meshId, const Material* material);
+
+	// Writes this frame's draws and reserves their instances. Call once every object is added.
+	void Finalize();
+
+	// Records the cull and compaction dispatches. Must be outside a render pass and before any DrawIndirect().
+	void Cull(VkCommandBuffer commandBuffer);
+
+	// Caller binds the group's buffers, and its material for the camera view
+	void DrawIndirect(VkCommandBuffer commandBuffer, const DrawGroup& group) const;
+
+	const std::vector<DrawGroup>& GetDrawGroups(View view) const { return _drawGroups[(u32)view]; }
+
+	// Objects that survived the GPU cull, read back when this frame slot was last reused. Lags by the frames in flight.
+	u32 GetVisibleCount(View view) const { return _visibleCounts[(u32)view]; }
+
+	// Call when this frame's InstanceBuffer was recreated, before Cull()
+	void OnInstanceBufferRecreated() { _frames[_frameIndex].DescriptorsStale = true; }
+
+private:
+	u32 CameraBucket(MeshBuckets& meshBuckets, MeshResourceId meshId, const Material& material);
+	u32 ShadowBucket(MeshBuckets& meshBuckets, MeshResourceId meshId);
+	u32 CreateBucket(View view, MeshResourceId meshId, const Material* material);
+	u32 Touch(u32 bucketIndex);
+	bool MostBucketsStale() const;
+	void ResetBuckets();
+
+	void CreateFrameResources(FrameResources& frame) const;
+	void DestroyFrameResources(FrameResources& frame) const;
+	void CreateGrowableBuffer(GrowableBuffer& buffer, u32 capacity, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+		VkMemoryPropertyFlags properties) const;
+	void DestroyGrowableBuffer(GrowableBuffer& buffer) const;
+	void GrowBuffer(FrameResources& frame, GrowableBuffer& buffer, u32 required, VkDeviceSize elementSize,
+		VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, u32 keepElements) const;
+	void WriteDescriptorSet(const FrameResources& frame, u32 frameIndex) const;
+	VkPipeline CreateComputePipeline(const std::string& shaderPath) const;
+};
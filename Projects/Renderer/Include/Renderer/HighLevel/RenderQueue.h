@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Orders a frame's draws by 64 bit sort keys. The key's most significant fields vary least, so sorted draws change
+// pipeline rarely, material less often than geometry, and so on. The radix sort is stable, so draws with equal keys
+// keep their submission order.
+//
+//   Opaque:      pass:2 | pipeline:4 | material:16 | geometry:16 | depth:26   State first, front to back within it
+//   Transparent: pass:2 | depth:32 | pipeline:4 | material:16 | geometry:10   Back to front, state breaks ties
+//
+// Material and geometry ids are truncated to their fields. A collision only costs a rebind, never correctness, as long
+// as binds compare the real state.
+class RenderQueue final
+{
+public: // Types
+	enum class Pass : u32
+	{
+		Opaque = 0,
+		Transparent = 1,
+	};
+
+	struct Entry
+	{
+		u64 Key;
+		u32 Item; // Caller's index for the draw
+	};
+
+private: // Data
+	std::vector<Entry> _entries{};
+	std::vector<Entry> _scratch{};
+
+public: // Methods
+	// depthSquared is the squared distance to the camera, or anything else that is non-negative and orders the same
+	static u64 OpaqueKey(u32 pipeline, u32 material, u32 geometry, f32 depthSquared);
+	static u64 TransparentKey(u32 pipeline, u32 material, u32 geometry, f32 depthSquared);
+
+	void Clear() { _entries.clear(); }
+	void Push(u64 key, u32 item) { _entries.push_back(Entry{ key, item }); }
+
+	// LSD radix sort, 8 bits per pass. Passes where every key has the same byte are skipped.
+	void Sort();
+
+	const std::vector<Entry>& Entries() const { return _entries; }
+	bool Empty() const { return _entries.empty(); }
+};
@@ -98,7 +98,7 @@ public: // Methods
 			createInfo.flags = 0;
 			createInfo.basePipelineHandle = nullptr;
 			createInfo.basePipelineIndex = 0;
-			if (vkCreateComputePipelines(_vk->LogicalDevice(), nullptr, 1, &createInfo, _vk->Allocator(), &computePipeline) != VK_SUCCESS)
+			if (_vk->GetPipelineCache().CreateComputePipeline(createInfo, &computePipeline) != VK_SUCCESS)
 			{
 				throw std::runtime_error("Failed to Create Compute Pipeline!");
 			}
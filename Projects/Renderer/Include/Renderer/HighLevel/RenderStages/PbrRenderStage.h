@@ -1,8 +1,19 @@
 #pragma once
 
 #include "Renderer/HighLevel/CommonRendererHighLevel.h"
+#include "Renderer/HighLevel/LightClusters.h"
+#include "Renderer/HighLevel/RenderQueue.h"
+#include "Renderer/HighLevel/RenderPasses/SceneRenderPass.h"
+#include "Renderer/HighLevel/ShIrradiance.h"
+#include "Renderer/LowLevel/InstanceBuffer.h"
+#include "Renderer/LowLevel/UniformRingBuffer.h"
 #include "Renderer/LowLevel/VulkanService.h"
 
+#include <Framework/Frustum.h>
+
+#include <algorithm>
+#include <optional>
+
 class VulkanService;
 class ResourceRegistry;
 class TextureResource;
@@ -14,7 +25,7 @@ class IPbrRenderStageDelegate
 public:
 	virtual ~IPbrRenderStageDelegate() = default;
 	virtual VkDescriptorImageInfo GetShadowmapDescriptor() = 0;
-	virtual const TextureResource& GetIrradianceTextureResource() = 0;
+	virtual const ShIrradiance::Coefficients& GetIrradianceSh() = 0;
 	virtual const TextureResource& GetPrefilterTextureResource() = 0;
 	virtual const TextureResource& GetBrdfTextureResource() = 0;
 };
@@ -25,8 +36,8 @@ struct PbrMaterialResource
 {
 public:
 	PbrMaterialResource() = delete;
-	PbrMaterialResource(VulkanService* vk, VkDescriptorSet descSet, VkBuffer buffer, VkDeviceMemory memory)
-		: _vk(vk), _descSet(descSet), _uniformBuffer(buffer), _uniformBufferMemory(memory)
+	PbrMaterialResource(VulkanService* vk, VkDescriptorSet descSet, u64 bindingsHash)
+		: _vk(vk), _descSet(descSet), _bindingsHash(bindingsHash)
 	{
 		// TODO Create the resource here so it's symmetrical with Destroy()
 	}
@@ -47,29 +58,29 @@ public:
 			Destroy();
 			_vk = other._vk;
 			_descSet = other._descSet;
-			_uniformBuffer = other._uniformBuffer;
-			_uniformBufferMemory = other._uniformBufferMemory;
+			_bindingsHash = other._bindingsHash;
 			other._vk = nullptr;
 			other._descSet = nullptr;
-			other._uniformBuffer = nullptr;
-			other._uniformBufferMemory = nullptr;
+			other._bindingsHash = 0;
 		}
 		
 		return *this;
 	}
 	
 
+	// Binding 0 is a dynamic UBO into the stage's UniformRingBuffer, so the set is valid for any frame's data
 	VkDescriptorSet GetMaterialDescriptorSet() const { return _descSet; }
-	VkBuffer GetMaterialUniformBuffer() const { return _uniformBuffer; }
-	VkDeviceMemory GetMaterialUniformBufferMemory() const { return _uniformBufferMemory; }
+
+	// Hash of the texture bindings last written to the set. See MaterialResourceManager::HashTextureBindings()
+	u64 GetBindingsHash() const { return _bindingsHash; }
+	void SetBindingsHash(u64 hash) { _bindingsHash = hash; }
 	
 private:
 	void Destroy();
 
 	VulkanService* _vk = nullptr;
 	VkDescriptorSet _descSet = nullptr;
-	VkBuffer _uniformBuffer = nullptr;
-	VkDeviceMemory _uniformBufferMemory = nullptr;
+	u64 _bindingsHash = 0;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -81,6 +92,7 @@ private:
 	ResourceRegistry* _resourceRegistry = nullptr;
 	VkDescriptorPool _pool = nullptr;
 	VkDescriptorSetLayout _descSetLayout = nullptr;
+	VkBuffer _uniformRingBuffer = nullptr;
 	TextureResourceId _placeholderTexture{};
 
 	
@@ -88,8 +100,8 @@ private:
 
 public:
 	MaterialResourceManager() = delete;
-	explicit MaterialResourceManager(VulkanService& vk, VkDescriptorPool pool, VkDescriptorSetLayout descSetLayout, ResourceRegistry* registry, TextureResourceId placeholder)
-		: _vk(&vk), _resourceRegistry(registry), _pool(pool), _descSetLayout(descSetLayout), _placeholderTexture(placeholder)
+	explicit MaterialResourceManager(VulkanService& vk, VkDescriptorPool pool, VkDescriptorSetLayout descSetLayout, VkBuffer uniformRingBuffer, ResourceRegistry* registry, TextureResourceId placeholder)
+		: _vk(&vk), _resourceRegistry(registry), _pool(pool), _descSetLayout(descSetLayout), _uniformRingBuffer(uniformRingBuffer), _placeholderTexture(placeholder)
 	{}
 	~MaterialResourceManager() = default;
 	// Copy
@@ -99,10 +111,17 @@ public:
 	MaterialResourceManager(MaterialResourceManager&&) = default;
 	MaterialResourceManager& operator=(MaterialResourceManager&&) = delete;
 
-	const PbrMaterialResource& GetOrCreate(const Material& material, u32 swapImageIndex);
+	PbrMaterialResource& GetOrCreate(const Material& material, u32 swapImageIndex);
 
 	PbrMaterialResource CreateMaterialFrameResources(const Material& material) const;
 
+	// Writes the material's descriptor set only if its texture bindings changed since the last write. Returns true if
+	// a write happened.
+	bool UpdateIfChanged(PbrMaterialResource& resource, const Material& material) const;
+
+	// Identifies the exact image views and samplers a material resolves to, placeholders included
+	u64 HashTextureBindings(const Material& material) const;
+
 
 	static void WriteMaterialDescriptorSet(
 		VkDescriptorSet descriptorSet,
@@ -112,6 +131,8 @@ public:
 		const TextureResource& transparencyMap, VkDevice device);
 
 private:
+	const TextureResource& GetTextureOrPlaceholder(const std::optional<Material::Map>& map) const;
+
 	static u32 CreateKey(u32 id, u32 frame)
 	{
 		assert(frame <= 3);          // only reserving 2 bits for frame
@@ -130,6 +151,46 @@ private:
 class PbrRenderStage
 {
 public: // Data
+	static constexpr u32 MaxPbrObjects = 10000; // Max materials! This is gross, but it'll do for now.
+	static constexpr u32 MaxLights = 4096;
+	static constexpr u32 MaxLightIndices = 256 * 1024; // Light references across all clusters
+	static constexpr u32 InitialInstanceCapacity = 16 * 1024; // Per frame in flight, grows to fit
+
+	// State changes issued while recording, and those skipped because the state was already bound
+	struct BindCounts
+	{
+		u32 Binds = 0;
+		u32 Skipped = 0;
+	};
+	
+private:// Types
+	struct BatchSortItem
+	{
+		const SceneRendererPrimitives::RenderableObject* Object;
+		MeshResourceId MeshId;
+		f32 DistSquared;
+	};
+
+	// A camera draw group or a transparent batch, with its material resolved ahead of recording
+	struct DrawItem
+	{
+		const SceneRenderPass::DrawGroup* Group = nullptr;
+		const InstanceBatch* Batch = nullptr;
+		VkDescriptorSet MaterialDescriptorSet = nullptr;
+		u32 MaterialUboOffset = 0;
+	};
+
+	// Host written each frame from _lightClusters
+	struct LightFrameResources
+	{
+		VkBuffer LightBuffer = nullptr;      // LightClusters::GpuHeader then a GpuLight per light
+		VkBuffer ClusterBuffer = nullptr;    // GpuCluster per cluster
+		VkBuffer LightIndexBuffer = nullptr; // u32 per light reference
+		GpuAllocation LightAllocation{};
+		GpuAllocation ClusterAllocation{};
+		GpuAllocation LightIndexAllocation{};
+	};
+
 private:// Data
 
 	// Dependencies
@@ -142,18 +203,42 @@ private:// Data
 
 	// PBR
 	VkPipeline _pbrPipeline = nullptr;
+	VkPipeline _pbrDepthEqualPipeline = nullptr; // Opaque objects after the depth prepass: EQUAL test, no depth writes
+	VkPipeline _depthPrepassPipeline = nullptr;   // Position only, shares _pbrPipelineLayout
 	VkPipelineLayout _pbrPipelineLayout = nullptr;
 	VkDescriptorSetLayout _materialDescriptorSetLayout = nullptr;
 	VkDescriptorSetLayout _pbrDescriptorSetLayout = nullptr;
 
 	// Resources
-	std::vector<VkBuffer> _lightBuffers{}; // 1 per frame in flight
-	std::vector<VkDeviceMemory> _lightBuffersMemory{};
+	std::unique_ptr<UniformRingBuffer> _uniformRing = nullptr; // Frame and material UBOs for every frame in flight
+	std::unique_ptr<InstanceBuffer> _instanceBuffer = nullptr; // Model matrices for every frame in flight
+	std::unique_ptr<SceneRenderPass> _scenePass = nullptr;     // GPU culled opaque objects and shadow casters
+	std::vector<VkDescriptorSet> _frameDescriptorSets{};        // 1 per frame in flight
+	std::vector<LightFrameResources> _lightFrames{};           // 1 per frame in flight
 
 	std::unique_ptr<MaterialResourceManager> _materialFrameResources = nullptr;
 	std::vector<std::unique_ptr<RenderableMesh>> _renderables{};
 
-	bool _refreshRenderableDescriptorSets = false;
+	// Built by PrepareDraws() each frame. Transparent objects need sorting, so they're culled and batched on the CPU.
+	std::vector<InstanceBatch> _transparentBatches{};   // Back to front
+	std::vector<BatchSortItem> _transparentSortItems{}; // Scratch, kept to avoid per-frame allocations
+	RenderQueue _queue{};                                // Scratch, sorts transparent items then opaque groups
+	std::vector<VkBuffer> _geometryIds{};                // Scratch, index buffers seen this frame, see GeometryId()
+
+	// Built by PrepareRecording() each frame, read only while recording
+	std::vector<DrawItem> _drawItems{}; // Opaque groups front to back, then transparent batches back to front
+	std::unordered_map<const Material*, u32> _materialUboOffsets{};
+	u32 _opaqueItemCount = 0;
+	LightClusters _lightClusters{};
+	u32 _frameUboOffset = 0;
+	bool _depthPrepass = false;
+	bool _instanceBufferRecreated = false; // By the last PrepareDraws()
+
+	std::vector<u64> _frameDescriptorInputHashes{}; // 1 per frame in flight. Hash of the IBL/shadowmap inputs last written to _frameDescriptorSets
+
+	// Descriptor set writes issued by the last UpdateDescriptors(). A static scene should report zero.
+	u32 _materialDescriptorWrites = 0;
+	u32 _frameDescriptorWrites = 0;
 
 	// Required resources
 	TextureResourceId _placeholderTexture;
@@ -163,25 +248,62 @@ private:// Data
 
 
 public: // Members
-	const std::vector<std::unique_ptr<RenderableMesh>>& Hack_GetRenderables() const { return _renderables; }
-
 	PbrRenderStage(VulkanService& vulkanService, ResourceRegistry* registry, IPbrRenderStageDelegate& delegate, std::string shaderDir, const std::string& assetsDir);
 
 	void Destroy();
 	
 	bool UpdateDescriptors(u32 imageIndex, const RenderOptions& options, bool skyboxUpdated, const SceneRendererPrimitives& scene);
 
-	void Draw(VkCommandBuffer commandBuffer, u32 frameIndex,
+	// Hands opaque objects and shadow casters to the scene pass and batches the visible transparent objects. Must
+	// precede RecordCulling(). See SceneRenderPass::BeginFrame() for the shadow frusta.
+	void PrepareDraws(u32 frameIndex, const std::vector<SceneRendererPrimitives::RenderableObject>& objects,
+		const Frustum& cameraFrustum, const std::vector<std::optional<Frustum>>& shadowFrusta, const glm::vec3& camPos);
+
+	// Records the transparent transforms' upload and the GPU cull. Must be outside a render pass and before the shadow
+	// and pbr passes draw.
+	void RecordCulling(VkCommandBuffer commandBuffer) const
+	{
+		_instanceBuffer->RecordUpload(commandBuffer);
+		_scenePass->Cull(commandBuffer);
+	}
+
+	// Pushes this frame's uniforms, clusters the lights and resolves every draw's material. Call after PrepareDraws(),
+	// before RecordDraws(). The clip planes and extent must match the projection and the render target.
+	void PrepareRecording(u32 frameIndex,
 		const RenderOptions& options,
-		const std::vector<SceneRendererPrimitives::RenderableObject>& objects,
 		const std::vector<Light>& lights,
-		const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camPos, const glm::mat4& lightSpaceMatrix);
+		const glm::mat4& view, const glm::mat4& projection, f32 nearClip, f32 farClip, VkExtent2D extent,
+		const glm::vec3& camPos, const ShadowCascades& shadowCascades);
+
+	// Records draw items [firstItem, firstItem + itemCount) in order. Safe to call from several threads at once, each
+	// with its own command buffer. With the depth prepass on, every prepass item must be executed first.
+	BindCounts RecordDraws(VkCommandBuffer commandBuffer, u32 frameIndex, u32 firstItem, u32 itemCount) const;
+	u32 GetDrawItemCount() const { return (u32)_drawItems.size(); }
+
+	// Depth only draws of the opaque items, so RecordDraws() shades each pixel once. Zero items when disabled in the
+	// RenderOptions passed to PrepareRecording(). Same threading rules as RecordDraws().
+	BindCounts RecordDepthPrepass(VkCommandBuffer commandBuffer, u32 frameIndex, u32 firstItem, u32 itemCount) const;
+	u32 GetDepthPrepassItemCount() const { return _depthPrepass ? _opaqueItemCount : 0; }
 
 	RenderableResourceId CreateRenderable(const MeshResourceId& meshId);
 
 	VkRenderPass GetRenderPass() const { return _renderPass; }
+	VkBuffer GetInstanceBuffer(u32 frameIndex) const { return _instanceBuffer->Buffer(frameIndex); }
+	u32 GetInstanceBufferCount() const { return _instanceBuffer->FrameCount(); }
+	// Other stages reading the frame's instance buffer must rewrite their descriptors before recording
+	bool InstanceBufferRecreated() const { return _instanceBufferRecreated; }
+	const SceneRenderPass& GetScenePass() const { return *_scenePass; }
+	u32 GetTransparentCount() const { return (u32)_transparentSortItems.size(); }
+	const LightClusters& GetLightClusters() const { return _lightClusters; }
+	u32 GetDrawCallCount() const
+	{
+		return u32(_scenePass->GetDrawGroups(SceneRenderPass::View::Camera).size() + _transparentBatches.size());
+	}
 	
-	void SetSkyboxDirty() { _refreshRenderableDescriptorSets = true; }
+	void SetSkyboxDirty() { std::fill(_frameDescriptorInputHashes.begin(), _frameDescriptorInputHashes.end(), 0); }
+
+	u32 GetMaterialDescriptorWrites() const { return _materialDescriptorWrites; }
+	u32 GetFrameDescriptorWrites() const { return _frameDescriptorWrites; }
 
 	void HandleSwapchainRecreated(u32 width, u32 height, u32 numSwapchainImages);
 
@@ -192,35 +314,46 @@ private:
 	void DestroyRenderResourcesDependentOnSwapchain();
 	static VkRenderPass CreateRenderPass(VkFormat format, VulkanService& vk);
 
+	// Small per-frame id for a geometry binding, for sort keys
+	u32 GeometryId(VkBuffer indexBuffer, VkIndexType indexType);
+
 	
 #pragma region Shared
 
 	static VkDescriptorPool CreateDescriptorPool(u32 numImagesInFlight, VkDevice device);
+	void CreateLightFrameResources(LightFrameResources& frame) const;
+	void DestroyLightFrameResources(LightFrameResources& frame) const;
 
 #pragma endregion Shared
 
 
 #pragma region Pbr
 
-	std::vector<PbrCommonResourceFrame> CreateCommonFrameResources(u32 numImagesInFlight) const;
-
 	// Defines the layout of the data bound to the shaders
 	static VkDescriptorSetLayout CreateMaterialDescriptorSetLayout(VkDevice device);
 	static VkDescriptorSetLayout CreatePbrDescriptorSetLayout(VkDevice device);
 
+	u64 HashFrameDescriptorInputs() const;
+
 	static void WriteCommonDescriptorSet(
 		VkDescriptorSet descriptorSet,
-		VkBuffer meshUbo,
-		VkBuffer lightUbo,
-		const TextureResource& irradianceMap,
+		VkBuffer uniformRingBuffer,
+		VkBuffer instanceBuffer,
+		const LightFrameResources& lights,
 		const TextureResource& prefilterMap,
 		const TextureResource& brdfMap,
 		VkDescriptorImageInfo shadowmapDescriptor,
 		VkDevice device);
+	static void WriteInstanceDescriptor(VkDescriptorSet descriptorSet, VkBuffer instanceBuffer, VkDevice device);
 
 	// The uniform and push values referenced by the shader that can be updated at draw time
+	// depthPrepassed tests for depth EQUAL to what the prepass wrote, and doesn't write it again
 	static VkPipeline CreatePbrGraphicsPipeline(const std::string& shaderDir, VkPipelineLayout pipelineLayout,
-		VkSampleCountFlagBits msaaSamples, VkRenderPass renderPass, VkDevice device);
+		VkSampleCountFlagBits msaaSamples, VkRenderPass renderPass, bool depthPrepassed, VkDevice device,
+		PipelineCache& pipelineCache);
+
+	static VkPipeline CreateDepthPrepassPipeline(const std::string& shaderDir, VkPipelineLayout pipelineLayout,
+		VkSampleCountFlagBits msaaSamples, VkRenderPass renderPass, VkDevice device, PipelineCache& pipelineCache);
 
 
 #pragma endregion Pbr
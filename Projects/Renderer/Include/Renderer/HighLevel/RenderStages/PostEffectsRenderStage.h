@@ -46,13 +46,13 @@ private: // Types
 		// Private resources
 		VkDescriptorSetLayout DescriptorSetLayout = nullptr;
 
-		void Destroy(VkDevice device, VkAllocationCallbacks* allocator)
+		void Destroy(VkDevice device, VkAllocationCallbacks* allocator, GpuMemoryAllocator& memoryAllocator)
 		{
 			//Quad
 			vkDestroyBuffer(device, Quad.IndexBuffer, allocator);
 			vkDestroyBuffer(device, Quad.VertexBuffer, allocator);
-			vkFreeMemory(device, Quad.IndexBufferMemory, allocator);
-			vkFreeMemory(device, Quad.VertexBufferMemory, allocator);
+			memoryAllocator.Free(Quad.IndexBufferAllocation);
+			memoryAllocator.Free(Quad.VertexBufferAllocation);
 
 			vkDestroyPipeline(device, Pipeline, nullptr);
 			vkDestroyPipelineLayout(device, PipelineLayout, nullptr);
@@ -80,7 +80,8 @@ public: // Methods
 		_screenQuadResources = CreateDrawResources(
 			_renderPass,
 			shaderDir,
-			_vulkan->LogicalDevice(), _vulkan->PhysicalDevice(), _vulkan->CommandPool(), _vulkan->GraphicsQueue());
+			_vulkan->LogicalDevice(), _vulkan->MemoryAllocator(), _vulkan->CommandPool(), _vulkan->GraphicsQueue(),
+			_vulkan->GetPipelineCache());
 	}
 
 	void Destroy()
@@ -89,7 +90,7 @@ public: // Methods
 		{
 			DestroyDescriptorResources();
 			vkDestroyRenderPass(_vulkan->LogicalDevice(), _renderPass, _vulkan->Allocator());
-			_screenQuadResources.Destroy(_vulkan->LogicalDevice(), _vulkan->Allocator());
+			_screenQuadResources.Destroy(_vulkan->LogicalDevice(), _vulkan->Allocator(), _vulkan->MemoryAllocator());
 			_vulkan = nullptr;
 		}
 	}
@@ -249,7 +250,8 @@ private: // Methods
 		return vkh::CreateRenderPass(vk.LogicalDevice(), { colourAttachDesc }, { subpassDescription }, {});
 	}
 	
-	static DrawResources CreateDrawResources(VkRenderPass renderPass, const std::string& shaderDir, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool cmdPool, VkQueue cmdQueue)
+	static DrawResources CreateDrawResources(VkRenderPass renderPass, const std::string& shaderDir, VkDevice device, GpuMemoryAllocator& allocator, VkCommandPool cmdPool, VkQueue cmdQueue,
+		PipelineCache& pipelineCache)
 	{
 		auto msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -285,11 +287,11 @@ private: // Methods
 			screenQuad.IndexCount = indices.size();
 			screenQuad.VertexCount = vertices.size();
 
-			std::tie(screenQuad.IndexBuffer, screenQuad.IndexBufferMemory) = vkh::CreateIndexBuffer(indices,
-				cmdQueue, cmdPool, physicalDevice, device);
+			std::tie(screenQuad.IndexBuffer, screenQuad.IndexBufferAllocation) = vkh::CreateIndexBuffer(indices,
+				cmdQueue, cmdPool, allocator, device);
 
-			std::tie(screenQuad.VertexBuffer, screenQuad.VertexBufferMemory) = vkh::CreateVertexBuffer(vertices,
-				cmdQueue, cmdPool, physicalDevice, device);
+			std::tie(screenQuad.VertexBuffer, screenQuad.VertexBufferAllocation) = vkh::CreateVertexBuffer(vertices,
+				cmdQueue, cmdPool, allocator, device);
 
 			return screenQuad;
 		}();
@@ -413,7 +415,7 @@ private: // Methods
 			pipelineCI.layout = pipelineLayout;
 
 
-			if (VK_SUCCESS != vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineCI, nullptr, &pipeline))
+			if (VK_SUCCESS != pipelineCache.CreateGraphicsPipeline(pipelineCI, &pipeline))
 			{
 				throw std::runtime_error("Failed to create pipeline");
 			}
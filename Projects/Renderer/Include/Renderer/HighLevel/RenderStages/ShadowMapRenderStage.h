@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Renderer/HighLevel/CommonRendererHighLevel.h"
+#include "Renderer/HighLevel/RenderPasses/SceneRenderPass.h"
 #include "Renderer/LowLevel/GpuTypes.h"
 #include "Renderer/LowLevel/VulkanService.h"
 #include "Renderer/LowLevel/RenderableMesh.h"
@@ -12,20 +13,33 @@ class ShadowMapRenderStage
 public:
 	struct PushConstants
 	{
-		glm::mat4 ShadowMatrix;
+		glm::mat4 LightSpaceMatrix; // Model matrices come from the instance buffer
 	};
 	
 
 private:
 	VkPipeline _pipeline = nullptr;
 	VkPipelineLayout _pipelineLayout = nullptr;
-	VkRenderPass _renderPass = nullptr;
+	VkRenderPass _renderPass = nullptr;     // Clears the whole atlas
+	VkRenderPass _loadRenderPass = nullptr; // Keeps the atlas, for redrawing some cascades. Compatible with _renderPass.
+
+	VkDescriptorSetLayout _descriptorSetLayout = nullptr;
+	VkDescriptorPool _descriptorPool = nullptr;
+	std::vector<VkDescriptorSet> _descriptorSets{}; // Instance buffer, 1 per frame in flight
 
 public:
 	ShadowMapRenderStage() = default;
 	ShadowMapRenderStage(const std::string& shaderDir, VulkanService& vk)
 	{
-		_renderPass = CreateRenderPass(vk);
+		_renderPass = CreateRenderPass(vk, false);
+		_loadRenderPass = CreateRenderPass(vk, true);
+
+		// Descriptors
+		{
+			_descriptorSetLayout = vkh::CreateDescriptorSetLayout(vk.LogicalDevice(), {
+				vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT),
+			});
+		}
 
 		// Pipeline Layout
 		{
@@ -33,7 +47,7 @@ public:
 			pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 			pushConstantRange.size = sizeof(PushConstants);
 			pushConstantRange.offset = 0;
-			_pipelineLayout = vkh::CreatePipelineLayout(vk.LogicalDevice(), {}, { pushConstantRange });
+			_pipelineLayout = vkh::CreatePipelineLayout(vk.LogicalDevice(), { _descriptorSetLayout }, { pushConstantRange });
 		}
 		
 		_pipeline = CreatePipeline(shaderDir, _renderPass, _pipelineLayout, vk);
@@ -42,15 +56,63 @@ public:
 	void Destroy(VkDevice device, VkAllocationCallbacks* allocator)
 	{
 		vkDestroyPipeline(device, _pipeline, allocator);
+		vkDestroyPipelineLayout(device, _pipelineLayout, allocator);
+		vkDestroyDescriptorPool(device, _descriptorPool, allocator);
+		vkDestroyDescriptorSetLayout(device, _descriptorSetLayout, allocator);
+		vkDestroyRenderPass(device, _loadRenderPass, allocator);
 		vkDestroyRenderPass(device, _renderPass, allocator);
 	}
 
 	VkRenderPass GetRenderPass() const { return _renderPass; }
+	VkRenderPass GetLoadRenderPass() const { return _loadRenderPass; } // Atlas must have been drawn before
+
+	// One set per frame in flight, each then needs SetInstanceBuffer(). Not safe while any frame is in flight.
+	void CreateDescriptorSets(u32 numImagesInFlight, VkDevice device)
+	{
+		vkDestroyDescriptorPool(device, _descriptorPool, nullptr); // Frees the sets
+		_descriptorPool = vkh::CreateDescriptorPool({ {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numImagesInFlight} },
+			numImagesInFlight, device);
+		_descriptorSets = vkh::AllocateDescriptorSets(numImagesInFlight, _descriptorSetLayout, _descriptorPool, device);
+	}
+
+	// Must be called again whenever the frame's instance buffer is recreated. Not safe while that frame is in flight.
+	void SetInstanceBuffer(u32 frameIndex, VkBuffer instanceBuffer, VkDevice device) const
+	{
+		VkDescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = instanceBuffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+
+		vkh::UpdateDescriptorSet(device, {
+			vki::WriteDescriptorSet(_descriptorSets[frameIndex], 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, 0, nullptr, &bufferInfo),
+		});
+	}
 	
-	void Draw(VkCommandBuffer commandBuffer, VkRect2D renderArea, const SceneRendererPrimitives& scene, const glm::mat4& lightSpaceMatrix,
-		const std::vector<std::unique_ptr<RenderableMesh>>& renderables,
-		const std::vector<std::unique_ptr<MeshResource>>& meshes) const
+	// Clears the cascade's tile. For the load render pass, before redrawing a cascade.
+	void ClearTile(VkCommandBuffer commandBuffer, const ShadowCascades& cascades, u32 cascade) const
+	{
+		const auto& tile = cascades.Get(cascade);
+
+		VkClearAttachment clear = {};
+		clear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		clear.clearValue.depthStencil = { 1.f, 0 };
+
+		VkClearRect rect = {};
+		rect.rect = { { (i32)tile.AtlasX, (i32)tile.AtlasY }, { cascades.Resolution(), cascades.Resolution() } };
+		rect.baseArrayLayer = 0;
+		rect.layerCount = 1;
+
+		vkCmdClearAttachments(commandBuffer, 1, &clear, 1, &rect);
+	}
+
+	// Draws the cascade's shadow view groups [firstGroup, firstGroup + groupCount) of the scene pass, whose cull must
+	// already be recorded, into its tile of the atlas. Sets all its own state, so chunks can be recorded into separate
+	// secondary command buffers.
+	void Draw(VkCommandBuffer commandBuffer, u32 frameIndex, const ShadowCascades& cascades, u32 cascade,
+		const SceneRenderPass& scenePass, u32 firstGroup, u32 groupCount) const
 	{
+		const auto& tile = cascades.Get(cascade);
+		const VkRect2D renderArea{ { (i32)tile.AtlasX, (i32)tile.AtlasY }, { cascades.Resolution(), cascades.Resolution() } };
 		const auto viewport = vki::Viewport(renderArea);
 		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 		vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
@@ -64,21 +126,30 @@ public:
 		const VkDeviceSize offsets[] = { 0 };
 		const auto size = sizeof(PushConstants);
 		PushConstants pushConstants{};
-		
-		for (const auto& object : scene.Objects)
-		{
-			pushConstants.ShadowMatrix = lightSpaceMatrix * object.Transform;
-			
-			const auto& renderable = *renderables[object.RenderableId.Value()];
-			const auto& mesh = *meshes[renderable.MeshId.Value()];
+		pushConstants.LightSpaceMatrix = tile.ViewProjection;
 
+		vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, size, &pushConstants);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout, 0, 1, &_descriptorSets[frameIndex], 0, nullptr);
+		
+		// Rebind only when the mesh pool chunk or index type changes
+		VkBuffer boundIndexBuffer = nullptr;
+		VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
 
-			const VkBuffer vertexBuffers[] = { mesh.VertexBuffer };
+		const auto& groups = scenePass.GetDrawGroups(SceneRenderPass::ShadowView(cascade));
+		assert(firstGroup + groupCount <= groups.size());
 
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, mesh.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, size, &pushConstants);
-			vkCmdDrawIndexed(commandBuffer, (u32)mesh.IndexCount, 1, 0, 0, 0);
+		for (u32 i = firstGroup; i < firstGroup + groupCount; i++)
+		{
+			const auto& group = groups[i];
+			if (group.IndexBuffer != boundIndexBuffer || group.IndexType != boundIndexType)
+			{
+				const VkBuffer vertexBuffers[] = { group.PositionBuffer };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, group.IndexBuffer, 0, group.IndexType);
+				boundIndexBuffer = group.IndexBuffer;
+				boundIndexType = group.IndexType;
+			}
+			scenePass.DrawIndirect(commandBuffer, group);
 		}
 	}
 
@@ -163,23 +234,16 @@ private:
 
 
 		// Vertex Input  -  Define the format of the vertex data passed to the vert shader
-		VkVertexInputBindingDescription vertBindingDesc = VertexHelper::BindingDescription();
-		//auto vertAttrDesc = VertexHelper::AttributeDescriptions();
-		std::vector<VkVertexInputAttributeDescription> vertAttrDesc(1);
-		{
-			// Pos
-			vertAttrDesc[0].binding = 0;
-			vertAttrDesc[0].location = 0;
-			vertAttrDesc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-			vertAttrDesc[0].offset = offsetof(Vertex, Pos);
-		}
+		// Position stream only
+		VkVertexInputBindingDescription vertBindingDesc = VertexHelper::PositionBindingDescription();
+		VkVertexInputAttributeDescription vertAttrDesc = VertexHelper::PositionAttributeDescription();
 
 		VkPipelineVertexInputStateCreateInfo vertexInputState = {};
 		vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputState.vertexBindingDescriptionCount = 1;
 		vertexInputState.pVertexBindingDescriptions = &vertBindingDesc;
-		vertexInputState.vertexAttributeDescriptionCount = (u32)vertAttrDesc.size();
-		vertexInputState.pVertexAttributeDescriptions = vertAttrDesc.data();
+		vertexInputState.vertexAttributeDescriptionCount = 1;
+		vertexInputState.pVertexAttributeDescriptions = &vertAttrDesc;
 
 
 		// Create the pipeline
@@ -200,7 +264,7 @@ private:
 
 
 		VkPipeline pipeline;
-		if (VK_SUCCESS != vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineCI, nullptr, &pipeline))
+		if (VK_SUCCESS != vk.GetPipelineCache().CreateGraphicsPipeline(pipelineCI, &pipeline))
 		{
 			throw std::runtime_error("Failed to create pipeline");
 		}
@@ -212,7 +276,7 @@ private:
 		return pipeline;
 	}
 
-	static VkRenderPass CreateRenderPass(VulkanService& vk)
+	static VkRenderPass CreateRenderPass(VulkanService& vk, bool loadAtlas)
 	{
 		const VkFormat depthFormat = vkh::FindDepthFormat(vk.PhysicalDevice());
 
@@ -222,11 +286,11 @@ private:
 		{
 			depthAttachDesc.format = depthFormat;
 			depthAttachDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-			depthAttachDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			depthAttachDesc.loadOp = loadAtlas ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
 			depthAttachDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 			depthAttachDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 			depthAttachDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			depthAttachDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			depthAttachDesc.initialLayout = loadAtlas ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
 			depthAttachDesc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 		}
 
@@ -241,14 +305,15 @@ private:
 		}
 
 
-		// Define dependencies for layout transitions
+		// Define dependencies for layout transitions. Must match between the two passes to keep them compatible; the load
+		// pass also reads the previous frame's writes.
 		std::vector<VkSubpassDependency> dependencies(2);
 		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 		dependencies[1].srcSubpass = 0;
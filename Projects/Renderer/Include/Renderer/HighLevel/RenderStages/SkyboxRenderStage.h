@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Renderer/HighLevel/ShIrradiance.h"
 #include "Renderer/LowLevel/VulkanService.h"
 
 class ResourceRegistry;
@@ -54,10 +55,10 @@ public: // Members
 	
 	// Generate Image Based Lighting resources from 6 textures representing the sides of a cubemap. 32b/channel. Ordered +X -X +Y -Y +Z -Z
 	[[deprecated]] // the cubemaps will appear mirrored (text is backwards)
-	IblTextureResourceIds CreateIblTextureResources(const std::array<std::string, 6>& sidePaths) const;
+	IblTextureResourceIds CreateIblTextureResources(const std::array<std::string, 6>& sidePaths, IblQuality quality) const;
 
 	// Generate Image Based Lighting resources from an Equirectangular HDRI map. 32b/channel
-	IblTextureResourceIds CreateIblTextureResources(const std::string& path) const;
+	IblTextureResourceIds CreateIblTextureResources(const std::string& path, IblQuality quality) const;
 	
 	SkyboxResourceId CreateSkybox(const SkyboxCreateInfo& createInfo);
 
@@ -77,7 +78,7 @@ private:
 
 
 public:
-	const TextureResource& GetIrradianceTextureResource() const;
+	const ShIrradiance::Coefficients& GetIrradianceSh() const;
 	const TextureResource& GetPrefilterTextureResource() const;
 	const TextureResource& GetBrdfTextureResource() const;
 
@@ -109,7 +110,7 @@ private:
 
 	// The uniform and push values referenced by the shader that can be updated at draw time
 	static VkPipeline CreateGraphicsPipeline(const std::string& shaderDir, VkPipelineLayout pipelineLayout,
-		VkSampleCountFlagBits msaaSamples, VkRenderPass renderPass, VkDevice device);
+		VkSampleCountFlagBits msaaSamples, VkRenderPass renderPass, VkDevice device, PipelineCache& pipelineCache);
 
 	void UpdateDescSets();
 };
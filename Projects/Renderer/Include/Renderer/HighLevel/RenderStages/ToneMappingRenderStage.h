@@ -40,13 +40,13 @@ private: // Types
 		// Private resources
 		VkDescriptorSetLayout DescriptorSetLayout = nullptr;
 
-		void Destroy(VkDevice device, VkAllocationCallbacks* allocator)
+		void Destroy(VkDevice device, VkAllocationCallbacks* allocator, GpuMemoryAllocator& memoryAllocator)
 		{
 			//Quad
 			vkDestroyBuffer(device, Quad.IndexBuffer, allocator);
 			vkDestroyBuffer(device, Quad.VertexBuffer, allocator);
-			vkFreeMemory(device, Quad.IndexBufferMemory, allocator);
-			vkFreeMemory(device, Quad.VertexBufferMemory, allocator);
+			memoryAllocator.Free(Quad.IndexBufferAllocation);
+			memoryAllocator.Free(Quad.VertexBufferAllocation);
 
 			vkDestroyPipeline(device, Pipeline, nullptr);
 			vkDestroyPipelineLayout(device, PipelineLayout, nullptr);
@@ -76,7 +76,8 @@ public: // Methods
 		_screenQuadResources = CreateDrawResources(
 			_vulkan->GetSwapchain().GetRenderPass(),
 			shaderDir,
-			_vulkan->LogicalDevice(), _vulkan->PhysicalDevice(), _vulkan->CommandPool(), _vulkan->GraphicsQueue());
+			_vulkan->LogicalDevice(), _vulkan->MemoryAllocator(), _vulkan->CommandPool(), _vulkan->GraphicsQueue(),
+			_vulkan->GetPipelineCache());
 	}
 	~ToneMappingRenderStage()
 	{
@@ -169,11 +170,12 @@ private: // Methods
 		if (_vulkan)
 		{
 			DestroyDescriptorResources();
-			_screenQuadResources.Destroy(_vulkan->LogicalDevice(), _vulkan->Allocator());
+			_screenQuadResources.Destroy(_vulkan->LogicalDevice(), _vulkan->Allocator(), _vulkan->MemoryAllocator());
 			_vulkan = nullptr;
 		}
 	}
-	static DrawResources CreateDrawResources(VkRenderPass renderPass, const std::string& shaderDir, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool cmdPool, VkQueue cmdQueue)
+	static DrawResources CreateDrawResources(VkRenderPass renderPass, const std::string& shaderDir, VkDevice device, GpuMemoryAllocator& allocator, VkCommandPool cmdPool, VkQueue cmdQueue,
+		PipelineCache& pipelineCache)
 	{
 		auto msaaSamples = VK_SAMPLE_COUNT_1_BIT;
 
@@ -209,11 +211,11 @@ private: // Methods
 			screenQuad.IndexCount = indices.size();
 			screenQuad.VertexCount = vertices.size();
 
-			std::tie(screenQuad.IndexBuffer, screenQuad.IndexBufferMemory) = vkh::CreateIndexBuffer(indices,
-				cmdQueue, cmdPool, physicalDevice, device);
+			std::tie(screenQuad.IndexBuffer, screenQuad.IndexBufferAllocation) = vkh::CreateIndexBuffer(indices,
+				cmdQueue, cmdPool, allocator, device);
 
-			std::tie(screenQuad.VertexBuffer, screenQuad.VertexBufferMemory) = vkh::CreateVertexBuffer(vertices,
-				cmdQueue, cmdPool, physicalDevice, device);
+			std::tie(screenQuad.VertexBuffer, screenQuad.VertexBufferAllocation) = vkh::CreateVertexBuffer(vertices,
+				cmdQueue, cmdPool, allocator, device);
 
 			return screenQuad;
 		}();
@@ -337,7 +339,7 @@ private: // Methods
 			pipelineCI.layout = pipelineLayout;
 
 
-			if (VK_SUCCESS != vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineCI, nullptr, &pipeline))
+			if (VK_SUCCESS != pipelineCache.CreateGraphicsPipeline(pipelineCI, &pipeline))
 			{
 				throw std::runtime_error("Failed to create pipeline");
 			}
@@ -3,10 +3,18 @@
 #include <Framework/IModelLoaderService.h>
 
 
+#include "BrdfLut.h"
 #include "IblLoader.h"
+#include "Renderer/LowLevel/JobSystem.h"
+#include "Renderer/LowLevel/MeshPool.h"
+#include "Renderer/LowLevel/TextureDecodePool.h"
 #include "Renderer/LowLevel/TextureResource.h"
+#include "Renderer/LowLevel/UploadBatcher.h"
 #include "Renderer/LowLevel/VulkanService.h"
 
+#include <chrono>
+#include <iostream>
+
 // The purpose of this class is to create/manage/destroy GPU textures and buffers resources.
 class ResourceRegistry
 {
@@ -16,20 +24,37 @@ private:// Data
 	// Dependencies
 	VulkanService* _vk;
 	IModelLoaderService* _modelLoaderService = nullptr;;
+	JobSystem* _jobSystem = nullptr;
 	std::string _shaderDir;
 	std::string _assetsDir;
-
-	MeshResourceId _skyboxMeshId;
+	std::string _cacheDir;
+
+	TextureResourceId _brdfLutId{}; // Shared by every IBL, see GetBrdfLutId()
+
+	std::unique_ptr<UploadBatcher> _uploader = nullptr;
+	std::unique_ptr<MeshPool> _meshPool = nullptr;
+	std::unique_ptr<TextureDecodePool> _decodePool = nullptr;
+	std::vector<TextureDecodePool::DecodedTexture> _decoded{};
+	std::chrono::steady_clock::time_point _decodeStart{};
+	u32 _decodeCount = 0;
+	u32 _lastDecodeBatchCount = 0;
+	f32 _lastDecodeBatchMs = 0;
 	
 	std::vector<std::unique_ptr<MeshResource>> _meshes{};
-	std::vector<std::unique_ptr<TextureResource>> _textures{};
+	std::vector<std::unique_ptr<TextureResource>> _textures{}; // Null while the texture is still decoding
+	std::unique_ptr<TextureResource> _placeholderTexture = nullptr;
 
 
 public: // Lifetime
 	ResourceRegistry() = delete;
-	ResourceRegistry(VulkanService* vk, IModelLoaderService* modelLoader, std::string shaderDir, std::string assetsDir)
-		: _vk(vk), _modelLoaderService(modelLoader), _shaderDir(std::move(shaderDir)), _assetsDir(std::move(assetsDir))
+	ResourceRegistry(VulkanService* vk, IModelLoaderService* modelLoader, std::string shaderDir, std::string assetsDir,
+		std::string cacheDir, JobSystem* jobSystem)
+		: _vk(vk), _modelLoaderService(modelLoader), _jobSystem(jobSystem), _shaderDir(std::move(shaderDir)),
+		_assetsDir(std::move(assetsDir)), _cacheDir(std::move(cacheDir))
 	{
+		_uploader = std::make_unique<UploadBatcher>(*vk);
+		_meshPool = std::make_unique<MeshPool>(*vk);
+		_decodePool = std::make_unique<TextureDecodePool>();
 		LoadHelperResources();
 	}
 
@@ -39,72 +64,97 @@ public: // Lifetime
 	ResourceRegistry& operator=(ResourceRegistry&&) = delete;
 	~ResourceRegistry()
 	{
-		// TODO Make all resources RAII
-		for (auto& mesh : _meshes)  
-		{
-			vkDestroyBuffer(_vk->LogicalDevice(), mesh->IndexBuffer, nullptr);
-			vkFreeMemory(_vk->LogicalDevice(), mesh->IndexBufferMemory, nullptr);
-			vkDestroyBuffer(_vk->LogicalDevice(), mesh->VertexBuffer, nullptr);
-			vkFreeMemory(_vk->LogicalDevice(), mesh->VertexBufferMemory, nullptr);
-		}
+		_decodePool = nullptr; // Joins the workers, dropping anything not yet collected
+		_uploader = nullptr; // Waits for in flight uploads, which may still be writing to the resources below
+
+		_meshes.clear();
+		_meshPool = nullptr; // Owns all mesh geometry
 		
 		_textures.clear(); // RAII will cleanup
+		_placeholderTexture = nullptr;
 	}
 
 public: // Methods
 	
-	const TextureResource& GetTexture(TextureResourceId id) const { return *_textures[id.Value()]; }
+	// Resolves to the placeholder until the texture has finished decoding
+	const TextureResource& GetTexture(TextureResourceId id) const
+	{
+		const auto& texture = _textures[id.Value()];
+		return texture ? *texture : *_placeholderTexture;
+	}
 	const MeshResource& GetMesh(MeshResourceId id) const { return *_meshes[id.Value()]; }
 	const std::vector<std::unique_ptr<MeshResource>>& Hack_GetMeshes() const { return _meshes; }
 
+	// A batch runs from the first texture queued while the pool was idle until the pool drains
+	u32 GetDecodingTextureCount() { return _decodePool->PendingCount(); }
+	u32 GetLastDecodeBatchCount() const { return _lastDecodeBatchCount; }
+	f32 GetLastDecodeBatchMs() const { return _lastDecodeBatchMs; }
+
+	// Submits uploads recorded since the last call and recycles staging from finished ones. Call once per frame before
+	// the frame's command buffer is submitted.
+	void FlushUploads()
+	{
+		_uploader->Poll();
+		InstallDecodedTextures();
+		_uploader->Flush();
+	}
+
+	// Only the header is read here so bad paths still throw. The texels are decoded on the pool and the texture reads
+	// as the placeholder until FlushUploads() installs it.
 	TextureResourceId CreateTextureResource(const std::string& path)
 	{
+		int width, height, channels;
+		if (!stbi_info(path.c_str(), &width, &height, &channels))
+		{
+			throw std::runtime_error("Failed to load texture image: " + path);
+		}
+
+		if (_decodeCount == 0)
+		{
+			_decodeStart = std::chrono::steady_clock::now();
+		}
+		_decodeCount++;
+
 		const auto id = TextureResourceId(static_cast<u32>(_textures.size()));
-		auto texRes = TextureResourceHelpers::LoadTexture(path, _vk->CommandPool(), _vk->GraphicsQueue(), _vk->PhysicalDevice(), _vk->LogicalDevice());
-		_textures.emplace_back(std::make_unique<TextureResource>(std::move(texRes)));
+		_textures.emplace_back(nullptr);
+		_decodePool->Enqueue(id.Value(), path);
 		return id;
 	}
 
-	IblTextureResourceIds CreateIblTextureResources(const std::array<std::string, 6>& sidePaths)
+	IblTextureResourceIds CreateIblTextureResources(const std::array<std::string, 6>& sidePaths, IblQuality quality)
 	{
-		IblTextureResources iblRes = IblLoader::LoadIblFromCubemapPath(sidePaths, GetMesh(_skyboxMeshId), _shaderDir, 
-			_vk->CommandPool(), _vk->GraphicsQueue(), _vk->PhysicalDevice(), _vk->LogicalDevice());
+		IblTextureResources iblRes = IblLoader::LoadIblFromCubemapPath(sidePaths, quality, _shaderDir,
+			_vk->CommandPool(), _vk->GraphicsQueue(), _vk->PhysicalDevice(), _vk->LogicalDevice(), _vk->GetPipelineCache());
 
 		IblTextureResourceIds ids = {};
 
 		ids.EnvironmentCubemapId = TextureResourceId(static_cast<u32>(_textures.size()));
 		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.EnvironmentCubemap)));
-			
-		ids.IrradianceCubemapId = TextureResourceId(static_cast<u32>(_textures.size()));
-		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.IrradianceCubemap)));
 
 		ids.PrefilterCubemapId = TextureResourceId(static_cast<u32>(_textures.size()));
 		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.PrefilterCubemap)));
 
-		ids.BrdfLutId = TextureResourceId(static_cast<u32>(_textures.size()));
-		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.BrdfLut)));
+		ids.BrdfLutId = GetBrdfLutId();
+		ids.IrradianceSh = iblRes.IrradianceSh;
 
 		return ids;
 	}
 
-	IblTextureResourceIds CreateIblTextureResources(const std::string& path)
+	IblTextureResourceIds CreateIblTextureResources(const std::string& path, IblQuality quality)
 	{
-		IblTextureResources iblRes = IblLoader::LoadIblFromEquirectangularPath(path, GetMesh(_skyboxMeshId), _shaderDir,
-			_vk->CommandPool(), _vk->GraphicsQueue(), _vk->PhysicalDevice(), _vk->LogicalDevice());
+		IblTextureResources iblRes = IblLoader::LoadIblFromEquirectangularPath(path, quality, _shaderDir, _cacheDir,
+			_vk->CommandPool(), _vk->GraphicsQueue(), _vk->PhysicalDevice(), _vk->LogicalDevice(), _vk->GetPipelineCache());
 
 		IblTextureResourceIds ids = {};
 
 		ids.EnvironmentCubemapId = TextureResourceId(static_cast<u32>(_textures.size()));
 		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.EnvironmentCubemap)));
 
-		ids.IrradianceCubemapId = TextureResourceId(static_cast<u32>(_textures.size()));
-		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.IrradianceCubemap)));
-
 		ids.PrefilterCubemapId = TextureResourceId(static_cast<u32>(_textures.size()));
 		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.PrefilterCubemap)));
 
-		ids.BrdfLutId = TextureResourceId(static_cast<u32>(_textures.size()));
-		_textures.emplace_back(std::make_unique<TextureResource>(std::move(iblRes.BrdfLut)));
+		ids.BrdfLutId = GetBrdfLutId();
+		ids.IrradianceSh = iblRes.IrradianceSh;
 
 		return ids;
 	}
@@ -129,11 +179,28 @@ public: // Methods
 		mesh->VertexCount = meshDefinition.Vertices.size();
 		//mesh->Bounds = meshDefinition.Bounds;
 
-		std::tie(mesh->VertexBuffer, mesh->VertexBufferMemory)
-			= vkh::CreateVertexBuffer(meshDefinition.Vertices, _vk->GraphicsQueue(), _vk->CommandPool(), _vk->PhysicalDevice(), _vk->LogicalDevice());
+		// Split into a position stream and a packed attribute stream, see PackedVertexAttributes
+		std::vector<glm::vec3> positions{};
+		std::vector<PackedVertexAttributes> attributes{};
+		positions.reserve(meshDefinition.Vertices.size());
+		attributes.reserve(meshDefinition.Vertices.size());
+		for (const auto& vertex : meshDefinition.Vertices)
+		{
+			positions.push_back(vertex.Pos);
+			attributes.push_back(VertexHelper::PackAttributes(vertex));
+		}
+
+		// Queued, not waited on. Ready for any frame submitted after the next FlushUploads().
+		const auto alloc = _meshPool->Add(positions.data(), attributes.data(), (u32)positions.size(),
+			meshDefinition.Indices.data(), (u32)meshDefinition.Indices.size(), *_uploader);
 
-		std::tie(mesh->IndexBuffer, mesh->IndexBufferMemory)
-			= vkh::CreateIndexBuffer(meshDefinition.Indices, _vk->GraphicsQueue(), _vk->CommandPool(), _vk->PhysicalDevice(), _vk->LogicalDevice());
+		mesh->VertexBuffer = _meshPool->PositionBuffer(alloc.Chunk);
+		mesh->AttributeBuffer = _meshPool->AttributeBuffer(alloc.Chunk);
+		mesh->IndexBuffer = _meshPool->IndexBuffer(alloc.Chunk);
+		mesh->IndexType = alloc.IndexType;
+		mesh->FirstIndex = alloc.FirstIndex;
+		mesh->VertexOffset = (i32)alloc.VertexOffset;
+		mesh->PoolAllocation = alloc;
 
 
 		const auto id = MeshResourceId(static_cast<u32>(_meshes.size()));
@@ -145,10 +212,69 @@ public: // Methods
 private:// Methods
 	void LoadHelperResources()
 	{
-		// Load a skybox mesh
-		auto model = _modelLoaderService->LoadModel(_assetsDir + "skybox.obj");
-		auto& meshDefinition = model.value().Meshes[0];
-		_skyboxMeshId = CreateMeshResource(meshDefinition);
+		// Stands in for textures that are still decoding
+		_placeholderTexture = std::make_unique<TextureResource>(TextureResourceHelpers::LoadTexture(
+			_assetsDir + "placeholder.png", *_uploader, _vk->MemoryAllocator(), _vk->LogicalDevice()));
+	}
+
+	// The split sum BRDF doesn't depend on the environment, so every IBL shares one table made on first use
+	TextureResourceId GetBrdfLutId()
+	{
+		if (_brdfLutId.IsValid())
+			return _brdfLutId;
+
+		const auto texels = BrdfLut::LoadOrGenerate(_cacheDir, *_jobSystem);
+
+		const auto format = VK_FORMAT_R16G16_SFLOAT;
+		const u32 dim = BrdfLut::Dim;
+		const u32 mipLevels = 1;
+		const u32 layerCount = 1;
+		auto* device = _vk->LogicalDevice();
+		auto& allocator = _vk->MemoryAllocator();
+
+		auto [image, allocation] = vkh::CreateImage2D(dim, dim, mipLevels, VK_SAMPLE_COUNT_1_BIT, format,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, allocator, device);
+
+		// Queued like any texture, ready for the first frame that could sample it
+		_uploader->UploadImage2D(image, format, dim, dim, mipLevels, texels.data(), sizeof(u32) * texels.size());
+
+		auto* view = vkh::CreateImage2DView(image, format, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, layerCount, device);
+		auto* sampler = vkh::CreateSampler(device, VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+		_brdfLutId = TextureResourceId(static_cast<u32>(_textures.size()));
+		_textures.emplace_back(std::make_unique<TextureResource>(device, dim, dim, mipLevels, layerCount, image,
+			&allocator, allocation, view, sampler, format));
+
+		return _brdfLutId;
+	}
+
+	void InstallDecodedTextures()
+	{
+		_decodePool->CollectFinished(_decoded);
+		if (_decoded.empty())
+			return;
+
+		for (auto& decoded : _decoded)
+		{
+			if (!decoded.Texels)
+			{
+				std::cerr << "Failed to decode texture image: " << decoded.Path << "\n";
+				continue;
+			}
+
+			_textures[decoded.Id] = std::make_unique<TextureResource>(TextureResourceHelpers::CreateTexture(
+				decoded.Texels.get(), decoded.Width, decoded.Height, *_uploader, _vk->MemoryAllocator(), _vk->LogicalDevice()));
+		}
+		_decoded.clear();
+
+		if (_decodePool->PendingCount() == 0)
+		{
+			_lastDecodeBatchMs = std::chrono::duration<f32, std::milli>(std::chrono::steady_clock::now() - _decodeStart).count();
+			_lastDecodeBatchCount = _decodeCount;
+			_decodeCount = 0;
+		}
 	}
 	
 };
\ No newline at end of file
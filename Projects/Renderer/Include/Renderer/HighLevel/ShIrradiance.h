@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Diffuse irradiance of an environment as 9 RGB L2 spherical harmonics (Ramamoorthi and Hanrahan 2001). Radiance is
+// projected a cube face at a time, then the cosine lobe is applied in SH space, which costs nothing next to
+// convolving a cubemap. Coefficients are scaled by 1/pi, so evaluating them gives the term Pbr.frag multiplies by the
+// diffuse albedo. Pure CPU, no Vulkan use.
+class ShIrradiance final
+{
+public: // Types
+	static constexpr u32 CoefficientCount = 9;
+	using Coefficients = std::array<glm::vec3, CoefficientCount>;
+
+private: // Data
+	Coefficients _radiance{};
+	f64 _solidAngle = 0;
+
+public: // Methods
+	// Faces are in Vulkan order +X -X +Y -Y +Z -Z with dim * dim row major texels. Alpha is ignored.
+	void AddFace(u32 face, const glm::vec4* texels, u32 dim);
+
+	// Of every face added so far. Renormalised by the solid angle covered, which is 4pi once all faces are in.
+	Coefficients Irradiance() const;
+
+	// Matches Pbr.frag. direction is in cubemap space and normalised.
+	static glm::vec3 Evaluate(const Coefficients& sh, const glm::vec3& direction);
+
+	// Direction of a texel centre, as a cubemap sample picks it
+	static glm::vec3 TexelDirection(u32 face, u32 x, u32 y, u32 dim);
+
+private:
+	static std::array<f32, CoefficientCount> Basis(const glm::vec3& direction);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Framework/AABB.h>
+#include <Framework/CommonTypes.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <array>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Fits cascaded shadow maps for a directional light. The camera's depth range, clipped to where the scene has
+// receivers, is split between cascades with the practical split scheme. Each cascade is a square the size of its
+// frustum slice's bounding sphere, slid to stay within the scene bounds in light space and snapped to whole texels so
+// the map doesn't shimmer as the camera moves. Depth spans every caster between the light and the slice.
+//
+// Cascades are tiles of one atlas, two per row. Pure CPU, no Vulkan use.
+class ShadowCascades final
+{
+public: // Types
+	static constexpr u32 MaxCascades = 4;
+
+	struct Cascade
+	{
+		glm::mat4 ViewProjection{}; // World to the cascade's clip space, 0..1 depth
+		glm::vec4 AtlasRect{};      // [OffsetU,OffsetV,ScaleU,ScaleV] of the tile in the atlas
+		u32 AtlasX = 0;             // Tile offset in pixels
+		u32 AtlasY = 0;
+		f32 FarDepth = 0;           // View depth the next cascade takes over from
+	};
+
+	struct BuildInfo
+	{
+		glm::mat4 View{};
+		glm::mat4 Projection{};     // Symmetric perspective. May flip Y.
+		f32 Near = 0;               // Must match Projection
+		glm::vec3 LightDirection{}; // Towards the light
+		AABB SceneBounds{};         // Every caster and receiver. Empty if unknown.
+		u32 CascadeCount = 0;
+		u32 Resolution = 0;         // Per cascade
+		f32 MaxDistance = 0;        // Nothing is shadowed past this view depth
+		f32 SplitLambda = 0.75f;    // 0 splits uniformly, 1 logarithmically
+	};
+
+private: // Data
+	std::array<Cascade, MaxCascades> _cascades{};
+	u32 _count = 0;
+	u32 _resolution = 0;
+
+public: // Methods
+	// Leaves no cascades if the scene is entirely out of range
+	void Build(const BuildInfo& info);
+	void Clear() { _count = 0; }
+
+	u32 Count() const { return _count; }
+	u32 Resolution() const { return _resolution; }
+	const Cascade& Get(u32 cascade) const { return _cascades[cascade]; }
+
+	static Extent2D AtlasExtent(u32 cascadeCount, u32 resolution);
+};
@@ -74,15 +74,14 @@ private:// Types
 	{
 		FramebufferAttachmentDesc Desc;
 		VkImage Image{};
-		VkDeviceMemory ImageMemory{};
+		GpuAllocation ImageAllocation{};
 		VkImageView ImageView{};
 
-		void Destroy(VkDevice device, VkAllocationCallbacks* allocator)
+		void Destroy(VkDevice device, VkAllocationCallbacks* allocator, GpuMemoryAllocator& memoryAllocator)
 		{
-			vkFreeMemory(device, ImageMemory, allocator);
 			vkDestroyImage(device, Image, allocator);
 			vkDestroyImageView(device, ImageView, allocator);
-			ImageMemory = nullptr;
+			memoryAllocator.Free(ImageAllocation);
 			Image = nullptr;
 			ImageView = nullptr;
 		}
@@ -146,7 +145,7 @@ public: // Methods
 			attachment.Desc = attachmentDesc;
 
 			// Create image
-			std::tie(attachment.Image, attachment.ImageMemory) = vkh::CreateImage2D(
+			std::tie(attachment.Image, attachment.ImageAllocation) = vkh::CreateImage2D(
             desc.Extent.width, desc.Extent.height,
             mipLevels,
             attachmentDesc.MultisampleCount,
@@ -154,7 +153,7 @@ public: // Methods
             VK_IMAGE_TILING_OPTIMAL,
             usageFromAspect(attachmentDesc.Aspect) | attachmentDesc.AdditionalUsageFlags,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            _vk.PhysicalDevice(), _vk.LogicalDevice());
+            _vk.MemoryAllocator(), _vk.LogicalDevice());
 
 			// Create image view
 			attachment.ImageView = vkh::CreateImage2DView(
@@ -208,7 +207,7 @@ public: // Methods
 	void Destroy()
 	{
 		for (auto&& attachment : Attachments) {
-			attachment.Destroy(_vk.LogicalDevice(), _vk.Allocator());
+			attachment.Destroy(_vk.LogicalDevice(), _vk.Allocator(), _vk.MemoryAllocator());
 		}
 
 		vkDestroyFramebuffer(_vk.LogicalDevice(), Framebuffer, _vk.Allocator());
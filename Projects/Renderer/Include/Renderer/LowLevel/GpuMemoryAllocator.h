@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+
+// Which pools an allocation is served from. Buffers and optimal-tiled images never share a block, which sidesteps
+// bufferImageGranularity entirely.
+enum class GpuResourceKind : u8
+{
+	Buffer,
+	Image,
+};
+
+// FreeList: general purpose first-fit with coalescing on free. Use for long lived resources.
+// Linear: bump allocator that rewinds once every allocation in a block is freed. Use for short lived staging data.
+enum class GpuPoolKind : u8
+{
+	FreeList,
+	Linear,
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct GpuAllocation
+{
+	VkDeviceMemory Memory = nullptr;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+	void* Mapped = nullptr; // Non-null if the memory is host visible. Blocks stay mapped for their lifetime.
+	u32 PoolIndex = UINT32_MAX;
+	u32 BlockIndex = UINT32_MAX;
+
+	bool IsValid() const { return Memory != nullptr; }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+struct GpuPoolStats
+{
+	u32 MemoryTypeIndex = 0;
+	GpuResourceKind ResourceKind = GpuResourceKind::Buffer;
+	GpuPoolKind PoolKind = GpuPoolKind::FreeList;
+	u32 BlockCount = 0;
+	u32 DedicatedBlockCount = 0;
+	u32 AllocationCount = 0;
+	VkDeviceSize BytesReserved = 0; // sum of all block sizes
+	VkDeviceSize BytesUsed = 0;     // sum of live allocation sizes
+	VkDeviceSize LargestFreeRange = 0;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sub-allocates VkDeviceMemory out of large blocks so the number of vkAllocateMemory calls stays tiny regardless of
+// how many buffers and images the scene creates. Pools are keyed on (memory type, resource kind, pool kind).
+// Requests bigger than half a block get their own dedicated block.
+class GpuMemoryAllocator
+{
+private: // Types
+	struct Range
+	{
+		VkDeviceSize Offset = 0;
+		VkDeviceSize Size = 0;
+	};
+
+	struct Block
+	{
+		VkDeviceMemory Memory = nullptr;
+		VkDeviceSize Size = 0;
+		u8* Mapped = nullptr;
+		bool Dedicated = false;
+		u32 AllocationCount = 0;
+		VkDeviceSize BytesUsed = 0;
+		std::vector<Range> FreeRanges{}; // FreeList only, sorted by offset
+		VkDeviceSize LinearHead = 0;     // Linear only
+	};
+
+	struct Pool
+	{
+		u32 MemoryTypeIndex = 0;
+		GpuResourceKind ResourceKind = GpuResourceKind::Buffer;
+		GpuPoolKind PoolKind = GpuPoolKind::FreeList;
+		std::vector<Block> Blocks{}; // Released blocks keep their slot (Memory == nullptr) so indices stay stable
+	};
+
+private: // Data
+	VkDevice _device = nullptr;
+	VkPhysicalDeviceMemoryProperties _memoryProperties{};
+	VkDeviceSize _blockSize = 0;
+	std::vector<Pool> _pools{};
+	u32 _deviceAllocationCount = 0;
+	mutable std::mutex _mutex;
+
+public: // Methods
+	GpuMemoryAllocator() = delete;
+	GpuMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = 64ull * 1024 * 1024);
+	~GpuMemoryAllocator();
+	GpuMemoryAllocator(const GpuMemoryAllocator&) = delete;
+	GpuMemoryAllocator(GpuMemoryAllocator&&) = delete;
+	GpuMemoryAllocator& operator=(const GpuMemoryAllocator&) = delete;
+	GpuMemoryAllocator& operator=(GpuMemoryAllocator&&) = delete;
+
+	[[nodiscard]] GpuAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags propertyFlags,
+		GpuResourceKind resourceKind, GpuPoolKind poolKind = GpuPoolKind::FreeList);
+
+	// Returns the range to its pool and resets the allocation. Freeing an invalid allocation is a no-op.
+	void Free(GpuAllocation& allocation);
+
+	std::vector<GpuPoolStats> GetStats() const;
+	void PrintStats() const;
+
+	// Number of live vkAllocateMemory allocations owned by the allocator
+	u32 DeviceAllocationCount() const;
+
+private:
+	u32 FindMemoryType(u32 typeFilter, VkMemoryPropertyFlags propertyFlags) const;
+	Pool& GetOrCreatePool(u32 memoryTypeIndex, GpuResourceKind resourceKind, GpuPoolKind poolKind, u32& outPoolIndex);
+	u32 CreateBlock(Pool& pool, VkDeviceSize size, bool dedicated);
+	void ReleaseBlock(Block& block);
+	static bool TryAllocateFromBlock(Block& block, GpuPoolKind poolKind, VkDeviceSize size, VkDeviceSize alignment,
+		VkDeviceSize& outOffset);
+	static void FreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size);
+};
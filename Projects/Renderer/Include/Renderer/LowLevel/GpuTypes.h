@@ -5,16 +5,57 @@
 #include <Framework/Material.h>
 #include <Framework/Vertex.h>
 
+#include "GpuMemoryAllocator.h"
+#include "MeshPool.h"
+
+#include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <cmath>
 #include <optional>
 #include <set>
 #include <vector>
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// GPU side of a mesh vertex, minus the position which lives in its own stream so depth only passes fetch 12 bytes
+// a vertex instead of the whole thing. Normal and tangent are octahedral encoded snorm16x2, the uv is half2.
+struct PackedVertexAttributes
+{
+	u32 Normal;
+	u32 Tangent;
+	u32 TexCoord;
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 namespace VertexHelper
 {
+	// Maps a unit vector to the [-1,1] square by projecting it onto an octahedron and folding the lower half out
+	static glm::vec2 OctEncode(const glm::vec3& n)
+	{
+		const f32 l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+		if (l1 == 0.f)
+			return glm::vec2{ 0 }; // Missing data, decodes to +Z
+
+		const glm::vec2 p = glm::vec2{ n.x, n.y } / l1;
+		if (n.z >= 0.f)
+			return p;
+
+		const glm::vec2 sign{ p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f };
+		return (1.f - glm::abs(glm::vec2{ p.y, p.x })) * sign;
+	}
+
+	static PackedVertexAttributes PackAttributes(const Vertex& vertex)
+	{
+		PackedVertexAttributes packed{};
+		packed.Normal = glm::packSnorm2x16(OctEncode(vertex.Normal));
+		packed.Tangent = glm::packSnorm2x16(OctEncode(vertex.Tangent));
+		packed.TexCoord = glm::packHalf2x16(vertex.TexCoord);
+		return packed;
+	}
+
+	// Interleaved fp32 Vertex. Only used by the small helper meshes built in place, eg screen quads.
 	static VkVertexInputBindingDescription BindingDescription()
 	{
 		VkVertexInputBindingDescription bindingDesc = {};
@@ -26,43 +67,59 @@ namespace VertexHelper
 		return bindingDesc;
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 5> AttributeDescriptions()
+	// Mesh resources: binding 0 is MeshResource::VertexBuffer (positions), binding 1 is MeshResource::AttributeBuffer
+	static std::array<VkVertexInputBindingDescription, 2> MeshBindingDescriptions()
+	{
+		std::array<VkVertexInputBindingDescription, 2> bindingDesc = {};
+		{
+			bindingDesc[0].binding = 0;
+			bindingDesc[0].stride = sizeof(glm::vec3);
+			bindingDesc[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+			bindingDesc[1].binding = 1;
+			bindingDesc[1].stride = sizeof(PackedVertexAttributes);
+			bindingDesc[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+		return bindingDesc;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 4> AttributeDescriptions()
 	{
-		std::array<VkVertexInputAttributeDescription, 5> attrDesc = {};
+		std::array<VkVertexInputAttributeDescription, 4> attrDesc = {};
 		{
 			// Pos
 			attrDesc[0].binding = 0;
 			attrDesc[0].location = 0;
 			attrDesc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attrDesc[0].offset = offsetof(Vertex, Pos);
+			attrDesc[0].offset = 0;
 			// Normal
-			attrDesc[1].binding = 0;
+			attrDesc[1].binding = 1;
 			attrDesc[1].location = 1;
-			attrDesc[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attrDesc[1].offset = offsetof(Vertex, Normal);
-			// Color
-			attrDesc[2].binding = 0;
-			attrDesc[2].location = 2;
-			attrDesc[2].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attrDesc[2].offset = offsetof(Vertex, Color);
+			attrDesc[1].format = VK_FORMAT_R16G16_SNORM;
+			attrDesc[1].offset = offsetof(PackedVertexAttributes, Normal);
 			// TexCoord
-			attrDesc[3].binding = 0;
-			attrDesc[3].location = 3;
-			attrDesc[3].format = VK_FORMAT_R32G32_SFLOAT;
-			attrDesc[3].offset = offsetof(Vertex, TexCoord);
+			attrDesc[2].binding = 1;
+			attrDesc[2].location = 3;
+			attrDesc[2].format = VK_FORMAT_R16G16_SFLOAT;
+			attrDesc[2].offset = offsetof(PackedVertexAttributes, TexCoord);
 			// Tangent
-			attrDesc[4].binding = 0;
-			attrDesc[4].location = 4;
-			attrDesc[4].format = VK_FORMAT_R32G32B32_SFLOAT;
-			attrDesc[4].offset = offsetof(Vertex, Tangent);
-			//// Bitangent
-			//attrDesc[5].binding = 0;
-			//attrDesc[5].location = 5;
-			//attrDesc[5].format = VK_FORMAT_R32G32B32_SFLOAT;
-			//attrDesc[5].offset = offsetof(Vertex, Bitangent);
+			attrDesc[3].binding = 1;
+			attrDesc[3].location = 4;
+			attrDesc[3].format = VK_FORMAT_R16G16_SNORM;
+			attrDesc[3].offset = offsetof(PackedVertexAttributes, Tangent);
 		}
 		return attrDesc;
 	}
+
+	// Position stream only, for depth only passes and the skybox
+	static VkVertexInputBindingDescription PositionBindingDescription()
+	{
+		return MeshBindingDescriptions()[0];
+	}
+
+	static VkVertexInputAttributeDescription PositionAttributeDescription()
+	{
+		return AttributeDescriptions()[0];
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -70,10 +127,19 @@ struct MeshResource
 {
 	size_t VertexCount = 0;
 	size_t IndexCount = 0;
-	VkBuffer VertexBuffer = nullptr;
-	VkDeviceMemory VertexBufferMemory = nullptr;
+	VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+	VkBuffer VertexBuffer = nullptr; // Positions only for registry meshes, interleaved Vertex for helper meshes
+	GpuAllocation VertexBufferAllocation = {};
+	VkBuffer AttributeBuffer = nullptr; // PackedVertexAttributes, null for helper meshes
+	GpuAllocation AttributeBufferAllocation = {};
 	VkBuffer IndexBuffer = nullptr;
-	VkDeviceMemory IndexBufferMemory = nullptr;
+	GpuAllocation IndexBufferAllocation = {};
+
+	// Registry meshes are sub-allocated from the MeshPool. Their buffers are the pool chunk's shared buffers, owned by
+	// the pool with empty allocations here, and are always bound at offset 0.
+	u32 FirstIndex = 0;
+	i32 VertexOffset = 0;
+	MeshPoolAllocation PoolAllocation = {};
 	//AABB Bounds;
 };
 
@@ -87,14 +153,6 @@ struct SkyboxResourceFrame // for lack of a better name...
 	VkDeviceMemory FragUniformBufferMemory;
 };
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-struct PbrCommonResourceFrame // for lack of a better name...
-{
-	VkDescriptorSet PbrDescriptorSet;
-	VkBuffer MeshUniformBuffer;
-	VkDeviceMemory MeshUniformBufferMemory;
-};
-
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct SwapChainSupportDetails
 {
@@ -108,6 +166,7 @@ struct QueueFamilyIndices
 {
 	std::optional<uint32_t> GraphicsAndComputeFamily = std::nullopt;
 	std::optional<uint32_t> PresentFamily = std::nullopt;
+	std::optional<uint32_t> TransferFamily = std::nullopt; // Transfer only (DMA) family, if the device exposes one
 
 	bool IsComplete() const
 	{
@@ -0,0 +1,217 @@
+#pragma once
+
+#include "GpuMemoryAllocator.h"
+#include "VulkanHelpers.h"
+
+#include <Framework/CommonTypes.h>
+
+#include <glm/mat4x4.hpp>
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <vector>
+
+using vkh = VulkanHelpers;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Device local storage buffers of per-instance model matrices, one per frame in flight. Push() returns an instance
+// index into the current frame's buffer, which is passed as firstInstance to vkCmdDrawIndexed so shaders can read their
+// transform with gl_InstanceIndex. Most instances are written by the GPU, see Reserve(). The few pushed by the host
+// are staged in a persistently mapped buffer and copied over by RecordUpload().
+//
+// A frame's buffers grow to fit, EndFrame() reports when the device buffer was recreated so the descriptors reading it
+// can be rewritten.
+class InstanceBuffer final
+{
+private:
+	static constexpr u32 InitialStagingCapacity = 1024;
+
+	struct GrowableBuffer
+	{
+		VkBuffer Buffer = nullptr;
+		GpuAllocation Allocation{};
+		u32 Capacity = 0; // Instances
+	};
+
+	struct Frame
+	{
+		GrowableBuffer Instances{}; // Device local, read by the vertex shaders
+		GrowableBuffer Staging{};   // Host written transforms, copied into Instances
+		std::vector<VkBufferCopy> Copies{};
+	};
+
+	VkDevice _device = nullptr;
+	GpuMemoryAllocator* _allocator = nullptr;
+	std::vector<Frame> _frames{};
+
+	u32 _frameIndex = 0;
+	u32 _head = 0;
+	u32 _pushed = 0;
+	bool _grown = false; // Current frame's device buffer was recreated
+
+public:
+	InstanceBuffer() = delete;
+	InstanceBuffer(u32 frameCount, u32 initialCapacity, GpuMemoryAllocator& allocator, VkDevice device)
+		: _device(device), _allocator(&allocator)
+	{
+		assert(frameCount > 0 && initialCapacity > 0);
+
+		_frames.resize(frameCount);
+		for (auto& frame : _frames)
+		{
+			CreateInstances(frame.Instances, initialCapacity);
+			CreateStaging(frame.Staging, InitialStagingCapacity);
+		}
+	}
+	~InstanceBuffer()
+	{
+		if (_device)
+		{
+			for (auto& frame : _frames)
+			{
+				DestroyBuffer(frame.Instances);
+				DestroyBuffer(frame.Staging);
+			}
+			_device = nullptr;
+		}
+	}
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+	InstanceBuffer(InstanceBuffer&&) = delete;
+	InstanceBuffer& operator=(InstanceBuffer&&) = delete;
+
+	// Rewinds frameIndex's buffers. Caller guarantees the GPU has finished with that frame.
+	void BeginFrame(u32 frameIndex)
+	{
+		assert(frameIndex < (u32)_frames.size());
+		_frameIndex = frameIndex;
+		_head = 0;
+		_pushed = 0;
+		_grown = false;
+		_frames[frameIndex].Copies.clear();
+	}
+
+	// Appends a transform to the current frame and returns its instance index. Consecutive pushes are contiguous, so a
+	// run of them can be drawn with a single instanced call.
+	u32 Push(const glm::mat4& transform)
+	{
+		auto& frame = _frames[_frameIndex];
+		if (_pushed >= frame.Staging.Capacity)
+		{
+			GrowStaging(frame.Staging, _pushed + 1);
+		}
+
+		memcpy((glm::mat4*)frame.Staging.Allocation.Mapped + _pushed, &transform, sizeof(glm::mat4));
+
+		// Runs of pushes with nothing reserved in between are one copy
+		const VkDeviceSize srcOffset = sizeof(glm::mat4) * _pushed;
+		const VkDeviceSize dstOffset = sizeof(glm::mat4) * _head;
+		auto& copies = frame.Copies;
+		if (!copies.empty() && copies.back().srcOffset + copies.back().size == srcOffset &&
+			copies.back().dstOffset + copies.back().size == dstOffset)
+		{
+			copies.back().size += sizeof(glm::mat4);
+		}
+		else
+		{
+			copies.emplace_back(VkBufferCopy{ srcOffset, dstOffset, sizeof(glm::mat4) });
+		}
+
+		_pushed++;
+		return _head++;
+	}
+
+	// Reserves count contiguous instances for the GPU to fill, eg. SceneRenderPass's cull shader. Returns the first
+	// instance index. Room is made by EndFrame().
+	u32 Reserve(u32 count)
+	{
+		const u32 index = _head;
+		_head += count;
+
+		return index;
+	}
+
+	// Grows the current frame's device buffer to fit every push and reservation. Returns true if it was recreated, in
+	// which case descriptors pointing at this frame's buffer must be rewritten before recording.
+	bool EndFrame()
+	{
+		auto& frame = _frames[_frameIndex];
+		if (_head > frame.Instances.Capacity)
+		{
+			// Nothing to carry over, pushes are still in staging
+			const u32 capacity = std::max(_head, frame.Instances.Capacity * 2);
+			DestroyBuffer(frame.Instances);
+			CreateInstances(frame.Instances, capacity);
+			_grown = true;
+		}
+
+		return _grown;
+	}
+
+	// Copies this frame's pushes into the device buffer. Record after EndFrame(), outside a render pass and before any
+	// draw reads them.
+	void RecordUpload(VkCommandBuffer commandBuffer) const
+	{
+		const auto& frame = _frames[_frameIndex];
+		if (frame.Copies.empty())
+		{
+			return;
+		}
+
+		vkCmdCopyBuffer(commandBuffer, frame.Staging.Buffer, frame.Instances.Buffer, (u32)frame.Copies.size(),
+			frame.Copies.data());
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	VkBuffer Buffer(u32 frameIndex) const { return _frames[frameIndex].Instances.Buffer; }
+	u32 FrameCount() const { return (u32)_frames.size(); }
+	u32 InstancesThisFrame() const { return _head; }
+
+private:
+	void CreateInstances(GrowableBuffer& buffer, u32 capacity) const
+	{
+		std::tie(buffer.Buffer, buffer.Allocation) = vkh::CreateBuffer(sizeof(glm::mat4) * capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			*_allocator, _device);
+		buffer.Capacity = capacity;
+	}
+
+	void CreateStaging(GrowableBuffer& buffer, u32 capacity) const
+	{
+		std::tie(buffer.Buffer, buffer.Allocation) = vkh::CreateBuffer(sizeof(glm::mat4) * capacity,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			*_allocator, _device);
+		buffer.Capacity = capacity;
+
+		assert(buffer.Allocation.Mapped);
+	}
+
+	void DestroyBuffer(GrowableBuffer& buffer) const
+	{
+		vkDestroyBuffer(_device, buffer.Buffer, nullptr);
+		_allocator->Free(buffer.Allocation);
+		buffer = {};
+	}
+
+	// Doubles at least, so a growing scene recreates it a handful of times rather than every frame. Pushes made before
+	// the growth are carried over.
+	void GrowStaging(GrowableBuffer& staging, u32 required) const
+	{
+		GrowableBuffer grown{};
+		CreateStaging(grown, std::max(required, staging.Capacity * 2));
+		memcpy(grown.Allocation.Mapped, staging.Allocation.Mapped, sizeof(glm::mat4) * staging.Capacity);
+
+		DestroyBuffer(staging);
+		staging = grown;
+	}
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Fork-join pool for splitting a frame's work across cores. Run() hands out jobs to the workers and the calling thread
+// alike and returns once every job is done, so jobs may reference the caller's stack.
+class JobSystem final
+{
+public: // Types
+	// thread is in [0, ThreadCount()), 0 being the thread that called Run(). Use it to index per-thread resources.
+	using JobFunction = std::function<void(u32 job, u32 thread)>;
+
+private: // Data
+	std::vector<std::thread> _workers{};
+
+	std::mutex _mutex{};
+	std::condition_variable _workAvailable{};
+	std::condition_variable _workDone{};
+
+	// The current Run(). Workers only join while _job is set and leave before Run() returns.
+	const JobFunction* _job = nullptr;
+	u32 _jobCount = 0;
+	std::atomic<u32> _nextJob = 0;
+	u32 _jobsDone = 0;
+	u32 _activeWorkers = 0;
+	u64 _generation = 0;
+	std::exception_ptr _error = nullptr;
+	bool _stopping = false;
+
+public: // Methods
+	// A threadCount of 0 uses one thread per hardware thread, the caller included
+	explicit JobSystem(u32 threadCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	JobSystem(JobSystem&&) = delete;
+	JobSystem& operator=(JobSystem&&) = delete;
+
+	// Runs job(i, thread) for every i in [0, jobCount) and blocks until they're all done. Rethrows the first exception
+	// a job threw. Not reentrant.
+	void Run(u32 jobCount, const JobFunction& job);
+
+	u32 ThreadCount() const { return (u32)_workers.size() + 1; }
+
+private:
+	void WorkerLoop(u32 thread);
+	void ExecuteJobs(const JobFunction& job, u32 jobCount, u32 thread);
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "GpuMemoryAllocator.h"
+
+#include <Framework/CommonTypes.h>
+
+#include <glm/vec3.hpp>
+#include <vulkan/vulkan.h>
+
+#include <optional>
+#include <vector>
+
+class UploadBatcher;
+class VulkanService;
+struct PackedVertexAttributes;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Where a mesh lives inside the pool. Draw with firstIndex = FirstIndex and vertexOffset = VertexOffset.
+struct MeshPoolAllocation
+{
+	u32 Chunk = UINT32_MAX;
+	u32 VertexOffset = 0; // In vertices
+	u32 VertexCount = 0;
+	u32 FirstIndex = 0;   // In units of IndexType
+	u32 IndexCount = 0;
+	VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+
+	bool IsValid() const { return Chunk != UINT32_MAX; }
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sub-allocates mesh geometry out of a few large chunks, each a position buffer, an attribute buffer and an index
+// buffer. Meshes in the same chunk share bindings, so a draw loop only rebinds when the chunk or index type changes.
+// 16 and 32 bit indices share a chunk's index buffer; it is always bound at offset 0 and FirstIndex is in units of the
+// mesh's index type.
+class MeshPool final
+{
+private: // Types
+	struct Range
+	{
+		u64 Offset = 0;
+		u64 Size = 0;
+	};
+
+	// First-fit free list with coalescing, sorted by offset
+	struct RangeAllocator
+	{
+		u64 Capacity = 0;
+		std::vector<Range> FreeRanges{};
+
+		std::optional<u64> Allocate(u64 size, u64 alignment);
+		void Free(u64 offset, u64 size);
+	};
+
+	struct Chunk
+	{
+		VkBuffer PositionBuffer = nullptr;
+		VkBuffer AttributeBuffer = nullptr;
+		VkBuffer IndexBuffer = nullptr;
+		GpuAllocation PositionAllocation{};
+		GpuAllocation AttributeAllocation{};
+		GpuAllocation IndexAllocation{};
+		RangeAllocator Vertices{}; // In vertices
+		RangeAllocator Indices{};  // In bytes
+	};
+
+private: // Data
+	VulkanService* _vk = nullptr;
+	u32 _chunkVertexCapacity = 0;
+	u64 _chunkIndexBytes = 0;
+	std::vector<Chunk> _chunks{};
+
+public: // Methods
+	MeshPool() = delete;
+	explicit MeshPool(VulkanService& vk, u32 chunkVertexCapacity = 1024 * 1024, u64 chunkIndexBytes = 16ull * 1024 * 1024);
+	~MeshPool();
+	MeshPool(const MeshPool&) = delete;
+	MeshPool& operator=(const MeshPool&) = delete;
+	MeshPool(MeshPool&&) = delete;
+	MeshPool& operator=(MeshPool&&) = delete;
+
+	// Reserves space for the mesh and queues its upload. Uses 16 bit indices when the vertex count allows.
+	MeshPoolAllocation Add(const glm::vec3* positions, const PackedVertexAttributes* attributes, u32 vertexCount,
+		const u32* indices, u32 indexCount, UploadBatcher& uploader);
+
+	// Caller guarantees the GPU is done with the mesh
+	void Remove(MeshPoolAllocation& allocation);
+
+	VkBuffer PositionBuffer(u32 chunk) const { return _chunks[chunk].PositionBuffer; }
+	VkBuffer AttributeBuffer(u32 chunk) const { return _chunks[chunk].AttributeBuffer; }
+	VkBuffer IndexBuffer(u32 chunk) const { return _chunks[chunk].IndexBuffer; }
+	u32 ChunkCount() const { return (u32)_chunks.size(); }
+
+private:
+	u32 CreateChunk(u32 vertexCapacity, u64 indexBytes);
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <vector>
+
+class JobSystem;
+class VulkanService;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Splits a render pass's draws into chunks, records each chunk into a secondary command buffer on a JobSystem thread
+// and executes them in order from the primary. Every thread records from its own command pool per frame in flight, so
+// recording never takes a lock and a frame's buffers are recycled with a single pool reset.
+//
+// Secondaries inherit no state: each chunk sets its own pipeline, descriptors and dynamic state. The render pass must
+// be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+class ParallelCommandRecorder final
+{
+public: // Types
+	// Records items [firstItem, firstItem + itemCount). The chunk with firstItem 0 is always recorded, even when empty.
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, u32 firstItem, u32 itemCount)>;
+
+private: // Types
+	struct ThreadPool
+	{
+		VkCommandPool Pool = nullptr;
+		std::vector<VkCommandBuffer> Buffers{}; // Secondaries, allocated as needed and reused every frame
+		u32 Used = 0;
+	};
+
+private: // Data
+	VulkanService* _vk = nullptr;
+	JobSystem* _jobs = nullptr;
+
+	std::vector<std::vector<ThreadPool>> _frames{}; // [frame in flight][thread]
+	u32 _frameIndex = 0;
+
+	std::vector<VkCommandBuffer> _recorded{}; // Scratch, in chunk order
+
+public: // Methods
+	ParallelCommandRecorder() = delete;
+	ParallelCommandRecorder(VulkanService& vk, JobSystem& jobs, u32 numImagesInFlight);
+	~ParallelCommandRecorder();
+	ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+	ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+	ParallelCommandRecorder(ParallelCommandRecorder&&) = delete;
+	ParallelCommandRecorder& operator=(ParallelCommandRecorder&&) = delete;
+
+	// Recycles the frame's command buffers. Caller guarantees the GPU has finished with frameIndex.
+	void BeginFrame(u32 frameIndex);
+
+	// Records itemCount items in chunks of at least minItemsPerChunk, at most one chunk per thread, then executes them
+	// into the primary. Blocks until recording is done. Call from the thread that owns primaryCommandBuffer.
+	void RecordAndExecute(VkCommandBuffer primaryCommandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer,
+		u32 itemCount, u32 minItemsPerChunk, const RecordFunction& record);
+
+	// Caller guarantees the GPU is idle
+	void HandleSwapchainRecreated(u32 numImagesInFlight);
+
+private:
+	void CreatePools(u32 numImagesInFlight);
+	void DestroyPools();
+	VkCommandBuffer NextBuffer(u32 thread);
+};
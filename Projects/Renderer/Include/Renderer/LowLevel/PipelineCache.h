@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A VkPipelineCache shared by every pipeline the renderer creates, persisted to disk so later runs skip most shader
+// compilation. The file is only trusted if it was written by the same format version, GPU and driver; anything else
+// starts an empty cache that overwrites the file on Save().
+//
+// Pipelines are created through here so the time spent compiling them can be measured, see GetStats().
+class PipelineCache final
+{
+public: // Types
+	struct Stats
+	{
+		u32 PipelinesCreated = 0;
+		f64 CreateMs = 0;
+
+		Stats operator-(const Stats& other) const
+		{
+			return { PipelinesCreated - other.PipelinesCreated, CreateMs - other.CreateMs };
+		}
+	};
+
+private: // Types
+	static constexpr u32 Magic = 0x43505846; // "FXPC"
+	static constexpr u32 FormatVersion = 1;
+
+	struct FileHeader
+	{
+		u32 Magic;
+		u32 FormatVersion;
+		u32 VendorId;
+		u32 DeviceId;
+		u32 DriverVersion;
+		u8 PipelineCacheUuid[VK_UUID_SIZE];
+		u32 DataChecksum;
+		u64 DataSize;
+	};
+	static_assert(std::is_trivially_copyable_v<FileHeader>);
+
+private: // Data
+	VkDevice _device = nullptr;
+	VkPipelineCache _cache = nullptr;
+	VkPhysicalDeviceProperties _deviceProperties{};
+	std::string _path{};
+	Stats _stats{};
+
+public: // Methods
+	PipelineCache() = delete;
+	// An empty path keeps the cache in memory only
+	PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, std::string path);
+	~PipelineCache();
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+	PipelineCache(PipelineCache&&) = delete;
+	PipelineCache& operator=(PipelineCache&&) = delete;
+
+	VkPipelineCache Handle() const { return _cache; }
+
+	// Drop-in for vkCreate*Pipelines with a single create info
+	VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* outPipeline);
+	VkResult CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline* outPipeline);
+
+	// Running totals since creation. Diff two snapshots to time a block of work.
+	const Stats& GetStats() const { return _stats; }
+
+	// Writes the cache's current contents to disk. Failures are reported and otherwise ignored.
+	void Save() const;
+
+private:
+	std::vector<char> TryReadFile() const;
+	static u32 Checksum(const char* data, size_t size);
+};
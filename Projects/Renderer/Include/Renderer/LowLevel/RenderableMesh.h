@@ -15,32 +15,9 @@ struct Skybox
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// TODO Eventually auto generate Infos stored in an unordered map key would be the unique combination of mesh and texture resources
-
-//TODO Think about this in some depth...
-/*
-- To make instance rendering possible the frame resources likely need to be decoupled from from RenderableMesh.
-- ?? Make the PbrCommonResourceFrame descriptor set only have info that pertains to this unique MeshAsset?
-- ?? Create a unique PbrCommonResourceFrame for each unique MeshAsset / Material combo and move transform into a diff per-renderable UBO. info.Some ofther abstractionConsidering MeshAsset will be unique for each MeshA
-	Necessary to make instance rendering possible. The
-
-- look at PbrRenderStage::CreatePbrDescriptorSetLayout()
-	- dependencies are
-		VS
-		- transform
-		FS
-		- 
-		- ibl images
-		- material
-			- images
-			- properties
-
-	- create descSet for each of
-		- Each usage of a given MeshAsset (1 mesh asset could be used with many transforms)
-		- Each unique Material should have a desc set.
-*/
+// Per-object transforms live in PbrRenderStage's InstanceBuffer and objects sharing a mesh and material are drawn as
+// one instanced draw, see SceneRenderPass
 struct RenderableMesh
 {
 	MeshResourceId MeshId;
-	std::vector<PbrCommonResourceFrame> CommonFrameResources{}; // One per frame in flight
 };
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Framework/CommonTypes.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Decodes image files to RGBA8 texels on worker threads. Jobs are tagged with a caller chosen id and come back in
+// whatever order they finish; the caller owns the GPU side and turns them into textures on its own thread.
+class TextureDecodePool final
+{
+public: // Types
+	struct TexelsDeleter
+	{
+		void operator()(unsigned char* texels) const;
+	};
+
+	struct DecodedTexture
+	{
+		u32 Id = 0;
+		std::string Path{};
+		std::unique_ptr<unsigned char, TexelsDeleter> Texels{}; // RGBA8, null if decoding failed
+		u32 Width = 0;
+		u32 Height = 0;
+	};
+
+private: // Types
+	struct Job
+	{
+		u32 Id;
+		std::string Path;
+	};
+
+private: // Data
+	std::vector<std::thread> _workers{};
+
+	std::mutex _mutex{};
+	std::condition_variable _jobAvailable{};
+	std::deque<Job> _jobs{};
+	std::vector<DecodedTexture> _finished{};
+	u32 _pending = 0; // Queued or decoding, not yet collected
+	bool _stopping = false;
+
+public: // Methods
+	// A threadCount of 0 uses one thread per hardware thread, leaving one for the render loop
+	explicit TextureDecodePool(u32 threadCount = 0);
+	~TextureDecodePool();
+	TextureDecodePool(const TextureDecodePool&) = delete;
+	TextureDecodePool& operator=(const TextureDecodePool&) = delete;
+	TextureDecodePool(TextureDecodePool&&) = delete;
+	TextureDecodePool& operator=(TextureDecodePool&&) = delete;
+
+	void Enqueue(u32 id, std::string path);
+
+	// Moves every finished decode into outFinished. Never blocks.
+	void CollectFinished(std::vector<DecodedTexture>& outFinished);
+
+	u32 PendingCount();
+	u32 ThreadCount() const { return (u32)_workers.size(); }
+
+private:
+	void WorkerLoop();
+};
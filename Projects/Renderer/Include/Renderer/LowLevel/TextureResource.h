@@ -1,5 +1,7 @@
 #pragma once
 
+#include "GpuMemoryAllocator.h"
+#include "UploadBatcher.h"
 #include "VulkanHelpers.h"
 
 #include <Framework/CommonTypes.h>
@@ -40,6 +42,17 @@ public:
 		_descriptorImageInfo.sampler = sampler;
 		_descriptorImageInfo.imageLayout = layout;
 	}
+
+	// Memory is owned by the allocator and returned to it on destruction
+	TextureResource(VkDevice device, u32 width, u32 height, u32 mipLevels, u32 layerCount, VkImage image, 
+	                GpuMemoryAllocator* allocator, const GpuAllocation& allocation, VkImageView view, VkSampler sampler,
+	                VkFormat format, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		: TextureResource(device, width, height, mipLevels, layerCount, image, VkDeviceMemory{nullptr}, view, sampler, format, layout)
+	{
+		assert(allocator);
+		_allocator = allocator;
+		_allocation = allocation;
+	}
 	// No copy
 	TextureResource(const TextureResource&) = delete;
 	TextureResource& operator=(const TextureResource&) = delete;
@@ -57,10 +70,14 @@ public:
 			_device       = other._device;
 			_image        = other._image;
 			_memory       = other._memory;
+			_allocator    = other._allocator;
+			_allocation   = other._allocation;
 			_descriptorImageInfo = other._descriptorImageInfo;
 			other._device = nullptr;
 			other._image = nullptr;
 			other._memory = nullptr;
+			other._allocator = nullptr;
+			other._allocation = {};
 			other._descriptorImageInfo = VkDescriptorImageInfo{};
 		}
 	}
@@ -77,10 +94,14 @@ public:
 			_device = other._device;
 			_image = other._image;
 			_memory = other._memory;
+			_allocator = other._allocator;
+			_allocation = other._allocation;
 			_descriptorImageInfo = other._descriptorImageInfo;
 			other._device = nullptr;
 			other._image = nullptr;
 			other._memory = nullptr;
+			other._allocator = nullptr;
+			other._allocation = {};
 			other._descriptorImageInfo = VkDescriptorImageInfo{};
 		}
 		return *this;
@@ -92,7 +113,10 @@ public:
 			vkDestroySampler(_device, _descriptorImageInfo.sampler, nullptr);
 			vkDestroyImageView(_device, _descriptorImageInfo.imageView, nullptr);
 			vkDestroyImage(_device, _image, nullptr);
-			vkFreeMemory(_device, _memory, nullptr);
+			if (_allocator)
+				_allocator->Free(_allocation);
+			else
+				vkFreeMemory(_device, _memory, nullptr);
 			_device = nullptr;
 		}
 	}
@@ -102,6 +126,7 @@ public:
 	inline u32 Height() const { return _height; }
 	inline u32 MipLevels() const { return _mipLevels; }
 	inline u32 LayerCount() const { return _layerCount; }
+	inline VkFormat Format() const { return _format; }
 	inline const VkImage& Image() const { return _image; }
 	//inline const VkDeviceMemory& Memory() const { return _memory; }
 	inline const VkDescriptorImageInfo& ImageInfo() const { return _descriptorImageInfo; }
@@ -116,6 +141,8 @@ private:
 	VkFormat _format{};
 	VkImage _image{};
 	VkDeviceMemory _memory{};
+	GpuMemoryAllocator* _allocator = nullptr;
+	GpuAllocation _allocation{};
 	VkDescriptorImageInfo _descriptorImageInfo{};
 };
 
@@ -126,98 +153,65 @@ private:
 class TextureResourceHelpers
 {
 public:
-	static TextureResource LoadTexture(const std::string& path, VkCommandPool transferPool, VkQueue transferQueue, 
-		VkPhysicalDevice physicalDevice, VkDevice device)
-	{
-		// TODO Pull the texture library out of the CreateTextureImage, just work on an TextureDefinition struct that
-		// has an array of pixels and width, height, channels, etc
-
-		const u32 layerCount = 1;
-		const auto format = VK_FORMAT_R8G8B8A8_UNORM;
-
-	
-		auto [image, memory, mipLevels, width, height] = CreateTextureImage(path, transferPool, transferQueue, physicalDevice, device);
-		auto* view = vkh::CreateImage2DView(image, format, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, layerCount, device);
-		auto* sampler = CreateTextureSampler(mipLevels, device);
-		const auto layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		return TextureResource(device, width, height, mipLevels, layerCount, image, memory, view, sampler, format, layout);
-	}
-
-private:
-
-	static std::tuple<VkImage, VkDeviceMemory, uint32_t, uint32_t, uint32_t> CreateTextureImage(
-		const std::string& path, VkCommandPool transferPool, VkQueue transferQueue, VkPhysicalDevice physicalDevice,
+	// The returned texture is usable by any work submitted after the uploader's next Flush()
+	static TextureResource LoadTexture(const std::string& path, UploadBatcher& uploader, GpuMemoryAllocator& allocator,
 		VkDevice device)
 	{
-		const VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-		
 		// Load texture from file into system mem
 		int texWidth, texHeight, texChannels;
 		unsigned char* texels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 		if (!texels)
 		{
-			stbi_image_free(texels);
 			throw std::runtime_error("Failed to load texture image: " + path);
 		}
 
-		const VkDeviceSize imageSizeBytes = (uint64_t)texWidth * (uint64_t)texHeight * 4; // RGBA = 4bytes
-		const uint32_t mipLevels = (uint32_t)std::floor(std::log2(std::max(texWidth, texHeight))) + 1;
+		auto texture = CreateTexture(texels, texWidth, texHeight, uploader, allocator, device);
+
+		// Free loaded image from system mem
+		stbi_image_free(texels);
 
-		// Create staging buffer
-		auto [stagingBuffer, stagingBufferMemory] = vkh::CreateBuffer(
-			imageSizeBytes,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // usage flags
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // property flags
-			device, physicalDevice);
+		return texture;
+	}
+
+	// Creates a sampled, mipmapped texture from RGBA8 texels. The texels are copied into staging before returning.
+	static TextureResource CreateTexture(const unsigned char* texels, u32 width, u32 height, UploadBatcher& uploader,
+		GpuMemoryAllocator& allocator, VkDevice device)
+	{
+		const u32 layerCount = 1;
+		const auto format = VK_FORMAT_R8G8B8A8_UNORM;
 
+		auto [image, allocation, mipLevels] = CreateTextureImage(texels, width, height, format, uploader, allocator, device);
+		auto* view = vkh::CreateImage2DView(image, format, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, layerCount, device);
+		auto* sampler = CreateTextureSampler(mipLevels, device);
+		const auto layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		// Copy texels from system mem to GPU staging buffer
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, imageSizeBytes, 0, &data);
-		memcpy(data, texels, imageSizeBytes);
-		vkUnmapMemory(device, stagingBufferMemory);
+		return TextureResource(device, width, height, mipLevels, layerCount, image, &allocator, allocation, view, sampler, format, layout);
+	}
 
+private:
 
-		// Free loaded image from system mem
-		stbi_image_free(texels);
+	static std::tuple<VkImage, GpuAllocation, uint32_t> CreateTextureImage(const unsigned char* texels, u32 width,
+		u32 height, VkFormat format, UploadBatcher& uploader, GpuMemoryAllocator& allocator, VkDevice device)
+	{
+		const VkDeviceSize imageSizeBytes = (uint64_t)width * (uint64_t)height * 4; // RGBA = 4bytes
+		const uint32_t mipLevels = (uint32_t)std::floor(std::log2(std::max(width, height))) + 1;
 
 
 		// Create image buffer
-		auto [textureImage, textureImageMemory] = vkh::CreateImage2D(texWidth, texHeight,
+		auto [textureImage, textureImageAllocation] = vkh::CreateImage2D(width, height,
 			mipLevels,
 			VK_SAMPLE_COUNT_1_BIT,
 			format, // format
 			VK_IMAGE_TILING_OPTIMAL, // tiling
 			VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // usageflags
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, //propertyflags
-			physicalDevice, device);
-
-
-		auto* cmdBuf = vkh::BeginSingleTimeCommands(transferPool, device);
-		
-		// Transition image layout to optimal for copying to it from the staging buffer
-		vkh::TransitionImageLayout(cmdBuf, textureImage,
-			VK_IMAGE_LAYOUT_UNDEFINED, // from
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, // to
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			0, mipLevels,
-			0, 1,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, // i'm not 100% if this is correct, but the synchronization warnings aren't yelling
-			VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-		vkh::CopyBufferToImage(cmdBuf, stagingBuffer, textureImage, texWidth, texHeight);
-
-		// GenerateMipmaps has a precondition that all mip levels are VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL. Which we are from above.
-		vkh::GenerateMipmaps(cmdBuf, physicalDevice, textureImage, format, texWidth, texHeight, mipLevels);
+			allocator, device);
 
-		vkh::EndSingeTimeCommands(cmdBuf, transferPool, transferQueue, device);
 
-		// Destroy the staging buffer
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		// Texels are copied into staging immediately, the copy and mip generation run with the next batch
+		uploader.UploadImage2D(textureImage, format, width, height, mipLevels, texels, imageSizeBytes);
 
-		return { textureImage, textureImageMemory, mipLevels, texWidth, texHeight };
+		return { textureImage, textureImageAllocation, mipLevels };
 	}
 
 	static VkSampler CreateTextureSampler(uint32_t mipLevels, VkDevice device)
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Renderer/HighLevel/CommonRendererHighLevel.h"
+#include "Renderer/HighLevel/ShadowCascades.h"
+#include "Renderer/HighLevel/ShIrradiance.h"
 #include <Framework/CommonTypes.h>
 #include <Framework/Material.h>
 
@@ -26,50 +28,15 @@ struct SkyboxFragUbo
 	alignas(4) f32  IblStrength;
 	alignas(4) f32  BackdropBrightness;
 	alignas(4) bool ShowClipping;
-};
-
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-struct LightUbo
-{
-	struct LightPacked
-	{
-		alignas(16) glm::vec4 LightColorIntensity;// floats [R,G,B,Intensity]
-		alignas(16) glm::vec4 LightPosType;       // floats [X,Y,Z], int [Type]
-	};
-
-	alignas(16)	LightPacked Lights[8];
-
-	static LightUbo Create(const std::vector<Light>& lights)
-	{
-		const u32 maxLights = 8;
-		assert(lights.size() <= maxLights);
-
-		LightUbo ubo{};
-
-		for (size_t i = 0; i < lights.size(); i++)
-		{
-			const auto& l = lights[i];
-			ubo.Lights[i].LightColorIntensity[0] = l.Color.r;
-			ubo.Lights[i].LightColorIntensity[1] = l.Color.g;
-			ubo.Lights[i].LightColorIntensity[2] = l.Color.b;
-			ubo.Lights[i].LightColorIntensity[3] = l.Intensity;
-			ubo.Lights[i].LightPosType[0] = l.Pos.x;
-			ubo.Lights[i].LightPosType[1] = l.Pos.y;
-			ubo.Lights[i].LightPosType[2] = l.Pos.z;
-			ubo.Lights[i].LightPosType[3] = f32(l.Type);
-		}
-
-		return ubo;
-	}
+	alignas(4) bool ShowIrradiance;
+	alignas(16) glm::vec4 IrradianceSh[ShIrradiance::CoefficientCount]; // [R,G,B,Unused]
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 struct PbrUboCreateInfo
 {
-	glm::mat4 Model{};
 	glm::mat4 View{};
 	glm::mat4 Projection{};
-	glm::mat4 LightSpaceMatrix{};
 	glm::vec3 CamPos{};
 
 	// Render options
@@ -78,22 +45,36 @@ struct PbrUboCreateInfo
 	float IblStrength = 1.0f;
 	float ExposureBias = 1.0f;
 	float CubemapRotation = 0;
+	ShIrradiance::Coefficients IrradianceSh{};
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-struct PbrMeshVsUbo
+struct PbrFrameUbo // Model matrices are per instance, see InstanceBuffer
 {
-	alignas(16) glm::mat4 Model;         
-	alignas(16) glm::mat4 ViewProjection;          
-	alignas(16) glm::mat4 LightSpaceMatrix;
-
-	static PbrMeshVsUbo Create(const PbrUboCreateInfo& info)
+	alignas(16) glm::mat4 ViewProjection;
+	alignas(16) glm::mat4 CascadeMatrices[ShadowCascades::MaxCascades];
+	alignas(16) glm::vec4 CascadeAtlasRects[ShadowCascades::MaxCascades];
+	alignas(16) glm::vec4 CascadeFarDepths;
+	alignas(4)  u32 CascadeCount;
+	alignas(16) glm::vec4 IrradianceSh[ShIrradiance::CoefficientCount]; // [R,G,B,Unused]
+
+	static PbrFrameUbo Create(const PbrUboCreateInfo& info, const ShadowCascades& cascades)
 	{
-		PbrMeshVsUbo ubo{};
+		PbrFrameUbo ubo{};
 		
-		ubo.Model = info.Model;
 		ubo.ViewProjection = info.Projection * info.View;
-		ubo.LightSpaceMatrix = info.LightSpaceMatrix;
+		ubo.CascadeCount = cascades.Count();
+		for (u32 i = 0; i < cascades.Count(); i++)
+		{
+			const auto& cascade = cascades.Get(i);
+			ubo.CascadeMatrices[i] = cascade.ViewProjection;
+			ubo.CascadeAtlasRects[i] = cascade.AtlasRect;
+			ubo.CascadeFarDepths[i] = cascade.FarDepth;
+		}
+		for (u32 i = 0; i < ShIrradiance::CoefficientCount; i++)
+		{
+			ubo.IrradianceSh[i] = glm::vec4(info.IrradianceSh[i], 0);
+		}
 		
 		return ubo;
 	}
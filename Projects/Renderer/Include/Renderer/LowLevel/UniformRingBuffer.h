@@ -0,0 +1,106 @@
+#pragma once
+
+#include "GpuMemoryAllocator.h"
+#include "VulkanHelpers.h"
+
+#include <Framework/CommonTypes.h>
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+using vkh = VulkanHelpers;
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// One persistently mapped uniform buffer split into a region per frame in flight. Each frame the region is rewound
+// and per-draw data is appended linearly; the returned offsets are fed to vkCmdBindDescriptorSets as dynamic offsets
+// against a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC binding. Because the offsets are absolute within the single
+// buffer, a descriptor set pointing at it never needs rewriting when the frame changes.
+class UniformRingBuffer final
+{
+private:
+	VkDevice _device = nullptr;
+	GpuMemoryAllocator* _allocator = nullptr;
+	VkBuffer _buffer = nullptr;
+	GpuAllocation _allocation{};
+
+	VkDeviceSize _alignment = 0;
+	VkDeviceSize _frameCapacity = 0;
+	u32 _frameCount = 0;
+
+	VkDeviceSize _frameStart = 0;
+	VkDeviceSize _head = 0;
+
+public:
+	UniformRingBuffer() = delete;
+	UniformRingBuffer(u32 frameCount, VkDeviceSize frameCapacity, GpuMemoryAllocator& allocator,
+		VkPhysicalDevice physicalDevice, VkDevice device)
+		: _device(device), _allocator(&allocator), _frameCount(frameCount)
+	{
+		assert(frameCount > 0);
+
+		VkPhysicalDeviceProperties props;
+		vkGetPhysicalDeviceProperties(physicalDevice, &props);
+		_alignment = std::max<VkDeviceSize>(props.limits.minUniformBufferOffsetAlignment, 1);
+		_frameCapacity = AlignUp(frameCapacity);
+
+		std::tie(_buffer, _allocation) = vkh::CreateBuffer(_frameCapacity * frameCount,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			allocator, device);
+
+		assert(_allocation.Mapped);
+	}
+	~UniformRingBuffer()
+	{
+		if (_device)
+		{
+			vkDestroyBuffer(_device, _buffer, nullptr);
+			_allocator->Free(_allocation);
+			_device = nullptr;
+		}
+	}
+	UniformRingBuffer(const UniformRingBuffer&) = delete;
+	UniformRingBuffer& operator=(const UniformRingBuffer&) = delete;
+	UniformRingBuffer(UniformRingBuffer&&) = delete;
+	UniformRingBuffer& operator=(UniformRingBuffer&&) = delete;
+
+	// Rewinds the region owned by frameIndex. Caller guarantees the GPU has finished with that frame.
+	void BeginFrame(u32 frameIndex)
+	{
+		assert(frameIndex < _frameCount);
+		_frameStart = _frameCapacity * frameIndex;
+		_head = 0;
+	}
+
+	// Copies data into the current frame's region and returns its dynamic offset
+	u32 Push(const void* data, VkDeviceSize size)
+	{
+		const auto offset = _head;
+		const auto alignedSize = AlignUp(size);
+		if (offset + alignedSize > _frameCapacity)
+		{
+			throw std::runtime_error("UniformRingBuffer frame capacity exceeded");
+		}
+
+		memcpy((u8*)_allocation.Mapped + _frameStart + offset, data, size);
+		_head += alignedSize;
+
+		return (u32)(_frameStart + offset);
+	}
+
+	template <typename T>
+	u32 Push(const T& data) { return Push(&data, sizeof(T)); }
+
+	VkBuffer Buffer() const { return _buffer; }
+	VkDeviceSize BytesUsedThisFrame() const { return _head; }
+
+private:
+	VkDeviceSize AlignUp(VkDeviceSize value) const
+	{
+		return (value + _alignment - 1) / _alignment * _alignment;
+	}
+};
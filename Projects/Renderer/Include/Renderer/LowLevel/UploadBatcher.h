@@ -0,0 +1,106 @@
+#pragma once
+
+#include "GpuMemoryAllocator.h"
+
+#include <Framework/CommonTypes.h>
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+class VulkanService;
+
+// Identifies the batch an upload was recorded into, see UploadBatcher::IsComplete()
+using UploadTicket = u64;
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Streams buffer and texture data into device local memory without stalling the GPU. Data is copied into a
+// persistently mapped staging ring and the copy is recorded into the open batch. Flush() submits the batch with a
+// fence and Poll() hands staging space back once the GPU is done with it.
+//
+// With a dedicated transfer family the copies run on the transfer queue and ownership is released to the graphics
+// queue, where a second command buffer acquires it, generates mips and transitions images for sampling. That half is
+// submitted to the same queue as the frames, so anything submitted after Flush() sees the finished data without the
+// CPU ever waiting on it.
+class UploadBatcher final
+{
+private: // Types
+	struct Batch
+	{
+		VkCommandBuffer TransferCmd = nullptr;
+		VkCommandBuffer GraphicsCmd = nullptr; // Same as TransferCmd without a dedicated transfer queue
+		VkSemaphore TransferDone = nullptr;
+		VkFence Fence = nullptr;
+		UploadTicket Ticket = 0;
+		VkDeviceSize RingBytes = 0; // Staging ring bytes consumed, including padding skipped when wrapping
+		std::vector<std::tuple<VkBuffer, GpuAllocation>> OversizeStaging{};
+	};
+
+	static constexpr u32 MaxBatches = 4;
+	static constexpr VkDeviceSize StagingAlignment = 16; // Satisfies the copy offset rules for every format we upload
+
+private: // Data
+	VulkanService* _vk = nullptr;
+	bool _dedicatedTransfer = false;
+	u32 _transferFamily = 0;
+	u32 _graphicsFamily = 0;
+	VkCommandPool _transferPool = nullptr;
+	VkCommandPool _graphicsPool = nullptr;
+
+	VkBuffer _stagingBuffer = nullptr;
+	GpuAllocation _stagingAllocation{};
+	VkDeviceSize _stagingCapacity = 0;
+	VkDeviceSize _stagingHead = 0;
+	VkDeviceSize _stagingUsed = 0;
+
+	std::vector<Batch> _batches{};
+	std::vector<u32> _freeBatches{};
+	std::deque<u32> _inFlight{}; // Oldest first
+	i32 _openBatch = -1;
+
+	UploadTicket _nextTicket = 1;
+	UploadTicket _completedTicket = 0;
+
+public: // Methods
+	UploadBatcher() = delete;
+	explicit UploadBatcher(VulkanService& vk, VkDeviceSize stagingCapacity = 32ull * 1024 * 1024);
+	~UploadBatcher();
+	UploadBatcher(const UploadBatcher&) = delete;
+	UploadBatcher& operator=(const UploadBatcher&) = delete;
+	UploadBatcher(UploadBatcher&&) = delete;
+	UploadBatcher& operator=(UploadBatcher&&) = delete;
+
+	// dst needs VK_BUFFER_USAGE_TRANSFER_DST_BIT. dstStage and dstAccess describe how the range is first used. Only the
+	// written range changes hands, so the rest of dst can be in use by the graphics queue.
+	UploadTicket UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+	// Fills mip 0 of a single layer image, generates the rest of the chain and leaves every mip in
+	// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. The image starts in VK_IMAGE_LAYOUT_UNDEFINED.
+	UploadTicket UploadImage2D(VkImage dst, VkFormat format, u32 width, u32 height, u32 mipLevels, const void* texels,
+		VkDeviceSize size);
+
+	// Submits everything recorded since the last flush. Must precede any submission that uses the uploads.
+	void Flush();
+
+	// Retires batches the GPU has finished. Never blocks.
+	void Poll();
+
+	// Blocks until every submitted batch has finished
+	void WaitIdle();
+
+	bool IsComplete(UploadTicket ticket) const { return ticket <= _completedTicket; }
+	bool HasDedicatedTransferQueue() const { return _dedicatedTransfer; }
+	u32 BatchesInFlight() const { return (u32)_inFlight.size(); }
+
+private:
+	Batch& GetOpenBatch();
+	std::optional<VkDeviceSize> TryAllocateStaging(VkDeviceSize size, VkDeviceSize& outConsumed);
+	std::tuple<VkBuffer, VkDeviceSize> AllocateStaging(const void* data, VkDeviceSize size);
+	void Retire(u32 batchIndex);
+	void RetireOldest();
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "GpuMemoryAllocator.h"
+
 #include <Framework/CommonTypes.h>
 
 #include <vulkan/vulkan.h>
@@ -46,7 +48,9 @@ public:
 	static VkSampleCountFlagBits GetMaxUsableSampleCount(VkPhysicalDevice physicalDevice);
 
 
-	[[nodiscard]] static std::tuple<VkDevice, VkQueue, VkQueue> CreateLogicalDevice(
+	// Returns the device, graphics, present and transfer queues. Transfer is the graphics queue if there is no
+	// dedicated transfer family.
+	[[nodiscard]] static std::tuple<VkDevice, VkQueue, VkQueue, VkQueue> CreateLogicalDevice(
 		VkPhysicalDevice physicalDevice,
 		VkSurfaceKHR surface,
 		const std::vector<const char*>& validationLayers,
@@ -100,6 +104,21 @@ public:
 			VkDevice device, VkPhysicalDevice physicalDevice);
 
 
+	// Sub-allocated variants. Free the returned allocation with the same allocator.
+	
+	[[nodiscard]] static std::tuple<VkBuffer, GpuAllocation>
+		CreateVertexBuffer(const std::vector<Vertex>& vertices, VkQueue transferQueue, VkCommandPool transferCommandPool,
+			GpuMemoryAllocator& allocator, VkDevice device);
+
+	[[nodiscard]] static std::tuple<VkBuffer, GpuAllocation>
+		CreateIndexBuffer(const std::vector<uint32_t>& indices, VkQueue transferQueue, VkCommandPool transferCommandPool,
+			GpuMemoryAllocator& allocator, VkDevice device);
+
+	[[nodiscard]] static std::tuple<VkBuffer, GpuAllocation>
+		CreateBuffer(VkDeviceSize sizeBytes, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags,
+			GpuMemoryAllocator& allocator, VkDevice device, GpuPoolKind poolKind = GpuPoolKind::FreeList);
+
+
 	// Helper method to find suitable memory type on GPU
 	static uint32_t
 		FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags, VkPhysicalDevice physicalDevice);;
@@ -154,6 +173,10 @@ public:
 	static std::tuple<std::vector<VkBuffer>, std::vector<VkDeviceMemory>>
 		CreateUniformBuffers(u32 count, VkDeviceSize typeSize, VkDevice device, VkPhysicalDevice physicalDevice);
 
+	// Host visible and coherent, so each GpuAllocation::Mapped can be written directly
+	static std::tuple<std::vector<VkBuffer>, std::vector<GpuAllocation>>
+		CreateUniformBuffers(u32 count, VkDeviceSize typeSize, GpuMemoryAllocator& allocator, VkDevice device);
+
 #pragma endregion
 
 
@@ -165,6 +188,12 @@ public:
 			VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags,
 			VkPhysicalDevice physicalDevice, VkDevice device, u32 arrayLayers = 1, VkImageCreateFlags flags = 0);
 
+	[[nodiscard]] static std::tuple<VkImage, GpuAllocation>
+		CreateImage2D(u32 width, u32 height, u32 mipLevels, VkSampleCountFlagBits multisampleSamples,
+			VkFormat format,
+			VkImageTiling tiling, VkImageUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags,
+			GpuMemoryAllocator& allocator, VkDevice device, u32 arrayLayers = 1, VkImageCreateFlags flags = 0);
+
 
 	[[nodiscard]] static VkImageView CreateImage2DView(VkImage image, VkFormat format, VkImageViewType viewType,
 		VkImageAspectFlags aspectFlags, u32 mipLevels, u32 layerCount, VkDevice device);
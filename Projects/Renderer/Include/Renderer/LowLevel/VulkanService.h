@@ -1,6 +1,8 @@
 #pragma once
 
+#include "GpuMemoryAllocator.h"
 #include "GpuTypes.h"
+#include "PipelineCache.h"
 #include "VulkanHelpers.h"
 #include "VulkanInitializers.h"
 #include "Swapchain.h"
@@ -9,7 +11,10 @@
 
 #include <vulkan/vulkan.h>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <string>
 
 using vkh = VulkanHelpers;
 
@@ -58,6 +63,7 @@ private: // DATA ///////////////////////////////////////////////////////////////
 	const size_t _maxFramesInFlight = 2;
 	const std::vector<const char*> _validationLayers = { "VK_LAYER_KHRONOS_validation", };
 	const std::vector<const char*> _physicalDeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	const std::vector<const char*> _optionalPhysicalDeviceExtensions = { VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME };
 
 	// Core vulkan
 	VkInstance _instance = nullptr;
@@ -65,9 +71,17 @@ private: // DATA ///////////////////////////////////////////////////////////////
 	VkPhysicalDevice _physicalDevice = nullptr;
 	VkDevice _device = nullptr;
 	VkCommandPool _commandPool = nullptr;
+	std::unique_ptr<GpuMemoryAllocator> _memoryAllocator = nullptr;
+	std::unique_ptr<PipelineCache> _pipelineCache = nullptr;
+	std::string _pipelineCachePath{};
 
+	QueueFamilyIndices _queueFamilies{};
 	VkQueue _graphicsQueue = nullptr;
 	VkQueue _presentQueue = nullptr;
+	VkQueue _transferQueue = nullptr;
+
+	// Optional device functions, null when the extension isn't supported
+	PFN_vkCmdDrawIndexedIndirectCountKHR _cmdDrawIndexedIndirectCount = nullptr;
 
 	std::unique_ptr<Swapchain> _swapchain = nullptr;
 	
@@ -88,7 +102,7 @@ private: // DATA ///////////////////////////////////////////////////////////////
 public: // METHODS ////////////////////////////////////////////////////////////////////////////////////////////////////
 	VulkanService() = delete;
 	VulkanService(bool enableValidationLayers, bool enableVsync, bool enableMsaa, IVulkanServiceDelegate* delegate,
-	              ISurfaceBuilder* builder, const VkExtent2D framebufferSize)
+	              ISurfaceBuilder* builder, const VkExtent2D framebufferSize, std::string pipelineCachePath = {})
 	{
 		assert(delegate);
 		assert(builder);
@@ -97,11 +111,13 @@ public: // METHODS /////////////////////////////////////////////////////////////
 		_enableValidationLayers = enableValidationLayers;
 		_vsync = enableVsync;
 		_msaaEnabled = enableMsaa;
+		_pipelineCachePath = std::move(pipelineCachePath);
 
 		Init(builder, framebufferSize);
 
 		std::cout << (_msaaEnabled ? "MSAA Enabled" : "MSAA Disabled") << std::endl;
 		std::cout << (_vsync ? "VSync Enabled" : "VSync Disabled") << std::endl;
+		std::cout << (_cmdDrawIndexedIndirectCount ? "Draw Indirect Count Enabled" : "Draw Indirect Count Disabled") << std::endl;
 	}
 	~VulkanService()
 	{
@@ -126,6 +142,7 @@ public: // METHODS /////////////////////////////////////////////////////////////
 			_msaaSamples = other._msaaSamples;
 			_currentFrame = other._currentFrame;
 			_swapchainInvalidated = other._swapchainInvalidated;
+			_pipelineCachePath = std::move(other._pipelineCachePath);
 			
 			// Pointers
 			_delegate = other._delegate;
@@ -134,11 +151,16 @@ public: // METHODS /////////////////////////////////////////////////////////////
 			_physicalDevice = other._physicalDevice;
 			_device = other._device;
 			_commandPool = other._commandPool;
+			_queueFamilies = other._queueFamilies;
 			_graphicsQueue = other._graphicsQueue;
 			_presentQueue = other._presentQueue;
+			_transferQueue = other._transferQueue;
 			_surface = other._surface;
+			_cmdDrawIndexedIndirectCount = other._cmdDrawIndexedIndirectCount;
 			
 			_swapchain = std::move(other._swapchain);
+			_memoryAllocator = std::move(other._memoryAllocator);
+			_pipelineCache = std::move(other._pipelineCache);
 
 			// Vectors
 			_commandBuffers = std::move(other._commandBuffers);
@@ -156,7 +178,9 @@ public: // METHODS /////////////////////////////////////////////////////////////
 			other._commandPool  = nullptr;
 			other._graphicsQueue = nullptr;
 			other._presentQueue  = nullptr;
+			other._transferQueue = nullptr;
 			other._surface = nullptr;
+			other._cmdDrawIndexedIndirectCount = nullptr;
 		}
 		
 		return *this;
@@ -169,7 +193,14 @@ public: // METHODS /////////////////////////////////////////////////////////////
 	VkPhysicalDevice PhysicalDevice() const { return _physicalDevice; }
 	VkCommandPool CommandPool() const { return _commandPool; }
 	VkQueue GraphicsQueue() const { return _graphicsQueue; }
+	VkQueue TransferQueue() const { return _transferQueue; } // Same as GraphicsQueue() without a dedicated transfer family
+	const QueueFamilyIndices& QueueFamilies() const { return _queueFamilies; }
 	VkAllocationCallbacks* Allocator() const { return nullptr; }
+	GpuMemoryAllocator& MemoryAllocator() const { return *_memoryAllocator; }
+	PipelineCache& GetPipelineCache() const { return *_pipelineCache; } // Create every pipeline through this
+
+	// VK_KHR_draw_indirect_count. Null if the device doesn't support it.
+	PFN_vkCmdDrawIndexedIndirectCountKHR CmdDrawIndexedIndirectCount() const { return _cmdDrawIndexedIndirectCount; }
 	
 	void InvalidateSwapchain() { _swapchainInvalidated = true; }
 
@@ -298,11 +329,21 @@ private: // METHODS ////////////////////////////////////////////////////////////
 		auto* surface = builder->CreateSurface(instance);
 
 		auto [physicalDevice, maxMsaaSamples] = vkh::PickPhysicalDevice(_physicalDeviceExtensions, instance, surface);
+
+		auto deviceExtensions = _physicalDeviceExtensions;
+		for (const auto* extension : _optionalPhysicalDeviceExtensions)
+		{
+			if (vkh::CheckPhysicalDeviceExtensionSupport({ extension }, physicalDevice))
+			{
+				deviceExtensions.push_back(extension);
+			}
+		}
 		
-		auto [device, graphicsQueue, presentQueue]
-			= vkh::CreateLogicalDevice(physicalDevice, surface, _validationLayers, _physicalDeviceExtensions);
+		auto [device, graphicsQueue, presentQueue, transferQueue]
+			= vkh::CreateLogicalDevice(physicalDevice, surface, _validationLayers, deviceExtensions);
 
-		auto* commandPool = vkh::CreateCommandPool(vkh::FindQueueFamilies(physicalDevice, surface), device);
+		const auto queueFamilies = vkh::FindQueueFamilies(physicalDevice, surface);
+		auto* commandPool = vkh::CreateCommandPool(queueFamilies, device);
 
 		
 		// Set em. Done like this to enforce the correct initialization order above 
@@ -313,7 +354,16 @@ private: // METHODS ////////////////////////////////////////////////////////////
 		_device = device;
 		_graphicsQueue = graphicsQueue;
 		_presentQueue = presentQueue;
+		_transferQueue = transferQueue;
+		_queueFamilies = queueFamilies;
 		_commandPool = commandPool;
+		const auto drawIndirectCountEnabled = std::find_if(deviceExtensions.begin(), deviceExtensions.end(),
+			[](const char* ext) { return strcmp(ext, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0; }) != deviceExtensions.end();
+		_cmdDrawIndexedIndirectCount = drawIndirectCountEnabled
+			? (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR")
+			: nullptr;
+		_memoryAllocator = std::make_unique<GpuMemoryAllocator>(physicalDevice, device);
+		_pipelineCache = std::make_unique<PipelineCache>(physicalDevice, device, _pipelineCachePath);
 
 		InitSwapchain(framebufferSize);
 	}
@@ -327,6 +377,9 @@ private: // METHODS ////////////////////////////////////////////////////////////
 		// DestroyVulkan();
 		{
 			vkDestroyCommandPool(_device, _commandPool, nullptr);
+			_pipelineCache->Save();
+			_pipelineCache = nullptr; // RAII cleanup, must precede the device
+			_memoryAllocator = nullptr; // RAII cleanup, must precede the device
 			vkDestroyDevice(_device, nullptr);
 			if (_enableValidationLayers)
 			{
@@ -0,0 +1,218 @@
+#include "Renderer/HighLevel/BrdfLut.h"
+
+#include "Renderer/LowLevel/JobSystem.h"
+
+#include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+
+#ifndef NDEBUG
+namespace
+{
+	// Scalar port of the GenIblBrdfMap.frag the table replaced, kept to check the vectorised integration against
+	glm::vec2 IntegrateTexelReference(f32 NdotV, f32 roughness, u32 sampleCount)
+	{
+		constexpr f32 pi = 3.14159265359f;
+		const f32 a = roughness * roughness;
+		const f32 k = a / 2.f;
+		const glm::vec3 toEye{ std::sqrt(1.f - NdotV * NdotV), 0, NdotV };
+
+		glm::vec2 sum{ 0 };
+		for (u32 i = 0; i < sampleCount; i++)
+		{
+			u32 bits = i;
+			bits = (bits << 16u) | (bits >> 16u);
+			bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+			bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+			bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+			bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+			const glm::vec2 xi = { (f32)i / sampleCount, (f32)bits * 2.3283064365386963e-10f };
+
+			// Tangent frame around N = +Z as the shader built it: tangent -Y, bitangent +X
+			const f32 phi = 2.f * pi * xi.x;
+			const f32 cosTheta = std::sqrt((1.f - xi.y) / (1.f + (a * a - 1.f) * xi.y));
+			const f32 sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+			const glm::vec3 halfway = glm::normalize(glm::vec3{ std::sin(phi) * sinTheta, -std::cos(phi) * sinTheta, cosTheta });
+			const glm::vec3 light = glm::normalize(2.f * glm::dot(toEye, halfway) * halfway - toEye);
+
+			const f32 NdotL = std::max(light.z, 0.f);
+			if (NdotL > 0.f)
+			{
+				const f32 NdotH = std::max(halfway.z, 0.f);
+				const f32 VdotH = std::max(glm::dot(toEye, halfway), 0.f);
+				const f32 geometry = NdotV / (NdotV * (1.f - k) + k) * (NdotL / (NdotL * (1.f - k) + k));
+				const f32 visibility = geometry * VdotH / (NdotH * NdotV);
+				const f32 fresnel = std::pow(1.f - VdotH, 5.f);
+				sum += glm::vec2{ (1.f - fresnel) * visibility, fresnel * visibility };
+			}
+		}
+		return sum / (f32)sampleCount;
+	}
+}
+#endif
+
+
+std::vector<u32> BrdfLut::LoadOrGenerate(const std::string& cacheDir, JobSystem& jobs)
+{
+	const auto path = std::filesystem::path(cacheDir) / "BrdfLut.fxlut";
+
+	std::vector<u32> texels{};
+	if (TryLoad(path, texels))
+		return texels;
+
+	texels = Generate(jobs);
+	Save(path, texels);
+	return texels;
+}
+
+std::vector<u32> BrdfLut::Generate(JobSystem& jobs)
+{
+	const auto benchStart = std::chrono::high_resolution_clock::now();
+
+	std::vector<u32> texels(Dim * Dim);
+	jobs.Run(Dim, [&](u32 row, u32) { IntegrateRow(row, texels.data() + row * Dim); });
+
+#ifndef NDEBUG
+	// Spot check a few texels against the reference, grazing NdotV columns included. They agree to half precision.
+	for (const u32 row : { 0u, Dim / 2, Dim - 1 })
+	{
+		for (const u32 col : { 0u, 1u, Dim / 2, Dim - 1 })
+		{
+			const auto expected = IntegrateTexelReference((col + 0.5f) / Dim, 1.f - (row + 0.5f) / Dim, SampleCount);
+			const auto actual = glm::unpackHalf2x16(texels[row * Dim + col]);
+			assert(std::abs(actual.x - expected.x) < 1e-3f && std::abs(actual.y - expected.y) < 1e-3f);
+		}
+	}
+#endif
+
+	const auto benchDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - benchStart).count();
+	std::cout << "Integrating brdf lut on " << jobs.ThreadCount() << " threads took " << benchDiff << " ms\n";
+
+	return texels;
+}
+
+// GGX split sum integration (Karis 2013), same sample set and texel centres as the fragment shader it replaced
+void BrdfLut::IntegrateRow(u32 row, u32* texels)
+{
+	constexpr f32 pi = 3.14159265359f;
+
+	const f32 roughness = 1.f - (row + 0.5f) / Dim;
+	const f32 a = roughness * roughness;
+	const f32 k = a / 2.f; // Schlick-GGX k for IBL
+
+	// N is +Z and V lies in the XZ plane, so a halfway vector's Y never reaches a dot product. The samples only
+	// depend on roughness and are shared by the whole row.
+	std::array<f32, SampleCount> halfwayX{};
+	std::array<f32, SampleCount> halfwayZ{};
+	for (u32 i = 0; i < SampleCount; i++)
+	{
+		// Hammersley
+		u32 bits = i;
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		const glm::vec2 xi = { (f32)i / SampleCount, (f32)bits * 2.3283064365386963e-10f };
+
+		// GGX importance sample. The tangent frame around +Z maps the sample's Y to world X.
+		const f32 phi = 2.f * pi * xi.x;
+		const f32 cosTheta = std::sqrt((1.f - xi.y) / (1.f + (a * a - 1.f) * xi.y));
+		const f32 sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+		halfwayX[i] = std::sin(phi) * sinTheta;
+		halfwayZ[i] = cosTheta;
+	}
+
+	for (u32 col = 0; col < Dim; col++)
+	{
+		const f32 NdotV = (col + 0.5f) / Dim;
+		const f32 toEyeX = std::sqrt(1.f - NdotV * NdotV);
+		const f32 geometryV = NdotV / (NdotV * (1.f - k) + k);
+
+		f32 scale = 0;
+		f32 bias = 0;
+		for (u32 i = 0; i < SampleCount; i++)
+		{
+			const f32 NdotH = halfwayZ[i];
+			const f32 VdotH = toEyeX * halfwayX[i] + NdotV * NdotH;
+			const f32 NdotL = 2.f * VdotH * NdotH - NdotV; // L is V reflected about H
+
+			// NdotL > 0 implies VdotH > 0 and NdotH > 0, the masked lanes may divide by zero
+			const f32 geometryL = NdotL / (NdotL * (1.f - k) + k);
+			const f32 visibility = NdotL > 0.f ? geometryV * geometryL * VdotH / (NdotH * NdotV) : 0.f;
+			const f32 t = 1.f - VdotH;
+			const f32 fresnel = t * t * t * t * t;
+
+			scale += (1.f - fresnel) * visibility;
+			bias += fresnel * visibility;
+		}
+
+		texels[col] = glm::packHalf2x16(glm::vec2{ scale, bias } / (f32)SampleCount);
+	}
+}
+
+bool BrdfLut::TryLoad(const std::filesystem::path& path, std::vector<u32>& outTexels)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	const auto fileSize = (u64)file.tellg();
+	file.seekg(0);
+
+	FileHeader header{};
+	if (fileSize != sizeof(FileHeader) + sizeof(u32) * Dim * Dim ||
+		!file.read((char*)&header, sizeof(FileHeader)) ||
+		header.Magic != Magic ||
+		header.FormatVersion != FormatVersion ||
+		header.Dim != Dim ||
+		header.SampleCount != SampleCount)
+	{
+		return false;
+	}
+
+	outTexels.resize(Dim * Dim);
+	return (bool)file.read((char*)outTexels.data(), sizeof(u32) * outTexels.size());
+}
+
+// Failures are reported and otherwise ignored, the next run integrates again
+void BrdfLut::Save(const std::filesystem::path& path, const std::vector<u32>& texels)
+{
+	const FileHeader header{ Magic, FormatVersion, Dim, SampleCount };
+
+	// Write to a temp file and swap it in, so an interrupted write never leaves a truncated table behind
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	auto tempPath = path;
+	tempPath += ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(FileHeader));
+		file.write((const char*)texels.data(), sizeof(u32) * texels.size());
+		if (!file)
+		{
+			std::cerr << "Failed to write brdf lut cache: " << tempPath.string() << "\n";
+			file.close();
+			std::filesystem::remove(tempPath, ec);
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, ec);
+	if (ec)
+	{
+		std::cerr << "Failed to write brdf lut cache: " << path.string() << " - " << ec.message() << "\n";
+		std::filesystem::remove(tempPath, ec);
+	}
+}
@@ -0,0 +1,644 @@
+#include "Renderer/HighLevel/IblGenerator.h"
+
+#include "Renderer/HighLevel/Texels.h"
+#include "Renderer/LowLevel/PipelineCache.h"
+#include "Renderer/LowLevel/VulkanHelpers.h"
+#include "Renderer/LowLevel/VulkanInitializers.h"
+
+#include <Framework/FileService.h>
+
+#include <glm/packing.hpp>
+#include <glm/vec4.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using vkh = VulkanHelpers;
+
+namespace
+{
+	constexpr u32 WorkgroupSize = 8; // Match the Ibl*.comp shaders
+
+	u32 GroupCount(u32 dim) { return (dim + WorkgroupSize - 1) / WorkgroupSize; }
+	u32 MipDim(u32 dim, u32 mip) { return std::max(1u, dim >> mip); }
+}
+
+
+IblTextureResources IblGenerator::FromEquirectangular(const std::string& path, const PrefilterDesc& prefilter,
+	const std::string& shaderDir, VkCommandPool pool, VkQueue queue, VkPhysicalDevice physicalDevice, VkDevice device,
+	PipelineCache& pipelineCache)
+{
+	auto texels = TexelsRgbaF32();
+	texels.Load(path);
+
+	return Generate(&texels, CreateEnvironmentCubemap(physicalDevice, device), prefilter, shaderDir, pool, queue,
+		physicalDevice, device, pipelineCache);
+}
+
+IblTextureResources IblGenerator::FromCubemap(TextureResource environment, const PrefilterDesc& prefilter,
+	const std::string& shaderDir, VkCommandPool pool, VkQueue queue, VkPhysicalDevice physicalDevice, VkDevice device,
+	PipelineCache& pipelineCache)
+{
+	return Generate(nullptr, std::move(environment), prefilter, shaderDir, pool, queue, physicalDevice, device,
+		pipelineCache);
+}
+
+ShIrradiance::Coefficients IblGenerator::ProjectIrradianceSh(const TextureResource& environment, VkCommandPool pool,
+	VkQueue queue, VkPhysicalDevice physicalDevice, VkDevice device)
+{
+	const auto readbackSize = IrradianceShReadbackSize(environment);
+	auto [readbackBuffer, readbackMemory] = vkh::CreateBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, device, physicalDevice);
+
+	auto* cmdBuf = vkh::BeginSingleTimeCommands(pool, device);
+	RecordIrradianceShReadback(cmdBuf, environment, readbackBuffer);
+	SubmitAndWait(cmdBuf, pool, queue, device);
+
+	void* mapped;
+	vkMapMemory(device, readbackMemory, 0, readbackSize, 0, &mapped);
+	const auto irradianceSh = ProjectIrradianceSh(environment, mapped);
+	vkUnmapMemory(device, readbackMemory);
+
+	vkDestroyBuffer(device, readbackBuffer, nullptr);
+	vkFreeMemory(device, readbackMemory, nullptr);
+
+	return irradianceSh;
+}
+
+TextureResource IblGenerator::CreateEnvironmentCubemap(VkPhysicalDevice physicalDevice, VkDevice device)
+{
+	return CreateCubemap(EnvironmentDim, EnvironmentMips, physicalDevice, device);
+}
+
+TextureResource IblGenerator::CreatePrefilterCubemap(const PrefilterDesc& desc, VkPhysicalDevice physicalDevice,
+	VkDevice device)
+{
+	return CreateCubemap(desc.Dim, desc.MipLevels, physicalDevice, device);
+}
+
+IblTextureResources IblGenerator::Generate(const TexelsRgbaF32* equirectangular, TextureResource environment,
+	const PrefilterDesc& prefilterDesc, const std::string& shaderDir, VkCommandPool pool, VkQueue queue,
+	VkPhysicalDevice physicalDevice, VkDevice device, PipelineCache& pipelineCache)
+{
+	std::cout << "Generating ibl maps\n";
+	const auto benchStart = std::chrono::high_resolution_clock::now();
+
+	auto prefilter = CreatePrefilterCubemap(prefilterDesc, physicalDevice, device);
+	const u32 envMips = equirectangular ? environment.MipLevels() : 0; // Mips written here, none for a loaded env
+	const auto readbackSize = IrradianceShReadbackSize(environment);
+
+
+	// Views of single mips to write through
+	std::vector<VkImageView> envMipViews(envMips);
+	for (u32 mip = 0; mip < envMips; mip++)
+	{
+		envMipViews[mip] = CreateMipView(environment.Image(), environment.Format(), mip, device);
+	}
+	std::vector<VkImageView> prefilterMipViews(prefilter.MipLevels());
+	for (u32 mip = 0; mip < prefilter.MipLevels(); mip++)
+	{
+		prefilterMipViews[mip] = CreateMipView(prefilter.Image(), prefilter.Format(), mip, device);
+	}
+
+
+	// Sample sets read a sampled image and write a mip, downsample sets read one mip and write the next
+	auto* sampleSetLayout = vkh::CreateDescriptorSetLayout(device, {
+		vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+		vki::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT),
+		});
+	auto* downsampleSetLayout = vkh::CreateDescriptorSetLayout(device, {
+		vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT),
+		vki::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT),
+		});
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PrefilterPushConstants);
+	auto* samplePipelineLayout = vkh::CreatePipelineLayout(device, { sampleSetLayout }, { pushConstantRange });
+	auto* downsamplePipelineLayout = vkh::CreatePipelineLayout(device, { downsampleSetLayout });
+
+	const u32 sampleSetCount = (equirectangular ? 1 : 0) + prefilter.MipLevels();
+	const u32 downsampleSetCount = envMips > 0 ? envMips - 1 : 0;
+	auto* descPool = vkh::CreateDescriptorPool({
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampleSetCount },
+		VkDescriptorPoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, sampleSetCount + 2 * downsampleSetCount },
+		}, sampleSetCount + downsampleSetCount, device);
+
+	const auto storageImageInfo = [](VkImageView view) { return VkDescriptorImageInfo{ nullptr, view, VK_IMAGE_LAYOUT_GENERAL }; };
+
+
+	// Pipelines
+	VkPipeline equirectPipeline = nullptr;
+	VkPipeline downsamplePipeline = nullptr;
+	if (equirectangular)
+	{
+		equirectPipeline = CreateComputePipeline(shaderDir + "IblEquirectToCubemap.comp.spv", samplePipelineLayout, device, pipelineCache);
+		downsamplePipeline = CreateComputePipeline(shaderDir + "IblDownsampleCubemap.comp.spv", downsamplePipelineLayout, device, pipelineCache);
+	}
+	VkPipeline prefilterPipeline = CreateComputePipeline(shaderDir + "IblPrefilterCubemap.comp.spv", samplePipelineLayout, device, pipelineCache);
+
+
+	// Equirectangular source, staged as f32 and blitted to f16 so it can be filtered linearly
+	VkBuffer stagingBuffer = nullptr;
+	VkDeviceMemory stagingMemory = nullptr;
+	VkImage stagedImage = nullptr;
+	VkDeviceMemory stagedMemory = nullptr;
+	VkImage sourceImage = nullptr;
+	VkDeviceMemory sourceMemory = nullptr;
+	VkImageView sourceView = nullptr;
+	VkSampler sourceSampler = nullptr;
+	VkDescriptorSet equirectSet = nullptr;
+	std::vector<VkDescriptorSet> downsampleSets{};
+	if (equirectangular)
+	{
+		std::tie(stagingBuffer, stagingMemory) = vkh::CreateBuffer(equirectangular->DataSize(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, device, physicalDevice);
+
+		void* data;
+		vkMapMemory(device, stagingMemory, 0, equirectangular->DataSize(), 0, &data);
+		memcpy(data, equirectangular->Data().data(), equirectangular->DataSize());
+		vkUnmapMemory(device, stagingMemory);
+
+		std::tie(stagedImage, stagedMemory) = vkh::CreateImage2D(equirectangular->Width(), equirectangular->Height(), 1,
+			VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			physicalDevice, device);
+
+		std::tie(sourceImage, sourceMemory) = vkh::CreateImage2D(equirectangular->Width(), equirectangular->Height(), 1,
+			VK_SAMPLE_COUNT_1_BIT, StorageFormat, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			physicalDevice, device);
+
+		sourceView = vkh::CreateImage2DView(sourceImage, StorageFormat, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, device);
+		sourceSampler = vkh::CreateSampler(device, VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+			VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+
+		equirectSet = vkh::AllocateDescriptorSets(1, sampleSetLayout, descPool, device)[0];
+		const VkDescriptorImageInfo sourceInfo{ sourceSampler, sourceView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		const auto envTopInfo = storageImageInfo(envMipViews[0]);
+		vkh::UpdateDescriptorSet(device, {
+			vki::WriteDescriptorSet(equirectSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, 0, &sourceInfo),
+			vki::WriteDescriptorSet(equirectSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, 0, &envTopInfo),
+			});
+
+		downsampleSets = vkh::AllocateDescriptorSets(downsampleSetCount, downsampleSetLayout, descPool, device);
+		for (u32 mip = 1; mip < envMips; mip++)
+		{
+			const auto srcInfo = storageImageInfo(envMipViews[mip - 1]);
+			const auto dstInfo = storageImageInfo(envMipViews[mip]);
+			vkh::UpdateDescriptorSet(device, {
+				vki::WriteDescriptorSet(downsampleSets[mip - 1], 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, 0, &srcInfo),
+				vki::WriteDescriptorSet(downsampleSets[mip - 1], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, 0, &dstInfo),
+				});
+		}
+	}
+
+	auto prefilterSets = vkh::AllocateDescriptorSets(prefilter.MipLevels(), sampleSetLayout, descPool, device);
+	for (u32 mip = 0; mip < prefilter.MipLevels(); mip++)
+	{
+		const auto envInfo = environment.ImageInfo();
+		const auto dstInfo = storageImageInfo(prefilterMipViews[mip]);
+		vkh::UpdateDescriptorSet(device, {
+			vki::WriteDescriptorSet(prefilterSets[mip], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, 0, &envInfo),
+			vki::WriteDescriptorSet(prefilterSets[mip], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, 0, &dstInfo),
+			});
+	}
+
+
+	auto [readbackBuffer, readbackMemory] = vkh::CreateBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, device, physicalDevice);
+
+
+	// A timestamp before the first stage and after each one
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	const u64 timestampMask = TimestampMask(physicalDevice);
+	const bool timed = properties.limits.timestampComputeAndGraphics == VK_TRUE && timestampMask != 0;
+	constexpr u32 queryCount = (u32)Stage::Count + 1;
+
+	VkQueryPool queryPool = nullptr;
+	if (timed)
+	{
+		VkQueryPoolCreateInfo queryPoolCI = {};
+		queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = queryCount;
+		if (vkCreateQueryPool(device, &queryPoolCI, nullptr, &queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create timestamp query pool");
+		}
+	}
+
+
+	auto* cmdBuf = vkh::BeginSingleTimeCommands(pool, device);
+
+	const auto writeTimestamp = [&](u32 query, VkPipelineStageFlagBits stage)
+	{
+		if (timed)
+			vkCmdWriteTimestamp(cmdBuf, stage, queryPool, query);
+	};
+
+	if (timed)
+	{
+		vkCmdResetQueryPool(cmdBuf, queryPool, 0, queryCount);
+	}
+	writeTimestamp(0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+
+	// Upload
+	if (equirectangular)
+	{
+		const auto range = vki::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1);
+		vkh::TransitionImageLayout(cmdBuf, stagedImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+
+		const auto region = vki::BufferImageCopy(0, 0, 0,
+			vki::ImageSubresourceLayers(VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1),
+			vki::Offset3D(0, 0, 0), vki::Extent3D(equirectangular->Width(), equirectangular->Height(), 1));
+		vkCmdCopyBufferToImage(cmdBuf, stagingBuffer, stagedImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		vkh::TransitionImageLayout(cmdBuf, stagedImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, range);
+		vkh::TransitionImageLayout(cmdBuf, sourceImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+		vkh::BlitSrcToDstImage(cmdBuf, stagedImage, sourceImage, equirectangular->Width(), equirectangular->Height(), range);
+		vkh::TransitionImageLayout(cmdBuf, sourceImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+	}
+	writeTimestamp(1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+
+	// Environment top mip
+	if (equirectangular)
+	{
+		ImageBarrier(cmdBuf, environment.Image(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			0, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, envMips);
+
+		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, equirectPipeline);
+		vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, samplePipelineLayout, 0, 1, &equirectSet, 0, nullptr);
+		vkCmdDispatch(cmdBuf, GroupCount(environment.Width()), GroupCount(environment.Height()), 6);
+	}
+	writeTimestamp(2, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+
+	// Environment mips, each averaged from the one above
+	if (equirectangular)
+	{
+		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline);
+		for (u32 mip = 1; mip < envMips; mip++)
+		{
+			ImageBarrier(cmdBuf, environment.Image(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+				VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, mip - 1, 1);
+
+			vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipelineLayout, 0, 1, &downsampleSets[mip - 1], 0, nullptr);
+			vkCmdDispatch(cmdBuf, GroupCount(MipDim(environment.Width(), mip)), GroupCount(MipDim(environment.Height(), mip)), 6);
+		}
+
+		ImageBarrier(cmdBuf, environment.Image(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, envMips);
+	}
+	writeTimestamp(3, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+
+	// Prefilter, its mips only read the environment so run back to back
+	{
+		ImageBarrier(cmdBuf, prefilter.Image(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			0, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, prefilter.MipLevels());
+
+		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, prefilterPipeline);
+		for (u32 mip = 0; mip < prefilter.MipLevels(); mip++)
+		{
+			PrefilterPushConstants pushBlock{};
+			pushBlock.EnvMapResPerFace = (f32)environment.Width();
+			pushBlock.Roughness = prefilter.MipLevels() > 1 ? mip / f32(prefilter.MipLevels() - 1) : 0; // mip 0 = 0, max mip = 1
+			pushBlock.SampleCount = mip == 0 ? 1 : prefilterDesc.SampleCount; // Zero roughness always samples the normal
+
+			vkCmdPushConstants(cmdBuf, samplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushBlock), &pushBlock);
+			vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, samplePipelineLayout, 0, 1, &prefilterSets[mip], 0, nullptr);
+			vkCmdDispatch(cmdBuf, GroupCount(MipDim(prefilter.Width(), mip)), GroupCount(MipDim(prefilter.Height(), mip)), 6);
+		}
+
+		ImageBarrier(cmdBuf, prefilter.Image(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, prefilter.MipLevels());
+	}
+	writeTimestamp(4, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+
+	RecordIrradianceShReadback(cmdBuf, environment, readbackBuffer);
+	writeTimestamp(5, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+
+	SubmitAndWait(cmdBuf, pool, queue, device);
+
+
+	// Report
+	if (timed)
+	{
+		std::array<u64, queryCount> ticks{};
+		if (vkGetQueryPoolResults(device, queryPool, 0, queryCount, sizeof(ticks), ticks.data(), sizeof(u64),
+			VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+		{
+			for (u32 i = 0; i < (u32)Stage::Count; i++)
+			{
+				if (!equirectangular && Stage(i) < Stage::Prefilter)
+					continue;
+
+				// Bits above timestampValidBits are undefined, masking the difference also handles the counter wrapping
+				const u64 delta = (ticks[i + 1] - ticks[i]) & timestampMask;
+				const f64 ms = f64(delta) * properties.limits.timestampPeriod / 1e6;
+				std::cout << "  GPU " << StageName(Stage(i)) << " took " << ms << " ms\n";
+			}
+		}
+	}
+
+	void* mapped;
+	vkMapMemory(device, readbackMemory, 0, readbackSize, 0, &mapped);
+	const auto irradianceSh = ProjectIrradianceSh(environment, mapped);
+	vkUnmapMemory(device, readbackMemory);
+
+
+	// Cleanup
+	vkDestroyQueryPool(device, queryPool, nullptr);
+	vkDestroyBuffer(device, readbackBuffer, nullptr);
+	vkFreeMemory(device, readbackMemory, nullptr);
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingMemory, nullptr);
+	vkDestroyImage(device, stagedImage, nullptr);
+	vkFreeMemory(device, stagedMemory, nullptr);
+	vkDestroySampler(device, sourceSampler, nullptr);
+	vkDestroyImageView(device, sourceView, nullptr);
+	vkDestroyImage(device, sourceImage, nullptr);
+	vkFreeMemory(device, sourceMemory, nullptr);
+	vkDestroyPipeline(device, equirectPipeline, nullptr);
+	vkDestroyPipeline(device, downsamplePipeline, nullptr);
+	vkDestroyPipeline(device, prefilterPipeline, nullptr);
+	vkDestroyDescriptorPool(device, descPool, nullptr);
+	vkDestroyPipelineLayout(device, samplePipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, downsamplePipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, sampleSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, downsampleSetLayout, nullptr);
+	for (auto* view : envMipViews)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+	for (auto* view : prefilterMipViews)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+
+
+	const auto benchDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - benchStart).count();
+	std::cout << "Generating ibl maps with a " << prefilter.Width() << "px prefilter cubemap and "
+		<< prefilterDesc.SampleCount << " samples took " << benchDiff << " ms\n";
+
+	IblTextureResources iblRes
+	{
+		std::move(environment),
+		std::move(prefilter),
+		irradianceSh,
+	};
+	return iblRes;
+}
+
+TextureResource IblGenerator::CreateCubemap(u32 dim, u32 mipLevels, VkPhysicalDevice physicalDevice, VkDevice device)
+{
+	const u32 layerCount = 6;
+
+	auto [image, memory] = vkh::CreateImage2D(dim, dim, mipLevels,
+		VK_SAMPLE_COUNT_1_BIT,
+		StorageFormat,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		physicalDevice, device, layerCount, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+
+	auto* view = vkh::CreateImage2DView(image, StorageFormat, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_ASPECT_COLOR_BIT,
+		mipLevels, layerCount, device);
+
+	// Trilinear over the whole chain, the prefilter picks env mips by each sample's footprint
+	auto* sampler = vkh::CreateSampler(device, VK_FILTER_LINEAR, VK_FILTER_LINEAR,
+		VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		false, 1, 0, (f32)mipLevels, VK_SAMPLER_MIPMAP_MODE_LINEAR);
+
+	return TextureResource(device, dim, dim, mipLevels, layerCount, image, memory, view, sampler, StorageFormat,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+VkImageView IblGenerator::CreateMipView(VkImage image, VkFormat format, u32 mip, VkDevice device)
+{
+	VkImageViewCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	createInfo.image = image;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY; // Storage images can't be cubes
+	createInfo.format = format;
+	createInfo.subresourceRange = vki::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 6);
+
+	VkImageView view;
+	if (vkCreateImageView(device, &createInfo, nullptr, &view) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create cubemap mip view");
+	}
+	return view;
+}
+
+VkPipeline IblGenerator::CreateComputePipeline(const std::string& shaderPath, VkPipelineLayout layout, VkDevice device,
+	PipelineCache& pipelineCache)
+{
+	VkPipelineShaderStageCreateInfo shaderStageInfo = {};
+	shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderStageInfo.module = vkh::CreateShaderModule(FileService::ReadFile(shaderPath), device);
+	shaderStageInfo.pName = "main";
+
+	VkComputePipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	createInfo.layout = layout;
+	createInfo.stage = shaderStageInfo;
+
+	VkPipeline pipeline = nullptr;
+	if (pipelineCache.CreateComputePipeline(createInfo, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create compute pipeline: " + shaderPath);
+	}
+
+	vkDestroyShaderModule(device, shaderStageInfo.module, nullptr);
+
+	return pipeline;
+}
+
+void IblGenerator::ImageBarrier(VkCommandBuffer cmdBuf, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+	u32 baseMip, u32 mipCount)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = vki::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, baseMip, mipCount, 0, 6);
+
+	vkCmdPipelineBarrier(cmdBuf, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+u32 IblGenerator::IrradianceShMip(const TextureResource& environment)
+{
+	// Maps without a mip chain are read at full size
+	u32 mip = 0;
+	while (mip + 1 < environment.MipLevels() && (environment.Width() >> (mip + 1)) >= IrradianceShFaceDim)
+	{
+		mip++;
+	}
+	return mip;
+}
+
+VkDeviceSize IblGenerator::IrradianceShReadbackSize(const TextureResource& environment)
+{
+	const auto format = environment.Format();
+	if (format != VK_FORMAT_R16G16B16A16_SFLOAT && format != VK_FORMAT_R32G32B32A32_SFLOAT)
+	{
+		throw std::runtime_error("Unsupported environment map format for irradiance projection");
+	}
+
+	const u32 dim = MipDim(environment.Width(), IrradianceShMip(environment));
+	const VkDeviceSize texelSize = format == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 16;
+	return 6 * (VkDeviceSize)dim * dim * texelSize;
+}
+
+void IblGenerator::RecordIrradianceShReadback(VkCommandBuffer cmdBuf, const TextureResource& environment, VkBuffer buffer)
+{
+	const u32 mip = IrradianceShMip(environment);
+	const u32 dim = MipDim(environment.Width(), mip);
+	const auto range = vki::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 6);
+
+	vkh::TransitionImageLayout(cmdBuf, environment.Image(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, range);
+
+	// Faces land one after another
+	const auto region = vki::BufferImageCopy(0, 0, 0,
+		vki::ImageSubresourceLayers(VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 6),
+		vki::Offset3D(0, 0, 0), vki::Extent3D(dim, dim, 1));
+	vkCmdCopyImageToBuffer(cmdBuf, environment.Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+	vkh::TransitionImageLayout(cmdBuf, environment.Image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+
+	// Make the copy visible to the host once the fence signals
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+ShIrradiance::Coefficients IblGenerator::ProjectIrradianceSh(const TextureResource& environment, const void* readback)
+{
+	const auto benchStart = std::chrono::high_resolution_clock::now();
+
+	const bool halfFloat = environment.Format() == VK_FORMAT_R16G16B16A16_SFLOAT;
+	const u32 dim = MipDim(environment.Width(), IrradianceShMip(environment));
+	const size_t faceTexels = (size_t)dim * dim;
+
+	ShIrradiance projection{};
+	std::vector<glm::vec4> texels(faceTexels);
+	for (u32 face = 0; face < 6; face++)
+	{
+		if (halfFloat)
+		{
+			const auto* packed = (const u32*)readback + face * faceTexels * 2;
+			for (size_t i = 0; i < faceTexels; i++)
+			{
+				texels[i] = glm::vec4(glm::unpackHalf2x16(packed[2 * i]), glm::unpackHalf2x16(packed[2 * i + 1]));
+			}
+		}
+		else
+		{
+			std::memcpy(texels.data(), (const glm::vec4*)readback + face * faceTexels, faceTexels * sizeof(glm::vec4));
+		}
+
+		projection.AddFace(face, texels.data(), dim);
+	}
+
+	const auto benchDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - benchStart).count();
+	std::cout << "Projecting irradiance sh from " << dim << "px faces took " << benchDiff << " ms\n";
+
+	return projection.Irradiance();
+}
+
+void IblGenerator::SubmitAndWait(VkCommandBuffer cmdBuf, VkCommandPool pool, VkQueue queue, VkDevice device)
+{
+	if (vkEndCommandBuffer(cmdBuf) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to end recording command buffer");
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create fence");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmdBuf;
+
+	const auto result = vkQueueSubmit(queue, 1, &submitInfo, fence);
+	if (result == VK_SUCCESS)
+	{
+		vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	}
+
+	vkDestroyFence(device, fence, nullptr);
+	vkFreeCommandBuffers(device, pool, 1, &cmdBuf);
+
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to submit ibl generation");
+	}
+}
+
+u64 IblGenerator::TimestampMask(VkPhysicalDevice physicalDevice)
+{
+	// Generation runs on a graphics and compute queue, use the fewest valid bits of any such family. 0 means untimed.
+	u32 queueFamilyCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies{ queueFamilyCount };
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	u32 validBits = 64;
+	for (const auto& family : queueFamilies)
+	{
+		if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT && family.queueFlags & VK_QUEUE_COMPUTE_BIT)
+		{
+			validBits = std::min(validBits, family.timestampValidBits);
+		}
+	}
+
+	return validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+}
+
+const char* IblGenerator::StageName(Stage stage)
+{
+	switch (stage)
+	{
+	case Stage::Upload: return "equirectangular upload";
+	case Stage::Environment: return "environment cubemap";
+	case Stage::EnvironmentMips: return "environment mips";
+	case Stage::Prefilter: return "prefilter convolution";
+	case Stage::Readback: return "irradiance readback";
+	case Stage::Count: break;
+	}
+	return "?";
+}
@@ -0,0 +1,154 @@
+#include "Renderer/HighLevel/LightClusters.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+f32 LightClusters::LightRange(const Light& light)
+{
+	const f32 peak = light.Intensity * std::max({ light.Color.r, light.Color.g, light.Color.b });
+	return peak > Cutoff ? std::sqrt(peak / Cutoff) : 0.f;
+}
+
+void LightClusters::Build(const std::vector<Light>& lights, const BuildInfo& info)
+{
+	assert(info.Near > 0 && info.Far > info.Near && info.Width > 0 && info.Height > 0);
+
+	_lights.clear();
+	_lightIndices.clear();
+	_spans.clear();
+	_clusters.assign(ClusterCount, GpuCluster{ 0, 0 });
+	_truncated = false;
+
+	const f32 logDepthRange = std::log(info.Far / info.Near);
+	const glm::mat4& view = info.View;
+
+	_header = {};
+	_header.ViewDepthRow = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]); // View space looks down -Z
+	_header.TileScale = { TilesX / (f32)info.Width, TilesY / (f32)info.Height };
+	_header.SliceScale = Slices / logDepthRange;
+	_header.SliceBias = -(f32)Slices * std::log(info.Near) / logDepthRange;
+
+	auto SliceOf = [&](f32 depth)
+	{
+		const f32 slice = std::floor(std::log(depth) * _header.SliceScale + _header.SliceBias);
+		return (u32)std::clamp(slice, 0.f, f32(Slices - 1));
+	};
+	auto SliceDepth = [&](u32 slice) { return info.Near * std::exp(logDepthRange * slice / Slices); };
+
+	// NDC [-1,1] to a tile, clamped to the grid
+	auto TileOf = [](f32 ndc, u32 tiles)
+	{
+		const f32 tile = std::floor((ndc + 1.f) * 0.5f * tiles);
+		return (u16)std::clamp(tile, 0.f, f32(tiles - 1));
+	};
+
+
+	// Directional lights apply everywhere
+	for (const auto& light : lights)
+	{
+		if (light.Type != Light::LightType::Directional || light.Intensity < 0.01f)
+			continue;
+		if (_lights.size() >= info.MaxLights)
+		{
+			_truncated = true;
+			break;
+		}
+		_lights.push_back(GpuLight{ glm::vec4(light.Color, light.Intensity), glm::vec4(light.Pos, 0) });
+	}
+	_header.DirectionalCount = (u32)_lights.size();
+
+
+	// Point lights are clipped to the depth range, then each slice they overlap gets the tile rect of their bounding
+	// box's depth span within it. x/d is monotonic in both x and d, so the box corners bound the projection.
+	const f32 scaleX = info.Projection[0][0];
+	const f32 scaleY = info.Projection[1][1];
+
+	for (const auto& light : lights)
+	{
+		if (light.Type != Light::LightType::Point)
+			continue;
+
+		const f32 range = LightRange(light);
+		const glm::vec3 center = view * glm::vec4(light.Pos, 1);
+		const f32 minDepth = std::max(-center.z - range, info.Near);
+		const f32 maxDepth = std::min(-center.z + range, info.Far);
+		if (range <= 0.f || minDepth >= maxDepth)
+			continue;
+
+		if (_lights.size() >= info.MaxLights)
+		{
+			_truncated = true;
+			break;
+		}
+
+		const u32 lightIndex = (u32)_lights.size();
+		const size_t firstSpan = _spans.size();
+
+		for (u32 slice = SliceOf(minDepth), lastSlice = SliceOf(maxDepth); slice <= lastSlice; slice++)
+		{
+			const f32 nearDepth = std::max(minDepth, SliceDepth(slice));
+			const f32 farDepth = std::min(maxDepth, SliceDepth(slice + 1));
+			if (nearDepth > farDepth)
+				continue;
+
+			const f32 xs[] = { scaleX * (center.x - range) / nearDepth, scaleX * (center.x - range) / farDepth,
+				scaleX * (center.x + range) / nearDepth, scaleX * (center.x + range) / farDepth };
+			const f32 ys[] = { scaleY * (center.y - range) / nearDepth, scaleY * (center.y - range) / farDepth,
+				scaleY * (center.y + range) / nearDepth, scaleY * (center.y + range) / farDepth };
+			const auto [minX, maxX] = std::minmax_element(std::begin(xs), std::end(xs));
+			const auto [minY, maxY] = std::minmax_element(std::begin(ys), std::end(ys));
+			if (*maxX < -1.f || *minX > 1.f || *maxY < -1.f || *minY > 1.f)
+				continue;
+
+			const Span span{ lightIndex, (u16)slice, TileOf(*minX, TilesX), TileOf(*maxX, TilesX), TileOf(*minY, TilesY),
+				TileOf(*maxY, TilesY) };
+			for (u32 y = span.MinY; y <= span.MaxY; y++)
+			{
+				for (u32 x = span.MinX; x <= span.MaxX; x++)
+				{
+					_clusters[ClusterIndex(x, y, slice)].Count++;
+				}
+			}
+			_spans.push_back(span);
+		}
+
+		if (_spans.size() > firstSpan)
+		{
+			_lights.push_back(GpuLight{ glm::vec4(light.Color, light.Intensity), glm::vec4(light.Pos, range) });
+		}
+	}
+	_header.PointCount = (u32)_lights.size() - _header.DirectionalCount;
+
+
+	// Lay the lists out back to back. Clusters past the index capacity lose their tail.
+	u32 offset = 0;
+	for (auto& cluster : _clusters)
+	{
+		const u32 count = std::min(cluster.Count, info.MaxLightIndices - offset);
+		_truncated |= count < cluster.Count;
+		cluster = GpuCluster{ offset, 0 };
+		offset += count;
+	}
+	_lightIndices.resize(offset);
+
+	// Fill in light order, so each list is sorted. Count is the fill cursor and ends as the list's length.
+	for (const auto& span : _spans)
+	{
+		for (u32 y = span.MinY; y <= span.MaxY; y++)
+		{
+			for (u32 x = span.MinX; x <= span.MaxX; x++)
+			{
+				auto& cluster = _clusters[ClusterIndex(x, y, span.Slice)];
+				const u32 end = (&cluster == &_clusters.back() ? offset : (&cluster + 1)->Offset);
+				if (cluster.Offset + cluster.Count < end)
+				{
+					_lightIndices[cluster.Offset + cluster.Count++] = span.Light;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,525 @@
+#include "Renderer/HighLevel/RenderPasses/SceneRenderPass.h"
+
+#include "Renderer/HighLevel/ResourceRegistry.h"
+#include "Renderer/LowLevel/InstanceBuffer.h"
+#include "Renderer/LowLevel/VulkanHelpers.h"
+#include "Renderer/LowLevel/VulkanInitializers.h"
+#include "Renderer/LowLevel/VulkanService.h"
+
+#include <Framework/FileService.h>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+using vkh = VulkanHelpers;
+
+namespace
+{
+	constexpr VkBufferUsageFlags StorageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	constexpr VkBufferUsageFlags IndirectUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	constexpr VkMemoryPropertyFlags HostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+SceneRenderPass::SceneRenderPass(VulkanService& vk, const ResourceRegistry* registry, InstanceBuffer& instanceBuffer,
+	const std::string& shaderDir, u32 numImagesInFlight)
+	: _vk(&vk), _resourceRegistry(registry), _instanceBuffer(&instanceBuffer)
+{
+	auto* device = _vk->LogicalDevice();
+
+	// Match the bindings in SceneCull.comp and SceneCompact.comp
+	_descriptorSetLayout = vkh::CreateDescriptorSetLayout(device, {
+		vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT), // Objects
+		vki::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT), // Bucket draws
+		vki::DescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT), // Draws
+		vki::DescriptorSetLayoutBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT), // Compacted draws
+		vki::DescriptorSetLayoutBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT), // Counters
+		vki::DescriptorSetLayoutBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT), // Instances
+	});
+	_descriptorPool = vkh::CreateDescriptorPool({ {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * numImagesInFlight} },
+		numImagesInFlight, device);
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+	_pipelineLayout = vkh::CreatePipelineLayout(device, { _descriptorSetLayout }, { pushConstantRange });
+
+	_cullPipeline = CreateComputePipeline(shaderDir + "SceneCull.comp.spv");
+	_compactPipeline = CreateComputePipeline(shaderDir + "SceneCompact.comp.spv");
+
+	const auto descriptorSets = vkh::AllocateDescriptorSets(numImagesInFlight, _descriptorSetLayout, _descriptorPool, device);
+	_frames.resize(numImagesInFlight);
+	for (u32 i = 0; i < numImagesInFlight; i++)
+	{
+		_frames[i].DescriptorSet = descriptorSets[i];
+		CreateFrameResources(_frames[i]);
+	}
+}
+
+SceneRenderPass::~SceneRenderPass()
+{
+	auto* device = _vk->LogicalDevice();
+
+	for (auto& frame : _frames)
+	{
+		DestroyFrameResources(frame);
+	}
+
+	vkDestroyPipeline(device, _compactPipeline, nullptr);
+	vkDestroyPipeline(device, _cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, _pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(device, _descriptorPool, nullptr); // Frees the sets
+	vkDestroyDescriptorSetLayout(device, _descriptorSetLayout, nullptr);
+}
+
+void SceneRenderPass::BeginFrame(u32 frameIndex, const Frustum& cameraFrustum, const glm::vec3& cameraPosition,
+	const std::vector<std::optional<Frustum>>& shadowFrusta)
+{
+	assert(frameIndex < (u32)_frames.size());
+	assert(shadowFrusta.size() <= ShadowCascades::MaxCascades);
+	_frameIndex = frameIndex;
+	_frameStamp++;
+
+	auto& frame = _frames[frameIndex];
+	if (frame.Culled)
+	{
+		const auto* counters = (const u32*)frame.Counters.Allocation.Mapped;
+		std::copy_n(counters, ViewCount, _visibleCounts.begin());
+		frame.Culled = false;
+	}
+	frame.ObjectCount = 0;
+	frame.DrawCount = 0;
+
+	_cameraPosition = cameraPosition;
+	_frusta[(u32)View::Camera] = cameraFrustum;
+	for (u32 cascade = 0; cascade < ShadowCascades::MaxCascades; cascade++)
+	{
+		_frusta[(u32)ShadowView(cascade)] = cascade < shadowFrusta.size() ? shadowFrusta[cascade] : std::nullopt;
+	}
+	for (u32 view = 0; view < ViewCount; view++)
+	{
+		_activeBuckets[view].clear();
+		_drawGroups[view].clear();
+	}
+
+	// Shadow bucket runs are sized by the cascade count. Stale buckets cost nothing per frame, only table space, so
+	// they're checked for now and then.
+	const bool checkStale = _frameStamp % StaleBucketFrames == 0;
+	if (shadowFrusta.size() != _shadowCascadeCount || (checkStale && MostBucketsStale()))
+	{
+		ResetBuckets();
+		_shadowCascadeCount = (u32)shadowFrusta.size();
+	}
+}
+
+void SceneRenderPass::Add(const glm::mat4& transform, const AABB& worldBounds, MeshResourceId meshId, const Material* material)
+{
+	auto& frame = _frames[_frameIndex];
+	if (frame.ObjectCount >= frame.Objects.Capacity)
+	{
+		GrowBuffer(frame, frame.Objects, frame.ObjectCount + 1, sizeof(GpuObject), StorageUsage, HostVisible,
+			frame.ObjectCount);
+	}
+
+	if (meshId.Value() >= (u32)_meshBuckets.size())
+	{
+		_meshBuckets.resize(meshId.Value() + 1);
+	}
+	auto& meshBuckets = _meshBuckets[meshId.Value()];
+
+	GpuObject object;
+	object.Transform = transform;
+	object.BoundsMin = worldBounds.Min();
+	object.BoundsMax = worldBounds.Max();
+	object.CameraBucket = material ? Touch(CameraBucket(meshBuckets, meshId, *material)) : NoBucket;
+	if (object.CameraBucket != NoBucket)
+	{
+		// Closest point of the bounds, or the origin when they're unknown
+		const glm::vec3 nearest = worldBounds.IsEmpty()
+			? glm::vec3{ transform[3] }
+			: glm::clamp(_cameraPosition, object.BoundsMin, object.BoundsMax);
+		const glm::vec3 delta = nearest - _cameraPosition;
+		auto& bucket = _buckets[object.CameraBucket];
+		bucket.NearestDistSquared = std::min(bucket.NearestDistSquared, glm::dot(delta, delta));
+	}
+	object.ShadowBucket = _shadowCascadeCount > 0 ? ShadowBucket(meshBuckets, meshId) : NoBucket;
+	for (u32 cascade = 0; cascade < _shadowCascadeCount; cascade++)
+	{
+		if (_frusta[(u32)ShadowView(cascade)])
+		{
+			Touch(object.ShadowBucket + cascade);
+		}
+		else
+		{
+			_buckets[object.ShadowBucket + cascade].LastUsed = _frameStamp; // Tile is kept, the caster still counts
+		}
+	}
+
+	// One sequential write into write-combined memory
+	memcpy((GpuObject*)frame.Objects.Allocation.Mapped + frame.ObjectCount, &object, sizeof(GpuObject));
+	frame.ObjectCount++;
+}
+
+void SceneRenderPass::Finalize()
+{
+	auto& frame = _frames[_frameIndex];
+
+	// Every active bucket is a draw and at most a group, the counters hold one per group after the views'
+	u32 drawCount = 0;
+	for (const auto& active : _activeBuckets)
+	{
+		drawCount += (u32)active.size();
+	}
+	if (_buckets.size() > frame.BucketDraws.Capacity)
+	{
+		GrowBuffer(frame, frame.BucketDraws, (u32)_buckets.size(), sizeof(u32), StorageUsage, HostVisible, 0);
+	}
+	if (drawCount > frame.Draws.Capacity)
+	{
+		GrowBuffer(frame, frame.Draws, drawCount, sizeof(GpuDrawCommand), IndirectUsage, HostVisible, 0);
+		GrowBuffer(frame, frame.CompactedDraws, drawCount, sizeof(GpuDrawCommand), IndirectUsage,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+	}
+	if (ViewCount + drawCount > frame.Counters.Capacity)
+	{
+		GrowBuffer(frame, frame.Counters, ViewCount + drawCount, sizeof(u32), IndirectUsage, HostVisible, 0);
+	}
+
+	auto* draws = (GpuDrawCommand*)frame.Draws.Allocation.Mapped;
+	auto* bucketDraws = (u32*)frame.BucketDraws.Allocation.Mapped;
+	u32 groupCount = 0;
+
+	for (u32 view = 0; view < ViewCount; view++)
+	{
+		auto& active = _activeBuckets[view];
+		auto& groups = _drawGroups[view];
+
+		// Neighbouring buckets with the same bindings and material share a group
+		std::sort(active.begin(), active.end(), [this](u32 a, u32 b)
+		{
+			const auto& ba = _buckets[a];
+			const auto& bb = _buckets[b];
+			return std::tie(ba.IndexBuffer, ba.IndexType, ba.Material) < std::tie(bb.IndexBuffer, bb.IndexType, bb.Material);
+		});
+
+		for (const u32 bucketIndex : active)
+		{
+			const auto& bucket = _buckets[bucketIndex];
+			const u32 drawIndex = frame.DrawCount++;
+			bucketDraws[bucketIndex] = drawIndex;
+
+			if (groups.empty() || groups.back().IndexBuffer != bucket.IndexBuffer ||
+				groups.back().IndexType != bucket.IndexType || groups.back().Material != bucket.Material)
+			{
+				DrawGroup group{};
+				group.PositionBuffer = bucket.PositionBuffer;
+				group.AttributeBuffer = bucket.AttributeBuffer;
+				group.IndexBuffer = bucket.IndexBuffer;
+				group.IndexType = bucket.IndexType;
+				group.Material = bucket.Material;
+				group.FirstDraw = drawIndex;
+				group.CounterIndex = ViewCount + groupCount++;
+				groups.emplace_back(group);
+			}
+			auto& group = groups.back();
+			group.DrawCount++;
+			group.NearestDistSquared = group.DrawCount == 1
+				? bucket.NearestDistSquared
+				: std::min(group.NearestDistSquared, bucket.NearestDistSquared);
+
+			// Room for every object in the bucket, the cull shader fills the front of it
+			GpuDrawCommand draw{};
+			draw.Command.indexCount = bucket.IndexCount;
+			draw.Command.instanceCount = 0;
+			draw.Command.firstIndex = bucket.FirstIndex;
+			draw.Command.vertexOffset = bucket.VertexOffset;
+			draw.Command.firstInstance = _instanceBuffer->Reserve(bucket.InstanceCount);
+			draw.Group = group.CounterIndex - ViewCount;
+			draw.GroupFirstDraw = group.FirstDraw;
+			memcpy(draws + drawIndex, &draw, sizeof(GpuDrawCommand));
+		}
+
+		// Front to back gives early depth testing the most to reject. Groups are self contained, so order is free.
+		if (view == (u32)View::Camera)
+		{
+			std::sort(groups.begin(), groups.end(), [](const DrawGroup& a, const DrawGroup& b)
+			{
+				return a.NearestDistSquared < b.NearestDistSquared;
+			});
+		}
+	}
+
+	memset(frame.Counters.Allocation.Mapped, 0, sizeof(u32) * (ViewCount + groupCount));
+}
+
+void SceneRenderPass::Cull(VkCommandBuffer commandBuffer)
+{
+	auto& frame = _frames[_frameIndex];
+	if (frame.DrawCount == 0)
+	{
+		return;
+	}
+
+	// Not bound since the GPU finished with the frame, so it can be rewritten here
+	if (frame.DescriptorsStale)
+	{
+		WriteDescriptorSet(frame, _frameIndex);
+		frame.DescriptorsStale = false;
+	}
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &frame.DescriptorSet, 0, nullptr);
+
+	for (u32 view = 0; view < ViewCount; view++)
+	{
+		if (_drawGroups[view].empty())
+			continue;
+
+		PushConstants pushConstants{};
+		pushConstants.Planes = _frusta[view]->Planes();
+		pushConstants.Count = frame.ObjectCount;
+		pushConstants.View = view;
+		vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (frame.ObjectCount + WorkgroupSize - 1) / WorkgroupSize, 1, 1);
+	}
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	// Without draw indirect count the uncompacted draws are used directly
+	if (_vk->CmdDrawIndexedIndirectCount())
+	{
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+
+		PushConstants pushConstants{};
+		pushConstants.Count = frame.DrawCount;
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _compactPipeline);
+		vkCmdPushConstants(commandBuffer, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+		vkCmdDispatch(commandBuffer, (frame.DrawCount + WorkgroupSize - 1) / WorkgroupSize, 1, 1);
+	}
+
+	// Draws and instance transforms are consumed by the passes, visible counts are read back by the host
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+		1, &barrier, 0, nullptr, 0, nullptr);
+
+	frame.Culled = true;
+}
+
+void SceneRenderPass::DrawIndirect(VkCommandBuffer commandBuffer, const DrawGroup& group) const
+{
+	const auto& frame = _frames[_frameIndex];
+	const VkDeviceSize offset = group.FirstDraw * sizeof(GpuDrawCommand);
+
+	if (auto* drawIndexedIndirectCount = _vk->CmdDrawIndexedIndirectCount())
+	{
+		drawIndexedIndirectCount(commandBuffer, frame.CompactedDraws.Buffer, offset,
+			frame.Counters.Buffer, group.CounterIndex * sizeof(u32), group.DrawCount, sizeof(GpuDrawCommand));
+	}
+	else
+	{
+		vkCmdDrawIndexedIndirect(commandBuffer, frame.Draws.Buffer, offset, group.DrawCount, sizeof(GpuDrawCommand));
+	}
+}
+
+u32 SceneRenderPass::CameraBucket(MeshBuckets& meshBuckets, MeshResourceId meshId, const Material& material)
+{
+	if (meshBuckets.LastMaterial != &material || meshBuckets.LastCamera == NoBucket)
+	{
+		const auto [it, inserted] = _cameraBucketLookup.try_emplace(BucketKey{ meshId.Value(), &material }, NoBucket);
+		if (inserted)
+		{
+			it->second = CreateBucket(View::Camera, meshId, &material);
+		}
+		meshBuckets.LastMaterial = &material;
+		meshBuckets.LastCamera = it->second;
+	}
+
+	return meshBuckets.LastCamera;
+}
+
+u32 SceneRenderPass::ShadowBucket(MeshBuckets& meshBuckets, MeshResourceId meshId)
+{
+	if (meshBuckets.Shadow == NoBucket)
+	{
+		meshBuckets.Shadow = CreateBucket(ShadowView(0), meshId, nullptr);
+		for (u32 cascade = 1; cascade < _shadowCascadeCount; cascade++)
+		{
+			CreateBucket(ShadowView(cascade), meshId, nullptr);
+		}
+	}
+
+	return meshBuckets.Shadow;
+}
+
+u32 SceneRenderPass::CreateBucket(View view, MeshResourceId meshId, const Material* material)
+{
+	const auto& mesh = _resourceRegistry->GetMesh(meshId);
+
+	Bucket bucket{};
+	bucket.BucketView = view;
+	bucket.Material = material;
+	bucket.PositionBuffer = mesh.VertexBuffer;
+	bucket.AttributeBuffer = mesh.AttributeBuffer;
+	bucket.IndexBuffer = mesh.IndexBuffer;
+	bucket.IndexType = mesh.IndexType;
+	bucket.IndexCount = (u32)mesh.IndexCount;
+	bucket.FirstIndex = mesh.FirstIndex;
+	bucket.VertexOffset = mesh.VertexOffset;
+	bucket.LastUsed = _frameStamp;
+
+	_buckets.emplace_back(bucket);
+	return (u32)_buckets.size() - 1;
+}
+
+u32 SceneRenderPass::Touch(u32 bucketIndex)
+{
+	auto& bucket = _buckets[bucketIndex];
+	if (bucket.FrameStamp != _frameStamp)
+	{
+		bucket.FrameStamp = _frameStamp;
+		bucket.LastUsed = _frameStamp;
+		bucket.InstanceCount = 0;
+		bucket.NearestDistSquared = FLT_MAX;
+		_activeBuckets[(u32)bucket.BucketView].push_back(bucketIndex);
+	}
+	bucket.InstanceCount++;
+
+	return bucketIndex;
+}
+
+bool SceneRenderPass::MostBucketsStale() const
+{
+	u32 staleCount = 0;
+	for (const auto& bucket : _buckets)
+	{
+		if (_frameStamp - bucket.LastUsed > StaleBucketFrames)
+		{
+			staleCount++;
+		}
+	}
+	return staleCount * 2 > (u32)_buckets.size();
+}
+
+void SceneRenderPass::ResetBuckets()
+{
+	_buckets.clear();
+	_meshBuckets.clear();
+	_cameraBucketLookup.clear();
+}
+
+void SceneRenderPass::CreateFrameResources(FrameResources& frame) const
+{
+	CreateGrowableBuffer(frame.Objects, InitialObjectCapacity, sizeof(GpuObject), StorageUsage, HostVisible);
+	CreateGrowableBuffer(frame.BucketDraws, InitialDrawCapacity, sizeof(u32), StorageUsage, HostVisible);
+	CreateGrowableBuffer(frame.Draws, InitialDrawCapacity, sizeof(GpuDrawCommand), IndirectUsage, HostVisible);
+	CreateGrowableBuffer(frame.CompactedDraws, InitialDrawCapacity, sizeof(GpuDrawCommand), IndirectUsage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	CreateGrowableBuffer(frame.Counters, ViewCount + InitialDrawCapacity, sizeof(u32), IndirectUsage, HostVisible);
+	frame.DescriptorsStale = true;
+}
+
+void SceneRenderPass::DestroyFrameResources(FrameResources& frame) const
+{
+	DestroyGrowableBuffer(frame.Objects);
+	DestroyGrowableBuffer(frame.BucketDraws);
+	DestroyGrowableBuffer(frame.Draws);
+	DestroyGrowableBuffer(frame.CompactedDraws);
+	DestroyGrowableBuffer(frame.Counters);
+	frame = {};
+}
+
+void SceneRenderPass::CreateGrowableBuffer(GrowableBuffer& buffer, u32 capacity, VkDeviceSize elementSize,
+	VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) const
+{
+	std::tie(buffer.Buffer, buffer.Allocation) = vkh::CreateBuffer(elementSize * capacity, usage, properties,
+		_vk->MemoryAllocator(), _vk->LogicalDevice());
+	buffer.Capacity = capacity;
+
+	assert(buffer.Allocation.Mapped || !(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+}
+
+void SceneRenderPass::DestroyGrowableBuffer(GrowableBuffer& buffer) const
+{
+	vkDestroyBuffer(_vk->LogicalDevice(), buffer.Buffer, nullptr);
+	_vk->MemoryAllocator().Free(buffer.Allocation);
+	buffer = {};
+}
+
+// Caller guarantees the GPU is done with the frame. At least doubles, so a growing scene only recreates a handful of
+// times. The first keepElements are copied over.
+void SceneRenderPass::GrowBuffer(FrameResources& frame, GrowableBuffer& buffer, u32 required, VkDeviceSize elementSize,
+	VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, u32 keepElements) const
+{
+	GrowableBuffer grown{};
+	CreateGrowableBuffer(grown, std::max(required, buffer.Capacity * 2), elementSize, usage, properties);
+	if (keepElements > 0)
+	{
+		memcpy(grown.Allocation.Mapped, buffer.Allocation.Mapped, elementSize * keepElements);
+	}
+
+	DestroyGrowableBuffer(buffer);
+	buffer = grown;
+	frame.DescriptorsStale = true;
+}
+
+void SceneRenderPass::WriteDescriptorSet(const FrameResources& frame, u32 frameIndex) const
+{
+	const std::array<VkBuffer, 6> buffers = {
+		frame.Objects.Buffer,
+		frame.BucketDraws.Buffer,
+		frame.Draws.Buffer,
+		frame.CompactedDraws.Buffer,
+		frame.Counters.Buffer,
+		_instanceBuffer->Buffer(frameIndex),
+	};
+
+	std::array<VkDescriptorBufferInfo, 6> bufferInfos{};
+	std::vector<VkWriteDescriptorSet> writes{};
+	for (u32 i = 0; i < (u32)buffers.size(); i++)
+	{
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+		writes.emplace_back(vki::WriteDescriptorSet(frame.DescriptorSet, i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, 0,
+			nullptr, &bufferInfos[i]));
+	}
+	vkh::UpdateDescriptorSet(_vk->LogicalDevice(), writes);
+}
+
+VkPipeline SceneRenderPass::CreateComputePipeline(const std::string& shaderPath) const
+{
+	auto* device = _vk->LogicalDevice();
+
+	VkPipelineShaderStageCreateInfo shaderStageInfo = {};
+	shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shaderStageInfo.module = vkh::CreateShaderModule(FileService::ReadFile(shaderPath), device);
+	shaderStageInfo.pName = "main";
+
+	VkComputePipelineCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	createInfo.layout = _pipelineLayout;
+	createInfo.stage = shaderStageInfo;
+
+	VkPipeline pipeline = nullptr;
+	if (_vk->GetPipelineCache().CreateComputePipeline(createInfo, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create compute pipeline: " + shaderPath);
+	}
+
+	vkDestroyShaderModule(device, shaderStageInfo.module, nullptr);
+
+	return pipeline;
+}
@@ -0,0 +1,78 @@
+#include "Renderer/HighLevel/RenderQueue.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+
+
+namespace
+{
+	// Non-negative floats order the same as their bit patterns
+	u32 DepthBits(f32 depth)
+	{
+		assert(depth >= 0.f);
+		u32 bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return depth > 0.f ? bits : 0; // Folds -0 into 0
+	}
+
+	u64 Field(u32 value, u32 bits, u32 shift)
+	{
+		return (u64(value) & ((1ull << bits) - 1)) << shift;
+	}
+}
+
+u64 RenderQueue::OpaqueKey(u32 pipeline, u32 material, u32 geometry, f32 depthSquared)
+{
+	return Field((u32)Pass::Opaque, 2, 62)
+		| Field(pipeline, 4, 58)
+		| Field(material, 16, 42)
+		| Field(geometry, 16, 26)
+		| Field(DepthBits(depthSquared) >> 6, 26, 0);
+}
+
+u64 RenderQueue::TransparentKey(u32 pipeline, u32 material, u32 geometry, f32 depthSquared)
+{
+	// Inverted so the furthest sorts first
+	return Field((u32)Pass::Transparent, 2, 62)
+		| Field(~DepthBits(depthSquared), 32, 30)
+		| Field(pipeline, 4, 26)
+		| Field(material, 16, 10)
+		| Field(geometry, 10, 0);
+}
+
+void RenderQueue::Sort()
+{
+	const size_t count = _entries.size();
+	if (count < 2)
+		return;
+
+	_scratch.resize(count);
+
+	for (u32 shift = 0; shift < 64; shift += 8)
+	{
+		std::array<size_t, 256> offsets{};
+		for (const auto& entry : _entries)
+		{
+			offsets[(entry.Key >> shift) & 0xFF]++;
+		}
+
+		// Every key shares this byte, the pass wouldn't move anything
+		if (offsets[(_entries[0].Key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t sum = 0;
+		for (auto& offset : offsets)
+		{
+			const size_t bucketCount = offset;
+			offset = sum;
+			sum += bucketCount;
+		}
+
+		for (const auto& entry : _entries)
+		{
+			_scratch[offsets[(entry.Key >> shift) & 0xFF]++] = entry;
+		}
+		_entries.swap(_scratch);
+	}
+}
@@ -17,26 +17,41 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 
 using vkh = VulkanHelpers;
 
-void PbrMaterialResource::Destroy()
+// FNV-1a over the handles and layout of an image binding
+static u64 HashImageInfo(u64 hash, const VkDescriptorImageInfo& info)
 {
-	if (_vk)
+	const u64 values[] = { (u64)info.imageView, (u64)info.sampler, (u64)info.imageLayout };
+	for (const u64 value : values)
 	{
-		vkDestroyBuffer(_vk->LogicalDevice(), _uniformBuffer, nullptr);
-		vkFreeMemory(_vk->LogicalDevice(), _uniformBufferMemory, nullptr);
-		_vk = nullptr;
+		for (u32 i = 0; i < 8; i++)
+		{
+			hash ^= (value >> (i * 8)) & 0xff;
+			hash *= 1099511628211ull;
+		}
 	}
+	return hash;
+}
+static constexpr u64 HashSeed = 14695981039346656037ull;
+
+void PbrMaterialResource::Destroy()
+{
+	// Descriptor sets are reclaimed with the pool and the UBO lives in the stage's ring buffer
+	_vk = nullptr;
 }
 
-const PbrMaterialResource& MaterialResourceManager::GetOrCreate(const Material& material, u32 swapImageIndex)
+PbrMaterialResource& MaterialResourceManager::GetOrCreate(const Material& material, u32 swapImageIndex)
 {
 	const auto key = CreateKey(material.Id.Value(), swapImageIndex);
 
@@ -59,39 +74,56 @@ const PbrMaterialResource& MaterialResourceManager::GetOrCreate(const Material&
 PbrMaterialResource MaterialResourceManager::CreateMaterialFrameResources(const Material& material) const
 {
 	const auto numImagesInFlight = 1;
-		
-	// Create uniform buffers
-	auto [materialBuffers, materialBuffersMemory] = vkh::CreateUniformBuffers(numImagesInFlight, sizeof(PbrMaterialUbo),
-		_vk->LogicalDevice(), _vk->PhysicalDevice());
-
 
 	// Create descriptor sets
 	const auto materialDescSets = vkh::AllocateDescriptorSets(numImagesInFlight, _descSetLayout, _pool, _vk->LogicalDevice());
 
 
-	// Get the id of an existing texture, fallback to placeholder if necessary.
-	auto GetTexture = [&](const std::optional<Material::Map>& map) -> const TextureResource&
-	{
-		const auto id =  map.has_value() ? map->Id : _placeholderTexture;
-		return _resourceRegistry->GetTexture(id);
-	};
-	for (u32 i = 0; i < numImagesInFlight; i++)
-	{
-		// Write updated descriptor sets
-		WriteMaterialDescriptorSet(
-			materialDescSets[i],
-			materialBuffers[i],
-			GetTexture(material.BasecolorMap),
-			GetTexture(material.NormalMap),
-			GetTexture(material.RoughnessMap),
-			GetTexture(material.MetalnessMap),
-			GetTexture(material.AoMap),
-			GetTexture(material.EmissiveMap),
-			GetTexture(material.TransparencyMap),
-			_vk->LogicalDevice());
-	}
+	PbrMaterialResource resource{ _vk, materialDescSets[0], 0 };
+	UpdateIfChanged(resource, material);
+
+	return resource;
+}
+
+bool MaterialResourceManager::UpdateIfChanged(PbrMaterialResource& resource, const Material& material) const
+{
+	const auto hash = HashTextureBindings(material);
+	if (hash == resource.GetBindingsHash())
+		return false;
+
+	WriteMaterialDescriptorSet(
+		resource.GetMaterialDescriptorSet(),
+		_uniformRingBuffer,
+		GetTextureOrPlaceholder(material.BasecolorMap),
+		GetTextureOrPlaceholder(material.NormalMap),
+		GetTextureOrPlaceholder(material.RoughnessMap),
+		GetTextureOrPlaceholder(material.MetalnessMap),
+		GetTextureOrPlaceholder(material.AoMap),
+		GetTextureOrPlaceholder(material.EmissiveMap),
+		GetTextureOrPlaceholder(material.TransparencyMap),
+		_vk->LogicalDevice());
+
+	resource.SetBindingsHash(hash);
+	return true;
+}
 
-	return PbrMaterialResource{_vk, materialDescSets[0], materialBuffers[0], materialBuffersMemory[0] };
+u64 MaterialResourceManager::HashTextureBindings(const Material& material) const
+{
+	auto hash = HashSeed;
+	hash = HashImageInfo(hash, GetTextureOrPlaceholder(material.BasecolorMap).ImageInfo());
+	hash = HashImageInfo(hash, GetTextureOrPlaceholder(material.NormalMap).ImageInfo());
+	hash = HashImageInfo(hash, GetTextureOrPlaceholder(material.RoughnessMap).ImageInfo());
+	hash = HashImageInfo(hash, GetTextureOrPlaceholder(material.MetalnessMap).ImageInfo());
+	hash = HashImageInfo(hash, GetTextureOrPlaceholder(material.AoMap).ImageInfo());
+	hash = HashImageInfo(hash, GetTextureOrPlaceholder(material.EmissiveMap).ImageInfo());
+	hash = HashImageInfo(hash, GetTextureOrPlaceholder(material.TransparencyMap).ImageInfo());
+	return hash;
+}
+
+const TextureResource& MaterialResourceManager::GetTextureOrPlaceholder(const std::optional<Material::Map>& map) const
+{
+	const auto id = map.has_value() ? map->Id : _placeholderTexture;
+	return _resourceRegistry->GetTexture(id);
 }
 
 void MaterialResourceManager::WriteMaterialDescriptorSet(VkDescriptorSet descriptorSet, VkBuffer materialUbo,
@@ -107,14 +139,14 @@ void MaterialResourceManager::WriteMaterialDescriptorSet(VkDescriptorSet descrip
 	VkDescriptorBufferInfo materialUboInfo = {};
 	{
 		materialUboInfo.buffer = materialUbo;
-		materialUboInfo.offset = 0;
+		materialUboInfo.offset = 0; // dynamic offset supplied at bind time
 		materialUboInfo.range = sizeof(PbrMaterialUbo);
 	}
 
 	const auto& s = descriptorSet;
 
 	vkh::UpdateDescriptorSet(device, {
-		                         vki::WriteDescriptorSet(s, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, 0, nullptr,
+		                         vki::WriteDescriptorSet(s, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, 0, nullptr,
 		                                                 &materialUboInfo),
 		                         vki::WriteDescriptorSet(s, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, 0,
 		                                                 &basecolorMap.ImageInfo()),
@@ -174,42 +206,67 @@ void PbrRenderStage::DestroyRenderer()
 void PbrRenderStage::InitRendererResourcesDependentOnSwapchain(u32 numImagesInFlight)
 {
 	auto msaaSamples = _vk.GetMsaaSamples(); // TODO This should query the render target
-	_pbrPipeline = CreatePbrGraphicsPipeline(_shaderDir, _pbrPipelineLayout, msaaSamples, _renderPass, _vk.LogicalDevice());
+	_pbrPipeline = CreatePbrGraphicsPipeline(_shaderDir, _pbrPipelineLayout, msaaSamples, _renderPass, false, _vk.LogicalDevice(), _vk.GetPipelineCache());
+	_pbrDepthEqualPipeline = CreatePbrGraphicsPipeline(_shaderDir, _pbrPipelineLayout, msaaSamples, _renderPass, true, _vk.LogicalDevice(), _vk.GetPipelineCache());
+	_depthPrepassPipeline = CreateDepthPrepassPipeline(_shaderDir, _pbrPipelineLayout, msaaSamples, _renderPass, _vk.LogicalDevice(),
+		_vk.GetPipelineCache());
 
 	_rendererDescriptorPool = CreateDescriptorPool(numImagesInFlight, _vk.LogicalDevice());
 
 
-	// Create light uniform buffers per swapchain image
-	std::tie(_lightBuffers, _lightBuffersMemory)
-		= vkh::CreateUniformBuffers(numImagesInFlight, sizeof(LightUbo), _vk.LogicalDevice(), _vk.PhysicalDevice());
+	// Size each frame's region for the frame ubo plus a material ubo for every material the pool can describe
+	const VkDeviceSize uboSlack = 256; // worst case minUniformBufferOffsetAlignment padding per push
+	const VkDeviceSize frameCapacity = sizeof(PbrFrameUbo) + uboSlack +
+		MaxPbrObjects * (sizeof(PbrMaterialUbo) + uboSlack);
+	_uniformRing = std::make_unique<UniformRingBuffer>(numImagesInFlight, frameCapacity, _vk.MemoryAllocator(),
+		_vk.PhysicalDevice(), _vk.LogicalDevice());
+	// The camera and each shadow cascade cull separately, so each gets its own copy of the transforms. Grows to fit.
+	_instanceBuffer = std::make_unique<InstanceBuffer>(numImagesInFlight, InitialInstanceCapacity, _vk.MemoryAllocator(),
+		_vk.LogicalDevice());
+	_scenePass = std::make_unique<SceneRenderPass>(_vk, _resourceRegistry, *_instanceBuffer, _shaderDir, numImagesInFlight);
+	_lightFrames.resize(numImagesInFlight);
+	for (auto& frame : _lightFrames)
+	{
+		CreateLightFrameResources(frame);
+	}
 
-	// Create model uniform buffers and descriptor sets per swapchain image
-	for (auto& renderable : _renderables)
+	// One common descriptor set per swapchain image serves every object drawn in that frame
+	_frameDescriptorSets = vkh::AllocateDescriptorSets(numImagesInFlight, _pbrDescriptorSetLayout, _rendererDescriptorPool, _vk.LogicalDevice());
+	_frameDescriptorInputHashes.assign(numImagesInFlight, HashFrameDescriptorInputs());
+	for (u32 i = 0; i < numImagesInFlight; i++)
 	{
-		renderable->CommonFrameResources = CreateCommonFrameResources(numImagesInFlight);
+		WriteCommonDescriptorSet(
+			_frameDescriptorSets[i],
+			_uniformRing->Buffer(),
+			_instanceBuffer->Buffer(i),
+			_lightFrames[i],
+			_delegate.GetPrefilterTextureResource(),
+			_delegate.GetBrdfTextureResource(),
+			_delegate.GetShadowmapDescriptor(),
+			_vk.LogicalDevice());
 	}
 
-	_materialFrameResources = std::make_unique<MaterialResourceManager>(_vk, _rendererDescriptorPool, _materialDescriptorSetLayout, _resourceRegistry, _placeholderTexture);
+	_materialFrameResources = std::make_unique<MaterialResourceManager>(_vk, _rendererDescriptorPool, _materialDescriptorSetLayout, _uniformRing->Buffer(), _resourceRegistry, _placeholderTexture);
 }
 void PbrRenderStage::DestroyRenderResourcesDependentOnSwapchain()
 {
 	_materialFrameResources = nullptr; // RAII
-	
-	for (auto& renderable : _renderables)
+	_uniformRing = nullptr; // RAII
+	_scenePass = nullptr; // RAII
+	_instanceBuffer = nullptr; // RAII
+	_frameDescriptorSets.clear(); // Freed with the pool
+	for (auto& frame : _lightFrames)
 	{
-		for (auto& info : renderable->CommonFrameResources)
-		{
-			vkDestroyBuffer(_vk.LogicalDevice(), info.MeshUniformBuffer, nullptr);
-			vkFreeMemory(_vk.LogicalDevice(), info.MeshUniformBufferMemory, nullptr);
-		}
+		DestroyLightFrameResources(frame);
 	}
-
-	for (auto& x : _lightBuffers) { vkDestroyBuffer(_vk.LogicalDevice(), x, nullptr); }
-	for (auto& x : _lightBuffersMemory) { vkFreeMemory(_vk.LogicalDevice(), x, nullptr); }
+	_lightFrames.clear();
+	_frameDescriptorInputHashes.clear();
 
 	vkDestroyDescriptorPool(_vk.LogicalDevice(), _rendererDescriptorPool, nullptr);
 
 	vkDestroyPipeline(_vk.LogicalDevice(), _pbrPipeline, nullptr);
+	vkDestroyPipeline(_vk.LogicalDevice(), _pbrDepthEqualPipeline, nullptr);
+	vkDestroyPipeline(_vk.LogicalDevice(), _depthPrepassPipeline, nullptr);
 }
 
 void PbrRenderStage::HandleSwapchainRecreated(u32 width, u32 height, u32 numSwapchainImages)
@@ -341,254 +398,363 @@ VkRenderPass PbrRenderStage::CreateRenderPass(VkFormat format, VulkanService& vk
 
 bool PbrRenderStage::UpdateDescriptors(u32 imageIndex, const RenderOptions& options, bool skyboxUpdated, const SceneRendererPrimitives& scene)
 {
-	// HACK HACK HACK TODO Optimise this so we only update descriptor sets when needed :)
-	_refreshRenderableDescriptorSets = true;
-	// HACK HACK HACK
-
-	const bool updateDescriptors = skyboxUpdated || _refreshRenderableDescriptorSets;
-
 	_lastOptions = options;
-	_refreshRenderableDescriptorSets = false;
+	_materialDescriptorWrites = 0;
+	_frameDescriptorWrites = 0;
 
-	// Rebuild descriptor sets if needed
-	if (!updateDescriptors)
-		return updateDescriptors;
-
-
-	// Get the id of an existing texture, fallback to placeholder if necessary.
-	auto GetTexture = [&](const std::optional<Material::Map>& map) -> const TextureResource&
+	if (skyboxUpdated)
 	{
-		const auto id =  map.has_value() ? map->Id : _placeholderTexture;
-		return _resourceRegistry->GetTexture(id);
-	};
+		SetSkyboxDirty();
+	}
 
-	// TODO
-	
-	/*
-	 * DONE! [x] v1  -  unique descset per mat, updated every frame
-	 * 
-	 * 1. Add scene.Materials of each unique mat.
-	 * 2. scene.Objects should have an index ref into scene.Materials
-	 * 3. add unordered_map of <matId, matDescSet>
-	 * 4. each mat.id has a desc set that's updated every frame
-	 */
 	
-	/*
-	 * [ ] v2  -  only update when changed
-	 * 
-	 * 1. add code in this layer that gens a hash id for material desc set
-	 * 2. add unordered_map of <matId, pair<matHash, matDescSet>>
-	 */
-
+	// Each material owns a set per swapchain image. Only rewrite it when the textures it resolves to have changed.
 	for (auto&& mat : scene.Materials)
 	{
-		/*
-		THIS REALLY DOES JUST NEED TO BE ABOUT FREQUENCY OF UPDATE
-		SPLITTING THEM UP IS PURELY TO MINIMISE UPDATES IN GENERAL
-
-		PER FRAME: time, ibl, punctual lightingS
-			PER MATERIAL: material textures and ubo
-				PER MESH: transform
-		*/
-		
-		const PbrMaterialResource& matResources = _materialFrameResources->GetOrCreate(*mat, imageIndex);
-		//matResources->UpdateDescriptorSet(mat);
-		
-		_materialFrameResources->WriteMaterialDescriptorSet(
-			matResources.GetMaterialDescriptorSet(),
-			matResources.GetMaterialUniformBuffer(),
-			GetTexture(mat->BasecolorMap),
-			GetTexture(mat->NormalMap),
-			GetTexture(mat->RoughnessMap),
-			GetTexture(mat->MetalnessMap),
-			GetTexture(mat->AoMap),
-			GetTexture(mat->EmissiveMap),
-			GetTexture(mat->TransparencyMap),
-			_vk.LogicalDevice());
+		PbrMaterialResource& matResources = _materialFrameResources->GetOrCreate(*mat, imageIndex);
+		if (_materialFrameResources->UpdateIfChanged(matResources, *mat))
+		{
+			_materialDescriptorWrites++;
+		}
 	}
 
-	
-	for (auto&& object : scene.Objects)
-	{
-		const auto& commonResources = _renderables[object.RenderableId.Value()]->CommonFrameResources[imageIndex];
 
+	// Same for the common set: IBL maps and shadowmap
+	const auto frameInputsHash = HashFrameDescriptorInputs();
+	if (_frameDescriptorInputHashes[imageIndex] != frameInputsHash)
+	{
 		WriteCommonDescriptorSet(
-			commonResources.PbrDescriptorSet,
-			commonResources.MeshUniformBuffer,
-			_lightBuffers[imageIndex],
-			_delegate.GetIrradianceTextureResource(),
+			_frameDescriptorSets[imageIndex],
+			_uniformRing->Buffer(),
+			_instanceBuffer->Buffer(imageIndex),
+			_lightFrames[imageIndex],
 			_delegate.GetPrefilterTextureResource(),
 			_delegate.GetBrdfTextureResource(),
 			_delegate.GetShadowmapDescriptor(),
 			_vk.LogicalDevice());
+
+		_frameDescriptorInputHashes[imageIndex] = frameInputsHash;
+		_frameDescriptorWrites++;
 	}
 
-	return updateDescriptors;
+	return _materialDescriptorWrites + _frameDescriptorWrites > 0;
 }
 
-void PbrRenderStage::Draw(VkCommandBuffer commandBuffer, u32 frameIndex,
-	const RenderOptions& options,
+u64 PbrRenderStage::HashFrameDescriptorInputs() const
+{
+	auto hash = HashSeed;
+	hash = HashImageInfo(hash, _delegate.GetPrefilterTextureResource().ImageInfo());
+	hash = HashImageInfo(hash, _delegate.GetBrdfTextureResource().ImageInfo());
+	hash = HashImageInfo(hash, _delegate.GetShadowmapDescriptor());
+	return hash;
+}
+
+void PbrRenderStage::PrepareDraws(u32 frameIndex,
 	const std::vector<SceneRendererPrimitives::RenderableObject>& objects,
-	const std::vector<Light>& lights,
-	const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camPos, const glm::mat4& lightSpaceMatrix)
+	const Frustum& cameraFrustum, const std::vector<std::optional<Frustum>>& shadowFrusta, const glm::vec3& camPos)
 {
-	const auto startBench = std::chrono::steady_clock::now();
+	_instanceBuffer->BeginFrame(frameIndex);
+	_scenePass->BeginFrame(frameIndex, cameraFrustum, camPos, shadowFrusta);
+	_transparentBatches.clear();
+	_transparentSortItems.clear();
 
-	// Update UBOs
+	
+	// Opaque objects and every shadow caster are culled on the GPU. Transparent objects must be drawn in order, so
+	// they're culled here and kept out of the scene pass's camera view.
+	for (const auto& object : objects)
 	{
-		// Light ubo - TODO PERF Keep mem mapped
-		{
-			auto lightsUbo = LightUbo::Create(lights);
+		const auto meshId = _renderables[object.RenderableId.Value()]->MeshId;
+		const bool transparent = object.Material.UsingTransparencyMap();
+
+		_scenePass->Add(object.Transform, object.WorldBounds, meshId, transparent ? nullptr : &object.Material);
 
-			void* data;
-			auto size = sizeof(lightsUbo);
-			vkMapMemory(_vk.LogicalDevice(), _lightBuffersMemory[frameIndex], 0, size, 0, &data);
-			memcpy(data, &lightsUbo, size);
-			vkUnmapMemory(_vk.LogicalDevice(), _lightBuffersMemory[frameIndex]);
+		if (transparent && (object.WorldBounds.IsEmpty() || cameraFrustum.Intersects(object.WorldBounds)))
+		{
+			// Calc depth of from camera to object transform - this isn't fullproof!
+			const glm::vec3 displacement = glm::vec3(object.Transform[3]) - camPos;
+			_transparentSortItems.emplace_back(BatchSortItem{ &object, meshId, glm::dot(displacement, displacement) });
 		}
+	}
 
+	_scenePass->Finalize();
+
+	
+	// Transparent objects are drawn back to front, so only neighbours in that order can share a batch
+	_queue.Clear();
+	for (u32 i = 0; i < (u32)_transparentSortItems.size(); i++)
+	{
+		const auto& item = _transparentSortItems[i];
+		_queue.Push(RenderQueue::TransparentKey(0, item.Object->Material.Id.Value(), item.MeshId.Value(), item.DistSquared), i);
 	}
+	_queue.Sort();
 
+	// Push transforms in draw order so each batch's instances are contiguous
+	for (const auto& entry : _queue.Entries())
+	{
+		const auto& item = _transparentSortItems[entry.Item];
+		const u32 instance = _instanceBuffer->Push(item.Object->Transform);
+		const Material* material = &item.Object->Material;
 
+		if (!_transparentBatches.empty() && _transparentBatches.back().MeshId == item.MeshId && _transparentBatches.back().Material == material)
+		{
+			_transparentBatches.back().InstanceCount++;
+		}
+		else
+		{
+			_transparentBatches.emplace_back(InstanceBatch{ item.MeshId, material, instance, 1 });
+		}
+	}
 
+	// A grown instance buffer is a new VkBuffer, point this frame's sets at it. The frame isn't in flight.
+	_instanceBufferRecreated = _instanceBuffer->EndFrame();
+	if (_instanceBufferRecreated)
+	{
+		WriteInstanceDescriptor(_frameDescriptorSets[frameIndex], _instanceBuffer->Buffer(frameIndex), _vk.LogicalDevice());
+		_scenePass->OnInstanceBufferRecreated();
+	}
+}
 
-	// Update material UBOs
-	for (auto&& object : objects)
+void PbrRenderStage::PrepareRecording(u32 frameIndex,
+	const RenderOptions& options,
+	const std::vector<Light>& lights,
+	const glm::mat4& view, const glm::mat4& projection, f32 nearClip, f32 farClip, VkExtent2D extent,
+	const glm::vec3& camPos, const ShadowCascades& shadowCascades)
+{
+	// All per-frame uniform data is appended to this frame's region of the persistently mapped ring
+	_uniformRing->BeginFrame(frameIndex);
+
+	PbrUboCreateInfo info = {};
+	info.View = view;
+	info.Projection = projection;
+	info.CamPos = camPos;
+	info.ExposureBias = options.ExposureBias;
+	info.IblStrength = options.IblStrength;
+	info.ShowClipping = options.ShowClipping;
+	info.ShowNormalMap = false;
+	info.CubemapRotation = options.SkyboxRotation;
+	info.IrradianceSh = _delegate.GetIrradianceSh();
+
+	_frameUboOffset = _uniformRing->Push(PbrFrameUbo::Create(info, shadowCascades));
+	_depthPrepass = options.DepthPrepass;
+
+
+	// Bin the lights into froxels and copy the result into this frame's light buffers
+	LightClusters::BuildInfo clusterInfo{};
+	clusterInfo.View = view;
+	clusterInfo.Projection = projection;
+	clusterInfo.Near = nearClip;
+	clusterInfo.Far = farClip;
+	clusterInfo.Width = extent.width;
+	clusterInfo.Height = extent.height;
+	clusterInfo.MaxLights = MaxLights;
+	clusterInfo.MaxLightIndices = MaxLightIndices;
+	_lightClusters.Build(lights, clusterInfo);
 	{
-		
+		const auto& frame = _lightFrames[frameIndex];
+		const auto& gpuLights = _lightClusters.Lights();
+		const auto& clusters = _lightClusters.Clusters();
+		const auto& indices = _lightClusters.LightIndices();
+
+		auto* lightData = (u8*)frame.LightAllocation.Mapped;
+		memcpy(lightData, &_lightClusters.Header(), sizeof(LightClusters::GpuHeader));
+		memcpy(lightData + sizeof(LightClusters::GpuHeader), gpuLights.data(), gpuLights.size() * sizeof(LightClusters::GpuLight));
+		memcpy(frame.ClusterAllocation.Mapped, clusters.data(), clusters.size() * sizeof(LightClusters::GpuCluster));
+		memcpy(frame.LightIndexAllocation.Mapped, indices.data(), indices.size() * sizeof(u32));
 	}
 
+	
+	// A material ubo only depends on the material and frame constants, so push it once per unique material
+	const auto& cameraGroups = _scenePass->GetDrawGroups(SceneRenderPass::View::Camera);
+	_materialUboOffsets.clear();
+	_drawItems.clear();
+	_drawItems.reserve(cameraGroups.size() + _transparentBatches.size());
 
-	// Determine draw order - Split renderables into an opaque and ordered transparent buckets.
-	std::vector<SceneRendererPrimitives::RenderableObject> opaqueObjects = {};
-	std::map<f32, SceneRendererPrimitives::RenderableObject> depthSortedTransparentObjects = {}; // map sorts by keys, so use dist as key
-	for (const auto& object : objects)
+	auto ResolveMaterial = [&](DrawItem& item, const Material& material)
 	{
-		const auto& renderable = *_renderables[object.RenderableId.Value()];
-		
-		// Update UBOs
+		item.MaterialDescriptorSet = _materialFrameResources->GetOrCreate(material, frameIndex).GetMaterialDescriptorSet();
+
+		const auto [it, inserted] = _materialUboOffsets.try_emplace(&material, 0);
+		if (inserted)
 		{
-			PbrUboCreateInfo info = {};
-			info.Model = object.Transform;
-			info.View = view;
-			info.Projection = projection;
-			info.LightSpaceMatrix = lightSpaceMatrix;
-			info.CamPos = camPos;
-			info.ExposureBias = options.ExposureBias;
-			info.IblStrength = options.IblStrength;
-			info.ShowClipping = options.ShowClipping;
-			info.ShowNormalMap = false;
-			info.CubemapRotation = options.SkyboxRotation;
-
-			
-			// Update Pbr Mesh ubos
-			{
-				const auto& bufferMemory = renderable.CommonFrameResources[frameIndex].MeshUniformBufferMemory;
-				const auto ubo = PbrMeshVsUbo::Create(info);
-
-				// Copy to gpu - TODO PERF Keep mem mapped 
-				void* data;
-				auto size = sizeof(ubo);
-				vkMapMemory(_vk.LogicalDevice(), bufferMemory, 0, size, 0, &data);
-				memcpy(data, &ubo, size);
-				vkUnmapMemory(_vk.LogicalDevice(), bufferMemory);
-			}
-
-			
-			// Update Pbr Material ubos
-			{
-				const auto& matResources = _materialFrameResources->GetOrCreate(object.Material, frameIndex);
-				auto* bufferMemory = matResources.GetMaterialUniformBufferMemory();
-				const auto ubo = PbrMaterialUbo::Create(info, object.Material);
-
-				// Copy to gpu - TODO PERF Keep mem mapped 
-				void* data;
-				auto size = sizeof(ubo);
-				vkMapMemory(_vk.LogicalDevice(), bufferMemory, 0, size, 0, &data);
-				memcpy(data, &ubo, size);
-				vkUnmapMemory(_vk.LogicalDevice(), bufferMemory);
-			}
+			it->second = _uniformRing->Push(PbrMaterialUbo::Create(info, material));
 		}
+		item.MaterialUboOffset = it->second;
+	};
 
-		
-		// Depth sort transparent object
-		if (object.Material.UsingTransparencyMap())
+	// Opaque objects first, one indirect call per group of GPU culled draws sorted by state, then transparent objects
+	// back to front. Opaque pipelines all match this frame, so the pipeline field is left for future variants.
+	_queue.Clear();
+	_geometryIds.clear();
+	for (u32 i = 0; i < (u32)cameraGroups.size(); i++)
+	{
+		const auto& group = cameraGroups[i];
+		_queue.Push(RenderQueue::OpaqueKey(0, group.Material->Id.Value(), GeometryId(group.IndexBuffer, group.IndexType),
+			group.NearestDistSquared), i);
+	}
+	_queue.Sort();
+
+	for (const auto& entry : _queue.Entries())
+	{
+		const auto& group = cameraGroups[entry.Item];
+		auto& item = _drawItems.emplace_back(DrawItem{ &group, nullptr });
+		ResolveMaterial(item, *group.Material);
+	}
+	_opaqueItemCount = (u32)_drawItems.size();
+	for (const auto& batch : _transparentBatches)
+	{
+		auto& item = _drawItems.emplace_back(DrawItem{ nullptr, &batch });
+		ResolveMaterial(item, *batch.Material);
+	}
+}
+
+PbrRenderStage::BindCounts PbrRenderStage::RecordDraws(VkCommandBuffer commandBuffer, u32 frameIndex, u32 firstItem,
+	u32 itemCount) const
+{
+	assert(firstItem + itemCount <= _drawItems.size());
+
+	// Items are sorted by state, so most binds repeat the last one and are skipped. Nothing is inherited from the
+	// primary, so the first of each is always issued.
+	BindCounts counts{};
+	VkPipeline boundPipeline = nullptr;
+	VkDescriptorSet boundMaterialSet = nullptr;
+	u32 boundMaterialUboOffset = UINT32_MAX;
+	VkBuffer boundIndexBuffer = nullptr;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+	if (itemCount > 0)
+	{
+		// Frame ubo (1,0) is the set's only dynamic binding
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pbrPipelineLayout,
+			1, 1, &_frameDescriptorSets[frameIndex], 1, &_frameUboOffset);
+		counts.Binds++;
+	}
+
+	for (u32 i = firstItem; i < firstItem + itemCount; i++)
+	{
+		const auto& item = _drawItems[i];
+
+		// Transparent objects aren't in the prepass, they test and blend as usual
+		const auto pipeline = _depthPrepass && i < _opaqueItemCount ? _pbrDepthEqualPipeline : _pbrPipeline;
+		if (pipeline != boundPipeline)
 		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+			counts.Binds++;
+		}
+		else
+		{
+			counts.Skipped++;
+		}
 
-			// Calc depth of from camera to object transform - this isn't fullproof!
-			const auto& tf = object.Transform;
-			const auto objPos = glm::vec3(tf[3]);
-			const glm::vec3 displacement = objPos - camPos;
-			float distSquared = glm::dot(displacement, displacement);
-
-			auto [it, success] = depthSortedTransparentObjects.try_emplace(distSquared, object);
-			while (!success)
-			{
-				// HACK to nudge the dist a little. Doing this to avoid needing a more complicated sorted map
-				distSquared += 0.001f * (float(rand()) / RAND_MAX);
-				std::tie(it, success) = depthSortedTransparentObjects.try_emplace(distSquared, object);
-				//std::cerr << "Failed to depth sort object\n";
-			}
+		if (item.MaterialDescriptorSet != boundMaterialSet || item.MaterialUboOffset != boundMaterialUboOffset)
+		{
+			// Material ubo (0,0). Set 1 stays bound as the layouts are identical.
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pbrPipelineLayout,
+				0, 1, &item.MaterialDescriptorSet, 1, &item.MaterialUboOffset);
+			boundMaterialSet = item.MaterialDescriptorSet;
+			boundMaterialUboOffset = item.MaterialUboOffset;
+			counts.Binds++;
 		}
-		else // Opaque
+		else
 		{
-			opaqueObjects.emplace_back(object);
+			counts.Skipped++;
 		}
-	}
 
-	
-	// Draw Pbr Objects
-	{
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pbrPipeline);
+		const MeshResource* mesh = item.Batch ? &_resourceRegistry->GetMesh(item.Batch->MeshId) : nullptr;
+		const VkBuffer indexBuffer = item.Group ? item.Group->IndexBuffer : mesh->IndexBuffer;
+		const VkIndexType indexType = item.Group ? item.Group->IndexType : mesh->IndexType;
 
-		auto DrawMesh = [&](const SceneRendererPrimitives::RenderableObject& obj)
+		// Meshes share a handful of pool buffers, so geometry is only rebound when the chunk or index type changes
+		if (indexBuffer != boundIndexBuffer || indexType != boundIndexType)
 		{
-			const auto& renderable = _renderables[obj.RenderableId.Value()].get();
-			const auto& mesh = _resourceRegistry->GetMesh(renderable->MeshId);
-			const auto& materialResource = _materialFrameResources->GetOrCreate(obj.Material, frameIndex);
-			
-			std::array<VkDescriptorSet, 2> descSets = {
-				materialResource.GetMaterialDescriptorSet(),
-				renderable->CommonFrameResources[frameIndex].PbrDescriptorSet
+			VkBuffer vertexBuffers[] = {
+				item.Group ? item.Group->PositionBuffer : mesh->VertexBuffer,
+				item.Group ? item.Group->AttributeBuffer : mesh->AttributeBuffer,
 			};
-			
-			// Draw mesh
-			VkBuffer vertexBuffers[] = { mesh.VertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-			vkCmdBindIndexBuffer(commandBuffer, mesh.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdBindDescriptorSets(commandBuffer,
-				VK_PIPELINE_BIND_POINT_GRAPHICS, _pbrPipelineLayout, // TODO Use diff pipeline with blending disabled?
-				0, (u32)descSets.size(), descSets.data(), 0, nullptr);
-			vkCmdDrawIndexed(commandBuffer, (u32)mesh.IndexCount, 1, 0, 0, 0);
-		};
+			VkDeviceSize offsets[] = { 0, 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType);
+			boundIndexBuffer = indexBuffer;
+			boundIndexType = indexType;
+			counts.Binds++;
+		}
+		else
+		{
+			counts.Skipped++;
+		}
 
-		
-		// Draw Opaque objects
-		for (auto&& opaqueObj : opaqueObjects)
+		if (item.Group)
 		{
-			DrawMesh(opaqueObj);
+			_scenePass->DrawIndirect(commandBuffer, *item.Group);
 		}
+		else
+		{
+			const auto& batch = *item.Batch;
+			vkCmdDrawIndexed(commandBuffer, (u32)mesh->IndexCount, batch.InstanceCount, mesh->FirstIndex, mesh->VertexOffset,
+				batch.FirstInstance);
+		}
+	}
+
+	return counts;
+}
+
+PbrRenderStage::BindCounts PbrRenderStage::RecordDepthPrepass(VkCommandBuffer commandBuffer, u32 frameIndex,
+	u32 firstItem, u32 itemCount) const
+{
+	// Front to back rather than the shading order, to reject as much as possible
+	const auto& groups = _scenePass->GetDrawGroups(SceneRenderPass::View::Camera);
+	assert(firstItem + itemCount <= GetDepthPrepassItemCount());
+
+	BindCounts counts{};
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _depthPrepassPipeline);
+
+	// Only the frame set is read: frame ubo (1,0), instances (1,6)
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, _pbrPipelineLayout,
+		1, 1, &_frameDescriptorSets[frameIndex], 1, &_frameUboOffset);
+	counts.Binds += 2;
 
-		// Draw transparent objects (reverse iterated)
-		for (auto it = depthSortedTransparentObjects.rbegin(); it != depthSortedTransparentObjects.rend(); ++it)
+	VkBuffer boundIndexBuffer = nullptr;
+	VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+	for (u32 i = firstItem; i < firstItem + itemCount; i++)
+	{
+		const auto& group = groups[i];
+		if (group.IndexBuffer != boundIndexBuffer || group.IndexType != boundIndexType)
+		{
+			const VkDeviceSize offset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &group.PositionBuffer, &offset);
+			vkCmdBindIndexBuffer(commandBuffer, group.IndexBuffer, 0, group.IndexType);
+			boundIndexBuffer = group.IndexBuffer;
+			boundIndexType = group.IndexType;
+			counts.Binds++;
+		}
+		else
 		{
-			auto [_, transparentObj] = *it;
-			DrawMesh(transparentObj);
+			counts.Skipped++;
 		}
+		_scenePass->DrawIndirect(commandBuffer, group);
 	}
 
-	
-	const std::chrono::duration<double, std::chrono::milliseconds::period> duration
-		= std::chrono::steady_clock::now() - startBench;
-	//std::cout << "# Update loop took:  " << std::setprecision(3) << duration.count() << "ms.\n";
+	return counts;
+}
+
+u32 PbrRenderStage::GeometryId(VkBuffer indexBuffer, VkIndexType indexType)
+{
+	// A handful of pool chunks per frame, a linear search beats hashing
+	const auto it = std::find(_geometryIds.begin(), _geometryIds.end(), indexBuffer);
+	const u32 id = (u32)std::distance(_geometryIds.begin(), it);
+	if (it == _geometryIds.end())
+	{
+		_geometryIds.push_back(indexBuffer);
+	}
+
+	return id << 1 | (indexType == VK_INDEX_TYPE_UINT32 ? 1 : 0);
 }
 
 RenderableResourceId PbrRenderStage::CreateRenderable(const MeshResourceId& meshId)
 {
 	auto model = std::make_unique<RenderableMesh>();
 	model->MeshId = meshId;
-	model->CommonFrameResources = CreateCommonFrameResources(_vk.GetSwapchain().GetImageCount()); 
 
 	const auto id = RenderableResourceId((u32)_renderables.size());
 	_renderables.emplace_back(std::move(model));
@@ -634,12 +800,17 @@ void PbrRenderStage::SetMaterial(const RenderableResourceId& renderableResId, co
 
 VkDescriptorPool PbrRenderStage::CreateDescriptorPool(u32 numImagesInFlight, VkDevice device)
 {
-	const u32 maxPbrObjects = 10000; // Max scene objects! This is gross, but it'll do for now.
+	const u32 maxMaterials = MaxPbrObjects; // Material sets are per material per frame
 	//const u32 maxSkyboxObjects = 1;
 
-	// Match these to CreatePbrDescriptorSetLayout
-	const auto numPbrUniformBuffers = 3;
-	const auto numPbrCombinedImageSamplers = 11;
+	// Match these to CreateMaterialDescriptorSetLayout
+	const auto numMaterialUniformBuffers = 1;
+	const auto numMaterialCombinedImageSamplers = 7;
+
+	// Match these to CreatePbrDescriptorSetLayout, one set per frame
+	const auto numFrameUniformBuffers = 1;
+	const auto numFrameCombinedImageSamplers = 3;
+	const auto numFrameStorageBuffers = 4;
 
 	// Match these to CreateSkyboxDescriptorSetLayout
 	//const auto numSkyboxUniformBuffers = 2;
@@ -649,25 +820,66 @@ VkDescriptorPool PbrRenderStage::CreateDescriptorPool(u32 numImagesInFlight, VkD
 	const std::vector<VkDescriptorPoolSize> poolSizes
 	{
 		// PBR Objects
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, numPbrUniformBuffers * maxPbrObjects * numImagesInFlight},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numPbrCombinedImageSamplers * maxPbrObjects * numImagesInFlight},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, (numMaterialUniformBuffers * maxMaterials + numFrameUniformBuffers) * numImagesInFlight},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (numMaterialCombinedImageSamplers * maxMaterials + numFrameCombinedImageSamplers) * numImagesInFlight},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, numFrameStorageBuffers * numImagesInFlight},
 
 		// Skybox Object
 		//{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, numSkyboxUniformBuffers * maxSkyboxObjects * numImagesInFlight},
 		//{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numSkyboxCombinedImageSamplers * maxSkyboxObjects * numImagesInFlight},
 	};
 
-	const auto totalDescSets = (maxPbrObjects/* + maxSkyboxObjects*/) * numImagesInFlight;
+	const auto totalDescSets = (maxMaterials + 1/* + maxSkyboxObjects*/) * numImagesInFlight;
 
 	return vkh::CreateDescriptorPool(poolSizes, totalDescSets, device);
 }
 
 
+void PbrRenderStage::CreateLightFrameResources(LightFrameResources& frame) const
+{
+	auto* device = _vk.LogicalDevice();
+	auto& allocator = _vk.MemoryAllocator();
+
+	const auto hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	std::tie(frame.LightBuffer, frame.LightAllocation) = vkh::CreateBuffer(
+		sizeof(LightClusters::GpuHeader) + sizeof(LightClusters::GpuLight) * MaxLights,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, allocator, device);
+
+	std::tie(frame.ClusterBuffer, frame.ClusterAllocation) = vkh::CreateBuffer(
+		sizeof(LightClusters::GpuCluster) * LightClusters::ClusterCount,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, allocator, device);
+
+	std::tie(frame.LightIndexBuffer, frame.LightIndexAllocation) = vkh::CreateBuffer(sizeof(u32) * MaxLightIndices,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, allocator, device);
+
+	// Valid and empty until the first PrepareRecording()
+	memset(frame.LightAllocation.Mapped, 0, sizeof(LightClusters::GpuHeader));
+	memset(frame.ClusterAllocation.Mapped, 0, sizeof(LightClusters::GpuCluster) * LightClusters::ClusterCount);
+}
+
+void PbrRenderStage::DestroyLightFrameResources(LightFrameResources& frame) const
+{
+	auto* device = _vk.LogicalDevice();
+	auto& allocator = _vk.MemoryAllocator();
+
+	vkDestroyBuffer(device, frame.LightBuffer, nullptr);
+	vkDestroyBuffer(device, frame.ClusterBuffer, nullptr);
+	vkDestroyBuffer(device, frame.LightIndexBuffer, nullptr);
+	allocator.Free(frame.LightAllocation);
+	allocator.Free(frame.ClusterAllocation);
+	allocator.Free(frame.LightIndexAllocation);
+	frame = {};
+}
+
+
 VkPipeline PbrRenderStage::CreatePbrGraphicsPipeline(const std::string& shaderDir,
 	VkPipelineLayout pipelineLayout,
 	VkSampleCountFlagBits msaaSamples,
 	VkRenderPass renderPass,
-	VkDevice device)
+	bool depthPrepassed,
+	VkDevice device,
+	PipelineCache& pipelineCache)
 {
 	//// SHADER MODULES ////
 
@@ -677,6 +889,14 @@ VkPipeline PbrRenderStage::CreatePbrGraphicsPipeline(const std::string& shaderDi
 	VkShaderModule fragShaderModule;
 	const auto numShaders = 2;
 	std::array<VkPipelineShaderStageCreateInfo, numShaders> shaderStageCIs{};
+
+	const i32 prefilterMipCount = (i32)IblLoader::PrefilterMips;
+	const VkSpecializationMapEntry prefilterMipCountEntry{ 0, 0, sizeof(prefilterMipCount) };
+	VkSpecializationInfo fragSpecialization{};
+	fragSpecialization.mapEntryCount = 1;
+	fragSpecialization.pMapEntries = &prefilterMipCountEntry;
+	fragSpecialization.dataSize = sizeof(prefilterMipCount);
+	fragSpecialization.pData = &prefilterMipCount;
 	{
 		const auto vertShaderCode = FileService::ReadFile(shaderDir + "Pbr.vert.spv");
 		const auto fragShaderCode = FileService::ReadFile(shaderDir + "Pbr.frag.spv");
@@ -695,6 +915,7 @@ VkPipeline PbrRenderStage::CreatePbrGraphicsPipeline(const std::string& shaderDi
 		fragCI.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		fragCI.module = fragShaderModule;
 		fragCI.pName = "main";
+		fragCI.pSpecializationInfo = &fragSpecialization;
 
 		shaderStageCIs[0] = vertCI;
 		shaderStageCIs[1] = fragCI;
@@ -708,13 +929,13 @@ VkPipeline PbrRenderStage::CreatePbrGraphicsPipeline(const std::string& shaderDi
 
 
 	// Vertex Input  -  Define the format of the vertex data passed to the vert shader
-	auto vertBindingDesc = VertexHelper::BindingDescription();
+	auto vertBindingDesc = VertexHelper::MeshBindingDescriptions();
 	auto vertAttrDesc = VertexHelper::AttributeDescriptions();
 	VkPipelineVertexInputStateCreateInfo vertexInputCI = {};
 	{
 		vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		vertexInputCI.vertexBindingDescriptionCount = 1;
-		vertexInputCI.pVertexBindingDescriptions = &vertBindingDesc;
+		vertexInputCI.vertexBindingDescriptionCount = (u32)vertBindingDesc.size();
+		vertexInputCI.pVertexBindingDescriptions = vertBindingDesc.data();
 		vertexInputCI.vertexAttributeDescriptionCount = (uint32_t)vertAttrDesc.size();
 		vertexInputCI.pVertexAttributeDescriptions = vertAttrDesc.data();
 	}
@@ -790,8 +1011,8 @@ VkPipeline PbrRenderStage::CreatePbrGraphicsPipeline(const std::string& shaderDi
 	{
 		depthStencilCI.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthStencilCI.depthTestEnable = true; // should compare new frags against depth to determine if discarding?
-		depthStencilCI.depthWriteEnable = true; // can new depth tests write to buffer?
-		depthStencilCI.depthCompareOp = VK_COMPARE_OP_LESS;
+		depthStencilCI.depthWriteEnable = !depthPrepassed; // can new depth tests write to buffer?
+		depthStencilCI.depthCompareOp = depthPrepassed ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
 
 		depthStencilCI.depthBoundsTestEnable = false; // optional test to keep only frags within a set bounds
 		depthStencilCI.minDepthBounds = 0; // optional
@@ -873,7 +1094,7 @@ VkPipeline PbrRenderStage::CreatePbrGraphicsPipeline(const std::string& shaderDi
 		graphicsPipelineCI.basePipelineIndex = -1;
 	}
 	VkPipeline pipeline;
-	if (vkCreateGraphicsPipelines(device, nullptr, 1, &graphicsPipelineCI, nullptr, &pipeline) != VK_SUCCESS)
+	if (pipelineCache.CreateGraphicsPipeline(graphicsPipelineCI, &pipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create Pipeline");
 	}
@@ -887,13 +1108,107 @@ VkPipeline PbrRenderStage::CreatePbrGraphicsPipeline(const std::string& shaderDi
 }
 
 
+VkPipeline PbrRenderStage::CreateDepthPrepassPipeline(const std::string& shaderDir,
+	VkPipelineLayout pipelineLayout,
+	VkSampleCountFlagBits msaaSamples,
+	VkRenderPass renderPass,
+	VkDevice device,
+	PipelineCache& pipelineCache)
+{
+	// Same shape as the shadow map pipeline: position stream only and no fragment shader
+	VkPipelineShaderStageCreateInfo vertShaderStage = {};
+	vertShaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertShaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertShaderStage.module = vkh::CreateShaderModule(FileService::ReadFile(shaderDir + "DepthPrepass.vert.spv"), device);
+	vertShaderStage.pName = "main";
+
+	VkVertexInputBindingDescription vertBindingDesc = VertexHelper::PositionBindingDescription();
+	VkVertexInputAttributeDescription vertAttrDesc = VertexHelper::PositionAttributeDescription();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+	vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputState.vertexBindingDescriptionCount = 1;
+	vertexInputState.pVertexBindingDescriptions = &vertBindingDesc;
+	vertexInputState.vertexAttributeDescriptionCount = 1;
+	vertexInputState.pVertexAttributeDescriptions = &vertAttrDesc;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
+	inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	// Must rasterize exactly like the pbr pipeline for the EQUAL test to pass
+	VkPipelineRasterizationStateCreateInfo rasterizationState = {};
+	rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationState.lineWidth = 1;
+
+	VkPipelineMultisampleStateCreateInfo multisampleState = {};
+	multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleState.rasterizationSamples = msaaSamples;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
+	depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilState.depthTestEnable = true;
+	depthStencilState.depthWriteEnable = true;
+	depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	// The subpass has a color attachment, leave it untouched
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = 0;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendState = {};
+	colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendState.attachmentCount = 1;
+	colorBlendState.pAttachments = &colorBlendAttachment;
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = (u32)dynamicStates.size();
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	VkGraphicsPipelineCreateInfo pipelineCI = {};
+	pipelineCI.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCI.stageCount = 1;
+	pipelineCI.pStages = &vertShaderStage;
+	pipelineCI.pVertexInputState = &vertexInputState;
+	pipelineCI.pInputAssemblyState = &inputAssemblyState;
+	pipelineCI.pViewportState = &viewportState;
+	pipelineCI.pRasterizationState = &rasterizationState;
+	pipelineCI.pMultisampleState = &multisampleState;
+	pipelineCI.pDepthStencilState = &depthStencilState;
+	pipelineCI.pColorBlendState = &colorBlendState;
+	pipelineCI.pDynamicState = &dynamicState;
+	pipelineCI.layout = pipelineLayout;
+	pipelineCI.renderPass = renderPass;
+	pipelineCI.subpass = 0;
+
+	VkPipeline pipeline;
+	if (pipelineCache.CreateGraphicsPipeline(pipelineCI, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create depth prepass pipeline");
+	}
+
+	vkDestroyShaderModule(device, vertShaderStage.module, nullptr);
+
+	return pipeline;
+}
+
+
 #pragma region Material Descriptor Sets
 
 VkDescriptorSetLayout PbrRenderStage::CreateMaterialDescriptorSetLayout(VkDevice device)
 {
 	return vkh::CreateDescriptorSetLayout(device, {
 		// pbr material ubo
-		vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
+		vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT),
 		// basecolor
 		vki::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 		// normalMap
@@ -916,101 +1231,85 @@ VkDescriptorSetLayout PbrRenderStage::CreateMaterialDescriptorSetLayout(VkDevice
 
 #pragma region Common Descriptor Sets
 
-std::vector<PbrCommonResourceFrame> PbrRenderStage::CreateCommonFrameResources(u32 numImagesInFlight) const
-{
-	// Create uniform buffers
-	auto [meshBuffers, meshBuffersMemory] = vkh::CreateUniformBuffers(numImagesInFlight, sizeof(PbrMeshVsUbo), 
-		_vk.LogicalDevice(), _vk.PhysicalDevice());
-
-	// Create descriptor sets
-	const auto pbrDescSets = vkh::AllocateDescriptorSets(numImagesInFlight, _pbrDescriptorSetLayout, _rendererDescriptorPool, _vk.LogicalDevice());
-
-
-	for (u32 i = 0; i < numImagesInFlight; i++)
-	{
-		WriteCommonDescriptorSet(
-			pbrDescSets[i],
-			meshBuffers[i],
-			_lightBuffers[i],
-			_delegate.GetIrradianceTextureResource(),
-			_delegate.GetPrefilterTextureResource(),
-			_delegate.GetBrdfTextureResource(),
-			_delegate.GetShadowmapDescriptor(),
-			_vk.LogicalDevice());
-	}
-
-	// Group data for return
-	std::vector<PbrCommonResourceFrame> ret(numImagesInFlight);
-	for (size_t i = 0; i < numImagesInFlight; i++)
-	{
-		ret[i].MeshUniformBuffer = meshBuffers[i];
-		ret[i].MeshUniformBufferMemory = meshBuffersMemory[i];
-		ret[i].PbrDescriptorSet = pbrDescSets[i];
-	}
-
-	return ret;
-}
-
 VkDescriptorSetLayout PbrRenderStage::CreatePbrDescriptorSetLayout(VkDevice device)
 {
 	return vkh::CreateDescriptorSetLayout(device, {
-		// pbr model ubo
-		vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT),
+		// pbr frame ubo
+		vki::DescriptorSetLayoutBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
 
-		// irradiance map
-		vki::DescriptorSetLayoutBinding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 		// prefilter map
 		vki::DescriptorSetLayoutBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 		// brdf map
 		vki::DescriptorSetLayoutBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 
-		// light ubo
-		vki::DescriptorSetLayoutBinding(4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
+		// lights
+		vki::DescriptorSetLayoutBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
 		// shadowMap
 		vki::DescriptorSetLayoutBinding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
+
+		// instance transforms
+		vki::DescriptorSetLayoutBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT),
+
+		// light clusters
+		vki::DescriptorSetLayoutBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
+		// light indices
+		vki::DescriptorSetLayoutBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
 	});
 }
 
 void PbrRenderStage::WriteCommonDescriptorSet(
 	VkDescriptorSet descriptorSet,
-	VkBuffer meshUbo,
-	VkBuffer lightUbo,
-	const TextureResource& irradianceMap,
+	VkBuffer uniformRingBuffer,
+	VkBuffer instanceBuffer,
+	const LightFrameResources& lights,
 	const TextureResource& prefilterMap,
 	const TextureResource& brdfMap,
 	VkDescriptorImageInfo shadowmapDescriptor,
 	VkDevice device)
 {
 
-	// Configure our new descriptor sets to point to our buffer/image data
-	VkDescriptorBufferInfo meshUboInfo = {};
+	// Configure our new descriptor sets to point to our buffer/image data. Ubo offsets are dynamic, supplied at bind time.
+	VkDescriptorBufferInfo frameUboInfo = {};
 	{
-		meshUboInfo.buffer = meshUbo;
-		meshUboInfo.offset = 0;
-		meshUboInfo.range = sizeof(PbrMeshVsUbo);
+		frameUboInfo.buffer = uniformRingBuffer;
+		frameUboInfo.offset = 0;
+		frameUboInfo.range = sizeof(PbrFrameUbo);
 	}
 
-	VkDescriptorBufferInfo lightUboInfo = {};
-	{
-		lightUboInfo.buffer = lightUbo;
-		lightUboInfo.offset = 0;
-		lightUboInfo.range = sizeof(LightUbo);
-	}
+	const VkDescriptorBufferInfo lightInfo = { lights.LightBuffer, 0, VK_WHOLE_SIZE };
+	const VkDescriptorBufferInfo clusterInfo = { lights.ClusterBuffer, 0, VK_WHOLE_SIZE };
+	const VkDescriptorBufferInfo lightIndexInfo = { lights.LightIndexBuffer, 0, VK_WHOLE_SIZE };
 
 	const auto& s = descriptorSet;
 
+	WriteInstanceDescriptor(s, instanceBuffer, device);
 	vkh::UpdateDescriptorSet(device, {
-		// Mesh
-		vki::WriteDescriptorSet(s, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, 0, nullptr, &meshUboInfo),
+		// Frame
+		vki::WriteDescriptorSet(s, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, 0, nullptr, &frameUboInfo),
 		
-		// IBL - TODO Move to a Frame scope descriptorSet as they're the same for every material and mesh in a frame
-		vki::WriteDescriptorSet(s, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, 0, &irradianceMap.ImageInfo()),
+		// IBL
 		vki::WriteDescriptorSet(s, 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, 0, &prefilterMap.ImageInfo()),
 		vki::WriteDescriptorSet(s, 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, 0, &brdfMap.ImageInfo()),
 		
-		// Discrete lighting - TODO Move to a Frame scope descriptorSet as they're the same for every material and mesh in a frame
-		vki::WriteDescriptorSet(s, 4, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, 0, nullptr, &lightUboInfo),
+		// Discrete lighting
+		vki::WriteDescriptorSet(s, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, 0, nullptr, &lightInfo),
 		vki::WriteDescriptorSet(s, 5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, 0, &shadowmapDescriptor),
+		vki::WriteDescriptorSet(s, 7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, 0, nullptr, &clusterInfo),
+		vki::WriteDescriptorSet(s, 8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, 0, nullptr, &lightIndexInfo),
+		});
+}
+
+void PbrRenderStage::WriteInstanceDescriptor(VkDescriptorSet descriptorSet, VkBuffer instanceBuffer, VkDevice device)
+{
+	VkDescriptorBufferInfo instanceBufferInfo = {};
+	{
+		instanceBufferInfo.buffer = instanceBuffer;
+		instanceBufferInfo.offset = 0;
+		instanceBufferInfo.range = VK_WHOLE_SIZE;
+	}
+
+	vkh::UpdateDescriptorSet(device, {
+		vki::WriteDescriptorSet(descriptorSet, 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, 0, nullptr, &instanceBufferInfo),
 		});
 }
 
@@ -58,7 +58,8 @@ void SkyboxRenderStage::DestroyResources()
 void SkyboxRenderStage::InitResourcesDependentOnSwapchain(u32 numImagesInFlight)
 {
 	auto msaaSamples = _vk.GetMsaaSamples();  // TODO This should query the render target
-	_pipeline = CreateGraphicsPipeline(_shaderDir, _pipelineLayout, msaaSamples, _renderPass, _vk.LogicalDevice());
+	_pipeline = CreateGraphicsPipeline(_shaderDir, _pipelineLayout, msaaSamples, _renderPass, _vk.LogicalDevice(),
+		_vk.GetPipelineCache());
 
 	_descPool = CreateDescPool(numImagesInFlight, _vk.LogicalDevice());
 	
@@ -211,11 +212,6 @@ VkRenderPass SkyboxRenderStage::CreateRenderPass(VkFormat format, VulkanService&
 bool SkyboxRenderStage::UpdateDescriptors(const RenderOptions& options)
 {
 	bool wasUpdated = false;
-	
-	// Diff render options and force state updates where needed
-		// Process whether refreshing is required
-	_refreshDescSets |= _lastOptions.ShowIrradiance != options.ShowIrradiance;
-
 
 	_lastOptions = options;
 
@@ -265,6 +261,11 @@ void SkyboxRenderStage::Draw(VkCommandBuffer commandBuffer, u32 frameIndex,
 		skyboxFragUbo.ShowClipping = options.ShowClipping;
 		skyboxFragUbo.IblStrength = options.IblStrength;
 		skyboxFragUbo.BackdropBrightness = options.BackdropBrightness;
+		skyboxFragUbo.ShowIrradiance = options.ShowIrradiance;
+		for (u32 i = 0; i < ShIrradiance::CoefficientCount; i++)
+		{
+			skyboxFragUbo.IrradianceSh[i] = glm::vec4(skybox->IblTextureIds.IrradianceSh[i], 0);
+		}
 
 		// Copy to gpu - TODO PERF Keep mem mapped 
 		void* data;
@@ -285,11 +286,11 @@ void SkyboxRenderStage::Draw(VkCommandBuffer commandBuffer, u32 frameIndex,
 		VkBuffer vertexBuffers[] = { mesh.VertexBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, mesh.IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(commandBuffer, mesh.IndexBuffer, 0, mesh.IndexType);
 		vkCmdBindDescriptorSets(commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS, _pipelineLayout,
 			0, 1, &skybox->FrameResources[frameIndex].DescriptorSet, 0, nullptr);
-		vkCmdDrawIndexed(commandBuffer, (uint32_t)mesh.IndexCount, 1, 0, 0, 0);
+		vkCmdDrawIndexed(commandBuffer, (uint32_t)mesh.IndexCount, 1, mesh.FirstIndex, mesh.VertexOffset, 0);
 	}
 
 	
@@ -298,14 +299,14 @@ void SkyboxRenderStage::Draw(VkCommandBuffer commandBuffer, u32 frameIndex,
 	//std::cout << "# Update loop took:  " << std::setprecision(3) << duration.count() << "ms.\n";
 }
 
-IblTextureResourceIds SkyboxRenderStage::CreateIblTextureResources(const std::array<std::string, 6>& sidePaths) const
+IblTextureResourceIds SkyboxRenderStage::CreateIblTextureResources(const std::array<std::string, 6>& sidePaths, IblQuality quality) const
 {
-	return _resources->CreateIblTextureResources(sidePaths);
+	return _resources->CreateIblTextureResources(sidePaths, quality);
 }
 
-IblTextureResourceIds SkyboxRenderStage::CreateIblTextureResources(const std::string& path) const
+IblTextureResourceIds SkyboxRenderStage::CreateIblTextureResources(const std::string& path, IblQuality quality) const
 {
-	return _resources->CreateIblTextureResources(path);
+	return _resources->CreateIblTextureResources(path, quality);
 }
 
 SkyboxResourceId SkyboxRenderStage::CreateSkybox(const SkyboxCreateInfo& createInfo)
@@ -350,10 +351,11 @@ VkDescriptorPool SkyboxRenderStage::CreateDescPool(u32 numImagesInFlight, VkDevi
 	return vkh::CreateDescriptorPool(poolSizes, totalDescSets, device);
 }
 
-const TextureResource& SkyboxRenderStage::GetIrradianceTextureResource() const
+const ShIrradiance::Coefficients& SkyboxRenderStage::GetIrradianceSh() const
 {
+	static const ShIrradiance::Coefficients none{};
 	const auto* skybox = GetCurrentSkyboxOrNull();
-	return _resources->GetTexture(skybox ? skybox->IblTextureIds.IrradianceCubemapId : _placeholderTextureId);
+	return skybox ? skybox->IblTextureIds.IrradianceSh : none;
 }
 
 const TextureResource& SkyboxRenderStage::GetPrefilterTextureResource() const
@@ -392,12 +394,8 @@ SkyboxRenderStage::CreateModelFrameResources(u32 numImagesInFlight, const Skybox
 		= vkh::CreateUniformBuffers(numImagesInFlight, sizeof(SkyboxFragUbo), _vk.LogicalDevice(), _vk.PhysicalDevice());
 
 
-	const auto textureId = _lastOptions.ShowIrradiance
-		? skybox.IblTextureIds.IrradianceCubemapId
-		: skybox.IblTextureIds.EnvironmentCubemapId;
-	
-	WriteDescSets(
-		numImagesInFlight, descriptorSets, skyboxVertBuffers, skyboxFragBuffers, _resources->GetTexture(textureId), _vk.LogicalDevice());
+	WriteDescSets(numImagesInFlight, descriptorSets, skyboxVertBuffers, skyboxFragBuffers,
+		_resources->GetTexture(skybox.IblTextureIds.EnvironmentCubemapId), _vk.LogicalDevice());
 
 
 	// Group data for return
@@ -466,7 +464,8 @@ VkPipeline SkyboxRenderStage::CreateGraphicsPipeline(const std::string& shaderDi
 	VkPipelineLayout pipelineLayout,
 	VkSampleCountFlagBits msaaSamples,
 	VkRenderPass renderPass,
-	VkDevice device)
+	VkDevice device,
+	PipelineCache& pipelineCache)
 {
 	//// SHADER MODULES ////
 
@@ -507,15 +506,15 @@ VkPipeline SkyboxRenderStage::CreateGraphicsPipeline(const std::string& shaderDi
 
 
 	// Vertex Input  -  Define the format of the vertex data passed to the vert shader
-	auto vertBindingDesc = VertexHelper::BindingDescription();
-	auto vertAttrDesc = VertexHelper::AttributeDescriptions();
+	auto vertBindingDesc = VertexHelper::PositionBindingDescription();
+	auto vertAttrDesc = VertexHelper::PositionAttributeDescription();
 	VkPipelineVertexInputStateCreateInfo vertexInputCI = {};
 	{
 		vertexInputCI.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 		vertexInputCI.vertexBindingDescriptionCount = 1;
 		vertexInputCI.pVertexBindingDescriptions = &vertBindingDesc;
-		vertexInputCI.vertexAttributeDescriptionCount = (u32)vertAttrDesc.size();
-		vertexInputCI.pVertexAttributeDescriptions = vertAttrDesc.data();
+		vertexInputCI.vertexAttributeDescriptionCount = 1;
+		vertexInputCI.pVertexAttributeDescriptions = &vertAttrDesc;
 	}
 
 
@@ -677,7 +676,7 @@ VkPipeline SkyboxRenderStage::CreateGraphicsPipeline(const std::string& shaderDi
 		graphicsPipelineCI.basePipelineIndex = -1;
 	}
 	VkPipeline pipeline;
-	if (vkCreateGraphicsPipelines(device, nullptr, 1, &graphicsPipelineCI, nullptr, &pipeline) != VK_SUCCESS)
+	if (pipelineCache.CreateGraphicsPipeline(graphicsPipelineCI, &pipeline) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to create Pipeline");
 	}
@@ -711,9 +710,7 @@ void SkyboxRenderStage::UpdateDescSets()
 			fragUbos[i] = skybox->FrameResources[i].FragUniformBuffer;
 		}
 
-		const auto& skyboxTexture = _resources->GetTexture(_lastOptions.ShowIrradiance
-			? skybox->IblTextureIds.IrradianceCubemapId
-			: skybox->IblTextureIds.EnvironmentCubemapId);
+		const auto& skyboxTexture = _resources->GetTexture(skybox->IblTextureIds.EnvironmentCubemapId);
 
 		WriteDescSets((u32)count, descriptorSets, vertUbos, fragUbos, skyboxTexture, _vk.LogicalDevice());
 	}
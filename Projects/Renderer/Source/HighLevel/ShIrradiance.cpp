@@ -0,0 +1,95 @@
+#include "Renderer/HighLevel/ShIrradiance.h"
+
+#include <glm/geometric.hpp>
+
+#include <cassert>
+#include <cmath>
+
+
+void ShIrradiance::AddFace(u32 face, const glm::vec4* texels, u32 dim)
+{
+	assert(face < 6 && dim > 0);
+
+	for (u32 y = 0; y < dim; y++)
+	{
+		for (u32 x = 0; x < dim; x++)
+		{
+			// Texel solid angle, up to the (2/dim)^2 area every texel shares
+			const f32 s = 2.f * (x + 0.5f) / dim - 1.f;
+			const f32 t = 2.f * (y + 0.5f) / dim - 1.f;
+			const f32 lengthSquared = 1.f + s * s + t * t;
+			const f32 weight = 1.f / (lengthSquared * std::sqrt(lengthSquared));
+
+			const auto basis = Basis(TexelDirection(face, x, y, dim));
+			const glm::vec3 radiance = glm::vec3(texels[y * dim + x]) * weight;
+			for (u32 i = 0; i < CoefficientCount; i++)
+			{
+				_radiance[i] += radiance * basis[i];
+			}
+			_solidAngle += weight;
+		}
+	}
+}
+
+ShIrradiance::Coefficients ShIrradiance::Irradiance() const
+{
+	if (_solidAngle <= 0)
+		return {};
+
+	// Convolution with the clamped cosine per band, over pi. Bands 0, 1 and 2 are 1, 2/3 and 1/4.
+	constexpr f32 pi = 3.14159265359f;
+	constexpr std::array<f32, CoefficientCount> band = { 1.f, 2.f / 3, 2.f / 3, 2.f / 3, .25f, .25f, .25f, .25f, .25f };
+	const f32 normalise = 4.f * pi / (f32)_solidAngle;
+
+	Coefficients irradiance{};
+	for (u32 i = 0; i < CoefficientCount; i++)
+	{
+		irradiance[i] = _radiance[i] * normalise * band[i];
+	}
+	return irradiance;
+}
+
+glm::vec3 ShIrradiance::Evaluate(const Coefficients& sh, const glm::vec3& direction)
+{
+	const auto basis = Basis(direction);
+	glm::vec3 result{ 0 };
+	for (u32 i = 0; i < CoefficientCount; i++)
+	{
+		result += sh[i] * basis[i];
+	}
+	return glm::max(result, glm::vec3{ 0 });
+}
+
+glm::vec3 ShIrradiance::TexelDirection(u32 face, u32 x, u32 y, u32 dim)
+{
+	const f32 s = 2.f * (x + 0.5f) / dim - 1.f;
+	const f32 t = 2.f * (y + 0.5f) / dim - 1.f;
+
+	glm::vec3 direction{};
+	switch (face)
+	{
+	case 0: direction = { 1, -t, -s }; break;
+	case 1: direction = { -1, -t, s }; break;
+	case 2: direction = { s, 1, t }; break;
+	case 3: direction = { s, -1, -t }; break;
+	case 4: direction = { s, -t, 1 }; break;
+	default: direction = { -s, -t, -1 }; break;
+	}
+	return glm::normalize(direction);
+}
+
+// Real SH basis in the usual order: l=0, then l=1 (y, z, x), then l=2 (xy, yz, 3z^2-1, xz, x^2-y^2)
+std::array<f32, ShIrradiance::CoefficientCount> ShIrradiance::Basis(const glm::vec3& d)
+{
+	return {
+		0.282095f,
+		0.488603f * d.y,
+		0.488603f * d.z,
+		0.488603f * d.x,
+		1.092548f * d.x * d.y,
+		1.092548f * d.y * d.z,
+		0.315392f * (3.f * d.z * d.z - 1.f),
+		1.092548f * d.x * d.z,
+		0.546274f * (d.x * d.x - d.y * d.y),
+	};
+}
@@ -0,0 +1,148 @@
+#include "Renderer/HighLevel/ShadowCascades.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+
+Extent2D ShadowCascades::AtlasExtent(u32 cascadeCount, u32 resolution)
+{
+	const u32 columns = std::min(cascadeCount, 2u);
+	const u32 rows = (cascadeCount + 1) / 2;
+	return Extent2D{ columns * resolution, rows * resolution };
+}
+
+void ShadowCascades::Build(const BuildInfo& info)
+{
+	assert(info.CascadeCount > 0 && info.CascadeCount <= MaxCascades && info.Resolution > 0);
+	assert(info.Near > 0 && info.MaxDistance > info.Near);
+
+	_count = 0;
+	_resolution = info.Resolution;
+
+	const bool hasSceneBounds = !info.SceneBounds.IsEmpty();
+	const auto sceneCorners = info.SceneBounds.Corners();
+
+
+	// Depth range holding receivers, so no cascade is spent on empty space
+	f32 nearDepth = info.Near;
+	f32 farDepth = info.MaxDistance;
+	if (hasSceneBounds)
+	{
+		f32 minDepth = std::numeric_limits<f32>::max();
+		f32 maxDepth = std::numeric_limits<f32>::lowest();
+		for (const auto& corner : sceneCorners)
+		{
+			const f32 depth = -(info.View * glm::vec4(corner, 1)).z;
+			minDepth = std::min(minDepth, depth);
+			maxDepth = std::max(maxDepth, depth);
+		}
+		nearDepth = std::clamp(minDepth, info.Near, info.MaxDistance);
+		farDepth = std::clamp(maxDepth, info.Near, info.MaxDistance);
+	}
+	if (farDepth <= nearDepth)
+		return;
+
+
+	// Light looks down -Z of its view space. Any up vector works, a fixed one keeps the texel grid still.
+	const glm::vec3 lightDir = glm::normalize(info.LightDirection);
+	const glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	const glm::mat4 lightView = glm::lookAtRH(lightDir, glm::vec3(0), up);
+	const glm::mat4 cameraToLight = lightView * glm::inverse(info.View);
+
+	glm::vec3 sceneMin{ std::numeric_limits<f32>::lowest() };
+	glm::vec3 sceneMax{ std::numeric_limits<f32>::max() };
+	if (hasSceneBounds)
+	{
+		sceneMin = glm::vec3{ std::numeric_limits<f32>::max() };
+		sceneMax = glm::vec3{ std::numeric_limits<f32>::lowest() };
+		for (const auto& corner : sceneCorners)
+		{
+			const glm::vec3 p = lightView * glm::vec4(corner, 1);
+			sceneMin = glm::min(sceneMin, p);
+			sceneMax = glm::max(sceneMax, p);
+		}
+	}
+
+	const f32 tanX = 1.f / info.Projection[0][0];
+	const f32 tanY = 1.f / std::abs(info.Projection[1][1]);
+	const u32 count = info.CascadeCount;
+	const Extent2D atlas = AtlasExtent(count, info.Resolution);
+
+	f32 sliceNear = nearDepth;
+	for (u32 i = 0; i < count; i++)
+	{
+		const f32 t = f32(i + 1) / count;
+		const f32 logSplit = nearDepth * std::pow(farDepth / nearDepth, t);
+		const f32 uniformSplit = nearDepth + (farDepth - nearDepth) * t;
+		const f32 sliceFar = i + 1 == count ? farDepth : glm::mix(uniformSplit, logSplit, info.SplitLambda);
+
+
+		// Slice corners in light space. Their bounding sphere only depends on the slice's shape, so the cascade's
+		// size and texel size stay fixed as the camera turns. Radius is rounded up to damp float noise.
+		std::array<glm::vec3, 8> corners{};
+		glm::vec3 center{ 0 };
+		for (u32 c = 0; c < 8; c++)
+		{
+			const f32 depth = c < 4 ? sliceNear : sliceFar;
+			const glm::vec4 viewPos{ (c & 1 ? 1 : -1) * depth * tanX, (c & 2 ? 1 : -1) * depth * tanY, -depth, 1 };
+			corners[c] = cameraToLight * viewPos;
+			center += corners[c];
+		}
+		center /= 8.f;
+
+		f32 radius = 0;
+		for (const auto& corner : corners)
+		{
+			radius = std::max(radius, glm::length(corner - center));
+		}
+		radius = std::ceil(radius * 16.f) / 16.f;
+
+
+		// Slide the square over the scene on each axis, so it covers all of the scene where the scene fits and otherwise
+		// doesn't hang past it. Receivers the slice loses that way lie outside the scene. A cascade covering the whole
+		// scene ends up depending only on the light and the scene, so it stays the same, and its cached tile valid, while
+		// the camera moves. Then snap to the texel grid. The square is never resized, which would change the texel size.
+		glm::vec2 rectMin = glm::vec2(center) - radius;
+		if (hasSceneBounds)
+		{
+			for (u32 axis = 0; axis < 2; axis++)
+			{
+				rectMin[axis] = sceneMax[axis] - sceneMin[axis] <= 2.f * radius
+					? (sceneMin[axis] + sceneMax[axis]) / 2.f - radius
+					: std::clamp(rectMin[axis], sceneMin[axis], sceneMax[axis] - 2.f * radius);
+			}
+		}
+		const f32 texel = 2.f * radius / info.Resolution;
+		rectMin = glm::floor(rectMin / texel) * texel;
+		const glm::vec2 rectMax = rectMin + glm::vec2(2.f * radius);
+
+		// Depth from the casters nearest the light to the back of the slice, snapped in 1/16ths of the cascade size.
+		// Without bounds, reach a slice's worth further towards the light.
+		const f32 depthStep = radius / 8.f;
+		const f32 zNear = hasSceneBounds ? -sceneMax.z : std::floor((-(center.z + radius) - 2.f * radius) / depthStep) * depthStep;
+		f32 zFar = std::ceil(-(center.z - radius) / depthStep) * depthStep;
+		if (hasSceneBounds)
+			zFar = std::min(zFar, -sceneMin.z);
+		zFar = std::max(zFar, zNear + 0.01f);
+
+		const glm::mat4 projection = glm::orthoRH_ZO(rectMin.x, rectMax.x, rectMin.y, rectMax.y, zNear, zFar);
+
+		auto& cascade = _cascades[i];
+		cascade.ViewProjection = projection * lightView;
+		cascade.AtlasX = (i % 2) * info.Resolution;
+		cascade.AtlasY = (i / 2) * info.Resolution;
+		cascade.AtlasRect = glm::vec4(
+			cascade.AtlasX / (f32)atlas.Width, cascade.AtlasY / (f32)atlas.Height,
+			info.Resolution / (f32)atlas.Width, info.Resolution / (f32)atlas.Height);
+		cascade.FarDepth = sliceFar;
+
+		sliceNear = sliceFar;
+	}
+
+	_count = count;
+}
@@ -0,0 +1,399 @@
+#include "Renderer/LowLevel/GpuMemoryAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace
+{
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return alignment > 1 ? (value + alignment - 1) & ~(alignment - 1) : value;
+	}
+}
+
+
+GpuMemoryAllocator::GpuMemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+	: _device(device), _blockSize(blockSize)
+{
+	assert(physicalDevice);
+	assert(device);
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &_memoryProperties);
+}
+
+GpuMemoryAllocator::~GpuMemoryAllocator()
+{
+	u32 leakedAllocations = 0;
+
+	for (auto& pool : _pools)
+	{
+		for (auto& block : pool.Blocks)
+		{
+			if (!block.Memory)
+				continue;
+
+			leakedAllocations += block.AllocationCount;
+			ReleaseBlock(block);
+		}
+	}
+
+	if (leakedAllocations > 0)
+	{
+		std::cerr << "GpuMemoryAllocator destroyed with " << leakedAllocations << " live allocation(s)" << std::endl;
+	}
+}
+
+GpuAllocation GpuMemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+	VkMemoryPropertyFlags propertyFlags, GpuResourceKind resourceKind, GpuPoolKind poolKind)
+{
+	std::lock_guard lock{ _mutex };
+
+	const u32 memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, propertyFlags);
+
+	u32 poolIndex;
+	Pool& pool = GetOrCreatePool(memoryTypeIndex, resourceKind, poolKind, poolIndex);
+
+	u32 blockIndex = UINT32_MAX;
+	VkDeviceSize offset = 0;
+
+	if (requirements.size > _blockSize / 2)
+	{
+		// Big resources (render targets, large cubemaps) get a block to themselves rather than fragmenting the pools
+		blockIndex = CreateBlock(pool, requirements.size, true);
+	}
+	else
+	{
+		for (u32 i = 0; i < (u32)pool.Blocks.size(); i++)
+		{
+			auto& block = pool.Blocks[i];
+			if (block.Memory && !block.Dedicated &&
+				TryAllocateFromBlock(block, poolKind, requirements.size, requirements.alignment, offset))
+			{
+				blockIndex = i;
+				break;
+			}
+		}
+
+		if (blockIndex == UINT32_MAX)
+		{
+			blockIndex = CreateBlock(pool, _blockSize, false);
+			if (!TryAllocateFromBlock(pool.Blocks[blockIndex], poolKind, requirements.size, requirements.alignment, offset))
+			{
+				throw std::runtime_error("Failed to sub-allocate from a new memory block");
+			}
+		}
+	}
+
+	auto& block = pool.Blocks[blockIndex];
+	block.AllocationCount++;
+	block.BytesUsed += requirements.size;
+
+	GpuAllocation allocation{};
+	allocation.Memory = block.Memory;
+	allocation.Offset = offset;
+	allocation.Size = requirements.size;
+	allocation.Mapped = block.Mapped ? block.Mapped + offset : nullptr;
+	allocation.PoolIndex = poolIndex;
+	allocation.BlockIndex = blockIndex;
+	return allocation;
+}
+
+void GpuMemoryAllocator::Free(GpuAllocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	std::lock_guard lock{ _mutex };
+
+	auto& pool = _pools[allocation.PoolIndex];
+	auto& block = pool.Blocks[allocation.BlockIndex];
+	assert(block.Memory == allocation.Memory);
+	assert(block.AllocationCount > 0);
+
+	block.AllocationCount--;
+	block.BytesUsed -= allocation.Size;
+
+	if (block.Dedicated)
+	{
+		ReleaseBlock(block);
+	}
+	else
+	{
+		if (pool.PoolKind == GpuPoolKind::FreeList)
+		{
+			FreeRange(block, allocation.Offset, allocation.Size);
+		}
+
+		if (block.AllocationCount == 0)
+		{
+			block.LinearHead = 0;
+
+			// Keep one empty block around per pool so alloc/free churn doesn't thrash vkAllocateMemory
+			const auto liveBlocks = std::count_if(pool.Blocks.begin(), pool.Blocks.end(),
+				[](const Block& b) { return b.Memory && !b.Dedicated; });
+			if (liveBlocks > 1)
+			{
+				ReleaseBlock(block);
+			}
+		}
+	}
+
+	allocation = GpuAllocation{};
+}
+
+std::vector<GpuPoolStats> GpuMemoryAllocator::GetStats() const
+{
+	std::lock_guard lock{ _mutex };
+
+	std::vector<GpuPoolStats> stats{};
+	stats.reserve(_pools.size());
+
+	for (const auto& pool : _pools)
+	{
+		GpuPoolStats s{};
+		s.MemoryTypeIndex = pool.MemoryTypeIndex;
+		s.ResourceKind = pool.ResourceKind;
+		s.PoolKind = pool.PoolKind;
+
+		for (const auto& block : pool.Blocks)
+		{
+			if (!block.Memory)
+				continue;
+
+			if (block.Dedicated)
+				s.DedicatedBlockCount++;
+			else
+				s.BlockCount++;
+
+			s.AllocationCount += block.AllocationCount;
+			s.BytesReserved += block.Size;
+			s.BytesUsed += block.BytesUsed;
+
+			if (block.Dedicated)
+				continue;
+
+			if (pool.PoolKind == GpuPoolKind::FreeList)
+			{
+				for (const auto& range : block.FreeRanges)
+				{
+					s.LargestFreeRange = std::max(s.LargestFreeRange, range.Size);
+				}
+			}
+			else
+			{
+				s.LargestFreeRange = std::max(s.LargestFreeRange, block.Size - block.LinearHead);
+			}
+		}
+
+		stats.emplace_back(s);
+	}
+
+	return stats;
+}
+
+void GpuMemoryAllocator::PrintStats() const
+{
+	const auto stats = GetStats();
+	const auto toMiB = [](VkDeviceSize bytes) { return (f64)bytes / (1024.0 * 1024.0); };
+
+	std::cout << "GpuMemoryAllocator: " << DeviceAllocationCount() << " device allocation(s)\n";
+	for (const auto& s : stats)
+	{
+		printf("  type %2u %-6s %-8s blocks %3u (+%3u dedicated)  allocs %6u  used %8.2f / %8.2f MiB  largest free %8.2f MiB\n",
+			s.MemoryTypeIndex,
+			s.ResourceKind == GpuResourceKind::Buffer ? "buffer" : "image",
+			s.PoolKind == GpuPoolKind::FreeList ? "freelist" : "linear",
+			s.BlockCount, s.DedicatedBlockCount, s.AllocationCount,
+			toMiB(s.BytesUsed), toMiB(s.BytesReserved), toMiB(s.LargestFreeRange));
+	}
+	std::cout << std::flush;
+}
+
+u32 GpuMemoryAllocator::DeviceAllocationCount() const
+{
+	std::lock_guard lock{ _mutex };
+	return _deviceAllocationCount;
+}
+
+u32 GpuMemoryAllocator::FindMemoryType(u32 typeFilter, VkMemoryPropertyFlags propertyFlags) const
+{
+	for (u32 i = 0; i < _memoryProperties.memoryTypeCount; i++)
+	{
+		const bool flagExists = typeFilter & (1 << i);
+		const bool propertiesMatch = (_memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags;
+
+		if (flagExists && propertiesMatch)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+GpuMemoryAllocator::Pool& GpuMemoryAllocator::GetOrCreatePool(u32 memoryTypeIndex, GpuResourceKind resourceKind,
+	GpuPoolKind poolKind, u32& outPoolIndex)
+{
+	for (u32 i = 0; i < (u32)_pools.size(); i++)
+	{
+		auto& pool = _pools[i];
+		if (pool.MemoryTypeIndex == memoryTypeIndex && pool.ResourceKind == resourceKind && pool.PoolKind == poolKind)
+		{
+			outPoolIndex = i;
+			return pool;
+		}
+	}
+
+	outPoolIndex = (u32)_pools.size();
+	Pool pool{};
+	pool.MemoryTypeIndex = memoryTypeIndex;
+	pool.ResourceKind = resourceKind;
+	pool.PoolKind = poolKind;
+	return _pools.emplace_back(std::move(pool));
+}
+
+u32 GpuMemoryAllocator::CreateBlock(Pool& pool, VkDeviceSize size, bool dedicated)
+{
+	VkMemoryAllocateInfo allocInfo = {};
+	{
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = pool.MemoryTypeIndex;
+	}
+
+	VkDeviceMemory memory = nullptr;
+	if (VK_SUCCESS != vkAllocateMemory(_device, &allocInfo, nullptr, &memory))
+	{
+		throw std::runtime_error("Failed to allocate device memory block");
+	}
+	_deviceAllocationCount++;
+
+	Block block{};
+	block.Memory = memory;
+	block.Size = size;
+	block.Dedicated = dedicated;
+	if (!dedicated && pool.PoolKind == GpuPoolKind::FreeList)
+	{
+		block.FreeRanges.push_back(Range{ 0, size });
+	}
+
+	const bool hostVisible = _memoryProperties.memoryTypes[pool.MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	if (hostVisible)
+	{
+		void* data;
+		if (VK_SUCCESS != vkMapMemory(_device, memory, 0, VK_WHOLE_SIZE, 0, &data))
+		{
+			throw std::runtime_error("Failed to map device memory block");
+		}
+		block.Mapped = (u8*)data;
+	}
+
+	// Reuse a released slot if there is one
+	for (u32 i = 0; i < (u32)pool.Blocks.size(); i++)
+	{
+		if (!pool.Blocks[i].Memory)
+		{
+			pool.Blocks[i] = std::move(block);
+			return i;
+		}
+	}
+
+	pool.Blocks.emplace_back(std::move(block));
+	return (u32)pool.Blocks.size() - 1;
+}
+
+void GpuMemoryAllocator::ReleaseBlock(Block& block)
+{
+	if (block.Mapped)
+	{
+		vkUnmapMemory(_device, block.Memory);
+	}
+	vkFreeMemory(_device, block.Memory, nullptr);
+	_deviceAllocationCount--;
+
+	block = Block{};
+}
+
+bool GpuMemoryAllocator::TryAllocateFromBlock(Block& block, GpuPoolKind poolKind, VkDeviceSize size,
+	VkDeviceSize alignment, VkDeviceSize& outOffset)
+{
+	if (poolKind == GpuPoolKind::Linear)
+	{
+		const auto offset = AlignUp(block.LinearHead, alignment);
+		if (offset + size > block.Size)
+			return false;
+
+		block.LinearHead = offset + size;
+		outOffset = offset;
+		return true;
+	}
+
+	// First fit. Alignment padding at the front of a range stays on the free list so Free() can return exactly
+	// [offset, offset+size) and coalescing restores the original range.
+	for (size_t i = 0; i < block.FreeRanges.size(); i++)
+	{
+		auto& range = block.FreeRanges[i];
+		const auto offset = AlignUp(range.Offset, alignment);
+		const auto end = offset + size;
+		const auto rangeEnd = range.Offset + range.Size;
+		if (end > rangeEnd)
+			continue;
+
+		const auto padding = offset - range.Offset;
+		const auto tail = rangeEnd - end;
+
+		if (padding > 0 && tail > 0)
+		{
+			range.Size = padding;
+			block.FreeRanges.insert(block.FreeRanges.begin() + i + 1, Range{ end, tail });
+		}
+		else if (padding > 0)
+		{
+			range.Size = padding;
+		}
+		else if (tail > 0)
+		{
+			range = Range{ end, tail };
+		}
+		else
+		{
+			block.FreeRanges.erase(block.FreeRanges.begin() + i);
+		}
+
+		outOffset = offset;
+		return true;
+	}
+
+	return false;
+}
+
+void GpuMemoryAllocator::FreeRange(Block& block, VkDeviceSize offset, VkDeviceSize size)
+{
+	auto& ranges = block.FreeRanges;
+
+	auto it = std::lower_bound(ranges.begin(), ranges.end(), offset,
+		[](const Range& r, VkDeviceSize o) { return r.Offset < o; });
+	it = ranges.insert(it, Range{ offset, size });
+
+	// Coalesce with next
+	auto next = it + 1;
+	if (next != ranges.end() && it->Offset + it->Size == next->Offset)
+	{
+		it->Size += next->Size;
+		it = ranges.erase(next) - 1;
+	}
+
+	// Coalesce with previous
+	if (it != ranges.begin())
+	{
+		auto prev = it - 1;
+		if (prev->Offset + prev->Size == it->Offset)
+		{
+			prev->Size += it->Size;
+			ranges.erase(it);
+		}
+	}
+}
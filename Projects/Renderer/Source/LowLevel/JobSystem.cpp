@@ -0,0 +1,131 @@
+#include "Renderer/LowLevel/JobSystem.h"
+
+#include <algorithm>
+
+
+JobSystem::JobSystem(u32 threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	_workers.reserve(threadCount - 1);
+	for (u32 i = 1; i < threadCount; i++)
+	{
+		_workers.emplace_back([this, i]() { WorkerLoop(i); });
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock(_mutex);
+		_stopping = true;
+	}
+	_workAvailable.notify_all();
+
+	for (auto& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::Run(u32 jobCount, const JobFunction& job)
+{
+	if (jobCount == 0)
+		return;
+
+	// Not worth waking anyone for
+	if (jobCount == 1 || _workers.empty())
+	{
+		for (u32 i = 0; i < jobCount; i++)
+		{
+			job(i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard lock(_mutex);
+		_job = &job;
+		_jobCount = jobCount;
+		_nextJob = 0;
+		_jobsDone = 0;
+		_error = nullptr;
+		_generation++;
+	}
+	_workAvailable.notify_all();
+
+	ExecuteJobs(job, jobCount, 0);
+
+	std::exception_ptr error;
+	{
+		std::unique_lock lock(_mutex);
+		_workDone.wait(lock, [this]() { return _jobsDone == _jobCount && _activeWorkers == 0; });
+		_job = nullptr;
+		error = _error;
+		_error = nullptr;
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void JobSystem::WorkerLoop(u32 thread)
+{
+	u64 seenGeneration = 0;
+
+	while (true)
+	{
+		const JobFunction* job;
+		u32 jobCount;
+		{
+			std::unique_lock lock(_mutex);
+			_workAvailable.wait(lock, [&]() { return _stopping || (_job && _generation != seenGeneration); });
+			if (_stopping)
+				return;
+
+			seenGeneration = _generation;
+			job = _job;
+			jobCount = _jobCount;
+			_activeWorkers++;
+		}
+
+		ExecuteJobs(*job, jobCount, thread);
+
+		{
+			std::lock_guard lock(_mutex);
+			_activeWorkers--;
+		}
+		_workDone.notify_one();
+	}
+}
+
+void JobSystem::ExecuteJobs(const JobFunction& job, u32 jobCount, u32 thread)
+{
+	for (u32 i = _nextJob.fetch_add(1); i < jobCount; i = _nextJob.fetch_add(1))
+	{
+		try
+		{
+			job(i, thread);
+		}
+		catch (...)
+		{
+			std::lock_guard lock(_mutex);
+			if (!_error)
+			{
+				_error = std::current_exception();
+			}
+		}
+
+		std::lock_guard lock(_mutex);
+		_jobsDone++;
+		if (_jobsDone == jobCount)
+		{
+			_workDone.notify_one();
+		}
+	}
+}
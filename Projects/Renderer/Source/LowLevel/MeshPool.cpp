@@ -0,0 +1,204 @@
+#include "Renderer/LowLevel/MeshPool.h"
+
+#include "Renderer/LowLevel/GpuTypes.h"
+#include "Renderer/LowLevel/UploadBatcher.h"
+#include "Renderer/LowLevel/VulkanHelpers.h"
+#include "Renderer/LowLevel/VulkanService.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+using vkh = VulkanHelpers;
+
+
+std::optional<u64> MeshPool::RangeAllocator::Allocate(u64 size, u64 alignment)
+{
+	for (size_t i = 0; i < FreeRanges.size(); i++)
+	{
+		auto& range = FreeRanges[i];
+		const u64 alignedOffset = (range.Offset + alignment - 1) / alignment * alignment;
+		const u64 padding = alignedOffset - range.Offset;
+		if (range.Size < padding + size)
+			continue;
+
+		const Range remainder{ alignedOffset + size, range.Size - padding - size };
+		if (padding > 0)
+		{
+			range.Size = padding;
+			if (remainder.Size > 0)
+				FreeRanges.insert(FreeRanges.begin() + i + 1, remainder);
+		}
+		else if (remainder.Size > 0)
+		{
+			range = remainder;
+		}
+		else
+		{
+			FreeRanges.erase(FreeRanges.begin() + i);
+		}
+
+		return alignedOffset;
+	}
+
+	return std::nullopt;
+}
+
+void MeshPool::RangeAllocator::Free(u64 offset, u64 size)
+{
+	auto it = std::lower_bound(FreeRanges.begin(), FreeRanges.end(), offset,
+		[](const Range& range, u64 value) { return range.Offset < value; });
+	it = FreeRanges.insert(it, Range{ offset, size });
+
+	// Coalesce with the next then the previous neighbour
+	if (it + 1 != FreeRanges.end() && it->Offset + it->Size == (it + 1)->Offset)
+	{
+		it->Size += (it + 1)->Size;
+		FreeRanges.erase(it + 1);
+	}
+	if (it != FreeRanges.begin() && (it - 1)->Offset + (it - 1)->Size == it->Offset)
+	{
+		(it - 1)->Size += it->Size;
+		FreeRanges.erase(it);
+	}
+}
+
+
+MeshPool::MeshPool(VulkanService& vk, u32 chunkVertexCapacity, u64 chunkIndexBytes)
+	: _vk(&vk), _chunkVertexCapacity(chunkVertexCapacity), _chunkIndexBytes(chunkIndexBytes)
+{
+}
+
+MeshPool::~MeshPool()
+{
+	auto* device = _vk->LogicalDevice();
+	auto& allocator = _vk->MemoryAllocator();
+
+	for (auto& chunk : _chunks)
+	{
+		vkDestroyBuffer(device, chunk.PositionBuffer, nullptr);
+		vkDestroyBuffer(device, chunk.AttributeBuffer, nullptr);
+		vkDestroyBuffer(device, chunk.IndexBuffer, nullptr);
+		allocator.Free(chunk.PositionAllocation);
+		allocator.Free(chunk.AttributeAllocation);
+		allocator.Free(chunk.IndexAllocation);
+	}
+}
+
+MeshPoolAllocation MeshPool::Add(const glm::vec3* positions, const PackedVertexAttributes* attributes,
+	u32 vertexCount, const u32* indices, u32 indexCount, UploadBatcher& uploader)
+{
+	assert(vertexCount > 0 && indexCount > 0);
+
+	MeshPoolAllocation alloc{};
+	alloc.VertexCount = vertexCount;
+	alloc.IndexCount = indexCount;
+	alloc.IndexType = vertexCount <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	const u64 indexSize = alloc.IndexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+	const u64 indexBytes = indexSize * indexCount;
+
+
+	// First chunk with room for both, otherwise a new one. Oversized meshes get a chunk of their own.
+	std::optional<u64> vertexOffset{};
+	std::optional<u64> indexOffset{};
+	for (u32 i = 0; i < (u32)_chunks.size() && !alloc.IsValid(); i++)
+	{
+		auto& chunk = _chunks[i];
+		vertexOffset = chunk.Vertices.Allocate(vertexCount, 1);
+		if (!vertexOffset)
+			continue;
+
+		indexOffset = chunk.Indices.Allocate(indexBytes, indexSize);
+		if (!indexOffset)
+		{
+			chunk.Vertices.Free(*vertexOffset, vertexCount);
+			continue;
+		}
+
+		alloc.Chunk = i;
+	}
+
+	if (!alloc.IsValid())
+	{
+		alloc.Chunk = CreateChunk(std::max(_chunkVertexCapacity, vertexCount), std::max(_chunkIndexBytes, indexBytes));
+		vertexOffset = _chunks[alloc.Chunk].Vertices.Allocate(vertexCount, 1);
+		indexOffset = _chunks[alloc.Chunk].Indices.Allocate(indexBytes, indexSize);
+		assert(vertexOffset && indexOffset);
+	}
+
+	alloc.VertexOffset = (u32)*vertexOffset;
+	alloc.FirstIndex = (u32)(*indexOffset / indexSize);
+
+
+	// Queue the uploads
+	const auto& chunk = _chunks[alloc.Chunk];
+
+	uploader.UploadBuffer(chunk.PositionBuffer, *vertexOffset * sizeof(glm::vec3), positions,
+		sizeof(glm::vec3) * vertexCount, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	uploader.UploadBuffer(chunk.AttributeBuffer, *vertexOffset * sizeof(PackedVertexAttributes), attributes,
+		sizeof(PackedVertexAttributes) * vertexCount, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+	if (alloc.IndexType == VK_INDEX_TYPE_UINT16)
+	{
+		std::vector<u16> indices16(indexCount);
+		for (u32 i = 0; i < indexCount; i++)
+		{
+			indices16[i] = (u16)indices[i];
+		}
+		uploader.UploadBuffer(chunk.IndexBuffer, *indexOffset, indices16.data(), indexBytes,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	}
+	else
+	{
+		uploader.UploadBuffer(chunk.IndexBuffer, *indexOffset, indices, indexBytes,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	}
+
+	return alloc;
+}
+
+void MeshPool::Remove(MeshPoolAllocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	auto& chunk = _chunks[allocation.Chunk];
+	const u64 indexSize = allocation.IndexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+
+	chunk.Vertices.Free(allocation.VertexOffset, allocation.VertexCount);
+	chunk.Indices.Free(allocation.FirstIndex * indexSize, allocation.IndexCount * indexSize);
+
+	allocation = {};
+}
+
+u32 MeshPool::CreateChunk(u32 vertexCapacity, u64 indexBytes)
+{
+	auto* device = _vk->LogicalDevice();
+	auto& allocator = _vk->MemoryAllocator();
+
+	Chunk chunk{};
+
+	std::tie(chunk.PositionBuffer, chunk.PositionAllocation) = vkh::CreateBuffer(sizeof(glm::vec3) * vertexCapacity,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		allocator, device);
+
+	std::tie(chunk.AttributeBuffer, chunk.AttributeAllocation) = vkh::CreateBuffer(sizeof(PackedVertexAttributes) * vertexCapacity,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		allocator, device);
+
+	std::tie(chunk.IndexBuffer, chunk.IndexAllocation) = vkh::CreateBuffer(indexBytes,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		allocator, device);
+
+	chunk.Vertices.Capacity = vertexCapacity;
+	chunk.Vertices.FreeRanges.push_back({ 0, vertexCapacity });
+	chunk.Indices.Capacity = indexBytes;
+	chunk.Indices.FreeRanges.push_back({ 0, indexBytes });
+
+	_chunks.push_back(std::move(chunk));
+	return (u32)_chunks.size() - 1;
+}
@@ -0,0 +1,140 @@
+#include "Renderer/LowLevel/ParallelCommandRecorder.h"
+
+#include "Renderer/LowLevel/JobSystem.h"
+#include "Renderer/LowLevel/VulkanInitializers.h"
+#include "Renderer/LowLevel/VulkanService.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+ParallelCommandRecorder::ParallelCommandRecorder(VulkanService& vk, JobSystem& jobs, u32 numImagesInFlight)
+	: _vk(&vk), _jobs(&jobs)
+{
+	CreatePools(numImagesInFlight);
+}
+
+ParallelCommandRecorder::~ParallelCommandRecorder()
+{
+	DestroyPools();
+}
+
+void ParallelCommandRecorder::BeginFrame(u32 frameIndex)
+{
+	_frameIndex = frameIndex;
+
+	for (auto& thread : _frames[frameIndex])
+	{
+		if (thread.Used > 0)
+		{
+			vkResetCommandPool(_vk->LogicalDevice(), thread.Pool, 0);
+			thread.Used = 0;
+		}
+	}
+}
+
+void ParallelCommandRecorder::RecordAndExecute(VkCommandBuffer primaryCommandBuffer, VkRenderPass renderPass,
+	VkFramebuffer framebuffer, u32 itemCount, u32 minItemsPerChunk, const RecordFunction& record)
+{
+	// Enough items per chunk to be worth a secondary and a thread hand-off
+	const u32 maxChunks = (itemCount + std::max(1u, minItemsPerChunk) - 1) / std::max(1u, minItemsPerChunk);
+	const u32 chunkCount = std::clamp(maxChunks, 1u, _jobs->ThreadCount());
+	const u32 itemsPerChunk = (itemCount + chunkCount - 1) / chunkCount;
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	const auto beginInfo = vki::CommandBufferBeginInfo(
+		VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, &inheritanceInfo);
+
+	_recorded.assign(chunkCount, nullptr);
+
+	_jobs->Run(chunkCount, [&](u32 chunk, u32 thread)
+	{
+		const u32 firstItem = std::min(itemCount, chunk * itemsPerChunk);
+		const u32 chunkItems = std::min(itemCount - firstItem, itemsPerChunk);
+
+		VkCommandBuffer commandBuffer = NextBuffer(thread);
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording secondary command buffer");
+		}
+
+		record(commandBuffer, firstItem, chunkItems);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to record secondary command buffer");
+		}
+
+		_recorded[chunk] = commandBuffer;
+	});
+
+	vkCmdExecuteCommands(primaryCommandBuffer, (u32)_recorded.size(), _recorded.data());
+}
+
+void ParallelCommandRecorder::HandleSwapchainRecreated(u32 numImagesInFlight)
+{
+	DestroyPools();
+	CreatePools(numImagesInFlight);
+}
+
+void ParallelCommandRecorder::CreatePools(u32 numImagesInFlight)
+{
+	VkCommandPoolCreateInfo poolCI = {};
+	poolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCI.queueFamilyIndex = _vk->QueueFamilies().GraphicsAndComputeFamily.value();
+	poolCI.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Reset as a whole in BeginFrame()
+
+	_frames.resize(numImagesInFlight);
+	for (auto& frame : _frames)
+	{
+		frame.resize(_jobs->ThreadCount());
+		for (auto& thread : frame)
+		{
+			if (vkCreateCommandPool(_vk->LogicalDevice(), &poolCI, nullptr, &thread.Pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("Failed to create Command Pool");
+			}
+		}
+	}
+}
+
+void ParallelCommandRecorder::DestroyPools()
+{
+	for (auto& frame : _frames)
+	{
+		for (auto& thread : frame)
+		{
+			// Frees its command buffers too
+			vkDestroyCommandPool(_vk->LogicalDevice(), thread.Pool, nullptr);
+		}
+	}
+	_frames.clear();
+}
+
+VkCommandBuffer ParallelCommandRecorder::NextBuffer(u32 thread)
+{
+	auto& pool = _frames[_frameIndex][thread];
+
+	if (pool.Used == pool.Buffers.size())
+	{
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool.Pool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(_vk->LogicalDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to allocate secondary command buffer");
+		}
+		pool.Buffers.push_back(commandBuffer);
+	}
+
+	return pool.Buffers[pool.Used++];
+}
@@ -0,0 +1,151 @@
+#include "Renderer/LowLevel/PipelineCache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+
+PipelineCache::PipelineCache(VkPhysicalDevice physicalDevice, VkDevice device, std::string path)
+	: _device(device), _path(std::move(path))
+{
+	vkGetPhysicalDeviceProperties(physicalDevice, &_deviceProperties);
+
+	const auto data = TryReadFile();
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(_device, &createInfo, nullptr, &_cache) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create pipeline cache");
+	}
+}
+
+PipelineCache::~PipelineCache()
+{
+	vkDestroyPipelineCache(_device, _cache, nullptr);
+}
+
+VkResult PipelineCache::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* outPipeline)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const auto result = vkCreateGraphicsPipelines(_device, _cache, 1, &createInfo, nullptr, outPipeline);
+	_stats.PipelinesCreated++;
+	_stats.CreateMs += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+VkResult PipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline* outPipeline)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const auto result = vkCreateComputePipelines(_device, _cache, 1, &createInfo, nullptr, outPipeline);
+	_stats.PipelinesCreated++;
+	_stats.CreateMs += std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+void PipelineCache::Save() const
+{
+	if (_path.empty())
+		return;
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(_device, _cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+		return;
+
+	std::vector<char> bytes(sizeof(FileHeader) + dataSize);
+	if (vkGetPipelineCacheData(_device, _cache, &dataSize, bytes.data() + sizeof(FileHeader)) != VK_SUCCESS)
+		return;
+	bytes.resize(sizeof(FileHeader) + dataSize);
+
+	FileHeader header{};
+	header.Magic = Magic;
+	header.FormatVersion = FormatVersion;
+	header.VendorId = _deviceProperties.vendorID;
+	header.DeviceId = _deviceProperties.deviceID;
+	header.DriverVersion = _deviceProperties.driverVersion;
+	memcpy(header.PipelineCacheUuid, _deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.DataChecksum = Checksum(bytes.data() + sizeof(FileHeader), dataSize);
+	header.DataSize = dataSize;
+	memcpy(bytes.data(), &header, sizeof(FileHeader));
+
+
+	// Write to a temp file and swap it in, so an interrupted write never leaves a truncated cache behind
+	const std::filesystem::path path = _path;
+	std::error_code ec;
+	if (path.has_parent_path())
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+	auto tempPath = path;
+	tempPath += ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file || !file.write(bytes.data(), bytes.size()))
+		{
+			std::cerr << "Failed to write pipeline cache: " << tempPath.string() << "\n";
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, ec);
+	if (ec)
+	{
+		std::cerr << "Failed to write pipeline cache: " << path.string() << " - " << ec.message() << "\n";
+		std::filesystem::remove(tempPath, ec);
+	}
+}
+
+std::vector<char> PipelineCache::TryReadFile() const
+{
+	if (_path.empty())
+		return {};
+
+	std::ifstream file(_path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return {};
+
+	const auto fileSize = (size_t)file.tellg();
+	if (fileSize < sizeof(FileHeader))
+		return {};
+
+	FileHeader header{};
+	file.seekg(0);
+	if (!file.read((char*)&header, sizeof(FileHeader)))
+		return {};
+
+	// Drivers aren't required to survive a foreign or damaged blob, so anything unexpected is a miss
+	if (header.Magic != Magic ||
+		header.FormatVersion != FormatVersion ||
+		header.VendorId != _deviceProperties.vendorID ||
+		header.DeviceId != _deviceProperties.deviceID ||
+		header.DriverVersion != _deviceProperties.driverVersion ||
+		memcmp(header.PipelineCacheUuid, _deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+		header.DataSize != fileSize - sizeof(FileHeader))
+	{
+		return {};
+	}
+
+	std::vector<char> data(header.DataSize);
+	if (!file.read(data.data(), data.size()) || Checksum(data.data(), data.size()) != header.DataChecksum)
+	{
+		return {};
+	}
+
+	return data;
+}
+
+// FNV-1a
+u32 PipelineCache::Checksum(const char* data, size_t size)
+{
+	u32 hash = 2166136261u;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ (u8)data[i]) * 16777619u;
+	}
+	return hash;
+}
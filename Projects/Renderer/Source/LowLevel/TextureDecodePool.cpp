@@ -0,0 +1,97 @@
+#include "Renderer/LowLevel/TextureDecodePool.h"
+
+#include <stbi/stb_image.h>
+
+#include <algorithm>
+
+
+void TextureDecodePool::TexelsDeleter::operator()(unsigned char* texels) const
+{
+	stbi_image_free(texels);
+}
+
+TextureDecodePool::TextureDecodePool(u32 threadCount)
+{
+	if (threadCount == 0)
+	{
+		const u32 hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+	}
+
+	_workers.reserve(threadCount);
+	for (u32 i = 0; i < threadCount; i++)
+	{
+		_workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+TextureDecodePool::~TextureDecodePool()
+{
+	{
+		std::lock_guard lock(_mutex);
+		_stopping = true;
+		_jobs.clear();
+	}
+	_jobAvailable.notify_all();
+
+	for (auto& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+void TextureDecodePool::Enqueue(u32 id, std::string path)
+{
+	{
+		std::lock_guard lock(_mutex);
+		_jobs.push_back(Job{ id, std::move(path) });
+		_pending++;
+	}
+	_jobAvailable.notify_one();
+}
+
+void TextureDecodePool::CollectFinished(std::vector<DecodedTexture>& outFinished)
+{
+	std::lock_guard lock(_mutex);
+	_pending -= (u32)_finished.size();
+	for (auto& decoded : _finished)
+	{
+		outFinished.emplace_back(std::move(decoded));
+	}
+	_finished.clear();
+}
+
+u32 TextureDecodePool::PendingCount()
+{
+	std::lock_guard lock(_mutex);
+	return _pending;
+}
+
+void TextureDecodePool::WorkerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock lock(_mutex);
+			_jobAvailable.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+			if (_stopping)
+				return;
+
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+		}
+
+		// stbi keeps no shared state unless the global flip/convert options are changed, which we never do
+		int width, height, channels;
+		DecodedTexture decoded{};
+		decoded.Id = job.Id;
+		decoded.Texels.reset(stbi_load(job.Path.c_str(), &width, &height, &channels, STBI_rgb_alpha));
+		decoded.Width = decoded.Texels ? (u32)width : 0;
+		decoded.Height = decoded.Texels ? (u32)height : 0;
+		decoded.Path = std::move(job.Path);
+
+		std::lock_guard lock(_mutex);
+		_finished.emplace_back(std::move(decoded));
+	}
+}
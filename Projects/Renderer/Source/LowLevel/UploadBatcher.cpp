@@ -0,0 +1,412 @@
+#include "Renderer/LowLevel/UploadBatcher.h"
+
+#include "Renderer/LowLevel/VulkanHelpers.h"
+#include "Renderer/LowLevel/VulkanInitializers.h"
+#include "Renderer/LowLevel/VulkanService.h"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+using vkh = VulkanHelpers;
+
+
+namespace
+{
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	VkCommandPool CreatePool(u32 queueFamily, VkDevice device)
+	{
+		VkCommandPoolCreateInfo poolCI = {};
+		poolCI.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolCI.queueFamilyIndex = queueFamily;
+		poolCI.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+		VkCommandPool pool;
+		if (vkCreateCommandPool(device, &poolCI, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload command pool");
+		}
+		return pool;
+	}
+}
+
+
+UploadBatcher::UploadBatcher(VulkanService& vk, VkDeviceSize stagingCapacity) : _vk(&vk)
+{
+	auto* device = vk.LogicalDevice();
+	const auto& families = vk.QueueFamilies();
+
+	_graphicsFamily = families.GraphicsAndComputeFamily.value();
+	_dedicatedTransfer = families.TransferFamily.has_value() && vk.TransferQueue() != vk.GraphicsQueue();
+	_transferFamily = _dedicatedTransfer ? families.TransferFamily.value() : _graphicsFamily;
+
+	_graphicsPool = CreatePool(_graphicsFamily, device);
+	_transferPool = _dedicatedTransfer ? CreatePool(_transferFamily, device) : _graphicsPool;
+
+
+	// Staging ring
+	_stagingCapacity = stagingCapacity;
+	std::tie(_stagingBuffer, _stagingAllocation) = vkh::CreateBuffer(_stagingCapacity,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		vk.MemoryAllocator(), device);
+	assert(_stagingAllocation.Mapped);
+
+
+	// Batches
+	_batches.resize(MaxBatches);
+	for (u32 i = 0; i < MaxBatches; i++)
+	{
+		auto& batch = _batches[i];
+
+		batch.TransferCmd = vkh::AllocateCommandBuffers(1, _transferPool, device)[0];
+		batch.GraphicsCmd = _dedicatedTransfer ? vkh::AllocateCommandBuffers(1, _graphicsPool, device)[0] : batch.TransferCmd;
+
+		VkFenceCreateInfo fenceCI = {};
+		fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		VkSemaphoreCreateInfo semaphoreCI = {};
+		semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkCreateFence(device, &fenceCI, nullptr, &batch.Fence) != VK_SUCCESS ||
+			vkCreateSemaphore(device, &semaphoreCI, nullptr, &batch.TransferDone) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to create upload sync objects");
+		}
+
+		_freeBatches.push_back(MaxBatches - 1 - i);
+	}
+}
+
+UploadBatcher::~UploadBatcher()
+{
+	auto* device = _vk->LogicalDevice();
+
+	// Anything never flushed is dropped, its destinations are being torn down with us
+	if (_openBatch != -1)
+	{
+		auto& batch = _batches[_openBatch];
+		vkEndCommandBuffer(batch.TransferCmd);
+		if (_dedicatedTransfer)
+			vkEndCommandBuffer(batch.GraphicsCmd);
+		for (auto& [buffer, allocation] : batch.OversizeStaging)
+		{
+			vkDestroyBuffer(device, buffer, nullptr);
+			_vk->MemoryAllocator().Free(allocation);
+		}
+		batch.OversizeStaging.clear();
+		_openBatch = -1;
+	}
+
+	WaitIdle();
+
+	for (auto& batch : _batches)
+	{
+		vkDestroyFence(device, batch.Fence, nullptr);
+		vkDestroySemaphore(device, batch.TransferDone, nullptr);
+	}
+
+	if (_dedicatedTransfer)
+		vkDestroyCommandPool(device, _transferPool, nullptr);
+	vkDestroyCommandPool(device, _graphicsPool, nullptr);
+
+	vkDestroyBuffer(device, _stagingBuffer, nullptr);
+	_vk->MemoryAllocator().Free(_stagingAllocation);
+}
+
+UploadTicket UploadBatcher::UploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	const auto [stagingBuffer, stagingOffset] = AllocateStaging(data, size);
+	auto& batch = GetOpenBatch();
+
+	const auto region = vki::BufferCopy(dstOffset, size, stagingOffset);
+	vkCmdCopyBuffer(batch.TransferCmd, stagingBuffer, dst, 1, &region);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.buffer = dst;
+	barrier.offset = dstOffset;
+	barrier.size = size;
+
+	if (_dedicatedTransfer)
+	{
+		// Release on the transfer queue...
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = _transferFamily;
+		barrier.dstQueueFamilyIndex = _graphicsFamily;
+		vkCmdPipelineBarrier(batch.TransferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		// ...acquire on the graphics queue
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(batch.GraphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+	else
+	{
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier(batch.TransferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	return batch.Ticket;
+}
+
+UploadTicket UploadBatcher::UploadImage2D(VkImage dst, VkFormat format, u32 width, u32 height, u32 mipLevels,
+	const void* texels, VkDeviceSize size)
+{
+	const auto [stagingBuffer, stagingOffset] = AllocateStaging(texels, size);
+	auto& batch = GetOpenBatch();
+
+	const auto allMips = vki::ImageSubresourceRange(VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1);
+
+	// Every mip becomes a copy destination. GenerateMipmaps relies on this.
+	vkh::TransitionImageLayout(batch.TransferCmd, dst,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, allMips,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	const auto region = vki::BufferImageCopy(stagingOffset, 0, 0,
+		vki::ImageSubresourceLayers(VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1),
+		vki::Offset3D(0, 0, 0), vki::Extent3D(width, height, 1));
+	vkCmdCopyBufferToImage(batch.TransferCmd, stagingBuffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	if (_dedicatedTransfer)
+	{
+		// Hand the image over without changing its layout. Blits need a graphics queue, so mips are made there.
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.image = dst;
+		barrier.subresourceRange = allMips;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = _transferFamily;
+		barrier.dstQueueFamilyIndex = _graphicsFamily;
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(batch.TransferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(batch.GraphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	vkh::GenerateMipmaps(batch.GraphicsCmd, _vk->PhysicalDevice(), dst, format, width, height, mipLevels);
+
+	return batch.Ticket;
+}
+
+void UploadBatcher::Flush()
+{
+	if (_openBatch == -1)
+		return;
+
+	auto& batch = _batches[_openBatch];
+
+	if (vkEndCommandBuffer(batch.TransferCmd) != VK_SUCCESS ||
+		(_dedicatedTransfer && vkEndCommandBuffer(batch.GraphicsCmd) != VK_SUCCESS))
+	{
+		throw std::runtime_error("Failed to end recording upload command buffer");
+	}
+
+	if (_dedicatedTransfer)
+	{
+		VkSubmitInfo transferSubmit = {};
+		transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		transferSubmit.commandBufferCount = 1;
+		transferSubmit.pCommandBuffers = &batch.TransferCmd;
+		transferSubmit.signalSemaphoreCount = 1;
+		transferSubmit.pSignalSemaphores = &batch.TransferDone;
+
+		if (vkQueueSubmit(_vk->TransferQueue(), 1, &transferSubmit, nullptr) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit upload transfer commands");
+		}
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkSubmitInfo graphicsSubmit = {};
+		graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		graphicsSubmit.commandBufferCount = 1;
+		graphicsSubmit.pCommandBuffers = &batch.GraphicsCmd;
+		graphicsSubmit.waitSemaphoreCount = 1;
+		graphicsSubmit.pWaitSemaphores = &batch.TransferDone;
+		graphicsSubmit.pWaitDstStageMask = &waitStage;
+
+		if (vkQueueSubmit(_vk->GraphicsQueue(), 1, &graphicsSubmit, batch.Fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit upload graphics commands");
+		}
+	}
+	else
+	{
+		VkSubmitInfo submit = {};
+		submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &batch.TransferCmd;
+
+		if (vkQueueSubmit(_vk->GraphicsQueue(), 1, &submit, batch.Fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to submit upload commands");
+		}
+	}
+
+	_inFlight.push_back((u32)_openBatch);
+	_openBatch = -1;
+}
+
+void UploadBatcher::Poll()
+{
+	while (!_inFlight.empty())
+	{
+		const u32 index = _inFlight.front();
+		if (vkGetFenceStatus(_vk->LogicalDevice(), _batches[index].Fence) != VK_SUCCESS)
+			return;
+
+		_inFlight.pop_front();
+		Retire(index);
+	}
+}
+
+void UploadBatcher::WaitIdle()
+{
+	while (!_inFlight.empty())
+	{
+		RetireOldest();
+	}
+}
+
+UploadBatcher::Batch& UploadBatcher::GetOpenBatch()
+{
+	if (_openBatch != -1)
+		return _batches[_openBatch];
+
+	if (_freeBatches.empty())
+	{
+		RetireOldest();
+	}
+
+	_openBatch = (i32)_freeBatches.back();
+	_freeBatches.pop_back();
+
+	auto& batch = _batches[_openBatch];
+	batch.Ticket = _nextTicket++;
+	batch.RingBytes = 0;
+
+	const auto beginInfo = vki::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+	vkResetCommandBuffer(batch.TransferCmd, 0);
+	if (vkBeginCommandBuffer(batch.TransferCmd, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to begin recording upload command buffer");
+	}
+	if (_dedicatedTransfer)
+	{
+		vkResetCommandBuffer(batch.GraphicsCmd, 0);
+		if (vkBeginCommandBuffer(batch.GraphicsCmd, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("Failed to begin recording upload command buffer");
+		}
+	}
+
+	return batch;
+}
+
+std::optional<VkDeviceSize> UploadBatcher::TryAllocateStaging(VkDeviceSize size, VkDeviceSize& outConsumed)
+{
+	// Free space is the contiguous run from the head up to the oldest in flight byte. Wrapping skips the tail end,
+	// which is counted as used until the batch that skipped it retires.
+	VkDeviceSize offset = AlignUp(_stagingHead, StagingAlignment);
+	if (offset + size > _stagingCapacity)
+	{
+		offset = 0;
+	}
+
+	const VkDeviceSize consumed = offset == 0 && _stagingHead != 0
+		? _stagingCapacity - _stagingHead + size
+		: offset - _stagingHead + size;
+
+	if (_stagingUsed + consumed > _stagingCapacity)
+		return std::nullopt;
+
+	_stagingHead = offset + size;
+	_stagingUsed += consumed;
+	outConsumed = consumed;
+	return offset;
+}
+
+std::tuple<VkBuffer, VkDeviceSize> UploadBatcher::AllocateStaging(const void* data, VkDeviceSize size)
+{
+	// Rare huge uploads get their own staging buffer rather than monopolising the ring
+	if (size > _stagingCapacity / 2)
+	{
+		auto [buffer, allocation] = vkh::CreateBuffer(size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			_vk->MemoryAllocator(), _vk->LogicalDevice(), GpuPoolKind::Linear);
+		memcpy(allocation.Mapped, data, size);
+
+		GetOpenBatch().OversizeStaging.emplace_back(buffer, allocation);
+		return { buffer, 0 };
+	}
+
+	VkDeviceSize consumed = 0;
+	auto offset = TryAllocateStaging(size, consumed);
+	while (!offset.has_value())
+	{
+		// Ring is full. Submit what we have so its space can come back, then wait for the oldest batch.
+		Flush();
+		RetireOldest();
+		offset = TryAllocateStaging(size, consumed);
+	}
+
+	memcpy((u8*)_stagingAllocation.Mapped + *offset, data, size);
+	GetOpenBatch().RingBytes += consumed;
+
+	return { _stagingBuffer, *offset };
+}
+
+void UploadBatcher::Retire(u32 batchIndex)
+{
+	auto* device = _vk->LogicalDevice();
+	auto& batch = _batches[batchIndex];
+
+	vkResetFences(device, 1, &batch.Fence);
+
+	for (auto& [buffer, allocation] : batch.OversizeStaging)
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
+		_vk->MemoryAllocator().Free(allocation);
+	}
+	batch.OversizeStaging.clear();
+
+	// Batches retire in submission order, which is also ring order
+	assert(_stagingUsed >= batch.RingBytes);
+	_stagingUsed -= batch.RingBytes;
+	if (_stagingUsed == 0 && _openBatch == -1)
+	{
+		_stagingHead = 0;
+	}
+
+	_completedTicket = batch.Ticket;
+	_freeBatches.push_back(batchIndex);
+}
+
+void UploadBatcher::RetireOldest()
+{
+	assert(!_inFlight.empty());
+
+	const u32 index = _inFlight.front();
+	_inFlight.pop_front();
+	vkWaitForFences(_vk->LogicalDevice(), 1, &_batches[index].Fence, true, UINT64_MAX);
+	Retire(index);
+}
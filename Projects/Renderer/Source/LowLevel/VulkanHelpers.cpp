@@ -273,7 +273,9 @@ bool VulkanHelpers::IsDeviceSuitable(const std::vector<const char*>& physicalDev
 
 
 	// Does it cut the mustard?!
-	return indices.IsComplete() && extensionsAreAdequate && swapchainIsAdequate && features.samplerAnisotropy;
+	// Multi draw indirect with a non-zero firstInstance is how SceneRenderPass issues the whole scene
+	return indices.IsComplete() && extensionsAreAdequate && swapchainIsAdequate && features.samplerAnisotropy &&
+		features.multiDrawIndirect && features.drawIndirectFirstInstance;
 }
 
 bool VulkanHelpers::CheckPhysicalDeviceExtensionSupport(const std::vector<const char*>& physicalDeviceExtensions,
@@ -313,7 +315,7 @@ VkSampleCountFlagBits VulkanHelpers::GetMaxUsableSampleCount(VkPhysicalDevice ph
 	return VK_SAMPLE_COUNT_1_BIT;
 }
 
-std::tuple<VkDevice, VkQueue, VkQueue> VulkanHelpers::CreateLogicalDevice(VkPhysicalDevice physicalDevice,
+std::tuple<VkDevice, VkQueue, VkQueue, VkQueue> VulkanHelpers::CreateLogicalDevice(VkPhysicalDevice physicalDevice,
 	VkSurfaceKHR surface,
 	const std::vector<const char*>&
 	validationLayers,
@@ -324,6 +326,10 @@ std::tuple<VkDevice, VkQueue, VkQueue> VulkanHelpers::CreateLogicalDevice(VkPhys
 
 	QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
 	std::set<uint32_t> uniqueQueueFamilies = { indices.GraphicsAndComputeFamily.value(), indices.PresentFamily.value() };
+	if (indices.TransferFamily.has_value())
+	{
+		uniqueQueueFamilies.insert(indices.TransferFamily.value());
+	}
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	float queuePriority = 1.0f;
@@ -344,6 +350,8 @@ std::tuple<VkDevice, VkQueue, VkQueue> VulkanHelpers::CreateLogicalDevice(VkPhys
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	{
 		deviceFeatures.samplerAnisotropy = true;
+		deviceFeatures.multiDrawIndirect = true;
+		deviceFeatures.drawIndirectFirstInstance = true;
 	}
 
 
@@ -372,7 +380,13 @@ std::tuple<VkDevice, VkQueue, VkQueue> VulkanHelpers::CreateLogicalDevice(VkPhys
 	VkQueue presentQueue;
 	vkGetDeviceQueue(device, indices.PresentFamily.value(), 0, &presentQueue);
 
-	return { device, graphicsQueue, presentQueue };
+	VkQueue transferQueue = graphicsQueue;
+	if (indices.TransferFamily.has_value())
+	{
+		vkGetDeviceQueue(device, indices.TransferFamily.value(), 0, &transferQueue);
+	}
+
+	return { device, graphicsQueue, presentQueue, transferQueue };
 }
 
 QueueFamilyIndices VulkanHelpers::FindQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface)
@@ -386,10 +400,12 @@ QueueFamilyIndices VulkanHelpers::FindQueueFamilies(VkPhysicalDevice physicalDev
 
 	for (uint32_t i = 0; i < queueFamilyCount; ++i)
 	{
-		// TODO Get a VK_QUEUE_TRANSFER_BIT for a new transferQueue for all the host to device local transfers
-		// 
-		// Transfer queue will be async and not block other work. It has some latency though.
-		// If needing an immediate copy for work done right now, then graphics or compute queues are faster, but clog system
+		// A family with transfer but no graphics/compute is the DMA engine. Uploads on it run alongside rendering.
+		const auto flags = queueFamilies[i].queueFlags;
+		if (flags & VK_QUEUE_TRANSFER_BIT && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			indices.TransferFamily = i;
+		}
 
 		// HACKY! Only supporting GPUs which share Graphics and Compute queues.
 		// TODO Graphics and Compute should be separate. And then i need to think about how to handle resources that are used on both. VK_SHARING_MODE_CONCURRENT vs VK_SHARING_MODE_EXCLUSIVE?
@@ -405,11 +421,11 @@ QueueFamilyIndices VulkanHelpers::FindQueueFamilies(VkPhysicalDevice physicalDev
 		{
 			indices.PresentFamily = i;
 		}
+	}
 
-		if (!indices.IsComplete())
-		{
-			throw std::runtime_error("Device doesn't support Compute and Graphics queue indicies. Currently unsupported in renderer.");
-		}
+	if (!indices.IsComplete())
+	{
+		throw std::runtime_error("Device doesn't support Compute and Graphics queue indicies. Currently unsupported in renderer.");
 	}
 
 	return indices;
@@ -677,6 +693,90 @@ std::tuple<VkBuffer, VkDeviceMemory> VulkanHelpers::CreateBuffer(VkDeviceSize si
 	return { outBuffer, outBufferMemory };
 }
 
+std::tuple<VkBuffer, GpuAllocation> VulkanHelpers::CreateVertexBuffer(const std::vector<Vertex>& vertices,
+	VkQueue transferQueue, VkCommandPool transferCommandPool, GpuMemoryAllocator& allocator, VkDevice device)
+{
+	const VkDeviceSize bufSize = sizeof(vertices[0]) * vertices.size();
+
+	// Staging is short lived, so it comes from a linear pool and is written through the persistent mapping
+	auto [stagingBuffer, stagingAlloc] = CreateBuffer(bufSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		allocator, device, GpuPoolKind::Linear);
+	memcpy(stagingAlloc.Mapped, vertices.data(), bufSize);
+
+	auto [vertexBuffer, vertexAlloc] = CreateBuffer(bufSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		allocator, device);
+
+	auto* const cmdBuf = BeginSingleTimeCommands(transferCommandPool, device);
+	CopyBuffer(cmdBuf, stagingBuffer, vertexBuffer, bufSize);
+	EndSingeTimeCommands(cmdBuf, transferCommandPool, transferQueue, device);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	allocator.Free(stagingAlloc);
+
+	return { vertexBuffer, vertexAlloc };
+}
+
+std::tuple<VkBuffer, GpuAllocation> VulkanHelpers::CreateIndexBuffer(const std::vector<uint32_t>& indices,
+	VkQueue transferQueue, VkCommandPool transferCommandPool, GpuMemoryAllocator& allocator, VkDevice device)
+{
+	const VkDeviceSize bufSize = sizeof(indices[0]) * indices.size();
+
+	auto [stagingBuffer, stagingAlloc] = CreateBuffer(bufSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		allocator, device, GpuPoolKind::Linear);
+	memcpy(stagingAlloc.Mapped, indices.data(), bufSize);
+
+	auto [indexBuffer, indexAlloc] = CreateBuffer(bufSize,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		allocator, device);
+
+	auto* const cmdBuf = BeginSingleTimeCommands(transferCommandPool, device);
+	CopyBuffer(cmdBuf, stagingBuffer, indexBuffer, bufSize);
+	EndSingeTimeCommands(cmdBuf, transferCommandPool, transferQueue, device);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	allocator.Free(stagingAlloc);
+
+	return { indexBuffer, indexAlloc };
+}
+
+std::tuple<VkBuffer, GpuAllocation> VulkanHelpers::CreateBuffer(VkDeviceSize sizeBytes, VkBufferUsageFlags usageFlags,
+	VkMemoryPropertyFlags propertyFlags, GpuMemoryAllocator& allocator, VkDevice device, GpuPoolKind poolKind)
+{
+	VkBuffer outBuffer;
+
+	VkBufferCreateInfo bufferCI = {};
+	{
+		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCI.size = sizeBytes;
+		bufferCI.usage = usageFlags;
+		bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	if (vkCreateBuffer(device, &bufferCI, nullptr, &outBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("Failed to create buffer");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(device, outBuffer, &memRequirements);
+
+	auto allocation = allocator.Allocate(memRequirements, propertyFlags, GpuResourceKind::Buffer, poolKind);
+
+	if (VK_SUCCESS != vkBindBufferMemory(device, outBuffer, allocation.Memory, allocation.Offset))
+	{
+		throw std::runtime_error("Failed to bind buffer memory");
+	}
+
+	return { outBuffer, allocation };
+}
+
 uint32_t VulkanHelpers::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags,
 	VkPhysicalDevice physicalDevice)
 {
@@ -1095,6 +1195,23 @@ std::tuple<std::vector<VkBuffer>, std::vector<VkDeviceMemory>> VulkanHelpers::Cr
 }
 
 
+std::tuple<std::vector<VkBuffer>, std::vector<GpuAllocation>> VulkanHelpers::CreateUniformBuffers(u32 count,
+	VkDeviceSize typeSize, GpuMemoryAllocator& allocator, VkDevice device)
+{
+	std::vector<VkBuffer> buffers{ count };
+	std::vector<GpuAllocation> allocations{ count };
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto usageFlags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		const auto propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+		std::tie(buffers[i], allocations[i]) = CreateBuffer(typeSize, usageFlags, propertyFlags, allocator, device);
+	}
+
+	return { buffers, allocations };
+}
+
 std::tuple<VkImage, VkDeviceMemory> VulkanHelpers::CreateImage2D(u32 width, u32 height, u32 mipLevels,
 	VkSampleCountFlagBits multisampleSamples, VkFormat format,
 	VkImageTiling tiling, VkImageUsageFlags usageFlags,
@@ -1156,6 +1273,52 @@ std::tuple<VkImage, VkDeviceMemory> VulkanHelpers::CreateImage2D(u32 width, u32
 	return { textureImage, textureImageMemory };
 }
 
+std::tuple<VkImage, GpuAllocation> VulkanHelpers::CreateImage2D(u32 width, u32 height, u32 mipLevels,
+	VkSampleCountFlagBits multisampleSamples, VkFormat format,
+	VkImageTiling tiling, VkImageUsageFlags usageFlags,
+	VkMemoryPropertyFlags propertyFlags,
+	GpuMemoryAllocator& allocator, VkDevice device, u32 arrayLayers, VkImageCreateFlags flags)
+{
+	VkImage image;
+
+	VkImageCreateInfo imageCI = {};
+	{
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.extent.depth = 1;
+		imageCI.extent.width = width;
+		imageCI.extent.height = height;
+		imageCI.mipLevels = mipLevels;
+		imageCI.arrayLayers = arrayLayers;
+		imageCI.format = format;
+		imageCI.tiling = tiling;
+		imageCI.usage = usageFlags;
+		imageCI.samples = multisampleSamples;
+		imageCI.flags = flags;
+	}
+
+	if (VK_SUCCESS != vkCreateImage(device, &imageCI, nullptr, &image))
+	{
+		throw std::runtime_error("Failed to create image");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+	// Linear tiled images obey the same granularity rules as buffers
+	const auto kind = tiling == VK_IMAGE_TILING_OPTIMAL ? GpuResourceKind::Image : GpuResourceKind::Buffer;
+	auto allocation = allocator.Allocate(memRequirements, propertyFlags, kind);
+
+	if (VK_SUCCESS != vkBindImageMemory(device, image, allocation.Memory, allocation.Offset))
+	{
+		throw std::runtime_error("Failed to bind image memory");
+	}
+
+	return { image, allocation };
+}
+
 VkImageView VulkanHelpers::CreateImage2DView(VkImage image, VkFormat format, VkImageViewType viewType,
 	VkImageAspectFlags aspectFlags, u32 mipLevels, u32 layerCount, VkDevice device)
 {
@@ -0,0 +1,25 @@
+#version 450
+
+// Lays down depth for Pbr.vert's EQUAL depth test. gl_Position must be computed exactly as it is there.
+
+layout(std140, set = 1, binding = 0) uniform PbrFrameUbo
+{
+	mat4 viewProjection;
+} ubo;
+
+layout(std430, set = 1, binding = 6) readonly buffer InstanceBuffer
+{
+	mat4 models[];
+} instances;
+
+layout(location = 0) in vec3 inPosition;
+
+invariant gl_Position;
+
+
+void main() 
+{
+	mat4 model = instances.models[gl_InstanceIndex];
+	vec3 posWorldSpace = vec3(model * vec4(inPosition, 1.0));
+	gl_Position = ubo.viewProjection * vec4(posWorldSpace, 1);
+}
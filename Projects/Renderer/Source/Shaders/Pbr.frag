@@ -2,16 +2,18 @@
 
 // Constants
 const float PI = 3.14159265359;
-const int MAX_LIGHT_COUNT = 8;		// TODO Convert to specialization constant to support N lights?
-const int PREFILTER_MIP_COUNT = 6;  // Must match PrefilterMap's # mip levels // TODO Pass this in.
+layout(constant_id = 0) const int PREFILTER_MIP_COUNT = 6; // Set from IblLoader::PrefilterMips
 const int TRANSPARENCY_MODE_ADDITIVE = 0;
 const int TRANSPARENCY_MODE_CUTOFF = 1;
+const uint CLUSTER_TILES_X = 16; // Must match LightClusters
+const uint CLUSTER_TILES_Y = 9;
+const uint CLUSTER_SLICES = 24;
 
 // Types
 struct LightPacked
 {
 	vec4 ColorIntensity;// floats [R,G,B,Intensity]
-	vec4 PosType;       // floats [X,Y,Z], int [Type:Point=0,Directional=1]
+	vec4 PosRadius;     // Point: [X,Y,Z,Range]. Directional: [DirX,DirY,DirZ,0]
 };
 
 layout(std140, set = 0, binding = 0) uniform PbrMaterialUbo
@@ -64,21 +66,39 @@ layout(set = 0, binding = 6) uniform sampler2D EmissiveMap;
 layout(set = 0, binding = 7) uniform sampler2D TransparencyMap;
 
 
-layout(set = 1, binding = 1) uniform samplerCube IrradianceMap; // diffuse
+layout(std140, set = 1, binding = 0) uniform PbrFrameUbo // Match PbrFrameUbo in UniformBufferObjects.h
+{
+	mat4 viewProjection;
+	mat4 cascadeMatrices[4];   // World to each cascade's clip space
+	vec4 cascadeAtlasRects[4]; // [OffsetU,OffsetV,ScaleU,ScaleV] of each cascade in ShadowMap
+	vec4 cascadeFarDepths;
+	uint cascadeCount;
+	vec4 irradianceSh[9];      // [R,G,B,Unused] L2 spherical harmonics, see ShIrradiance. Diffuse.
+} frameUbo;
 layout(set = 1, binding = 2) uniform samplerCube PrefilterMap; // spec
 layout(set = 1, binding = 3) uniform sampler2D BrdfLUT; // spec
-layout(std140, set = 1, binding = 4) uniform LightUbo
+layout(std430, set = 1, binding = 4) readonly buffer LightBuffer // Match LightClusters::GpuHeader and GpuLight
+{
+	vec4 viewDepthRow;
+	vec2 tileScale;
+	float sliceScale;
+	float sliceBias;
+	uint directionalCount;
+	uint pointCount;
+	LightPacked lights[]; // Directional lights first
+} lightBuffer;
+layout(set = 1, binding = 5) uniform sampler2D ShadowMap; // Cascade atlas
+layout(std430, set = 1, binding = 7) readonly buffer ClusterBuffer
 {
-	LightPacked[MAX_LIGHT_COUNT] lights;
-	// TODO see this post about dealing with N number of lights OR just pass in N via a specialization constant?
-	//  https://www.reddit.com/r/vulkan/comments/8vzpir/whats_the_best_practice_for_dealing_with/
-} lightUbo;
-layout(set = 1, binding = 5) uniform sampler2D ShadowMap;
+	uvec2 clusters[]; // [Offset,Count] into lightIndices
+} clusterBuffer;
+layout(std430, set = 1, binding = 8) readonly buffer LightIndexBuffer
+{
+	uint lightIndices[];
+} lightIndexBuffer;
 
 
-layout(location = 0) in vec4 fragPosLightSpace;
 layout(location = 1) in vec3 fragPosWorldSpace;
-layout(location = 2) in vec3 fragColor;
 layout(location = 3) in vec2 fragTexCoord;
 layout(location = 4) in vec3 fragNormal;
 layout(location = 5) in mat3 fragTBN;
@@ -92,6 +112,13 @@ vec3 Fresnel_Schlick(float cosTheta, vec3 F0);
 float Distribution_GGX(float NdotH, float roughness);
 float Geometry_SchlickGGX_Direct(float NdotV, float roughness);
 float Geometry_Smith(float NdotV, float NdotL, float roughness);
+vec3 DirectLight(vec3 L, vec3 incomingRadiance, vec3 normal, vec3 V, float NdotV, vec3 F0, vec3 basecolor, float metalness, float roughness);
+vec3 Irradiance(vec3 n);
+
+// Lights
+float ViewDepth();
+uint ClusterIndex();
+float CascadedShadow();
 
 // Material
 vec3 GetBasecolor();
@@ -102,53 +129,12 @@ float GetAmbientOcclusion();
 vec3 GetEmissive();
 float GetTransparency();
 
-float textureProj2(vec4 shadowCoord, vec2 off)
-{
-	float shadow = 1.0;
-	if ( shadowCoord.z > -1.0 && shadowCoord.z < 1.0 ) 
-	{
-		float dist = texture( ShadowMap, shadowCoord.st + off ).r;
-		if ( shadowCoord.w > 0.0 && dist < shadowCoord.z ) 
-		{
-			shadow = 0.0;
-		}
-	}
-	return shadow;
-}
-//
-//float ShadowCalculation(vec4 fragPosLightSpace)
-//{
-//	vec4 projCoords = fragPosLightSpace / fragPosLightSpace.w;
-//	//projCoords = projCoords * 0.5 + 0.5;
-//	float closestDepth = texture(ShadowMap, projCoords.xy).r;
-//	float currentDepth = projCoords.z;
-//	float shadow = currentDepth > closestDepth ? 1.0 : 0.0;
-//	return shadow;
-//}
-
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // main
 
 void main() 
 {
-//	float shadow = textureProj(fragPosLightSpace / fragPosLightSpace.w, vec2(0.0));
-//	if (shadow < 0.90)
-//	{
-//		outColor = vec4(1,0,0,1);
-//		return;
-//	}
-//	if (shadow > 0.50)
-//	{
-//		outColor = vec4(0,1,0,1);
-//		return;
-//	}
-//	if (shadow > 0.001)
-//	{
-//		outColor = vec4(0,0,1,1);
-//		return;
-//	}
-
 	vec3 normal = GetNormal();
 	vec3 basecolor = GetBasecolor();
 	float metalness = GetMetalness();
@@ -183,58 +169,31 @@ void main()
 	vec3 F0 = mix(F0Default, basecolor, metalness); 
 
 	
-	// Reflectance equation for direct lighting
+	// Reflectance equation for direct lighting. The first directional light casts the cascaded shadows.
 	vec3 Lo = vec3(0.0);
-	for(int i = 0; i < MAX_LIGHT_COUNT; i++) // Always looping max light count even if there aren't any (it's faster...)
+	for (uint i = 0; i < lightBuffer.directionalCount; i++)
 	{
-		// Unpack light values
-		const vec3 lightPos = lightUbo.lights[i].PosType.xyz;
-		const int lightType = int(lightUbo.lights[i].PosType.w);
-		const vec3 lightColor = lightUbo.lights[i].ColorIntensity.rgb; 
-		const float lightIntensity = lightUbo.lights[i].ColorIntensity.w;
-
-		if (lightIntensity < 0.01) continue; // pretty good optimisation
-
-		// Incoming light direction - point or directional
-		const vec3 pointDir = lightPos - fragPosWorldSpace;
-		const vec3 directionalDir = lightPos;
-		const vec3 L = normalize(mix(pointDir, directionalDir, lightType));
-		const float NdotL = max(dot(normal,L), 0.0);
-		
-		// Compute Radiance - Li
-		vec3 incomingRadiance;
-		{
-			const float dist = length(lightPos - fragPosWorldSpace);
-			const float attenuation = mix(1.0 / (dist * dist), 1, lightType); // no attenuation for directional lights
-			incomingRadiance = lightColor * lightIntensity * attenuation;
-		}
-
-		// Compute BRDF - fr - Cook-Torrance material response
-		vec3 brdf;
-		{
-			const vec3 H = normalize(V + L); // half vec
-			const float NdotH = max(dot(normal,H), 0.0);
-			const float HdotV = max(dot(H, V), 0.0);
-
-			const float NDF = Distribution_GGX(NdotH, roughness);
-			const float G = Geometry_Smith(NdotV, NdotL, roughness);
-			const vec3 F = Fresnel_Schlick(HdotV, F0); // Note: HdotV is correct for direct lighting, based on discussion in http://disq.us/p/1etzl77
-			const float denominator = 4.0 * NdotV * NdotL;
-			const vec3 specular = NDF*G*F / max(denominator, 0.0000001); // safe guard div0
-
-			// Spec/Diff contributions 
-			//const vec3 kS = F; // fresnel already represents spec contribution
-			vec3 kD = vec3(1.0) - F; // ensure kS+kD=1
-			kD *= 1.0 - metalness; // remove diffuse contribution for metals
-
-			vec3 diffuse = kD*basecolor/PI;
-
-			brdf = diffuse + specular;
-		}
+		const LightPacked light = lightBuffer.lights[i];
+		const vec3 L = normalize(light.PosRadius.xyz);
+		const vec3 incomingRadiance = light.ColorIntensity.rgb * light.ColorIntensity.w; // no attenuation
+		const float shadow = i == 0 ? CascadedShadow() : 1.0;
+		Lo += shadow * DirectLight(L, incomingRadiance, normal, V, NdotV, F0, basecolor, metalness, roughness);
+	}
 
-		// Outgoing radiance due to light hitting surface
-		float shadow = textureProj2(fragPosLightSpace / fragPosLightSpace.w, vec2(0.0));
-		Lo += brdf * incomingRadiance * NdotL * shadow; // TODO Shadows should be limted shadow casting lights
+	// Point lights come from this fragment's cluster, each faded out to reach zero at its range
+	const uvec2 cluster = clusterBuffer.clusters[ClusterIndex()];
+	for (uint i = 0; i < cluster.y; i++)
+	{
+		const LightPacked light = lightBuffer.lights[lightIndexBuffer.lightIndices[cluster.x + i]];
+		const vec3 toLight = light.PosRadius.xyz - fragPosWorldSpace;
+		const float distSquared = max(dot(toLight, toLight), 0.0001);
+		const float rangeFraction = distSquared / (light.PosRadius.w * light.PosRadius.w);
+		float window = clamp(1.0 - rangeFraction * rangeFraction, 0.0, 1.0);
+		window *= window;
+
+		const vec3 L = toLight * inversesqrt(distSquared);
+		const vec3 incomingRadiance = light.ColorIntensity.rgb * light.ColorIntensity.w * window / distSquared;
+		Lo += DirectLight(L, incomingRadiance, normal, V, NdotV, F0, basecolor, metalness, roughness);
 	}
 
 
@@ -253,7 +212,7 @@ void main()
 		// Compute diffuse IBL
 		vec3 diffuse;
 		{
-			const vec3 irradiance = texture(IrradianceMap, cubemapRotationMat3*normal).rgb;
+			const vec3 irradiance = Irradiance(cubemapRotationMat3*normal);
 			diffuse = kD * irradiance * basecolor;
 		}
 
@@ -379,8 +338,97 @@ float GetTransparency()
 
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lights
+
+float ViewDepth()
+{
+	return max(dot(lightBuffer.viewDepthRow, vec4(fragPosWorldSpace, 1)), 0.0001);
+}
+
+// Froxel of this fragment, see LightClusters
+uint ClusterIndex()
+{
+	const float viewDepth = ViewDepth();
+	const float slice = clamp(floor(log(viewDepth) * lightBuffer.sliceScale + lightBuffer.sliceBias), 0.0, float(CLUSTER_SLICES - 1));
+	const uvec2 tile = min(uvec2(gl_FragCoord.xy * lightBuffer.tileScale), uvec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+	return (uint(slice) * CLUSTER_TILES_Y + tile.y) * CLUSTER_TILES_X + tile.x;
+}
+
+// 0 if the shadow caster's light is blocked, see ShadowCascades. Lit past the last cascade and outside its tile.
+float CascadedShadow()
+{
+	const float viewDepth = ViewDepth();
+	uint cascade = 0;
+	while (cascade < frameUbo.cascadeCount && viewDepth > frameUbo.cascadeFarDepths[cascade])
+	{
+		cascade++;
+	}
+	if (cascade == frameUbo.cascadeCount)
+	{
+		return 1.0;
+	}
+
+	const vec4 shadowCoord = frameUbo.cascadeMatrices[cascade] * vec4(fragPosWorldSpace, 1); // Orthographic, w is 1
+	const vec2 uv = shadowCoord.xy * 0.5 + 0.5;
+	if (any(lessThan(uv, vec2(0))) || any(greaterThan(uv, vec2(1))) || shadowCoord.z > 1.0)
+	{
+		return 1.0;
+	}
+
+	// Stay half a texel inside the tile so filtering never reads a neighbouring cascade
+	const vec4 rect = frameUbo.cascadeAtlasRects[cascade];
+	const vec2 halfTexel = 0.5 / (vec2(textureSize(ShadowMap, 0)) * rect.zw);
+	const float dist = texture(ShadowMap, rect.xy + clamp(uv, halfTexel, 1.0 - halfTexel) * rect.zw).r;
+	return dist < shadowCoord.z ? 0.0 : 1.0;
+}
+
+// Outgoing radiance due to one light hitting the surface. L points from the surface to the light.
+vec3 DirectLight(vec3 L, vec3 incomingRadiance, vec3 normal, vec3 V, float NdotV, vec3 F0, vec3 basecolor, float metalness, float roughness)
+{
+	const float NdotL = max(dot(normal,L), 0.0);
+
+	// Compute BRDF - fr - Cook-Torrance material response
+	const vec3 H = normalize(V + L); // half vec
+	const float NdotH = max(dot(normal,H), 0.0);
+	const float HdotV = max(dot(H, V), 0.0);
+
+	const float NDF = Distribution_GGX(NdotH, roughness);
+	const float G = Geometry_Smith(NdotV, NdotL, roughness);
+	const vec3 F = Fresnel_Schlick(HdotV, F0); // Note: HdotV is correct for direct lighting, based on discussion in http://disq.us/p/1etzl77
+	const float denominator = 4.0 * NdotV * NdotL;
+	const vec3 specular = NDF*G*F / max(denominator, 0.0000001); // safe guard div0
+
+	// Spec/Diff contributions 
+	//const vec3 kS = F; // fresnel already represents spec contribution
+	vec3 kD = vec3(1.0) - F; // ensure kS+kD=1
+	kD *= 1.0 - metalness; // remove diffuse contribution for metals
+
+	const vec3 diffuse = kD*basecolor/PI;
+
+	return (diffuse + specular) * incomingRadiance * NdotL;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // IBL
+
+// Irradiance over pi about cubemap space direction n. Match ShIrradiance::Evaluate.
+vec3 Irradiance(vec3 n)
+{
+	vec3 result = frameUbo.irradianceSh[0].rgb * 0.282095
+		+ frameUbo.irradianceSh[1].rgb * (0.488603 * n.y)
+		+ frameUbo.irradianceSh[2].rgb * (0.488603 * n.z)
+		+ frameUbo.irradianceSh[3].rgb * (0.488603 * n.x)
+		+ frameUbo.irradianceSh[4].rgb * (1.092548 * n.x * n.y)
+		+ frameUbo.irradianceSh[5].rgb * (1.092548 * n.y * n.z)
+		+ frameUbo.irradianceSh[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+		+ frameUbo.irradianceSh[7].rgb * (1.092548 * n.x * n.z)
+		+ frameUbo.irradianceSh[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+	return max(result, vec3(0));
+}
+
 vec3 Fresnel_Schlick(float cosTheta, vec3 F0)
 {
 	cosTheta = min(cosTheta,1); // fixes issue where cosTheta is slightly > 1.0. a floating point issue that causes black pixels where the half and view dirs align
@@ -1,46 +1,51 @@
 #version 450
 
-layout(std140, set = 1, binding = 0) uniform PbrModelVsUbo
+layout(std140, set = 1, binding = 0) uniform PbrFrameUbo
 {
-	mat4 model;
 	mat4 viewProjection;
-	mat4 lightSpaceMatrix;
 } ubo;
 
+layout(std430, set = 1, binding = 6) readonly buffer InstanceBuffer
+{
+	mat4 models[];
+} instances;
+
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inColor;
+layout(location = 1) in vec2 inNormalOct; // Octahedral encoded, see VertexHelper::OctEncode()
 layout(location = 3) in vec2 inTexCoord;
-layout(location = 4) in vec3 inTangent;
+layout(location = 4) in vec2 inTangentOct;
 
-layout(location = 0) out vec4 fragPosLightSpace;
 layout(location = 1) out vec3 fragPosWorldSpace; // in world space
-layout(location = 2) out vec3 fragColor;
 layout(location = 3) out vec2 fragTexCoord;
 layout(location = 4) out vec3 fragNormal;
 layout(location = 5) out mat3 fragTBN;
 
-const mat4 biasMat = mat4( 
-	0.5, 0.0, 0.0, 0.0,
-	0.0, 0.5, 0.0, 0.0,
-	0.0, 0.0, 1.0, 0.0,
-	0.5, 0.5, 0.0, 1.0 );
+invariant gl_Position; // Must match DepthPrepass.vert bit for bit
+
+vec3 OctDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
 
 void main() 
 {
-	vec3 T = normalize(vec3(ubo.model * vec4(inTangent, 0)));
-	vec3 N = normalize(vec3(ubo.model * vec4(inNormal, 0)));
+	mat4 model = instances.models[gl_InstanceIndex];
+	vec3 inNormal = OctDecode(inNormalOct);
+	vec3 inTangent = OctDecode(inTangentOct);
+
+	vec3 T = normalize(vec3(model * vec4(inTangent, 0)));
+	vec3 N = normalize(vec3(model * vec4(inNormal, 0)));
 	vec3 B = normalize(cross(N,T));
 
-	mat3 normalMatrix = transpose(inverse(mat3(ubo.model)));
+	mat3 normalMatrix = transpose(inverse(mat3(model)));
 
 	// Outputs
-	fragPosWorldSpace = vec3(ubo.model * vec4(inPosition, 1.0));
-	fragColor = inColor;
+	fragPosWorldSpace = vec3(model * vec4(inPosition, 1.0));
 	fragTexCoord = inTexCoord;
 	fragNormal = normalize(normalMatrix * inNormal);
 	fragTBN = mat3(T, B, N);
-	fragPosLightSpace = (biasMat * ubo.lightSpaceMatrix * ubo.model) * vec4(inPosition, 1);
-	//fragPosLightSpace = (ubo.lightSpaceMatrix * ubo.model) * vec4(inPosition, 1);
 	gl_Position = ubo.viewProjection * vec4(fragPosWorldSpace, 1);
 }
\ No newline at end of file
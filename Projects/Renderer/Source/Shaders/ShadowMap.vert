@@ -2,13 +2,18 @@
 
 layout(std140, push_constant) uniform PushConstants
 {
-	layout (offset = 0) mat4 shadowMatrix;
+	layout (offset = 0) mat4 lightSpaceMatrix;
 } pushConsts;
 
+layout(std430, set = 0, binding = 0) readonly buffer InstanceBuffer
+{
+	mat4 models[];
+} instances;
+
 layout(location = 0) in vec3 inPosition;
 
 
 void main() 
 {
-	gl_Position = pushConsts.shadowMatrix * vec4(inPosition, 1.0);
+	gl_Position = pushConsts.lightSpaceMatrix * instances.models[gl_InstanceIndex] * vec4(inPosition, 1.0);
 }
\ No newline at end of file
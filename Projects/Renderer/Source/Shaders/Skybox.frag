@@ -5,6 +5,8 @@ layout(std140, binding = 1) uniform SkyboxFragUbo
 	layout(offset= 4) float IblStrength;
 	layout(offset= 8) float BackdropBrightness;
 	layout(offset= 12) bool ShowClipping;
+	layout(offset= 16) bool ShowIrradiance;
+	layout(offset= 32) vec4 IrradianceSh[9]; // [R,G,B,Unused] Match SkyboxFragUbo
 } ubo;
 layout(binding = 2) uniform samplerCube uCubemap;
 
@@ -14,9 +16,25 @@ layout (location=0) out vec4 outColor;
 
 
 
+// Match ShIrradiance::Evaluate
+vec3 Irradiance(vec3 n)
+{
+	vec3 result = ubo.IrradianceSh[0].rgb * 0.282095
+		+ ubo.IrradianceSh[1].rgb * (0.488603 * n.y)
+		+ ubo.IrradianceSh[2].rgb * (0.488603 * n.z)
+		+ ubo.IrradianceSh[3].rgb * (0.488603 * n.x)
+		+ ubo.IrradianceSh[4].rgb * (1.092548 * n.x * n.y)
+		+ ubo.IrradianceSh[5].rgb * (1.092548 * n.y * n.z)
+		+ ubo.IrradianceSh[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+		+ ubo.IrradianceSh[7].rgb * (1.092548 * n.x * n.z)
+		+ ubo.IrradianceSh[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+	return max(result, vec3(0));
+}
+
+
 void main()
 {
-	vec3 color = texture(uCubemap, fragUVW).rgb;
+	vec3 color = ubo.ShowIrradiance ? Irradiance(normalize(fragUVW)) : texture(uCubemap, fragUVW).rgb;
 
 	// TODO Support blurring 
 
@@ -8,10 +8,6 @@ layout(std140, binding = 0) uniform SkyboxVertUbo
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inColor;
-layout(location = 3) in vec2 inTexCoord;
-layout(location = 4) in vec3 inTangent;
 
 layout (location = 0) out vec3 fragUVW;
 
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <Framework/AABB.h>
+#include <Framework/CommonTypes.h>
+#include <Framework/Frustum.h>
+
+#include <array>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Dynamic bounding volume hierarchy. Leaves store fattened bounds so small movements don't touch the tree; anything
+// that leaves its fat bounds is reinserted and the path to the root is refit and rebalanced. Insert, remove and move
+// are O(log n), and queries only visit the branches that can contain results.
+class AabbTree
+{
+public: // Data
+	static constexpr i32 NullNode = -1;
+
+private: // Types
+	struct Node
+	{
+		AABB Bounds{};
+		i32 Parent = NullNode; // Next free node while on the free list
+		i32 Left = NullNode;
+		i32 Right = NullNode;
+		i32 Height = -1; // 0 for leaves, -1 when free
+		i32 UserData = -1;
+
+		bool IsLeaf() const { return Left == NullNode; }
+	};
+
+	// Explicit traversal stack. The tree is height balanced, so this comfortably covers millions of leaves.
+	static constexpr u32 MaxStackDepth = 128;
+
+private: // Data
+	std::vector<Node> _nodes{};
+	i32 _root = NullNode;
+	i32 _freeList = NullNode;
+	u32 _leafCount = 0;
+	f32 _margin = 0;
+
+public: // Methods
+	explicit AabbTree(f32 margin = 0.1f) : _margin(margin) {}
+
+	// Returns a proxy id that stays valid until Remove()
+	i32 Insert(const AABB& bounds, i32 userData);
+	void Remove(i32 proxy);
+
+	// Updates a proxy's bounds. Returns true if it had to be reinserted.
+	bool Move(i32 proxy, const AABB& bounds);
+
+	i32 GetUserData(i32 proxy) const { return _nodes[proxy].UserData; }
+	const AABB& GetFatBounds(i32 proxy) const { return _nodes[proxy].Bounds; }
+	u32 Count() const { return _leafCount; }
+	bool IsEmpty() const { return _root == NullNode; }
+
+	// Bounds of every leaf. Includes the fat margin.
+	AABB GetRootBounds() const { return IsEmpty() ? AABB{} : _nodes[_root].Bounds; }
+
+	// callback(i32 userData) for every leaf whose fat bounds overlap bounds
+	template <typename Fn>
+	void QueryOverlap(const AABB& bounds, Fn&& callback) const;
+
+	// callback(i32 userData) for every leaf whose fat bounds aren't outside the frustum. Subtrees fully inside the
+	// frustum are reported without further tests.
+	template <typename Fn>
+	void QueryFrustum(const Frustum& frustum, Fn&& callback) const;
+
+	// f32 callback(i32 userData, f32 entryDistance) for every leaf the ray enters within maxDistance. The callback
+	// returns the new max distance, so returning the hit distance of an exact test turns this into a closest hit query.
+	template <typename Fn>
+	void QueryRay(const glm::vec3& origin, const glm::vec3& direction, f32 maxDistance, Fn&& callback) const;
+
+private:
+	i32 AllocateNode();
+	void FreeNode(i32 index);
+	void InsertLeaf(i32 leaf);
+	void RemoveLeaf(i32 leaf);
+	void Refit(i32 index);
+	i32 Balance(i32 index);
+
+	template <typename Fn>
+	void ReportSubtree(i32 index, Fn&& callback) const;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <typename Fn>
+void AabbTree::QueryOverlap(const AABB& bounds, Fn&& callback) const
+{
+	if (_root == NullNode)
+		return;
+
+	std::array<i32, MaxStackDepth> stack;
+	u32 count = 0;
+	stack[count++] = _root;
+
+	while (count > 0)
+	{
+		const Node& node = _nodes[stack[--count]];
+		if (!node.Bounds.Overlaps(bounds))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			callback(node.UserData);
+		}
+		else
+		{
+			assert(count + 2 <= MaxStackDepth);
+			stack[count++] = node.Left;
+			stack[count++] = node.Right;
+		}
+	}
+}
+
+template <typename Fn>
+void AabbTree::QueryFrustum(const Frustum& frustum, Fn&& callback) const
+{
+	if (_root == NullNode)
+		return;
+
+	std::array<i32, MaxStackDepth> stack;
+	u32 count = 0;
+	stack[count++] = _root;
+
+	while (count > 0)
+	{
+		const i32 index = stack[--count];
+		const Node& node = _nodes[index];
+
+		const auto result = frustum.Classify(node.Bounds);
+		if (result == Frustum::Result::Outside)
+			continue;
+
+		if (result == Frustum::Result::Inside || node.IsLeaf())
+		{
+			ReportSubtree(index, callback);
+		}
+		else
+		{
+			assert(count + 2 <= MaxStackDepth);
+			stack[count++] = node.Left;
+			stack[count++] = node.Right;
+		}
+	}
+}
+
+template <typename Fn>
+void AabbTree::QueryRay(const glm::vec3& origin, const glm::vec3& direction, f32 maxDistance, Fn&& callback) const
+{
+	if (_root == NullNode)
+		return;
+
+	const glm::vec3 invDirection = 1.f / direction;
+
+	std::array<i32, MaxStackDepth> stack;
+	u32 count = 0;
+	stack[count++] = _root;
+
+	while (count > 0)
+	{
+		const Node& node = _nodes[stack[--count]];
+
+		f32 entry;
+		if (!node.Bounds.IntersectsRay(origin, invDirection, maxDistance, entry))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			maxDistance = callback(node.UserData, entry);
+		}
+		else
+		{
+			assert(count + 2 <= MaxStackDepth);
+			stack[count++] = node.Left;
+			stack[count++] = node.Right;
+		}
+	}
+}
+
+template <typename Fn>
+void AabbTree::ReportSubtree(i32 index, Fn&& callback) const
+{
+	std::array<i32, MaxStackDepth> stack;
+	u32 count = 0;
+	stack[count++] = index;
+
+	while (count > 0)
+	{
+		const Node& node = _nodes[stack[--count]];
+		if (node.IsLeaf())
+		{
+			callback(node.UserData);
+		}
+		else
+		{
+			assert(count + 2 <= MaxStackDepth);
+			stack[count++] = node.Left;
+			stack[count++] = node.Right;
+		}
+	}
+}
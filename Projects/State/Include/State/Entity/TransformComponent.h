@@ -1,8 +1,17 @@
 #pragma once
 
+#include <Framework/CommonTypes.h>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+class ITransformListener
+{
+public:
+	virtual ~ITransformListener() = default;
+	virtual void OnTransformChanged(int entityId) = 0;
+};
+
 class TransformComponent
 {
 public:
@@ -18,9 +27,9 @@ public:
 	glm::vec3 GetPos() const { return _position; }
 	glm::vec3 GetRot() const { return _rotation; }
 	glm::vec3 GetScale() const { return _scale; }
-	void SetPos(const glm::vec3 pos) { _position = pos; _dirty = true; }
-	void SetRot(const glm::vec3 rot) { _rotation = rot; _dirty = true; }
-	void SetScale(const glm::vec3 scale) { _scale = scale; _dirty = true; }
+	void SetPos(const glm::vec3 pos) { _position = pos; Invalidate(); }
+	void SetRot(const glm::vec3 rot) { _rotation = rot; Invalidate(); }
+	void SetScale(const glm::vec3 scale) { _scale = scale; Invalidate(); }
 
 	const glm::mat4& GetMatrix()
 	{
@@ -40,10 +49,27 @@ public:
 		return _mat;
 	}
 
+	// Bumped on every change. Unlike the dirty flag it isn't reset by GetMatrix(), so observers can detect changes.
+	u32 GetVersion() const { return _version; }
+
+	// Told the owning entity's id on every change, so a scene only revisits what moved. Null stops reporting.
+	void SetListener(ITransformListener* listener, int entityId) { _listener = listener; _entityId = entityId; }
+
 private:
+	void Invalidate()
+	{
+		_dirty = true;
+		_version++;
+		if (_listener)
+			_listener->OnTransformChanged(_entityId);
+	}
+
 	glm::vec3 _position{};
 	glm::vec3 _rotation{}; // degrees
 	glm::vec3 _scale{1};
 	glm::mat4 _mat{ 1 };
 	bool _dirty = false;
+	u32 _version = 0;
+	ITransformListener* _listener = nullptr;
+	int _entityId = 0;
 };
@@ -7,6 +7,7 @@
 #include <Framework/CommonTypes.h>
 #include <Framework/IModelLoaderService.h>
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <utility>
@@ -163,6 +164,41 @@ public:
 		LoadObjectArray({ 0,0,0 }, 30, 30);
 	}
 
+	// The heavy object array lit by 1,000 small coloured point lights hovering in front of it
+	void LoadLightStressScene()
+	{
+		std::cout << "Loading light stress scene\n";
+		_scene.LoadAndSetSkybox(GetSkyboxes()[0].Path);
+		LoadObjectArray({ 0,0,0 }, 30, 30);
+
+		const u32 numColumns = 40;
+		const u32 numRows = 25;
+		const f32 halfExtent = 31.5f; // Just past the array's edge
+
+		for (u32 row = 0; row < numRows; row++)
+		{
+			for (u32 col = 0; col < numColumns; col++)
+			{
+				const f32 x = -halfExtent + 2 * halfExtent * col / f32(numColumns - 1);
+				const f32 y = -halfExtent + 2 * halfExtent * row / f32(numRows - 1);
+				const glm::vec3 color{ RandF(0, 1), RandF(0, 1), RandF(0, 1) };
+
+				auto entity = std::make_unique<Entity>();
+				entity->Name = "PointLight" + std::to_string(entity->Id);
+				entity->Light = LightComponent{};
+				entity->Light->Type = LightComponent::Types::point;
+				entity->Light->Color = color / std::max({ color.r, color.g, color.b, 0.01f }); // Saturated, full brightness
+				entity->Light->Intensity = 4;
+				entity->Transform.SetPos({ x, y, RandF(0.5f, 2.5f) });
+				_scene.AddEntity(std::move(entity));
+			}
+		}
+
+		auto ro = _scene.GetRenderOptions();
+		ro.IblStrength = 0.1f; // Let the point lights dominate
+		_scene.SetRenderOptions(ro);
+	}
+
 	void LoadObjectArray(const glm::vec3& offset = glm::vec3{ 0,0,0 }, u32 numRows = 2, u32 numColumns = 5)
 	{
 		std::cout << "Loading material array" << std::endl;
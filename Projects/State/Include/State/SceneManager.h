@@ -1,11 +1,13 @@
 #pragma once
 
+#include "AabbTree.h"
 #include "Camera.h"
 #include "Entity/Entity.h"
 
 #include <Framework/IModelLoaderService.h> 
 #include <Framework/CommonRenderer.h>
 
+#include <map>
 #include <unordered_map>
 
 struct Material;
@@ -19,13 +21,13 @@ public:
 	virtual MeshResourceId CreateMeshResource(const MeshDefinition& meshDefinition) = 0;
 	virtual RenderableResourceId CreateRenderable(const MeshResourceId& meshId) = 0;
 	virtual TextureResourceId CreateTextureResource(const std::string& path) = 0;
-	virtual IblTextureResourceIds CreateIblTextureResources(const std::string& path) = 0;
+	virtual IblTextureResourceIds CreateIblTextureResources(const std::string& path, IblQuality quality) = 0;
 	virtual SkyboxResourceId CreateSkybox(const SkyboxCreateInfo& createInfo) = 0;
 	virtual void SetSkybox(const SkyboxResourceId& resourceId) = 0;
 };
 
 // GPU loaded resources
-class SceneManager
+class SceneManager final : public ITransformListener
 {
 public:
 	explicit SceneManager(ISceneManagerDelegate& delegate, IModelLoaderService& mls)
@@ -42,8 +44,22 @@ public:
 	std::vector<Material*> GetMaterials() const;
 
 	const std::vector<std::unique_ptr<Entity>>& EntitiesView() const { return _entities; }
-	void AddEntity(std::unique_ptr<Entity> e) { _entities.emplace_back(std::move(e)); }
+	void AddEntity(std::unique_ptr<Entity> e);
 	void RemoveEntity(int entId);
+	const std::vector<Entity*>& LightEntitiesView() const { return _lightEntities; }
+
+	// Spatial queries over renderable entities. Call UpdateSpatialIndex() after transforms change to bring the
+	// hierarchy up to date, it only visits entities moved since the last call. Queries are conservative and may return
+	// entities slightly outside the query volume.
+	void UpdateSpatialIndex();
+	void QueryFrustum(const Frustum& frustum, std::vector<Entity*>& outEntities) const;
+	void QueryOverlap(const AABB& bounds, std::vector<Entity*>& outEntities) const;
+	Entity* Raycast(const glm::vec3& origin, const glm::vec3& direction, f32& outDistance);
+	AABB GetSceneBounds() const; // Conservative. Empty if there are no renderables or any are unbounded.
+
+	// Replaces outBounds with where renderables were added, removed or moved since the last call, both before and after
+	// a move. An empty box means an unbounded renderable changed. Lets the renderer keep shadow maps that didn't change.
+	void TakeChangedBounds(std::vector<AABB>& outBounds);
 
 	SkyboxResourceId LoadAndSetSkybox(const std::string& path);
 	void SetSkybox(const SkyboxResourceId& id);
@@ -53,6 +69,16 @@ public:
 	void SetRenderOptions(const RenderOptions& ro) { _renderOptions = ro; }
 
 private:
+	struct SpatialEntry
+	{
+		i32 Proxy = AabbTree::NullNode;
+		Entity* Entity = nullptr;
+		u32 TransformVersion = 0;
+	};
+
+	AABB ComputeWorldBounds(Entity& entity) const;
+	void OnTransformChanged(int entityId) override;
+
 	// Dependencies
 	ISceneManagerDelegate& _delegate;
 	IModelLoaderService& _modelLoaderService;
@@ -64,7 +90,15 @@ private:
 	RenderOptions _renderOptions;
 	std::unordered_map<u32, std::unique_ptr<Material>> _materials{}; //TODO Make type id usable as hash key (convertable to u32?)
 
+	// Spatial index
+	AabbTree _entityTree{};
+	std::unordered_map<int, SpatialEntry> _spatialEntries{}; // by entity id
+	std::vector<Entity*> _unboundedEntities{}; // Renderables without bounds. Always returned by frustum queries.
+	std::vector<int> _movedEntities{};         // Ids reported by transforms since the last UpdateSpatialIndex(), may repeat
+	std::vector<AABB> _changedBounds{};        // Since the last TakeChangedBounds()
+	std::vector<Entity*> _lightEntities{};
+
 	// Cache
-	std::unordered_map<std::string, SkyboxResourceId> _loadedSkyboxesCache = {};
+	std::map<std::pair<std::string, IblQuality>, SkyboxResourceId> _loadedSkyboxesCache = {}; // Each quality is its own load
 	std::unordered_map<std::string, TextureResourceId> _loadedTexturesCache = {};
 };
@@ -0,0 +1,294 @@
+#include "AabbTree.h"
+
+#include <algorithm>
+
+
+i32 AabbTree::Insert(const AABB& bounds, i32 userData)
+{
+	const i32 proxy = AllocateNode();
+	_nodes[proxy].Bounds = bounds.Expand(_margin);
+	_nodes[proxy].UserData = userData;
+	_nodes[proxy].Height = 0;
+
+	InsertLeaf(proxy);
+	_leafCount++;
+
+	return proxy;
+}
+
+void AabbTree::Remove(i32 proxy)
+{
+	assert(proxy >= 0 && proxy < (i32)_nodes.size());
+	assert(_nodes[proxy].IsLeaf());
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	_leafCount--;
+}
+
+bool AabbTree::Move(i32 proxy, const AABB& bounds)
+{
+	assert(proxy >= 0 && proxy < (i32)_nodes.size());
+	assert(_nodes[proxy].IsLeaf());
+
+	if (_nodes[proxy].Bounds.Contains(bounds))
+		return false;
+
+	RemoveLeaf(proxy);
+	_nodes[proxy].Bounds = bounds.Expand(_margin);
+	InsertLeaf(proxy);
+
+	return true;
+}
+
+i32 AabbTree::AllocateNode()
+{
+	if (_freeList == NullNode)
+	{
+		_nodes.emplace_back();
+		return (i32)_nodes.size() - 1;
+	}
+
+	const i32 index = _freeList;
+	_freeList = _nodes[index].Parent;
+	_nodes[index] = Node{};
+	return index;
+}
+
+void AabbTree::FreeNode(i32 index)
+{
+	_nodes[index] = Node{};
+	_nodes[index].Parent = _freeList;
+	_freeList = index;
+}
+
+void AabbTree::InsertLeaf(i32 leaf)
+{
+	if (_root == NullNode)
+	{
+		_root = leaf;
+		_nodes[leaf].Parent = NullNode;
+		return;
+	}
+
+
+	// Descend to the sibling that minimises the surface area added to the tree
+	const AABB leafBounds = _nodes[leaf].Bounds;
+	i32 index = _root;
+	while (!_nodes[index].IsLeaf())
+	{
+		const Node& node = _nodes[index];
+
+		const f32 area = node.Bounds.SurfaceArea();
+		const f32 combinedArea = AABB::Merge(node.Bounds, leafBounds).SurfaceArea();
+
+		// Cost of creating a new parent for this node and the new leaf
+		const f32 cost = 2.f * combinedArea;
+
+		// Minimum cost of pushing the leaf further down the tree
+		const f32 inheritanceCost = 2.f * (combinedArea - area);
+
+		auto DescendCost = [&](i32 child)
+		{
+			const AABB& childBounds = _nodes[child].Bounds;
+			const f32 mergedArea = AABB::Merge(childBounds, leafBounds).SurfaceArea();
+			return _nodes[child].IsLeaf()
+				? mergedArea + inheritanceCost
+				: mergedArea - childBounds.SurfaceArea() + inheritanceCost;
+		};
+		const f32 costLeft = DescendCost(node.Left);
+		const f32 costRight = DescendCost(node.Right);
+
+		if (cost < costLeft && cost < costRight)
+			break;
+
+		index = costLeft < costRight ? node.Left : node.Right;
+	}
+
+
+	// Replace the sibling with a new parent of both. Allocating may grow _nodes, so no references are held across it.
+	const i32 sibling = index;
+	const i32 oldParent = _nodes[sibling].Parent;
+	const i32 newParent = AllocateNode();
+	_nodes[newParent].Parent = oldParent;
+	_nodes[newParent].Bounds = AABB::Merge(leafBounds, _nodes[sibling].Bounds);
+	_nodes[newParent].Height = _nodes[sibling].Height + 1;
+	_nodes[newParent].Left = sibling;
+	_nodes[newParent].Right = leaf;
+	_nodes[sibling].Parent = newParent;
+	_nodes[leaf].Parent = newParent;
+
+	if (oldParent == NullNode)
+	{
+		_root = newParent;
+	}
+	else if (_nodes[oldParent].Left == sibling)
+	{
+		_nodes[oldParent].Left = newParent;
+	}
+	else
+	{
+		_nodes[oldParent].Right = newParent;
+	}
+
+	Refit(_nodes[leaf].Parent);
+}
+
+void AabbTree::RemoveLeaf(i32 leaf)
+{
+	if (leaf == _root)
+	{
+		_root = NullNode;
+		return;
+	}
+
+	const i32 parent = _nodes[leaf].Parent;
+	const i32 grandParent = _nodes[parent].Parent;
+	const i32 sibling = _nodes[parent].Left == leaf ? _nodes[parent].Right : _nodes[parent].Left;
+
+	// Collapse the parent, promoting the sibling into its slot
+	if (grandParent == NullNode)
+	{
+		_root = sibling;
+		_nodes[sibling].Parent = NullNode;
+		FreeNode(parent);
+		return;
+	}
+
+	if (_nodes[grandParent].Left == parent)
+	{
+		_nodes[grandParent].Left = sibling;
+	}
+	else
+	{
+		_nodes[grandParent].Right = sibling;
+	}
+	_nodes[sibling].Parent = grandParent;
+	FreeNode(parent);
+
+	Refit(grandParent);
+}
+
+void AabbTree::Refit(i32 index)
+{
+	// Walk back up to the root fixing bounds and heights, rebalancing on the way
+	while (index != NullNode)
+	{
+		index = Balance(index);
+
+		Node& node = _nodes[index];
+		const Node& left = _nodes[node.Left];
+		const Node& right = _nodes[node.Right];
+		node.Height = 1 + std::max(left.Height, right.Height);
+		node.Bounds = AABB::Merge(left.Bounds, right.Bounds);
+
+		index = node.Parent;
+	}
+}
+
+i32 AabbTree::Balance(i32 iA)
+{
+	// Performs a left or right rotation if node A is imbalanced. Returns the new root of the subtree.
+	Node& a = _nodes[iA];
+	if (a.IsLeaf() || a.Height < 2)
+		return iA;
+
+	const i32 iB = a.Left;
+	const i32 iC = a.Right;
+	Node& b = _nodes[iB];
+	Node& c = _nodes[iC];
+
+	const i32 balance = c.Height - b.Height;
+
+	auto ReplaceChild = [&](i32 parent, i32 oldChild, i32 newChild)
+	{
+		if (parent == NullNode)
+		{
+			_root = newChild;
+		}
+		else if (_nodes[parent].Left == oldChild)
+		{
+			_nodes[parent].Left = newChild;
+		}
+		else
+		{
+			_nodes[parent].Right = newChild;
+		}
+	};
+
+	// Rotate C up
+	if (balance > 1)
+	{
+		const i32 iF = c.Left;
+		const i32 iG = c.Right;
+		Node& f = _nodes[iF];
+		Node& g = _nodes[iG];
+
+		c.Left = iA;
+		c.Parent = a.Parent;
+		a.Parent = iC;
+		ReplaceChild(c.Parent, iA, iC);
+
+		if (f.Height > g.Height)
+		{
+			c.Right = iF;
+			a.Right = iG;
+			g.Parent = iA;
+			a.Bounds = AABB::Merge(b.Bounds, g.Bounds);
+			c.Bounds = AABB::Merge(a.Bounds, f.Bounds);
+			a.Height = 1 + std::max(b.Height, g.Height);
+			c.Height = 1 + std::max(a.Height, f.Height);
+		}
+		else
+		{
+			c.Right = iG;
+			a.Right = iF;
+			f.Parent = iA;
+			a.Bounds = AABB::Merge(b.Bounds, f.Bounds);
+			c.Bounds = AABB::Merge(a.Bounds, g.Bounds);
+			a.Height = 1 + std::max(b.Height, f.Height);
+			c.Height = 1 + std::max(a.Height, g.Height);
+		}
+
+		return iC;
+	}
+
+	// Rotate B up
+	if (balance < -1)
+	{
+		const i32 iD = b.Left;
+		const i32 iE = b.Right;
+		Node& d = _nodes[iD];
+		Node& e = _nodes[iE];
+
+		b.Left = iA;
+		b.Parent = a.Parent;
+		a.Parent = iB;
+		ReplaceChild(b.Parent, iA, iB);
+
+		if (d.Height > e.Height)
+		{
+			b.Right = iD;
+			a.Left = iE;
+			e.Parent = iA;
+			a.Bounds = AABB::Merge(c.Bounds, e.Bounds);
+			b.Bounds = AABB::Merge(a.Bounds, d.Bounds);
+			a.Height = 1 + std::max(c.Height, e.Height);
+			b.Height = 1 + std::max(a.Height, d.Height);
+		}
+		else
+		{
+			b.Right = iE;
+			a.Left = iD;
+			d.Parent = iA;
+			a.Bounds = AABB::Merge(c.Bounds, d.Bounds);
+			b.Bounds = AABB::Merge(a.Bounds, e.Bounds);
+			a.Height = 1 + std::max(c.Height, d.Height);
+			b.Height = 1 + std::max(a.Height, e.Height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
@@ -4,9 +4,11 @@
 #include <Framework/Material.h>
 #include <Framework/CommonRenderer.h>
 
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <iostream>
+#include <limits>
 
 std::optional<RenderableComponent> SceneManager::LoadRenderableComponentFromFile(const std::string& path)
 {
@@ -174,6 +176,38 @@ std::vector<Material*> SceneManager::GetMaterials() const
 	return mats;
 }
 
+void SceneManager::AddEntity(std::unique_ptr<Entity> e)
+{
+	Entity* entity = e.get();
+	_entities.emplace_back(std::move(e));
+	entity->Transform.SetListener(this, entity->Id);
+
+	if (entity->Light.has_value())
+	{
+		_lightEntities.emplace_back(entity);
+	}
+
+	if (entity->Renderable.has_value())
+	{
+		if (entity->Renderable->GetBounds().IsEmpty())
+		{
+			_unboundedEntities.emplace_back(entity);
+			_changedBounds.emplace_back();
+		}
+		else
+		{
+			const AABB bounds = ComputeWorldBounds(*entity);
+
+			SpatialEntry entry{};
+			entry.Entity = entity;
+			entry.TransformVersion = entity->Transform.GetVersion();
+			entry.Proxy = _entityTree.Insert(bounds, entity->Id);
+			_spatialEntries.emplace(entity->Id, entry);
+			_changedBounds.emplace_back(bounds);
+		}
+	}
+}
+
 void SceneManager::RemoveEntity(int entId)
 {
 	// Find item
@@ -197,16 +231,132 @@ void SceneManager::RemoveEntity(int entId)
 		// TODO Clean up rendereable shit
 	}
 
+	const auto spatialIt = _spatialEntries.find(entId);
+	if (spatialIt != _spatialEntries.end())
+	{
+		_changedBounds.emplace_back(_entityTree.GetFatBounds(spatialIt->second.Proxy));
+		_entityTree.Remove(spatialIt->second.Proxy);
+		_spatialEntries.erase(spatialIt);
+	}
+	if (std::erase(_unboundedEntities, e) > 0)
+	{
+		_changedBounds.emplace_back();
+	}
+	std::erase(_lightEntities, e);
+	e->Transform.SetListener(nullptr, 0);
+
 
 	_entities.erase(iterator);
 }
 
+void SceneManager::UpdateSpatialIndex()
+{
+	// Only entities whose transform reported a change are visited, and most of those stay within their fat bounds so
+	// Move() returns without restructuring. An entity set several times is refit once, its version is already current.
+	bool unboundedMoved = false;
+	for (const int entityId : _movedEntities)
+	{
+		const auto it = _spatialEntries.find(entityId);
+		if (it == _spatialEntries.end())
+		{
+			// Unbounded renderables aren't in the tree, lights and the like aren't spatial
+			unboundedMoved |= std::any_of(_unboundedEntities.begin(), _unboundedEntities.end(),
+				[entityId](const Entity* entity) { return entity->Id == entityId; });
+			continue;
+		}
+
+		auto& entry = it->second;
+		const u32 version = entry.Entity->Transform.GetVersion();
+		if (version == entry.TransformVersion)
+			continue;
+
+		entry.TransformVersion = version;
+		const AABB bounds = ComputeWorldBounds(*entry.Entity);
+		_changedBounds.emplace_back(_entityTree.GetFatBounds(entry.Proxy)); // Covers where it was
+		_changedBounds.emplace_back(bounds);
+		_entityTree.Move(entry.Proxy, bounds);
+	}
+	_movedEntities.clear();
+
+	if (unboundedMoved)
+	{
+		_changedBounds.emplace_back();
+	}
+}
+
+void SceneManager::OnTransformChanged(int entityId)
+{
+	_movedEntities.emplace_back(entityId);
+}
+
+void SceneManager::QueryFrustum(const Frustum& frustum, std::vector<Entity*>& outEntities) const
+{
+	_entityTree.QueryFrustum(frustum, [&](i32 entityId)
+	{
+		outEntities.emplace_back(_spatialEntries.at(entityId).Entity);
+	});
+
+	outEntities.insert(outEntities.end(), _unboundedEntities.begin(), _unboundedEntities.end());
+}
+
+AABB SceneManager::GetSceneBounds() const
+{
+	return _unboundedEntities.empty() ? _entityTree.GetRootBounds() : AABB{};
+}
+
+void SceneManager::TakeChangedBounds(std::vector<AABB>& outBounds)
+{
+	outBounds.swap(_changedBounds);
+	_changedBounds.clear();
+}
+
+void SceneManager::QueryOverlap(const AABB& bounds, std::vector<Entity*>& outEntities) const
+{
+	_entityTree.QueryOverlap(bounds, [&](i32 entityId)
+	{
+		outEntities.emplace_back(_spatialEntries.at(entityId).Entity);
+	});
+}
+
+Entity* SceneManager::Raycast(const glm::vec3& origin, const glm::vec3& direction, f32& outDistance)
+{
+	UpdateSpatialIndex();
+
+	const glm::vec3 invDirection = 1.f / direction;
+	Entity* closest = nullptr;
+	f32 closestDistance = std::numeric_limits<f32>::max();
+
+	// The tree holds fat bounds, so confirm each candidate against its tight world bounds before accepting it
+	_entityTree.QueryRay(origin, direction, closestDistance, [&](i32 entityId, f32 /*entry*/)
+	{
+		Entity* entity = _spatialEntries.at(entityId).Entity;
+
+		f32 distance;
+		if (ComputeWorldBounds(*entity).IntersectsRay(origin, invDirection, closestDistance, distance))
+		{
+			closest = entity;
+			closestDistance = distance;
+		}
+
+		return closestDistance;
+	});
+
+	outDistance = closestDistance;
+	return closest;
+}
+
+AABB SceneManager::ComputeWorldBounds(Entity& entity) const
+{
+	return entity.Renderable->GetBounds().Transform(entity.Transform.GetMatrix());
+}
+
 SkyboxResourceId SceneManager::LoadAndSetSkybox(const std::string& path)
 {
 	SkyboxResourceId id;
 	
-	// Check if skybox is already loaded
-	const auto it = _loadedSkyboxesCache.find(path);
+	// Check if skybox is already loaded at the current quality
+	const auto key = std::make_pair(path, _renderOptions.SkyboxQuality);
+	const auto it = _loadedSkyboxesCache.find(key);
 	if (it != _loadedSkyboxesCache.end())
 	{
 		id = it->second;
@@ -217,13 +367,13 @@ SkyboxResourceId SceneManager::LoadAndSetSkybox(const std::string& path)
 		std::cout << "Creating skybox " << path << std::endl;
 
 		// Create new resource
-		const auto ids = _delegate.CreateIblTextureResources(path);
+		const auto ids = _delegate.CreateIblTextureResources(path, _renderOptions.SkyboxQuality);
 		SkyboxCreateInfo createInfo = {};
 		createInfo.IblTextureIds = ids;
 		
 		id = _delegate.CreateSkybox(createInfo);
 
-		_loadedSkyboxesCache.emplace(path, id);
+		_loadedSkyboxesCache.emplace(key, id);
 	}
 
 	SetSkybox(id);
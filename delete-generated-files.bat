@@ -1,3 +1,4 @@
 rd /q /s "Bin" 2>nul
 rd /q /s "Build" 2>nul
-rd /q /s "Export" 2>nul
\ No newline at end of file
+rd /q /s "Export" 2>nul
+rd /q /s "Cache" 2>nul
\ No newline at end of file